@@ -0,0 +1,305 @@
+#include "atlas.h"
+#include "utils/timing.h"
+#include <algorithm>
+#include <cassert>
+
+// imgui builds its own static copy, this one is private to the atlas
+#define STBRP_STATIC
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "imgui/stb_rect_pack.h"
+
+struct Atlas::Packer::Page
+{
+    stbrp_context context;
+    std::vector<stbrp_node> nodes;
+    uint64_t usedArea;
+};
+
+namespace {
+    // xorshift, so the benchmark icon set is the same on every run
+    uint32_t nextRandom(uint32_t& state)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    uint32_t randomIconSize(uint32_t& state)
+    {
+        // mostly small square icons, some strips and a few large ones
+        static const uint32_t sizes[] = {16, 24, 32, 32, 48, 48, 64, 64, 96, 128};
+        return sizes[nextRandom(state) % (sizeof(sizes) / sizeof(sizes[0]))];
+    }
+
+    uint32_t countBatches(const std::vector<uint32_t>& textures)
+    {
+        uint32_t batches = 0;
+        for (size_t i = 0; i < textures.size(); ++i)
+        {
+            if (i == 0 || textures[i] != textures[i - 1])
+                batches++;
+        }
+        return batches;
+    }
+}
+
+Atlas::Packer::Packer(uint32_t pageSize, uint32_t padding, uint32_t maxPages)
+    : m_PageSize(pageSize)
+    , m_Padding(padding)
+    , m_MaxPages(maxPages)
+    , m_FreedArea(0)
+{
+    // stb_rect_pack keeps coordinates in 16 bits
+    assert(pageSize > 0 && pageSize <= 0xFFFF);
+}
+
+Atlas::Packer::~Packer()
+{
+}
+
+std::unique_ptr<Atlas::Packer::Page> Atlas::Packer::NewPage() const
+{
+    std::unique_ptr<Page> page(new Page());
+    page->nodes.resize(m_PageSize);
+    page->usedArea = 0;
+    stbrp_init_target(&page->context, m_PageSize, m_PageSize, page->nodes.data(), (int)page->nodes.size());
+    return page;
+}
+
+bool Atlas::Packer::AddPage()
+{
+    if (m_Pages.size() >= m_MaxPages)
+        return false;
+
+    m_Pages.push_back(NewPage());
+    return true;
+}
+
+Atlas::Handle Atlas::Packer::Insert(uint32_t width, uint32_t height)
+{
+    const uint32_t paddedWidth = width + 2 * m_Padding;
+    const uint32_t paddedHeight = height + 2 * m_Padding;
+    if (width == 0 || height == 0 || paddedWidth > m_PageSize || paddedHeight > m_PageSize)
+        return InvalidHandle;
+
+    stbrp_rect rect = {};
+    rect.w = (stbrp_coord)paddedWidth;
+    rect.h = (stbrp_coord)paddedHeight;
+
+    uint32_t page = 0;
+    for (;; ++page)
+    {
+        if (page == m_Pages.size() && !AddPage())
+            return InvalidHandle;
+
+        stbrp_pack_rects(&m_Pages[page]->context, &rect, 1);
+        if (rect.was_packed)
+            break;
+    }
+    m_Pages[page]->usedArea += uint64_t(paddedWidth) * paddedHeight;
+
+    Handle handle;
+    if (!m_FreeHandles.empty())
+    {
+        handle = m_FreeHandles.back();
+        m_FreeHandles.pop_back();
+    }
+    else
+    {
+        handle = Handle(m_Entries.size());
+        m_Entries.push_back(Entry());
+    }
+
+    Entry& entry = m_Entries[handle];
+    entry.region = {page, rect.x + m_Padding, rect.y + m_Padding, width, height};
+    entry.live = true;
+    return handle;
+}
+
+void Atlas::Packer::Remove(Handle handle)
+{
+    if (!IsValid(handle))
+        return;
+
+    Entry& entry = m_Entries[handle];
+    const uint64_t area = uint64_t(entry.region.width + 2 * m_Padding) * (entry.region.height + 2 * m_Padding);
+    m_Pages[entry.region.page]->usedArea -= area;
+    m_FreedArea += area;
+    entry.live = false;
+    m_FreeHandles.push_back(handle);
+}
+
+bool Atlas::Packer::IsValid(Handle handle) const
+{
+    return handle < m_Entries.size() && m_Entries[handle].live;
+}
+
+const Atlas::Region& Atlas::Packer::Get(Handle handle) const
+{
+    assert(IsValid(handle));
+    return m_Entries[handle].region;
+}
+
+std::vector<Atlas::Move> Atlas::Packer::Defragment()
+{
+    std::vector<Move> moves;
+
+    std::vector<Handle> pending;
+    for (Handle handle = 0; handle < m_Entries.size(); ++handle)
+    {
+        if (m_Entries[handle].live)
+            pending.push_back(handle);
+    }
+
+    // tallest first packs a skyline tightest; ties by width keep it deterministic
+    std::sort(pending.begin(), pending.end(), [this](Handle a, Handle b) {
+        const Region& ra = m_Entries[a].region;
+        const Region& rb = m_Entries[b].region;
+        if (ra.height != rb.height)
+            return ra.height > rb.height;
+        if (ra.width != rb.width)
+            return ra.width > rb.width;
+        return a < b;
+    });
+
+    // into new pages, the old ones stay as they are until everything is placed
+    std::vector<std::unique_ptr<Page> > pages;
+    std::vector<Region> regions(m_Entries.size());
+    std::vector<stbrp_rect> rects;
+    while (!pending.empty())
+    {
+        if (pages.size() >= m_MaxPages)
+        {
+            // packed in another order a skyline may need more room than before;
+            // then nothing moves, the holes stay until the next try
+            return moves;
+        }
+        pages.push_back(NewPage());
+        Page& page = *pages.back();
+
+        // fill one page at a time with everything that is still left
+        rects.resize(pending.size());
+        for (size_t i = 0; i < pending.size(); ++i)
+        {
+            const Region& region = m_Entries[pending[i]].region;
+            rects[i] = stbrp_rect();
+            rects[i].w = (stbrp_coord)(region.width + 2 * m_Padding);
+            rects[i].h = (stbrp_coord)(region.height + 2 * m_Padding);
+        }
+        stbrp_pack_rects(&page.context, rects.data(), (int)rects.size());
+
+        size_t left = 0;
+        for (size_t i = 0; i < pending.size(); ++i)
+        {
+            if (!rects[i].was_packed)
+            {
+                pending[left++] = pending[i];
+                continue;
+            }
+
+            const Region& region = m_Entries[pending[i]].region;
+            regions[pending[i]] = {uint32_t(pages.size() - 1), rects[i].x + m_Padding, rects[i].y + m_Padding, region.width, region.height};
+            page.usedArea += uint64_t(rects[i].w) * rects[i].h;
+        }
+        pending.resize(left);
+    }
+
+    for (Handle handle = 0; handle < m_Entries.size(); ++handle)
+    {
+        Entry& entry = m_Entries[handle];
+        const Region& region = regions[handle];
+        if (entry.live && (region.page != entry.region.page || region.x != entry.region.x || region.y != entry.region.y))
+        {
+            moves.push_back({handle, entry.region, region});
+            entry.region = region;
+        }
+    }
+
+    m_Pages.swap(pages);
+    m_FreedArea = 0;
+    return moves;
+}
+
+Atlas::Stats Atlas::Packer::GetStats() const
+{
+    Stats stats = {uint32_t(m_Pages.size()), 0, 0, m_FreedArea, 0.0f};
+    for (const Entry& entry : m_Entries)
+    {
+        if (entry.live)
+            stats.images++;
+    }
+    for (const auto& page : m_Pages)
+        stats.usedArea += page->usedArea;
+
+    const uint64_t pageArea = uint64_t(m_PageSize) * m_PageSize * m_Pages.size();
+    stats.efficiency = pageArea > 0 ? float(double(stats.usedArea) / double(pageArea)) : 0.0f;
+    return stats;
+}
+
+uint32_t Atlas::Packer::PageCount() const
+{
+    return uint32_t(m_Pages.size());
+}
+
+uint32_t Atlas::Packer::PageSize() const
+{
+    return m_PageSize;
+}
+
+Atlas::BenchmarkResult Atlas::RunBenchmark(uint32_t iconCount, uint32_t pageSize)
+{
+    BenchmarkResult result = {};
+    result.icons = iconCount;
+
+    Packer packer(pageSize, 1, 1024);
+    std::vector<Handle> handles;
+    handles.reserve(iconCount);
+    uint32_t random = 0x2468ACE1;
+
+    Timewatcher timer = Timing::Start();
+    for (uint32_t i = 0; i < iconCount; ++i)
+    {
+        uint32_t width = randomIconSize(random);
+        uint32_t height = nextRandom(random) % 4 == 0 ? width / 2 : width;
+        handles.push_back(packer.Insert(width, height));
+    }
+    result.insertMilliseconds = timer->GetNanoseconds() * 1000.0;
+
+    Stats stats = packer.GetStats();
+    result.pages = stats.pages;
+    result.efficiency = stats.efficiency;
+
+    // churn: a third goes, as many new ones come in
+    for (uint32_t i = 0; i < iconCount; i += 3)
+    {
+        packer.Remove(handles[i]);
+        uint32_t width = randomIconSize(random);
+        handles[i] = packer.Insert(width, width);
+    }
+    stats = packer.GetStats();
+    result.pagesAfterChurn = stats.pages;
+    result.efficiencyAfterChurn = stats.efficiency;
+
+    timer = Timing::Start();
+    result.moved = uint32_t(packer.Defragment().size());
+    result.defragmentMilliseconds = timer->GetNanoseconds() * 1000.0;
+    stats = packer.GetStats();
+    result.pagesAfterDefragment = stats.pages;
+    result.efficiencyAfterDefragment = stats.efficiency;
+
+    // every icon once, in random order: its own texture vs its atlas page
+    std::vector<uint32_t> perImage, perPage;
+    for (uint32_t i = 0; i < iconCount; ++i)
+    {
+        Handle handle = handles[nextRandom(random) % iconCount];
+        if (!packer.IsValid(handle))
+            continue;
+        perImage.push_back(handle);
+        perPage.push_back(packer.Get(handle).page);
+    }
+    result.batchesPerImage = countBatches(perImage);
+    result.batchesPerPage = countBatches(perPage);
+
+    return result;
+}
@@ -0,0 +1,109 @@
+/* Atlas packing
+ *
+ * Packs small images into square pages with stb_rect_pack's skyline packer.
+ * Insert() adds to the existing pages and only opens a new one when nothing
+ * fits; Remove() frees the handle, but a skyline can't take space back, so
+ * the hole stays until Defragment() repacks every live image tallest first
+ * and reports which ones moved.
+ *
+ * Regions exclude the padding kept around every image against filtering
+ * bleed. Handles are reused after Remove().
+ *
+ * Only rectangles in here, the pixels and GL pages are TextureAtlas' job,
+ * so packing and the benchmark run on a host.
+ */
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace Atlas
+{
+	typedef uint32_t Handle;
+	const Handle InvalidHandle = 0xFFFFFFFF;
+
+	struct Region
+	{
+		uint32_t page;
+		uint32_t x, y;
+		uint32_t width, height;
+	};
+
+	struct Move
+	{
+		Handle handle;
+		Region from;
+		Region to;
+	};
+
+	struct Stats
+	{
+		uint32_t pages;
+		uint32_t images;
+		uint64_t usedArea;  // live images, padding included
+		uint64_t freedArea; // removed since the last Defragment, not reusable yet
+		float efficiency;   // usedArea over the area of all pages
+	};
+
+	class Packer
+	{
+	public:
+		Packer(uint32_t pageSize, uint32_t padding = 1, uint32_t maxPages = 16);
+		~Packer();
+
+		// InvalidHandle if the image is larger than a page or all pages are full
+		Handle Insert(uint32_t width, uint32_t height);
+		void Remove(Handle handle);
+		bool IsValid(Handle handle) const;
+		const Region& Get(Handle handle) const;
+
+		// repacks into as few pages as possible; pages past the last used one are
+		// dropped. If the repack would need more than maxPages nothing moves
+		std::vector<Move> Defragment();
+
+		Stats GetStats() const;
+		uint32_t PageCount() const;
+		uint32_t PageSize() const;
+
+	private:
+		struct Page;
+		struct Entry
+		{
+			Region region;
+			bool live;
+		};
+
+		std::unique_ptr<Page> NewPage() const;
+		bool AddPage();
+
+		uint32_t m_PageSize;
+		uint32_t m_Padding;
+		uint32_t m_MaxPages;
+		std::vector<std::unique_ptr<Page> > m_Pages;
+		std::vector<Entry> m_Entries;
+		std::vector<Handle> m_FreeHandles;
+		uint64_t m_FreedArea;
+	};
+
+	struct BenchmarkResult
+	{
+		uint32_t icons;
+		uint32_t pages;
+		float efficiency;
+		// after removing a third of the icons and inserting as many new ones
+		uint32_t pagesAfterChurn;
+		float efficiencyAfterChurn;
+		uint32_t pagesAfterDefragment;
+		float efficiencyAfterDefragment;
+		uint32_t moved;
+		// texture switches drawing every icon once in random order
+		uint32_t batchesPerImage;
+		uint32_t batchesPerPage;
+		double insertMilliseconds;
+		double defragmentMilliseconds;
+	};
+
+	// a synthetic icon set, 16 to 128 pixels, the same on every run
+	BenchmarkResult RunBenchmark(uint32_t iconCount, uint32_t pageSize);
+}
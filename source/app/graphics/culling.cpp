@@ -0,0 +1,156 @@
+#include "culling.h"
+#include <cmath>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CULLING_NEON
+#elif defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define CULLING_SSE
+#endif
+
+namespace {
+    void normalize(float plane[4])
+    {
+        float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0.0f)
+        {
+            for (int i = 0; i < 4; ++i)
+                plane[i] /= length;
+        }
+    }
+
+    // the products are kept in separate statements so the compiler can't fuse them
+    // into FMAs here and not in the SIMD version, which would move results at the edges
+    float distance(const float plane[4], float x, float y, float z)
+    {
+        float dx = plane[0] * x;
+        float dy = plane[1] * y;
+        float dz = plane[2] * z;
+        float sum = dx + dy;
+        sum = sum + dz;
+        return sum + plane[3];
+    }
+
+#if defined(CULLING_NEON)
+    uint32_t moveMask(uint32x4_t mask)
+    {
+        static const uint32_t bits[4] = {1, 2, 4, 8};
+        uint32x4_t selected = vandq_u32(mask, vld1q_u32(bits));
+        uint32x2_t pairs = vadd_u32(vget_low_u32(selected), vget_high_u32(selected));
+        return vget_lane_u32(vpadd_u32(pairs, pairs), 0);
+    }
+
+    uint32_t insideMask(const Culling::Frustum& frustum, const Culling::Bounds* bounds)
+    {
+        // deinterleaves four spheres into x, y, z and radius lanes
+        float32x4x4_t spheres = vld4q_f32(&bounds->x);
+        float32x4_t negativeRadius = vnegq_f32(spheres.val[3]);
+
+        uint32x4_t inside = vdupq_n_u32(0xFFFFFFFF);
+        for (int p = 0; p < 6; ++p)
+        {
+            const float* plane = frustum.planes[p];
+            float32x4_t dx = vmulq_n_f32(spheres.val[0], plane[0]);
+            float32x4_t dy = vmulq_n_f32(spheres.val[1], plane[1]);
+            float32x4_t dz = vmulq_n_f32(spheres.val[2], plane[2]);
+            float32x4_t sum = vaddq_f32(vaddq_f32(dx, dy), dz);
+            sum = vaddq_f32(sum, vdupq_n_f32(plane[3]));
+            inside = vandq_u32(inside, vcgeq_f32(sum, negativeRadius));
+        }
+
+        return moveMask(inside);
+    }
+#elif defined(CULLING_SSE)
+    uint32_t insideMask(const Culling::Frustum& frustum, const Culling::Bounds* bounds)
+    {
+        __m128 x = _mm_loadu_ps(&bounds[0].x);
+        __m128 y = _mm_loadu_ps(&bounds[1].x);
+        __m128 z = _mm_loadu_ps(&bounds[2].x);
+        __m128 radius = _mm_loadu_ps(&bounds[3].x);
+        _MM_TRANSPOSE4_PS(x, y, z, radius);
+        __m128 negativeRadius = _mm_sub_ps(_mm_setzero_ps(), radius);
+
+        int inside = 0xF;
+        for (int p = 0; p < 6; ++p)
+        {
+            const float* plane = frustum.planes[p];
+            __m128 dx = _mm_mul_ps(x, _mm_set1_ps(plane[0]));
+            __m128 dy = _mm_mul_ps(y, _mm_set1_ps(plane[1]));
+            __m128 dz = _mm_mul_ps(z, _mm_set1_ps(plane[2]));
+            __m128 sum = _mm_add_ps(_mm_add_ps(dx, dy), dz);
+            sum = _mm_add_ps(sum, _mm_set1_ps(plane[3]));
+            inside &= _mm_movemask_ps(_mm_cmpge_ps(sum, negativeRadius));
+        }
+
+        return (uint32_t)inside;
+    }
+#endif
+}
+
+Culling::Frustum Culling::FromMatrix(const float m[16])
+{
+    // row i of a column-major matrix is m[i], m[4 + i], m[8 + i], m[12 + i]
+    Frustum frustum;
+    for (int c = 0; c < 4; ++c)
+    {
+        float row0 = m[c * 4 + 0];
+        float row1 = m[c * 4 + 1];
+        float row2 = m[c * 4 + 2];
+        float row3 = m[c * 4 + 3];
+
+        frustum.planes[0][c] = row3 + row0; // left
+        frustum.planes[1][c] = row3 - row0; // right
+        frustum.planes[2][c] = row3 + row1; // top, y points down in Vulkan clip space
+        frustum.planes[3][c] = row3 - row1; // bottom
+        frustum.planes[4][c] = row2;        // near, depth starts at 0
+        frustum.planes[5][c] = row3 - row2; // far
+    }
+
+    for (auto& plane : frustum.planes)
+        normalize(plane);
+
+    return frustum;
+}
+
+bool Culling::IsVisible(const Frustum& frustum, const Bounds& bounds)
+{
+    for (const auto& plane : frustum.planes)
+    {
+        if (distance(plane, bounds.x, bounds.y, bounds.z) < -bounds.radius)
+            return false;
+    }
+    return true;
+}
+
+uint32_t Culling::CullScalar(const Frustum& frustum, const Bounds* bounds, const DrawCommand* draws, uint32_t count, DrawCommand* out)
+{
+    uint32_t visible = 0;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        if (IsVisible(frustum, bounds[i]))
+            out[visible++] = draws[i];
+    }
+    return visible;
+}
+
+uint32_t Culling::Cull(const Frustum& frustum, const Bounds* bounds, const DrawCommand* draws, uint32_t count, DrawCommand* out)
+{
+#if defined(CULLING_NEON) || defined(CULLING_SSE)
+    uint32_t visible = 0;
+    uint32_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        uint32_t mask = insideMask(frustum, bounds + i);
+        while (mask)
+        {
+            out[visible++] = draws[i + __builtin_ctz(mask)];
+            mask &= mask - 1;
+        }
+    }
+
+    return visible + CullScalar(frustum, bounds + i, draws + i, count - i, out + visible);
+#else
+    return CullScalar(frustum, bounds, draws, count, out);
+#endif
+}
@@ -0,0 +1,47 @@
+/* Frustum culling and draw compaction
+ *
+ * The CPU side of the GPU-driven path: the same test cull.comp runs, over the
+ * same data layout, so its output can be checked against the GPU's and used
+ * when compute isn't available. Four bounding spheres are tested at a time
+ * with NEON or SSE where the compiler has them.
+ */
+#pragma once
+#include <cstdint>
+
+namespace Culling
+{
+	// bounding sphere, one vec4 in the bounds storage buffer
+	struct Bounds
+	{
+		float x, y, z;
+		float radius;
+	};
+
+	// same layout as VkDrawIndexedIndirectCommand
+	struct DrawCommand
+	{
+		uint32_t indexCount;
+		uint32_t instanceCount;
+		uint32_t firstIndex;
+		int32_t vertexOffset;
+		uint32_t firstInstance;
+	};
+
+	// planes as (nx, ny, nz, d), pointing inwards, so a point p is inside when dot(n, p) + d >= 0
+	struct Frustum
+	{
+		float planes[6][4];
+	};
+
+	// Gribb-Hartmann extraction from a column-major view-projection matrix with 0..1 depth
+	Frustum FromMatrix(const float viewProjection[16]);
+
+	bool IsVisible(const Frustum& frustum, const Bounds& bounds);
+
+	// Writes the draws whose bounds touch the frustum to 'out', in input order, and
+	// returns how many there are. Scalar reference version.
+	uint32_t CullScalar(const Frustum& frustum, const Bounds* bounds, const DrawCommand* draws, uint32_t count, DrawCommand* out);
+
+	// Same result as CullScalar, using SIMD when it's available
+	uint32_t Cull(const Frustum& frustum, const Bounds* bounds, const DrawCommand* draws, uint32_t count, DrawCommand* out);
+}
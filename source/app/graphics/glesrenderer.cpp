@@ -0,0 +1,305 @@
+#include "glesrenderer.h"
+#include "graphics.h"
+#include "shader.h"
+#include "texture.h"
+#include "glstate.h"
+#include "gldebug.h"
+#include "egl.h"
+#include "utils/log.h"
+#include <GLES2/gl2.h>
+#include <cstddef>
+
+namespace {
+    const size_t NoAttributes = ~size_t(0);
+
+    GLenum Target(Renderer::BufferUsage usage)
+    {
+        return usage == Renderer::BufferUsage::Index ? GL_ELEMENT_ARRAY_BUFFER : GL_ARRAY_BUFFER;
+    }
+}
+
+Renderer::GlesBackend::GlesBackend()
+    : m_Initialized(false)
+    , m_Program(nullptr)
+    , m_VertexBuffer(0)
+    , m_VertexOffset(0)
+    , m_IndexBuffer(0)
+    , m_IndexOffset(0)
+    , m_AttributeBase(NoAttributes)
+{
+}
+
+Renderer::GlesBackend::~GlesBackend()
+{
+    Destroy();
+}
+
+Renderer::Api Renderer::GlesBackend::GetApi() const
+{
+    return Api::Gles;
+}
+
+bool Renderer::GlesBackend::Initialize(ANativeWindow* window)
+{
+    if (!Graphics::Initialize(window))
+    {
+        LOGE("Unable to initialize Graphics!");
+        return false;
+    }
+
+    m_Initialized = true;
+    return true;
+}
+
+void Renderer::GlesBackend::Destroy()
+{
+    if (!m_Initialized)
+    {
+        return;
+    }
+
+    m_Buffers.ForEach([](BufferId, Buffer& buffer)
+    {
+        GlState::ForgetBuffer(buffer.object);
+        CHECK_GL(glDeleteBuffers(1, &buffer.object));
+    });
+    m_Buffers = Slots<Buffer>();
+    //the textures go with their Texture objects
+    m_Textures = Slots<std::unique_ptr<Texture> >();
+    m_Pipelines = Slots<PipelineDesc>();
+
+    Graphics::Destroy();
+    m_Initialized = false;
+}
+
+Renderer::BufferId Renderer::GlesBackend::CreateBuffer(BufferUsage usage, uint32_t size, bool dynamic)
+{
+    Buffer buffer = {0, usage, size, dynamic};
+    CHECK_GL(glGenBuffers(1, &buffer.object));
+    CHECK_GL(GlState::BindBuffer(Target(usage), buffer.object));
+    CHECK_GL(glBufferData(Target(usage), size, nullptr, dynamic ? GL_STREAM_DRAW : GL_STATIC_DRAW));
+    return m_Buffers.Add(std::move(buffer));
+}
+
+bool Renderer::GlesBackend::UpdateBuffer(BufferId buffer, uint32_t offset, const void* data, uint32_t size)
+{
+    Buffer* target = m_Buffers.Get(buffer);
+    if (!target || offset + size > target->size)
+    {
+        return false;
+    }
+
+    CHECK_GL(GlState::BindBuffer(Target(target->usage), target->object));
+    if (target->dynamic && offset == 0)
+    {
+        //a new frame's contents, the GPU may still read last frame's from the old storage
+        CHECK_GL(glBufferData(Target(target->usage), target->size, nullptr, GL_STREAM_DRAW));
+    }
+    CHECK_GL(glBufferSubData(Target(target->usage), offset, size, data));
+
+    m_Stats.uploadBytes += size;
+    return true;
+}
+
+void Renderer::GlesBackend::DestroyBuffer(BufferId buffer)
+{
+    Buffer* target = m_Buffers.Get(buffer);
+    if (target)
+    {
+        GlState::ForgetBuffer(target->object);
+        CHECK_GL(glDeleteBuffers(1, &target->object));
+        m_Buffers.Remove(buffer);
+    }
+}
+
+Renderer::TextureId Renderer::GlesBackend::CreateTexture(uint32_t width, uint32_t height, const unsigned char* pixels)
+{
+    std::unique_ptr<Texture> texture(new Texture());
+    //the raw path only reads the pixels
+    texture->LoadFromBuffer(TextureFormat::Raw, const_cast<unsigned char*>(pixels), width, height);
+    m_Stats.uploadBytes += uint64_t(width) * height * 4;
+    return m_Textures.Add(std::move(texture));
+}
+
+void Renderer::GlesBackend::DestroyTexture(TextureId texture)
+{
+    m_Textures.Remove(texture);
+}
+
+Renderer::PipelineId Renderer::GlesBackend::CreatePipeline(const PipelineDesc& desc)
+{
+    PipelineDesc copy = desc;
+    return m_Pipelines.Add(std::move(copy));
+}
+
+void Renderer::GlesBackend::DestroyPipeline(PipelineId pipeline)
+{
+    m_Pipelines.Remove(pipeline);
+}
+
+unsigned Renderer::GlesBackend::ReloadShaders(const std::vector<std::string>& paths)
+{
+    if (!m_Initialized)
+    {
+        return 0;
+    }
+
+    //pipelines look their program up by name on every apply, the next frame draws with the new ones
+    const unsigned reloaded = Graphics::ReloadShaders(paths);
+    if (reloaded > 0)
+    {
+        //may be the one just deleted
+        m_Program = nullptr;
+    }
+    return reloaded;
+}
+
+bool Renderer::GlesBackend::BeginFrame()
+{
+    if (!m_Initialized)
+    {
+        return false;
+    }
+
+    Graphics::BeginFrame();
+    ResetFrameState();
+    m_Program = nullptr;
+    m_AttributeBase = NoAttributes;
+
+    CHECK_GL(GlState::SetVertexAttribArray((GLuint)Shader::Attribute::Position, true));
+    CHECK_GL(GlState::SetVertexAttribArray((GLuint)Shader::Attribute::TexCoord, true));
+    CHECK_GL(GlState::SetVertexAttribArray((GLuint)Shader::Attribute::Color, true));
+    return true;
+}
+
+void Renderer::GlesBackend::Submit(const DrawList& list)
+{
+    Execute(list);
+}
+
+void Renderer::GlesBackend::EndFrame()
+{
+    //back to what the gui expects
+    CHECK_GL(GlState::SetEnabled(GL_SCISSOR_TEST, false));
+    CHECK_GL(GlState::SetEnabled(GL_BLEND, true));
+    CHECK_GL(GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+
+    Graphics::EndFrame();
+    FinishFrameStats();
+}
+
+bool Renderer::GlesBackend::ApplyPipeline(PipelineId pipeline)
+{
+    PipelineDesc* desc = m_Pipelines.Get(pipeline);
+    Shader::Program* program = desc ? Graphics::GetShader(desc->shader.c_str()) : nullptr;
+    m_Program = program;
+    if (!program)
+    {
+        return false;
+    }
+
+    program->Use();
+    CHECK_GL(glUniformMatrix4fv(program->GetUniform(Shader::Uniform::ProjMatrix), 1, GL_FALSE, Graphics::GetProjection()));
+    CHECK_GL(glUniform1i(program->GetUniform(Shader::Uniform::Texture), 0));
+
+    switch (desc->blend)
+    {
+    case Blend::Opaque:
+        CHECK_GL(GlState::SetEnabled(GL_BLEND, false));
+        break;
+    case Blend::Alpha:
+        CHECK_GL(GlState::SetEnabled(GL_BLEND, true));
+        CHECK_GL(GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+        break;
+    case Blend::Additive:
+        CHECK_GL(GlState::SetEnabled(GL_BLEND, true));
+        CHECK_GL(GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE));
+        break;
+    }
+    return true;
+}
+
+bool Renderer::GlesBackend::ApplyVertexBuffer(BufferId buffer, uint32_t offset)
+{
+    Buffer* target = m_Buffers.Get(buffer);
+    if (!target || target->usage != BufferUsage::Vertex)
+    {
+        return false;
+    }
+
+    CHECK_GL(GlState::BindBuffer(GL_ARRAY_BUFFER, target->object));
+    m_VertexBuffer = target->object;
+    m_VertexOffset = offset;
+    m_AttributeBase = NoAttributes;
+    return true;
+}
+
+bool Renderer::GlesBackend::ApplyIndexBuffer(BufferId buffer, uint32_t offset)
+{
+    Buffer* target = m_Buffers.Get(buffer);
+    if (!target || target->usage != BufferUsage::Index)
+    {
+        return false;
+    }
+
+    CHECK_GL(GlState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, target->object));
+    m_IndexBuffer = target->object;
+    m_IndexOffset = offset;
+    return true;
+}
+
+bool Renderer::GlesBackend::ApplyTexture(TextureId texture)
+{
+    std::unique_ptr<Texture>* target = m_Textures.Get(texture);
+    if (!target)
+    {
+        return false;
+    }
+
+    //the programs sample unit 0, set with the pipeline
+    CHECK_GL(GlState::BindTexture(0, (*target)->GetObject()));
+    return true;
+}
+
+void Renderer::GlesBackend::ApplyScissor(int32_t x, int32_t y, uint32_t width, uint32_t height)
+{
+    if (width == 0)
+    {
+        CHECK_GL(GlState::SetEnabled(GL_SCISSOR_TEST, false));
+        return;
+    }
+
+    //GL counts from the bottom
+    CHECK_GL(GlState::SetEnabled(GL_SCISSOR_TEST, true));
+    CHECK_GL(GlState::Scissor(x, EGL::GetHeight() - y - (GLint)height, width, height));
+}
+
+void Renderer::GlesBackend::ApplyDraw(uint32_t vertexCount, uint32_t firstVertex)
+{
+    SetAttributes(m_VertexOffset);
+    CHECK_GL(glDrawArrays(GL_TRIANGLES, firstVertex, vertexCount));
+}
+
+void Renderer::GlesBackend::ApplyDrawIndexed(uint32_t indexCount, uint32_t firstIndex, uint32_t vertexOffset)
+{
+    //no base vertex in GLES2, the attribute pointers move instead
+    SetAttributes(m_VertexOffset + size_t(vertexOffset) * sizeof(Vertex));
+    //UpdateBuffer may have bound another one since
+    CHECK_GL(GlState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_IndexBuffer));
+    CHECK_GL(glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_SHORT, (const GLvoid*)(size_t(m_IndexOffset) + size_t(firstIndex) * sizeof(uint16_t))));
+}
+
+void Renderer::GlesBackend::SetAttributes(size_t base)
+{
+    if (base == m_AttributeBase)
+    {
+        return;
+    }
+
+    //the pointers capture whatever is bound
+    CHECK_GL(GlState::BindBuffer(GL_ARRAY_BUFFER, m_VertexBuffer));
+    CHECK_GL(glVertexAttribPointer((GLuint)Shader::Attribute::Position, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*)(base + offsetof(Vertex, x))));
+    CHECK_GL(glVertexAttribPointer((GLuint)Shader::Attribute::TexCoord, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*)(base + offsetof(Vertex, u))));
+    CHECK_GL(glVertexAttribPointer((GLuint)Shader::Attribute::Color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (const GLvoid*)(base + offsetof(Vertex, color))));
+    m_AttributeBase = base;
+}
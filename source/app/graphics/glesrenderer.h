@@ -0,0 +1,79 @@
+/* GLES renderer backend
+ *
+ * Runs on top of Graphics: BeginFrame()/EndFrame() clear, draw the gui and
+ * swap, the lists are executed right away in between. Pipelines name one
+ * of Graphics' programs; until that one has linked, GetShader() hands out
+ * the default one.
+ */
+#pragma once
+
+#include "renderer.h"
+#include "slots.h"
+
+class Texture;
+
+namespace Shader
+{
+	class Program;
+}
+
+namespace Renderer
+{
+	class GlesBackend : public Backend
+	{
+	public:
+		GlesBackend();
+		virtual ~GlesBackend();
+
+		virtual Api GetApi() const;
+		virtual bool Initialize(ANativeWindow* window);
+		virtual void Destroy();
+
+		virtual BufferId CreateBuffer(BufferUsage usage, uint32_t size, bool dynamic);
+		virtual bool UpdateBuffer(BufferId buffer, uint32_t offset, const void* data, uint32_t size);
+		virtual void DestroyBuffer(BufferId buffer);
+		virtual TextureId CreateTexture(uint32_t width, uint32_t height, const unsigned char* pixels);
+		virtual void DestroyTexture(TextureId texture);
+		virtual PipelineId CreatePipeline(const PipelineDesc& desc);
+		virtual void DestroyPipeline(PipelineId pipeline);
+		virtual unsigned ReloadShaders(const std::vector<std::string>& paths);
+
+		virtual bool BeginFrame();
+		virtual void Submit(const DrawList& list);
+		virtual void EndFrame();
+
+	protected:
+		virtual bool ApplyPipeline(PipelineId pipeline);
+		virtual bool ApplyVertexBuffer(BufferId buffer, uint32_t offset);
+		virtual bool ApplyIndexBuffer(BufferId buffer, uint32_t offset);
+		virtual bool ApplyTexture(TextureId texture);
+		virtual void ApplyScissor(int32_t x, int32_t y, uint32_t width, uint32_t height);
+		virtual void ApplyDraw(uint32_t vertexCount, uint32_t firstVertex);
+		virtual void ApplyDrawIndexed(uint32_t indexCount, uint32_t firstIndex, uint32_t vertexOffset);
+
+	private:
+		struct Buffer
+		{
+			unsigned int object;
+			BufferUsage usage;
+			uint32_t size;
+			bool dynamic;
+		};
+
+		// the attribute pointers, for a vertex base in bytes
+		void SetAttributes(size_t base);
+
+		bool m_Initialized;
+		Slots<Buffer> m_Buffers;
+		Slots<std::unique_ptr<Texture> > m_Textures;
+		Slots<PipelineDesc> m_Pipelines;
+
+		Shader::Program* m_Program;
+		unsigned int m_VertexBuffer;
+		uint32_t m_VertexOffset;
+		unsigned int m_IndexBuffer;
+		uint32_t m_IndexOffset;
+		// where the attribute pointers point, ~0 when they have to be set again
+		size_t m_AttributeBase;
+	};
+}
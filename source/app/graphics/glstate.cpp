@@ -0,0 +1,294 @@
+#include "glstate.h"
+#include <cstdarg>
+#include <cstdio>
+
+namespace {
+    const GLenum g_Capabilities[] = {GL_BLEND, GL_SCISSOR_TEST, GL_DEPTH_TEST, GL_CULL_FACE, GL_STENCIL_TEST};
+    const unsigned int g_CapabilityCount = sizeof(g_Capabilities) / sizeof(g_Capabilities[0]);
+
+    // a shadowed value and whether it is known to match GL
+    template <typename T>
+    struct Shadow
+    {
+        T value;
+        bool valid;
+
+        // true when the call has to go through
+        bool Set(const T& newValue)
+        {
+            if (valid && value == newValue)
+                return false;
+            value = newValue;
+            valid = true;
+            return true;
+        }
+    };
+
+    struct Rect
+    {
+        GLint x, y;
+        GLsizei width, height;
+
+        bool operator==(const Rect& other) const
+        {
+            return x == other.x && y == other.y && width == other.width && height == other.height;
+        }
+    };
+
+    struct BlendState
+    {
+        GLenum source, destination;
+
+        bool operator==(const BlendState& other) const
+        {
+            return source == other.source && destination == other.destination;
+        }
+    };
+
+    GlState::Dispatch g_Dispatch = {};
+    GlState::Counters g_Counters = {0, 0};
+    bool g_Counting = false;
+
+    Shadow<GLuint> g_Program;
+    Shadow<GLuint> g_ArrayBuffer;
+    Shadow<GLuint> g_ElementArrayBuffer;
+    Shadow<GLenum> g_ActiveTexture;
+    Shadow<GLuint> g_Textures[GlState::MaxTextureUnits];
+    Shadow<bool> g_Enabled[g_CapabilityCount];
+    Shadow<BlendState> g_Blend;
+    Shadow<Rect> g_Scissor;
+    Shadow<Rect> g_Viewport;
+    Shadow<bool> g_VertexAttribArrays[GlState::MaxVertexAttribs];
+
+    inline bool Count(bool issue)
+    {
+        if (g_Counting)
+        {
+            if (issue)
+                g_Counters.issued++;
+            else
+                g_Counters.avoided++;
+        }
+        return issue;
+    }
+
+    int CapabilityIndex(GLenum capability)
+    {
+        for (unsigned int i = 0; i < g_CapabilityCount; ++i)
+        {
+            if (g_Capabilities[i] == capability)
+                return (int)i;
+        }
+        return -1;
+    }
+
+    // mock dispatch
+    std::vector<std::string> g_MockCalls;
+
+    void Record(const char* format, ...) __attribute__((format(printf, 1, 2)));
+    void Record(const char* format, ...)
+    {
+        char call[128];
+        va_list args;
+        va_start(args, format);
+        vsnprintf(call, sizeof(call), format, args);
+        va_end(args);
+        g_MockCalls.push_back(call);
+    }
+
+    void GL_APIENTRY MockUseProgram(GLuint program) { Record("glUseProgram(%u)", program); }
+    void GL_APIENTRY MockBindBuffer(GLenum target, GLuint buffer) { Record("glBindBuffer(0x%04x, %u)", target, buffer); }
+    void GL_APIENTRY MockActiveTexture(GLenum texture) { Record("glActiveTexture(0x%04x)", texture); }
+    void GL_APIENTRY MockBindTexture(GLenum target, GLuint texture) { Record("glBindTexture(0x%04x, %u)", target, texture); }
+    void GL_APIENTRY MockEnable(GLenum cap) { Record("glEnable(0x%04x)", cap); }
+    void GL_APIENTRY MockDisable(GLenum cap) { Record("glDisable(0x%04x)", cap); }
+    void GL_APIENTRY MockBlendFunc(GLenum sfactor, GLenum dfactor) { Record("glBlendFunc(0x%04x, 0x%04x)", sfactor, dfactor); }
+    void GL_APIENTRY MockScissor(GLint x, GLint y, GLsizei width, GLsizei height) { Record("glScissor(%d, %d, %d, %d)", x, y, width, height); }
+    void GL_APIENTRY MockViewport(GLint x, GLint y, GLsizei width, GLsizei height) { Record("glViewport(%d, %d, %d, %d)", x, y, width, height); }
+    void GL_APIENTRY MockEnableVertexAttribArray(GLuint index) { Record("glEnableVertexAttribArray(%u)", index); }
+    void GL_APIENTRY MockDisableVertexAttribArray(GLuint index) { Record("glDisableVertexAttribArray(%u)", index); }
+}
+
+GlState::Dispatch GlState::GlesDispatch()
+{
+    Dispatch dispatch = {
+        glUseProgram,
+        glBindBuffer,
+        glActiveTexture,
+        glBindTexture,
+        glEnable,
+        glDisable,
+        glBlendFunc,
+        glScissor,
+        glViewport,
+        glEnableVertexAttribArray,
+        glDisableVertexAttribArray,
+    };
+    return dispatch;
+}
+
+GlState::Dispatch GlState::MockDispatch()
+{
+    Dispatch dispatch = {
+        MockUseProgram,
+        MockBindBuffer,
+        MockActiveTexture,
+        MockBindTexture,
+        MockEnable,
+        MockDisable,
+        MockBlendFunc,
+        MockScissor,
+        MockViewport,
+        MockEnableVertexAttribArray,
+        MockDisableVertexAttribArray,
+    };
+    return dispatch;
+}
+
+std::vector<std::string>& GlState::MockCalls()
+{
+    return g_MockCalls;
+}
+
+void GlState::Initialize(const Dispatch& dispatch)
+{
+    g_Dispatch = dispatch;
+    Invalidate();
+    ResetCounters();
+}
+
+void GlState::Invalidate()
+{
+    g_Program.valid = false;
+    g_ArrayBuffer.valid = false;
+    g_ElementArrayBuffer.valid = false;
+    g_ActiveTexture.valid = false;
+    for (auto& texture : g_Textures)
+        texture.valid = false;
+    for (auto& enabled : g_Enabled)
+        enabled.valid = false;
+    g_Blend.valid = false;
+    g_Scissor.valid = false;
+    g_Viewport.valid = false;
+    for (auto& attribArray : g_VertexAttribArrays)
+        attribArray.valid = false;
+}
+
+void GlState::SetCounting(bool counting)
+{
+    g_Counting = counting;
+}
+
+const GlState::Counters& GlState::GetCounters()
+{
+    return g_Counters;
+}
+
+void GlState::ResetCounters()
+{
+    g_Counters = {0, 0};
+}
+
+void GlState::UseProgram(GLuint program)
+{
+    if (Count(g_Program.Set(program)))
+        g_Dispatch.useProgram(program);
+}
+
+void GlState::BindBuffer(GLenum target, GLuint buffer)
+{
+    Shadow<GLuint>* shadow = nullptr;
+    if (target == GL_ARRAY_BUFFER)
+        shadow = &g_ArrayBuffer;
+    else if (target == GL_ELEMENT_ARRAY_BUFFER)
+        shadow = &g_ElementArrayBuffer;
+
+    if (!shadow || Count(shadow->Set(buffer)))
+        g_Dispatch.bindBuffer(target, buffer);
+}
+
+void GlState::BindTexture(unsigned int unit, GLuint texture)
+{
+    if (unit >= MaxTextureUnits)
+    {
+        g_Dispatch.activeTexture(GL_TEXTURE0 + unit);
+        g_Dispatch.bindTexture(GL_TEXTURE_2D, texture);
+        g_ActiveTexture.valid = false;
+        return;
+    }
+
+    //selected even when the texture is bound already, uploads after this go to the unit's texture
+    if (Count(g_ActiveTexture.Set(GL_TEXTURE0 + unit)))
+        g_Dispatch.activeTexture(GL_TEXTURE0 + unit);
+
+    if (Count(g_Textures[unit].Set(texture)))
+        g_Dispatch.bindTexture(GL_TEXTURE_2D, texture);
+}
+
+void GlState::SetEnabled(GLenum capability, bool enabled)
+{
+    int index = CapabilityIndex(capability);
+    if (index >= 0 && !Count(g_Enabled[index].Set(enabled)))
+        return;
+
+    if (enabled)
+        g_Dispatch.enable(capability);
+    else
+        g_Dispatch.disable(capability);
+}
+
+void GlState::BlendFunc(GLenum source, GLenum destination)
+{
+    BlendState blend = {source, destination};
+    if (Count(g_Blend.Set(blend)))
+        g_Dispatch.blendFunc(source, destination);
+}
+
+void GlState::Scissor(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    Rect rect = {x, y, width, height};
+    if (Count(g_Scissor.Set(rect)))
+        g_Dispatch.scissor(x, y, width, height);
+}
+
+void GlState::Viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+    Rect rect = {x, y, width, height};
+    if (Count(g_Viewport.Set(rect)))
+        g_Dispatch.viewport(x, y, width, height);
+}
+
+void GlState::SetVertexAttribArray(GLuint index, bool enabled)
+{
+    if (index < MaxVertexAttribs && !Count(g_VertexAttribArrays[index].Set(enabled)))
+        return;
+
+    if (enabled)
+        g_Dispatch.enableVertexAttribArray(index);
+    else
+        g_Dispatch.disableVertexAttribArray(index);
+}
+
+// a deleted program stays in use until another one is, but its name can come back
+void GlState::ForgetProgram(GLuint program)
+{
+    if (g_Program.valid && g_Program.value == program)
+        g_Program.valid = false;
+}
+
+void GlState::ForgetBuffer(GLuint buffer)
+{
+    if (g_ArrayBuffer.valid && g_ArrayBuffer.value == buffer)
+        g_ArrayBuffer.value = 0;
+    if (g_ElementArrayBuffer.valid && g_ElementArrayBuffer.value == buffer)
+        g_ElementArrayBuffer.value = 0;
+}
+
+void GlState::ForgetTexture(GLuint texture)
+{
+    for (auto& unit : g_Textures)
+    {
+        if (unit.valid && unit.value == texture)
+            unit.value = 0;
+    }
+}
@@ -0,0 +1,73 @@
+/* GL state cache
+ *
+ * Shadows the bits of GLES state the renderer touches every frame and drops
+ * calls that would not change anything. All GL calls go through a dispatch
+ * table: the real one comes from GlesDispatch(), MockDispatch() only records
+ * the calls, so the cache can be exercised on a host without a GL context.
+ *
+ * Anything that changes this state behind the cache's back (imgui user
+ * callbacks, other libraries) has to be followed by Invalidate().
+ */
+#pragma once
+#include <GLES2/gl2.h>
+#include <string>
+#include <vector>
+
+namespace GlState
+{
+	struct Dispatch
+	{
+		void (GL_APIENTRYP useProgram)(GLuint program);
+		void (GL_APIENTRYP bindBuffer)(GLenum target, GLuint buffer);
+		void (GL_APIENTRYP activeTexture)(GLenum texture);
+		void (GL_APIENTRYP bindTexture)(GLenum target, GLuint texture);
+		void (GL_APIENTRYP enable)(GLenum cap);
+		void (GL_APIENTRYP disable)(GLenum cap);
+		void (GL_APIENTRYP blendFunc)(GLenum sfactor, GLenum dfactor);
+		void (GL_APIENTRYP scissor)(GLint x, GLint y, GLsizei width, GLsizei height);
+		void (GL_APIENTRYP viewport)(GLint x, GLint y, GLsizei width, GLsizei height);
+		void (GL_APIENTRYP enableVertexAttribArray)(GLuint index);
+		void (GL_APIENTRYP disableVertexAttribArray)(GLuint index);
+	};
+
+	struct Counters
+	{
+		unsigned int issued;
+		unsigned int avoided;
+	};
+
+	const unsigned int MaxTextureUnits = 8;
+	const unsigned int MaxVertexAttribs = 16;
+
+	// the GLES entry points
+	Dispatch GlesDispatch();
+
+	// records every call as text, e.g. "glBindTexture(0x0de1, 3)"
+	Dispatch MockDispatch();
+	std::vector<std::string>& MockCalls();
+
+	// forgets all shadowed state, so the next call of each kind always goes through
+	void Initialize(const Dispatch& dispatch);
+	void Invalidate();
+
+	// counting is off by default, it costs a branch per call
+	void SetCounting(bool counting);
+	const Counters& GetCounters();
+	void ResetCounters();
+
+	void UseProgram(GLuint program);
+	void BindBuffer(GLenum target, GLuint buffer);
+	// leaves the unit active, also when the texture was bound on it already,
+	// so glTexImage2D and friends after it edit that texture
+	void BindTexture(unsigned int unit, GLuint texture);
+	void SetEnabled(GLenum capability, bool enabled);
+	void BlendFunc(GLenum source, GLenum destination);
+	void Scissor(GLint x, GLint y, GLsizei width, GLsizei height);
+	void Viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+	void SetVertexAttribArray(GLuint index, bool enabled);
+
+	// deleting a bound object unbinds it in GL, the shadow has to follow
+	void ForgetProgram(GLuint program);
+	void ForgetBuffer(GLuint buffer);
+	void ForgetTexture(GLuint texture);
+}
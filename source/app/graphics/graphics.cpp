@@ -3,12 +3,17 @@
 #include "egl.h"
 #include "gui.h"
 #include "gldebug.h"
+#include "glstate.h"
+#include "programcache.h"
 #include "utils/make_unique.h"
 #include "utils/log.h"
 #include "utils/opengl.h"
+#include "utils/timing.h"
+#include "utils/vfs.h"
 #include <map>
 #include <string>
 #include <algorithm>
+#include <cstring>
 #include <GLES2/gl2.h>
 
 namespace {
@@ -16,6 +21,72 @@ namespace {
 	float g_OrthoProjection[16];
 	GLuint g_VertexBuffer = 0;
 	GLuint g_IndexBuffer = 0;
+	unsigned int g_FrameCount = 0;
+	//looked up once, GetShader goes through the map
+	Shader::Program* g_DefaultShader = nullptr;
+	//from Initialize until the first frame with the gui in it
+	Timewatcher g_StartupTimer;
+	bool g_FirstFrameDrawn = false;
+
+	const char* g_DefaultVertexSource =
+		"#version 100\n"
+		"uniform mat4 uProjMatrix;\n"
+		"attribute vec2 aPos;\n"
+		"attribute vec2 aTex;\n"
+		"attribute vec4 aColor;\n"
+		"varying vec2 vTex;\n"
+		"varying vec4 vColor;\n"
+		"void main()\n"
+		"{\n"
+		"   gl_Position = uProjMatrix * vec4(aPos, 0, 1);\n"
+		"   vColor = aColor;\n"
+		"   vTex = aTex;\n"
+		"   \n"
+		"}\n";
+
+	const char* g_DefaultFragmentSource =
+		"#version 100\n"
+		"varying highp vec2 vTex;\n"
+		"varying highp vec4 vColor;\n"
+		"uniform sampler2D uTexture;\n"
+		"void main()\n"
+		"{\n"
+		"   gl_FragColor = vColor * texture2D(uTexture, vTex);\n"
+		"}\n"
+		"\n";
+
+	//what each program was built from, the shipped sources, for ReloadShaders
+	struct ShaderSource
+	{
+		std::string vertex;
+		std::string fragment;
+	};
+	std::map<std::string, ShaderSource> g_ShaderSources;
+
+	void Build(const std::string& name, const char* vertexSource, const char* fragmentSource)
+	{
+		g_ShaderSources[name] = {vertexSource, fragmentSource};
+		g_Shaders[name] = std::make_unique<Shader::Program>(vertexSource, fragmentSource, false);
+	}
+
+	//the file pushed for it if there is one, else what shipped
+	bool ReadSource(const std::string& path, const std::string& shipped, std::string& source)
+	{
+		auto file = Vfs::Open<Vfs::VirtualFile>(path);
+		if (!file)
+		{
+			source = shipped;
+			return true;
+		}
+		const int64_t size = file->Size();
+		source.resize(size > 0 ? size_t(size) : 0);
+		if (source.empty() || file->ReadAt(0, &source[0], size) != size)
+		{
+			LOGW("Unable to read shader %s", path.c_str());
+			return false;
+		}
+		return true;
+	}
 }
 
 bool Graphics::Initialize(ANativeWindow* window)
@@ -26,39 +97,36 @@ bool Graphics::Initialize(ANativeWindow* window)
 		return false;
 	}
 
+	g_StartupTimer = Timing::Start();
+	g_FirstFrameDrawn = false;
+	g_FrameCount = 0;
+
 	Graphics::SetBufferSize(EGL::GetWidth(), EGL::GetHeight());
 
+	//all per-frame state changes go through the cache
+	GlState::Initialize(GlState::GlesDispatch());
+#ifndef NDEBUG
+	GlState::SetCounting(true);
+#endif
+
 	//create buffers
     CHECK_GL(glGenBuffers(1, &g_VertexBuffer));
     CHECK_GL(glGenBuffers(1, &g_IndexBuffer));
 
-	//create default shader
-	g_Shaders["default"] = std::make_unique<Shader::Program>(
-        "#version 100\n"
-        "uniform mat4 uProjMatrix;\n"
-        "attribute vec2 aPos;\n"
-        "attribute vec2 aTex;\n"
-        "attribute vec4 aColor;\n"
-        "varying vec2 vTex;\n"
-        "varying vec4 vColor;\n"
-        "void main()\n"
-        "{\n"
-        "   gl_Position = uProjMatrix * vec4(aPos, 0, 1);\n"
-        "   vColor = aColor;\n"
-        "   vTex = aTex;\n"
-        "   \n"
-        "}\n"
-    ,
-        "#version 100\n"
-        "varying highp vec2 vTex;\n"
-        "varying highp vec4 vColor;\n"
-        "uniform sampler2D uTexture;\n"
-        "void main()\n"
-        "{\n"
-        "   gl_FragColor = vColor * texture2D(uTexture, vTex);\n"
-        "}\n"
-        "\n"
-    );
+	//create default shader, from the binary cache if possible;
+	//everything else is only issued here, Draw() picks the programs up once they're linked
+	ProgramCache::Initialize();
+	const bool parallelCompile = Shader::EnableParallelCompile();
+	Timewatcher shaderTimer = Timing::Start();
+
+	Build("default", g_DefaultVertexSource, g_DefaultFragmentSource);
+	g_DefaultShader = g_Shaders["default"].get();
+
+	const ProgramCache::Stats& cacheStats = ProgramCache::GetStats();
+	LOGI("Shaders issued in %.2f ms (%s start: %u cached, %u built, %u rejected, parallel compile %s)",
+		shaderTimer->GetNanoseconds() * 1000.0, cacheStats.hits > 0 ? "warm" : "cold",
+		cacheStats.hits, cacheStats.misses + cacheStats.rejected, cacheStats.rejected,
+		parallelCompile ? "on" : "off");
 
     // Check openGL on the system
     auto opengl_info = {GL_VENDOR, GL_RENDERER, GL_VERSION, GL_EXTENSIONS};
@@ -76,10 +144,10 @@ bool Graphics::Initialize(ANativeWindow* window)
     // Initialize GL state.
     //CHECK_GL(glHint(GL_PERSPECTIVE_CORRECTION_HINT, GL_FASTEST));
     //CHECK_GL(glShadeModel(GL_SMOOTH));
-    CHECK_GL(glDisable(GL_CULL_FACE));
-    CHECK_GL(glDisable(GL_DEPTH_TEST));
-    CHECK_GL(glEnable(GL_BLEND));
-    CHECK_GL(glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+    CHECK_GL(GlState::SetEnabled(GL_CULL_FACE, false));
+    CHECK_GL(GlState::SetEnabled(GL_DEPTH_TEST, false));
+    CHECK_GL(GlState::SetEnabled(GL_BLEND, true));
+    CHECK_GL(GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
 
     if (!Gui::Initialize())
     {
@@ -89,6 +157,26 @@ bool Graphics::Initialize(ANativeWindow* window)
     return true;
 }
 
+bool Graphics::HasExtension(const char* name)
+{
+	const char* extensions = (const char*)glGetString(GL_EXTENSIONS);
+	if (!extensions)
+	{
+		return false;
+	}
+
+	//whole words only, GL_OES_foo must not match GL_OES_foo_bar
+	const size_t length = strlen(name);
+	for (const char* found = strstr(extensions, name); found; found = strstr(found + length, name))
+	{
+		if ((found == extensions || found[-1] == ' ') && (found[length] == ' ' || found[length] == '\0'))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
 void Graphics::SetBufferSize(int width_, int height_)
 {
 	float width = width_;
@@ -106,41 +194,126 @@ void Graphics::SetBufferSize(int width_, int height_)
 
 Shader::Program* Graphics::GetShader(const char* name)
 {
-	if (g_Shaders.find(name) != g_Shaders.end())
+	auto shader = g_Shaders.find(name);
+	if (shader != g_Shaders.end() && shader->second->IsReady() && shader->second->Ok())
 	{
-		return g_Shaders[name].get();
+		return shader->second.get();
 	}
-	else
+
+	//substitute the default one while the requested one is still building
+	if (g_DefaultShader && g_DefaultShader->IsReady() && g_DefaultShader->Ok())
 	{
-		return g_Shaders["default"].get();
+		return g_DefaultShader;
 	}
+	return nullptr;
 }
 
-namespace {
+unsigned Graphics::ReloadShaders(const std::vector<std::string>& paths)
+{
+	unsigned reloaded = 0;
+	for (const auto& shipped : g_ShaderSources)
+	{
+		const std::string& name = shipped.first;
+		const std::string vertexPath = "shaders/gles/" + name + ".vert";
+		const std::string fragmentPath = "shaders/gles/" + name + ".frag";
+		if (std::find(paths.begin(), paths.end(), vertexPath) == paths.end() &&
+			std::find(paths.begin(), paths.end(), fragmentPath) == paths.end())
+		{
+			continue;
+		}
+
+		//a removed file brings back the shipped source
+		std::string vertexSource;
+		std::string fragmentSource;
+		if (!ReadSource(vertexPath, shipped.second.vertex, vertexSource) ||
+			!ReadSource(fragmentPath, shipped.second.fragment, fragmentSource))
+		{
+			continue;
+		}
+
+		//built right away, one that doesn't compile leaves the old one in place
+		std::unique_ptr<Shader::Program> program = std::make_unique<Shader::Program>(vertexSource.c_str(), fragmentSource.c_str(), true);
+		if (!program->Ok())
+		{
+			LOGW("Keeping shader %s, the new one doesn't build", name.c_str());
+			continue;
+		}
 
+		std::unique_ptr<Shader::Program>& current = g_Shaders[name];
+		const GLuint object = current ? current->GetObject() : 0;
+		current.swap(program);
+		program.reset();
+		if (object != 0)
+		{
+			GlState::ForgetProgram(object);
+			CHECK_GL(glDeleteProgram(object));
+		}
+		if (name == "default")
+		{
+			g_DefaultShader = current.get();
+		}
+		reloaded++;
+	}
+
+	if (reloaded > 0)
+	{
+		LOGI("Reloaded %u shaders", reloaded);
+	}
+	return reloaded;
 }
 
-void Graphics::Draw()
+const float* Graphics::GetProjection()
+{
+	return g_OrthoProjection;
+}
+
+void Graphics::BeginFrame()
 {
-	//begin
-    CHECK_GL(glViewport(0, 0, EGL::GetWidth(), EGL::GetHeight()));
+    CHECK_GL(GlState::Viewport(0, 0, EGL::GetWidth(), EGL::GetHeight()));
     CHECK_GL(glClear(GL_COLOR_BUFFER_BIT));
     CHECK_GL(glClearColor(1.0, 0.0, 1.0, 1));
+}
 
-    Gui::StartDraw();
+void Graphics::EndFrame()
+{
+	//draw gui, once its program is linked
+	Shader::Program* shader = g_DefaultShader;
+	if (shader->IsReady() && shader->Ok())
+	{
+		Gui::StartDraw();
+
+		shader->Use();
 
-	//draw gui
-	Shader::Program* shader = Graphics::GetShader("default");
-	shader->Use();
+		CHECK_GL(glUniformMatrix4fv(shader->GetUniform(Shader::Uniform::ProjMatrix), 1, GL_FALSE, g_OrthoProjection));
+
+		Gui::EndDraw(shader, g_VertexBuffer, g_IndexBuffer);
+
+		if (!g_FirstFrameDrawn)
+		{
+			g_FirstFrameDrawn = true;
+			LOGI("First frame after %.2f ms (%u frames without the gui)", g_StartupTimer->GetNanoseconds() * 1000.0, g_FrameCount);
+		}
+	}
 
-	CHECK_GL(glUniformMatrix4fv(shader->GetUniform("uProjMatrix"), 1, GL_FALSE, g_OrthoProjection));
+	if (++g_FrameCount % 300 == 0)
+	{
+		const Gui::DrawStats& stats = Gui::GetDrawStats();
+		LOGI("Gui: %u draw calls, %u state changes, %u uploads (%u bytes) per frame", stats.drawCalls, stats.stateChanges, stats.uploads, stats.uploadBytes);
 
-	Gui::EndDraw(shader, g_VertexBuffer, g_IndexBuffer);
+		const GlState::Counters& counters = GlState::GetCounters();
+		LOGI("GL state: %u calls issued, %u redundant ones skipped since the last report", counters.issued, counters.avoided);
+		GlState::ResetCounters();
+	}
 
-	//end
 	EGL::Swap();
 }
 
+void Graphics::Draw()
+{
+	BeginFrame();
+	EndFrame();
+}
+
 void Graphics::Destroy()
 {
 	Gui::Destroy();
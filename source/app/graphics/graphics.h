@@ -1,6 +1,8 @@
 #pragma once
 
 #include <android/native_window.h>
+#include <string>
+#include <vector>
 
 namespace Shader
 {
@@ -11,7 +13,19 @@ namespace Graphics
 {
 	bool Initialize(ANativeWindow* window);
 	void SetBufferSize(int width, int height);
+	// a linked program: the requested one, the default one while that is still building, or nullptr
 	Shader::Program* GetShader(const char* name);
+	// rebuilds the programs whose shaders/gles/<name>.vert or .frag is among the
+	// changed Vfs paths, from those files or the shipped source; the number rebuilt
+	unsigned ReloadShaders(const std::vector<std::string>& paths);
+	// with a current context
+	bool HasExtension(const char* name);
+	// clears the frame; draws submitted in between land under the gui
+	void BeginFrame();
+	// draws the gui and swaps
+	void EndFrame();
 	void Draw();
+	// window pixels to clip space, origin top left, column-major
+	const float* GetProjection();
 	void Destroy();
 }
\ No newline at end of file
@@ -5,11 +5,13 @@
 #include "imgui/imgui.h"
 #include "utils/log.h"
 #include "gldebug.h"
+#include "glstate.h"
 #include "shader.h"
 #include "texture.h"
 #include <GLES2/gl2.h>
 #include <vector>
 #include <algorithm>
+#include <cstring>
 #include <utils/make_unique.h>
 
 namespace {
@@ -18,6 +20,231 @@ namespace {
     float g_MousePos[2] = {0.0f, 0.0f};
     bool g_MousePress[10] = {false};
 
+    Gui::UploadMode g_UploadMode = Gui::UploadMode::Merged;
+    Gui::DrawStats g_DrawStats = {};
+
+    // A buffer streamed into with glBufferSubData. Each frame's data goes after
+    // the previous frame's, the storage is only re-specified when it has to
+    // grow or when the write position wraps around, so the driver doesn't have
+    // to orphan and reallocate it for every upload.
+    struct StreamBuffer
+    {
+        GLuint buffer;
+        GLenum target;
+        size_t capacity;
+        size_t offset;
+    };
+
+    // how many frames of data fit before wrapping
+    const size_t g_StreamFrames = 3;
+
+    StreamBuffer g_VertexStream = {0, GL_ARRAY_BUFFER, 0, 0};
+    StreamBuffer g_IndexStream = {0, GL_ELEMENT_ARRAY_BUFFER, 0, 0};
+
+    // all lists of a frame, merged
+    std::vector<ImDrawVert> g_Vertices;
+    std::vector<ImDrawIdx> g_Indices;
+
+    size_t NextPowerOfTwo(size_t value)
+    {
+        size_t result = 1;
+        while (result < value)
+            result <<= 1;
+        return result;
+    }
+
+    // returns the byte offset the data was written to, the buffer has to be bound
+    size_t Upload(StreamBuffer& stream, GLuint buffer, const void* data, size_t size)
+    {
+        if (stream.buffer != buffer)
+        {
+            stream.buffer = buffer;
+            stream.capacity = 0;
+        }
+
+        if (size * g_StreamFrames > stream.capacity)
+        {
+            stream.capacity = NextPowerOfTwo(size * g_StreamFrames);
+            stream.offset = 0;
+            CHECK_GL(glBufferData(stream.target, (GLsizeiptr)stream.capacity, nullptr, GL_STREAM_DRAW));
+            g_DrawStats.stateChanges++;
+        }
+        else if (stream.offset + size > stream.capacity)
+        {
+            //the GPU may still read the start, hand the old storage back to the driver
+            stream.offset = 0;
+            CHECK_GL(glBufferData(stream.target, (GLsizeiptr)stream.capacity, nullptr, GL_STREAM_DRAW));
+            g_DrawStats.stateChanges++;
+        }
+
+        size_t offset = stream.offset;
+        CHECK_GL(glBufferSubData(stream.target, (GLintptr)offset, (GLsizeiptr)size, data));
+        stream.offset = (offset + size + 3) & ~size_t(3);
+
+        g_DrawStats.uploads++;
+        g_DrawStats.uploadBytes += size;
+        return offset;
+    }
+
+    void SetVertexAttributes(Shader::Program* shader, size_t offset)
+    {
+        CHECK_GL(glVertexAttribPointer(shader->GetAttribute(Shader::Attribute::Position), 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)(offset + IM_OFFSETOF(ImDrawVert, pos))));
+        CHECK_GL(glVertexAttribPointer(shader->GetAttribute(Shader::Attribute::TexCoord), 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)(offset + IM_OFFSETOF(ImDrawVert, uv))));
+        CHECK_GL(glVertexAttribPointer(shader->GetAttribute(Shader::Attribute::Color), 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)(offset + IM_OFFSETOF(ImDrawVert, col))));
+        g_DrawStats.stateChanges += 3;
+    }
+
+    // after a user callback, which may have changed any of it: the shadowed state is
+    // forgotten and everything the draws rely on is set again
+    void RestoreState(Shader::Program* shader, GLuint vertexBuffer, GLuint indexBuffer, size_t attributeOffset)
+    {
+        GlState::Invalidate();
+        shader->Use();
+        CHECK_GL(GlState::SetEnabled(GL_SCISSOR_TEST, true));
+        CHECK_GL(GlState::BindBuffer(GL_ARRAY_BUFFER, vertexBuffer));
+        CHECK_GL(GlState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer));
+        CHECK_GL(GlState::SetVertexAttribArray(shader->GetAttribute(Shader::Attribute::Position), true));
+        CHECK_GL(GlState::SetVertexAttribArray(shader->GetAttribute(Shader::Attribute::TexCoord), true));
+        CHECK_GL(GlState::SetVertexAttribArray(shader->GetAttribute(Shader::Attribute::Color), true));
+        g_DrawStats.stateChanges += 7;
+        SetVertexAttributes(shader, attributeOffset);
+    }
+
+    // the old path: one glBufferData per list and buffer
+    void DrawPerList(ImDrawData* draw_data, Shader::Program* shader, GLuint vertexBuffer, GLuint indexBuffer)
+    {
+        SetVertexAttributes(shader, 0);
+
+        for (int n = 0; n < draw_data->CmdListsCount; n++)
+        {
+            ImDrawList* cmd_list = draw_data->CmdLists[n];
+            const ImDrawIdx* idx_buffer_ptr = 0;
+
+            CHECK_GL(GlState::BindBuffer(GL_ARRAY_BUFFER, vertexBuffer));
+            CHECK_GL(glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)cmd_list->VtxBuffer.Size * sizeof(ImDrawVert), (const GLvoid*)cmd_list->VtxBuffer.Data, GL_STREAM_DRAW));
+
+            CHECK_GL(GlState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer));
+            CHECK_GL(glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx), (const GLvoid*)cmd_list->IdxBuffer.Data, GL_STREAM_DRAW));
+
+            g_DrawStats.stateChanges += 4;
+            g_DrawStats.uploads += 2;
+            g_DrawStats.uploadBytes += cmd_list->VtxBuffer.Size * sizeof(ImDrawVert) + cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx);
+
+            for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
+            {
+                const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
+                if (pcmd->UserCallback)
+                {
+                    pcmd->UserCallback(cmd_list, pcmd);
+                    RestoreState(shader, vertexBuffer, indexBuffer, 0);
+                }
+                else
+                {
+                    static_cast<Texture*>(pcmd->TextureId)->Bind(shader, 0);
+                    CHECK_GL(GlState::Scissor((int)pcmd->ClipRect.x, (int)(EGL::GetHeight() - pcmd->ClipRect.w), (int)(pcmd->ClipRect.z - pcmd->ClipRect.x), (int)(pcmd->ClipRect.w - pcmd->ClipRect.y)));
+                    CHECK_GL(glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, GL_UNSIGNED_SHORT, idx_buffer_ptr));
+                    g_DrawStats.stateChanges += 2;
+                    g_DrawStats.drawCalls++;
+                }
+                idx_buffer_ptr += pcmd->ElemCount;
+            }
+        }
+    }
+
+    // One vertex and one index upload per frame. While the frame's vertices fit
+    // 16 bit indices, the indices are rebased onto the merged vertex array, so the
+    // attribute pointers are set once; otherwise they move once per list.
+    void DrawMerged(ImDrawData* draw_data, Shader::Program* shader, GLuint vertexBuffer, GLuint indexBuffer)
+    {
+        const bool rebase = draw_data->TotalVtxCount <= 0x10000;
+
+        g_Vertices.resize(draw_data->TotalVtxCount);
+        g_Indices.resize(draw_data->TotalIdxCount);
+
+        size_t vertexCount = 0;
+        size_t indexCount = 0;
+        for (int n = 0; n < draw_data->CmdListsCount; n++)
+        {
+            const ImDrawList* cmd_list = draw_data->CmdLists[n];
+            std::memcpy(&g_Vertices[vertexCount], cmd_list->VtxBuffer.Data, cmd_list->VtxBuffer.Size * sizeof(ImDrawVert));
+
+            ImDrawIdx base = rebase ? (ImDrawIdx)vertexCount : 0;
+            for (int i = 0; i < cmd_list->IdxBuffer.Size; i++)
+            {
+                g_Indices[indexCount + i] = (ImDrawIdx)(cmd_list->IdxBuffer.Data[i] + base);
+            }
+
+            vertexCount += cmd_list->VtxBuffer.Size;
+            indexCount += cmd_list->IdxBuffer.Size;
+        }
+
+        if (vertexCount == 0 || indexCount == 0)
+        {
+            return;
+        }
+
+        CHECK_GL(GlState::BindBuffer(GL_ARRAY_BUFFER, vertexBuffer));
+        CHECK_GL(GlState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer));
+        g_DrawStats.stateChanges += 2;
+
+        size_t vertexOffset = Upload(g_VertexStream, vertexBuffer, g_Vertices.data(), vertexCount * sizeof(ImDrawVert));
+        size_t indexOffset = Upload(g_IndexStream, indexBuffer, g_Indices.data(), indexCount * sizeof(ImDrawIdx));
+
+        if (rebase)
+        {
+            SetVertexAttributes(shader, vertexOffset);
+        }
+
+        Texture* boundTexture = nullptr;
+        ImVec4 scissor(-1.0f, -1.0f, -1.0f, -1.0f);
+        size_t listVertexOffset = vertexOffset;
+        for (int n = 0; n < draw_data->CmdListsCount; n++)
+        {
+            const ImDrawList* cmd_list = draw_data->CmdLists[n];
+
+            if (!rebase)
+            {
+                SetVertexAttributes(shader, listVertexOffset);
+            }
+
+            for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
+            {
+                const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
+                if (pcmd->UserCallback)
+                {
+                    pcmd->UserCallback(cmd_list, pcmd);
+                    RestoreState(shader, vertexBuffer, indexBuffer, rebase ? vertexOffset : listVertexOffset);
+                    boundTexture = nullptr;
+                    scissor = ImVec4(-1.0f, -1.0f, -1.0f, -1.0f);
+                }
+                else
+                {
+                    Texture* texture = static_cast<Texture*>(pcmd->TextureId);
+                    if (texture != boundTexture)
+                    {
+                        texture->Bind(shader, 0);
+                        boundTexture = texture;
+                        g_DrawStats.stateChanges++;
+                    }
+
+                    const ImVec4& clip = pcmd->ClipRect;
+                    if (clip.x != scissor.x || clip.y != scissor.y || clip.z != scissor.z || clip.w != scissor.w)
+                    {
+                        CHECK_GL(GlState::Scissor((int)clip.x, (int)(EGL::GetHeight() - clip.w), (int)(clip.z - clip.x), (int)(clip.w - clip.y)));
+                        scissor = clip;
+                        g_DrawStats.stateChanges++;
+                    }
+
+                    CHECK_GL(glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, GL_UNSIGNED_SHORT, (const GLvoid*)indexOffset));
+                    g_DrawStats.drawCalls++;
+                }
+                indexOffset += pcmd->ElemCount * sizeof(ImDrawIdx);
+            }
+
+            listVertexOffset += cmd_list->VtxBuffer.Size * sizeof(ImDrawVert);
+        }
+    }
+
     void HandleInput(int action, float x, float y)
     {
         switch(action)
@@ -160,52 +387,41 @@ void Gui::StartDraw()
     ImGui::End();
 }
 
+void Gui::SetUploadMode(UploadMode mode)
+{
+    g_UploadMode = mode;
+}
+
+const Gui::DrawStats& Gui::GetDrawStats()
+{
+    return g_DrawStats;
+}
+
 void Gui::EndDraw(Shader::Program* shader, unsigned int& vertexBuffer, unsigned int& indexBuffer)
 {
     //GUI: Render frame here
     ImGui::Render();
 
-    CHECK_GL(glEnable(GL_SCISSOR_TEST));
+    g_DrawStats = {};
 
-    Texture* tex = reinterpret_cast<Texture*>(g_Io->Fonts->TexID);
-    tex->Bind(shader, 0);
+    CHECK_GL(GlState::SetEnabled(GL_SCISSOR_TEST, true));
 
-    CHECK_GL(glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer));
+    CHECK_GL(GlState::BindBuffer(GL_ARRAY_BUFFER, vertexBuffer));
 
-    CHECK_GL(glEnableVertexAttribArray(shader->GetAttribute("aPos")));
-    CHECK_GL(glEnableVertexAttribArray(shader->GetAttribute("aTex")));
-    CHECK_GL(glEnableVertexAttribArray(shader->GetAttribute("aColor")));
-    CHECK_GL(glVertexAttribPointer(shader->GetAttribute("aPos"), 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, pos)));
-    CHECK_GL(glVertexAttribPointer(shader->GetAttribute("aTex"), 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, uv)));
-    CHECK_GL(glVertexAttribPointer(shader->GetAttribute("aColor"), 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, col)));
+    CHECK_GL(GlState::SetVertexAttribArray(shader->GetAttribute(Shader::Attribute::Position), true));
+    CHECK_GL(GlState::SetVertexAttribArray(shader->GetAttribute(Shader::Attribute::TexCoord), true));
+    CHECK_GL(GlState::SetVertexAttribArray(shader->GetAttribute(Shader::Attribute::Color), true));
+    g_DrawStats.stateChanges += 4;
 
     ImDrawData* draw_data = ImGui::GetDrawData();
-    for (int n = 0; n < draw_data->CmdListsCount; n++)
+    if (g_UploadMode == UploadMode::Merged)
     {
-        ImDrawList* cmd_list = draw_data->CmdLists[n];
-        const ImDrawIdx* idx_buffer_ptr = 0;
-
-        CHECK_GL(glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer));
-        CHECK_GL(glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)cmd_list->VtxBuffer.Size * sizeof(ImDrawVert), (const GLvoid*)cmd_list->VtxBuffer.Data, GL_STREAM_DRAW));
-
-        CHECK_GL(glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer));
-        CHECK_GL(glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx), (const GLvoid*)cmd_list->IdxBuffer.Data, GL_STREAM_DRAW));
-
-        for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
-        {
-            const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[cmd_i];
-            if (pcmd->UserCallback)
-            {
-                pcmd->UserCallback(cmd_list, pcmd);
-            }
-            else
-            {
-                CHECK_GL(glBindTexture(GL_TEXTURE_2D, (GLuint)(intptr_t)pcmd->TextureId));
-                CHECK_GL(glScissor((int)pcmd->ClipRect.x, (int)(EGL::GetHeight() - pcmd->ClipRect.w), (int)(pcmd->ClipRect.z - pcmd->ClipRect.x), (int)(pcmd->ClipRect.w - pcmd->ClipRect.y)));
-                CHECK_GL(glDrawElements(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, GL_UNSIGNED_SHORT, idx_buffer_ptr));
-            }
-            idx_buffer_ptr += pcmd->ElemCount;
-        }
+        DrawMerged(draw_data, shader, vertexBuffer, indexBuffer);
     }
-    CHECK_GL(glDisable(GL_SCISSOR_TEST));
+    else
+    {
+        DrawPerList(draw_data, shader, vertexBuffer, indexBuffer);
+    }
+
+    CHECK_GL(GlState::SetEnabled(GL_SCISSOR_TEST, false));
 }
\ No newline at end of file
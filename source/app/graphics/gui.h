@@ -9,10 +9,27 @@ namespace Shader {
 namespace Gui {
 	struct ButtonImpl;
 
+	enum class UploadMode : unsigned
+	{
+		PerList = 0,    // one glBufferData per draw list and buffer
+		Merged,         // all lists in one vertex and one index upload per frame
+	};
+
+	// counted over the last EndDraw
+	struct DrawStats
+	{
+		unsigned int drawCalls;
+		unsigned int stateChanges;
+		unsigned int uploads;
+		unsigned int uploadBytes;
+	};
+
 	bool Initialize();
 	void Destroy();
 	void SetBufferSize(int width, int height);
 	ButtonImpl* CreateButton(const std::string& label, const std::function<void(ButtonImpl*)>& onClick);
 	void StartDraw();
+	void SetUploadMode(UploadMode mode);
 	void EndDraw(Shader::Program* shader, unsigned int& vertextBuffer, unsigned int& indexBuffer);
+	const DrawStats& GetDrawStats();
 }
\ No newline at end of file
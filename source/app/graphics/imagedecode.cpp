@@ -0,0 +1,410 @@
+#include "imagedecode.h"
+#include "utils/log.h"
+#include "utils/timing.h"
+#include "utils/contentcache.h"
+#include "utils/vfs.h"
+#include <algorithm>
+#include <cstring>
+
+#ifdef __ANDROID__
+#include <android/bitmap.h>
+#if __ANDROID_API__ >= 30
+#include <android/imagedecoder.h>
+#endif
+#endif
+
+namespace {
+    unsigned WorkerCount(unsigned threads)
+    {
+        if (threads > 0)
+        {
+            return threads;
+        }
+        const unsigned cores = std::thread::hardware_concurrency();
+        return cores > 1 ? cores - 1 : 1;
+    }
+}
+
+bool ImageDecode::ReadFromVfs(const std::string& path, std::vector<unsigned char>& data)
+{
+    //whichever backend has it: the assets, a pack in them, the writable layer
+    std::shared_ptr<Vfs::VirtualFile> file = Vfs::Open<Vfs::VirtualFile>(path);
+    if (!file)
+    {
+        return false;
+    }
+
+    const int64_t size = file->Size();
+    if (size <= 0)
+    {
+        return false;
+    }
+
+    data.resize(size_t(size));
+    return file->ReadAt(0, data.data(), size) == size;
+}
+
+bool ImageDecode::DecodeWithPlatform(const unsigned char* data, size_t size, Image& image)
+{
+#if defined(__ANDROID__) && __ANDROID_API__ >= 30
+    AImageDecoder* decoder = nullptr;
+    if (AImageDecoder_createFromBuffer(data, size, &decoder) != ANDROID_IMAGE_DECODER_SUCCESS)
+    {
+        return false;
+    }
+
+    //straight alpha, like the blend state expects
+    bool ok = AImageDecoder_setAndroidBitmapFormat(decoder, ANDROID_BITMAP_FORMAT_RGBA_8888) == ANDROID_IMAGE_DECODER_SUCCESS
+        && AImageDecoder_setUnpremultipliedRequired(decoder, true) == ANDROID_IMAGE_DECODER_SUCCESS;
+
+    if (ok)
+    {
+        const AImageDecoderHeaderInfo* info = AImageDecoder_getHeaderInfo(decoder);
+        image.width = uint32_t(AImageDecoderHeaderInfo_getWidth(info));
+        image.height = uint32_t(AImageDecoderHeaderInfo_getHeight(info));
+
+        const size_t stride = size_t(image.width) * 4;
+        image.pixels.resize(stride * image.height);
+        ok = AImageDecoder_decodeImage(decoder, image.pixels.data(), stride, image.pixels.size()) == ANDROID_IMAGE_DECODER_SUCCESS;
+    }
+
+    AImageDecoder_delete(decoder);
+    return ok;
+#else
+    (void)data;
+    (void)size;
+    (void)image;
+    return false;
+#endif
+}
+
+ImageDecode::DecodeFunction ImageDecode::CachedDecoder(Vfs::ContentCache& cache, DecodeFunction decode)
+{
+    return [&cache, decode](const unsigned char* data, size_t size, Image& image)
+    {
+        //bump the version when the decoder's output changes
+        const Vfs::Hash128 key = Vfs::ContentCache::Key({data, size}, "ImageDecode rgba8 v1");
+
+        //width and height, then the pixels
+        std::vector<unsigned char> cached;
+        if (cache.Load(key, cached) && cached.size() >= 8)
+        {
+            memcpy(&image.width, cached.data(), 4);
+            memcpy(&image.height, cached.data() + 4, 4);
+            if (cached.size() - 8 == size_t(image.width) * image.height * 4)
+            {
+                image.pixels.assign(cached.begin() + 8, cached.end());
+                return true;
+            }
+        }
+
+        if (!decode(data, size, image))
+        {
+            return false;
+        }
+
+        cached.resize(8 + image.pixels.size());
+        memcpy(cached.data(), &image.width, 4);
+        memcpy(cached.data() + 4, &image.height, 4);
+        if (!image.pixels.empty())
+        {
+            memcpy(cached.data() + 8, image.pixels.data(), image.pixels.size());
+        }
+        cache.Store(key, cached.data(), cached.size());
+        return true;
+    };
+}
+
+ImageDecode::BufferPool::BufferPool(size_t maxBuffers)
+    : m_MaxBuffers(maxBuffers)
+{
+}
+
+std::vector<unsigned char> ImageDecode::BufferPool::Acquire()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_Free.empty())
+    {
+        return std::vector<unsigned char>();
+    }
+
+    std::vector<unsigned char> buffer = std::move(m_Free.back());
+    m_Free.pop_back();
+    return buffer;
+}
+
+void ImageDecode::BufferPool::Release(std::vector<unsigned char> buffer)
+{
+    buffer.clear();
+
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    if (m_Free.size() < m_MaxBuffers && buffer.capacity() > 0)
+    {
+        m_Free.push_back(std::move(buffer));
+    }
+}
+
+size_t ImageDecode::BufferPool::Pooled()
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    return m_Free.size();
+}
+
+bool ImageDecode::Pipeline::Later::operator()(const Job* a, const Job* b) const
+{
+    if (a->priority != b->priority)
+    {
+        return a->priority < b->priority;
+    }
+    return a->sequence > b->sequence;
+}
+
+ImageDecode::Pipeline::Pipeline(unsigned threads, ReadFunction read, DecodeFunction decode)
+    : m_Read(read)
+    , m_Decode(decode)
+    //a buffer per worker plus a few waiting for upload
+    , m_Pool(WorkerCount(threads) * 2 + 2)
+    , m_NextId(InvalidRequest + 1)
+    , m_NextSequence(0)
+    , m_Stop(false)
+    , m_Completed(nullptr)
+    , m_Decoded(0)
+    , m_Failed(0)
+    , m_Cancelled(0)
+    , m_BytesRead(0)
+{
+    threads = WorkerCount(threads);
+    for (unsigned i = 0; i < threads; i++)
+    {
+        m_Threads.push_back(std::thread(&Pipeline::Work, this));
+    }
+}
+
+ImageDecode::Pipeline::~Pipeline()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stop = true;
+    }
+    m_Wake.notify_all();
+
+    for (std::thread& thread : m_Threads)
+    {
+        thread.join();
+    }
+
+    //pending, completed and ready ones are all still in here
+    for (auto& job : m_Jobs)
+    {
+        delete job.second;
+    }
+}
+
+ImageDecode::RequestId ImageDecode::Pipeline::Request(const std::string& path, int priority)
+{
+    Job* job = new Job();
+    job->image.path = path;
+    job->image.ok = false;
+    job->image.width = 0;
+    job->image.height = 0;
+    job->priority = priority;
+    job->cancelled = false;
+    job->next = nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        job->image.id = m_NextId++;
+        if (m_NextId == InvalidRequest)
+        {
+            m_NextId++;
+        }
+        job->sequence = m_NextSequence++;
+        m_Jobs[job->image.id] = job;
+        m_Pending.push(job);
+    }
+    m_Wake.notify_one();
+
+    return job->image.id;
+}
+
+bool ImageDecode::Pipeline::Cancel(RequestId request)
+{
+    std::lock_guard<std::mutex> lock(m_Mutex);
+    auto job = m_Jobs.find(request);
+    if (job == m_Jobs.end() || job->second->cancelled)
+    {
+        return false;
+    }
+
+    //the worker or Poll drops it, whoever sees it next
+    job->second->cancelled = true;
+    return true;
+}
+
+void ImageDecode::Pipeline::Work()
+{
+    //the encoded file, reused from one image to the next
+    std::vector<unsigned char> file;
+
+    for (;;)
+    {
+        Job* job;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_Wake.wait(lock, [this] { return m_Stop || !m_Pending.empty(); });
+            if (m_Stop)
+            {
+                return;
+            }
+            job = m_Pending.top();
+            m_Pending.pop();
+        }
+
+        if (!job->cancelled)
+        {
+            Image& image = job->image;
+            if (m_Read(image.path, file))
+            {
+                m_BytesRead += file.size();
+                image.pixels = m_Pool.Acquire();
+                image.ok = m_Decode(file.data(), file.size(), image);
+            }
+
+            if (!image.ok)
+            {
+                LOGW("ImageDecode: unable to load %s", image.path.c_str());
+            }
+        }
+
+        Complete(job);
+    }
+}
+
+void ImageDecode::Pipeline::Complete(Job* job)
+{
+    //lock-free push; Poll takes the whole list at once, so there is no ABA
+    Job* head = m_Completed.load(std::memory_order_relaxed);
+    do
+    {
+        job->next = head;
+    }
+    while (!m_Completed.compare_exchange_weak(head, job, std::memory_order_release, std::memory_order_relaxed));
+}
+
+unsigned ImageDecode::Pipeline::Poll(const std::function<void(Image&)>& upload, unsigned maxImages)
+{
+    Job* taken = m_Completed.exchange(nullptr, std::memory_order_acquire);
+    if (taken)
+    {
+        //the list is newest first
+        const size_t start = m_Ready.size();
+        for (; taken; taken = taken->next)
+        {
+            m_Ready.push_back(taken);
+        }
+        std::reverse(m_Ready.begin() + start, m_Ready.end());
+    }
+
+    unsigned delivered = 0;
+    size_t done = 0;
+    for (; done < m_Ready.size() && delivered < maxImages; done++)
+    {
+        Job* job = m_Ready[done];
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Jobs.erase(job->image.id);
+        }
+
+        if (job->cancelled)
+        {
+            m_Cancelled++;
+        }
+        else
+        {
+            (job->image.ok ? m_Decoded : m_Failed)++;
+            upload(job->image);
+            delivered++;
+        }
+
+        m_Pool.Release(std::move(job->image.pixels));
+        delete job;
+    }
+    m_Ready.erase(m_Ready.begin(), m_Ready.begin() + done);
+
+    return delivered;
+}
+
+ImageDecode::Stats ImageDecode::Pipeline::GetStats() const
+{
+    Stats stats;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        stats.requested = m_NextSequence;
+    }
+    stats.decoded = m_Decoded;
+    stats.failed = m_Failed;
+    stats.cancelled = m_Cancelled;
+    stats.bytesRead = m_BytesRead;
+    return stats;
+}
+
+unsigned ImageDecode::Pipeline::ThreadCount() const
+{
+    return unsigned(m_Threads.size());
+}
+
+std::vector<ImageDecode::BenchmarkResult> ImageDecode::RunBenchmark(const std::vector<std::vector<unsigned char> >& files,
+    const DecodeFunction& decode, unsigned maxThreads, unsigned rounds)
+{
+    std::vector<BenchmarkResult> results;
+    if (files.empty())
+    {
+        return results;
+    }
+
+    //paths are indices into files
+    ReadFunction read = [&files](const std::string& path, std::vector<unsigned char>& data)
+    {
+        const std::vector<unsigned char>& file = files[std::stoul(path)];
+        data.assign(file.begin(), file.end());
+        return true;
+    };
+
+    for (unsigned threads = 1; threads <= std::max(maxThreads, 1u); threads *= 2)
+    {
+        Pipeline pipeline(threads, read, decode);
+
+        Timewatcher timer = Timing::Start();
+        const unsigned count = unsigned(files.size()) * rounds;
+        for (unsigned i = 0; i < count; i++)
+        {
+            pipeline.Request(std::to_string(i % files.size()));
+        }
+
+        unsigned received = 0;
+        uint64_t pixels = 0;
+        while (received < count)
+        {
+            received += pipeline.Poll([&pixels](Image& image)
+            {
+                pixels += uint64_t(image.width) * image.height;
+            });
+            if (received < count)
+            {
+                std::this_thread::yield();
+            }
+        }
+        const double seconds = timer->GetNanoseconds();
+
+        BenchmarkResult result;
+        result.threads = threads;
+        result.images = count;
+        result.milliseconds = seconds * 1000.0;
+        result.imagesPerSecond = seconds > 0.0 ? count / seconds : 0.0;
+        result.megapixelsPerSecond = seconds > 0.0 ? pixels / seconds / 1000000.0 : 0.0;
+        result.speedup = results.empty() || result.imagesPerSecond == 0.0 ? 1.0 : result.imagesPerSecond / results.front().imagesPerSecond;
+        results.push_back(result);
+    }
+
+    return results;
+}
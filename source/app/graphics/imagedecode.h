@@ -0,0 +1,163 @@
+/* Image decoding off the render thread
+ *
+ * Request() queues a file by path and priority. A pool of workers reads it
+ * (through Vfs by default) and decodes it to RGBA8, into pixel buffers that
+ * are recycled once the render thread is done with them. Finished images
+ * come back through a lock-free queue: Poll() on the render thread hands
+ * each one to the upload callback.
+ *
+ * Cancel() drops a request that hasn't been delivered yet; if a worker is
+ * already decoding it the result is thrown away instead of delivered.
+ *
+ * PNG and JPEG are decoded with AImageDecoder (API 30 and up). Read and
+ * decode are both replaceable, which is what the benchmark uses on a host.
+ */
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Vfs
+{
+	class ContentCache;
+}
+
+namespace ImageDecode
+{
+	typedef uint32_t RequestId;
+	const RequestId InvalidRequest = 0;
+
+	struct Image
+	{
+		RequestId id;
+		std::string path;
+		bool ok;
+		uint32_t width;
+		uint32_t height;
+		// RGBA8, tightly packed, not premultiplied
+		std::vector<unsigned char> pixels;
+	};
+
+	// whole file into data, which keeps its capacity between calls
+	typedef std::function<bool(const std::string& path, std::vector<unsigned char>& data)> ReadFunction;
+	// width, height and pixels of the image; pixels comes from the pool, resize it
+	typedef std::function<bool(const unsigned char* data, size_t size, Image& image)> DecodeFunction;
+
+	bool ReadFromVfs(const std::string& path, std::vector<unsigned char>& data);
+	// false without AImageDecoder
+	bool DecodeWithPlatform(const unsigned char* data, size_t size, Image& image);
+	// decode, with the pixels kept in cache by the file's contents, so an image is
+	// decoded once per device rather than once per launch; cache has to outlive it
+	DecodeFunction CachedDecoder(Vfs::ContentCache& cache, DecodeFunction decode);
+
+	// recycled pixel buffers, so steady state decoding doesn't allocate
+	class BufferPool
+	{
+	public:
+		explicit BufferPool(size_t maxBuffers);
+
+		std::vector<unsigned char> Acquire();
+		void Release(std::vector<unsigned char> buffer);
+		size_t Pooled();
+
+	private:
+		std::mutex m_Mutex;
+		std::vector<std::vector<unsigned char> > m_Free;
+		size_t m_MaxBuffers;
+	};
+
+	struct Stats
+	{
+		uint32_t requested;
+		uint32_t decoded;
+		uint32_t failed;
+		uint32_t cancelled;
+		uint64_t bytesRead;
+	};
+
+	class Pipeline
+	{
+	public:
+		// 0 threads means one less than there are cores, at least one
+		Pipeline(unsigned threads = 0, ReadFunction read = ReadFromVfs, DecodeFunction decode = DecodeWithPlatform);
+		~Pipeline();
+
+		// higher priorities are decoded first, equal ones in request order
+		RequestId Request(const std::string& path, int priority = 0);
+		// false once it was delivered, or for an unknown request
+		bool Cancel(RequestId request);
+
+		// render thread; failed images are delivered too, with ok false.
+		// The pixels go back to the pool after the callback returns.
+		unsigned Poll(const std::function<void(Image&)>& upload, unsigned maxImages = ~0u);
+
+		Stats GetStats() const;
+		unsigned ThreadCount() const;
+
+	private:
+		struct Job
+		{
+			Image image;
+			int priority;
+			uint64_t sequence;
+			std::atomic<bool> cancelled;
+			Job* next;
+		};
+
+		struct Later
+		{
+			bool operator()(const Job* a, const Job* b) const;
+		};
+
+		void Work();
+		void Complete(Job* job);
+
+		ReadFunction m_Read;
+		DecodeFunction m_Decode;
+		BufferPool m_Pool;
+
+		mutable std::mutex m_Mutex;
+		std::condition_variable m_Wake;
+		std::priority_queue<Job*, std::vector<Job*>, Later> m_Pending;
+		// everything not delivered yet, for Cancel
+		std::map<RequestId, Job*> m_Jobs;
+		RequestId m_NextId;
+		uint64_t m_NextSequence;
+		bool m_Stop;
+
+		// pushed by the workers, taken as a whole by Poll
+		std::atomic<Job*> m_Completed;
+		// taken but not delivered yet, oldest first
+		std::vector<Job*> m_Ready;
+
+		std::atomic<uint32_t> m_Decoded;
+		std::atomic<uint32_t> m_Failed;
+		std::atomic<uint32_t> m_Cancelled;
+		std::atomic<uint64_t> m_BytesRead;
+
+		std::vector<std::thread> m_Threads;
+	};
+
+	struct BenchmarkResult
+	{
+		unsigned threads;
+		unsigned images;
+		double milliseconds;
+		double imagesPerSecond;
+		double megapixelsPerSecond;
+		// against the single thread run
+		double speedup;
+	};
+
+	// decodes the in-memory files rounds times over with 1, 2, 4 .. maxThreads workers
+	std::vector<BenchmarkResult> RunBenchmark(const std::vector<std::vector<unsigned char> >& files,
+		const DecodeFunction& decode, unsigned maxThreads, unsigned rounds);
+}
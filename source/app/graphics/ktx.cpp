@@ -0,0 +1,418 @@
+#include "ktx.h"
+#include "utils/log.h"
+#include <cstring>
+
+namespace {
+    const unsigned char g_Ktx1Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+    const unsigned char g_Ktx2Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+    const uint32_t g_NativeEndianness = 0x04030201;
+
+    // uncompressed formats, GLES2 style unsized ones included
+    const uint32_t GL_RGB = 0x1907;
+    const uint32_t GL_RGBA = 0x1908;
+    const uint32_t GL_RGB8 = 0x8051;
+    const uint32_t GL_RGBA8 = 0x8058;
+    const uint32_t GL_UNSIGNED_BYTE = 0x1401;
+
+    // VkFormat values
+    const uint32_t VK_R8G8B8_UNORM = 23;
+    const uint32_t VK_R8G8B8A8_UNORM = 37;
+    const uint32_t VK_ETC2_R8G8B8_UNORM = 147;
+    const uint32_t VK_EAC_R11G11_SNORM = 156;
+    const uint32_t VK_ASTC_4x4_UNORM = 157;
+    const uint32_t VK_ASTC_12x12_SRGB = 184;
+
+    const uint32_t g_AstcBlocks[][2] = {
+        {4, 4}, {5, 4}, {5, 5}, {6, 5}, {6, 6}, {8, 5}, {8, 6},
+        {8, 8}, {10, 5}, {10, 6}, {10, 8}, {10, 10}, {12, 10}, {12, 12},
+    };
+
+    struct Ktx1Header
+    {
+        unsigned char identifier[12];
+        uint32_t endianness;
+        uint32_t glType;
+        uint32_t glTypeSize;
+        uint32_t glFormat;
+        uint32_t glInternalFormat;
+        uint32_t glBaseInternalFormat;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t numberOfArrayElements;
+        uint32_t numberOfFaces;
+        uint32_t numberOfMipmapLevels;
+        uint32_t bytesOfKeyValueData;
+    };
+    static_assert(sizeof(Ktx1Header) == 64, "KTX1 header layout");
+
+    struct Ktx2Header
+    {
+        unsigned char identifier[12];
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint64_t sgdByteOffset;
+        uint64_t sgdByteLength;
+    };
+    static_assert(sizeof(Ktx2Header) == 80, "KTX2 header layout");
+
+    struct Ktx2Level
+    {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+
+    // offset + length inside size, without overflowing
+    bool InBounds(uint64_t offset, uint64_t length, size_t size)
+    {
+        return offset <= size && length <= size - offset;
+    }
+
+    // the chain may stop early, but not go past 1x1
+    bool CheckLevelCount(uint32_t width, uint32_t height, uint32_t levels)
+    {
+        if (levels > Ktx::FullMipCount(width, height))
+        {
+            LOGE("KTX: %u mip levels for a %ux%u image", levels, width, height);
+            return false;
+        }
+        return true;
+    }
+
+    bool CheckFormat(Ktx::Image& image)
+    {
+        Ktx::BlockInfo block;
+        if (!Ktx::GetBlockInfo(image.glInternalFormat, block))
+        {
+            LOGE("KTX: unsupported format 0x%04x", image.glInternalFormat);
+            return false;
+        }
+        image.compressed = block.width > 1 || block.height > 1;
+        return true;
+    }
+
+    bool ParseKtx1(const unsigned char* data, size_t size, Ktx::Image& image)
+    {
+        Ktx1Header header;
+        if (size < sizeof(header))
+        {
+            LOGE("KTX: file too small");
+            return false;
+        }
+        memcpy(&header, data, sizeof(header));
+
+        if (header.endianness != g_NativeEndianness)
+        {
+            LOGE("KTX: byte swapped files are not supported");
+            return false;
+        }
+        if (header.pixelDepth > 1 || header.numberOfArrayElements > 0 || header.numberOfFaces != 1)
+        {
+            LOGE("KTX: only 2D textures are supported");
+            return false;
+        }
+        if (header.pixelWidth == 0 || header.pixelHeight == 0)
+        {
+            LOGE("KTX: empty image");
+            return false;
+        }
+
+        image.container = Ktx::Container::Ktx1;
+        image.glInternalFormat = header.glInternalFormat;
+        image.glFormat = header.glFormat;
+        image.glType = header.glType;
+        image.width = header.pixelWidth;
+        image.height = header.pixelHeight;
+        image.generateMipmaps = header.numberOfMipmapLevels == 0;
+        if (!CheckFormat(image))
+        {
+            return false;
+        }
+        if (image.compressed != (header.glType == 0))
+        {
+            LOGE("KTX: glType doesn't match format 0x%04x", header.glInternalFormat);
+            return false;
+        }
+
+        const uint32_t levelCount = image.generateMipmaps ? 1 : header.numberOfMipmapLevels;
+        if (!CheckLevelCount(image.width, image.height, levelCount))
+        {
+            return false;
+        }
+
+        Ktx::BlockInfo block;
+        Ktx::GetBlockInfo(image.glInternalFormat, block);
+
+        uint64_t offset = sizeof(header) + (uint64_t)header.bytesOfKeyValueData;
+        image.levels.clear();
+        for (uint32_t i = 0; i < levelCount; ++i)
+        {
+            uint32_t imageSize;
+            if (!InBounds(offset, sizeof(imageSize), size))
+            {
+                LOGE("KTX: level %u truncated", i);
+                return false;
+            }
+            memcpy(&imageSize, data + offset, sizeof(imageSize));
+            offset += sizeof(imageSize);
+
+            Ktx::Level level;
+            level.width = Ktx::MipDimension(image.width, i);
+            level.height = Ktx::MipDimension(image.height, i);
+            level.offset = (size_t)offset;
+            level.size = imageSize;
+
+            // uncompressed rows are padded to 4 bytes, so only a lower bound there
+            const size_t expected = Ktx::LevelSize(block, level.width, level.height);
+            if (image.compressed ? imageSize != expected : imageSize < expected)
+            {
+                LOGE("KTX: level %u is %u bytes, expected %zu", i, imageSize, expected);
+                return false;
+            }
+            if (!InBounds(offset, imageSize, size))
+            {
+                LOGE("KTX: level %u truncated", i);
+                return false;
+            }
+
+            image.levels.push_back(level);
+            offset += (imageSize + 3) & ~3u;
+        }
+
+        return true;
+    }
+
+    bool ParseKtx2(const unsigned char* data, size_t size, Ktx::Image& image)
+    {
+        Ktx2Header header;
+        if (size < sizeof(header))
+        {
+            LOGE("KTX2: file too small");
+            return false;
+        }
+        memcpy(&header, data, sizeof(header));
+
+        if (header.supercompressionScheme != 0)
+        {
+            LOGE("KTX2: supercompression scheme %u is not supported", header.supercompressionScheme);
+            return false;
+        }
+        if (header.pixelDepth > 0 || header.layerCount > 0 || header.faceCount != 1)
+        {
+            LOGE("KTX2: only 2D textures are supported");
+            return false;
+        }
+        if (header.pixelWidth == 0 || header.pixelHeight == 0)
+        {
+            LOGE("KTX2: empty image");
+            return false;
+        }
+
+        image.container = Ktx::Container::Ktx2;
+        image.glInternalFormat = Ktx::FromVkFormat(header.vkFormat);
+        image.width = header.pixelWidth;
+        image.height = header.pixelHeight;
+        image.generateMipmaps = header.levelCount == 0;
+        if (image.glInternalFormat == 0)
+        {
+            LOGE("KTX2: unsupported vkFormat %u", header.vkFormat);
+            return false;
+        }
+        if (!CheckFormat(image))
+        {
+            return false;
+        }
+        image.glFormat = image.compressed ? 0 : (image.glInternalFormat == GL_RGBA8 ? GL_RGBA : GL_RGB);
+        image.glType = image.compressed ? 0 : GL_UNSIGNED_BYTE;
+
+        const uint32_t levelCount = image.generateMipmaps ? 1 : header.levelCount;
+        if (!CheckLevelCount(image.width, image.height, levelCount))
+        {
+            return false;
+        }
+        if (!InBounds(sizeof(header), (uint64_t)levelCount * sizeof(Ktx2Level), size))
+        {
+            LOGE("KTX2: level index truncated");
+            return false;
+        }
+
+        Ktx::BlockInfo block;
+        Ktx::GetBlockInfo(image.glInternalFormat, block);
+
+        image.levels.clear();
+        for (uint32_t i = 0; i < levelCount; ++i)
+        {
+            Ktx2Level entry;
+            memcpy(&entry, data + sizeof(header) + i * sizeof(entry), sizeof(entry));
+
+            Ktx::Level level;
+            level.width = Ktx::MipDimension(image.width, i);
+            level.height = Ktx::MipDimension(image.height, i);
+
+            const size_t expected = Ktx::LevelSize(block, level.width, level.height);
+            if (entry.byteLength != expected)
+            {
+                LOGE("KTX2: level %u is %llu bytes, expected %zu", i, (unsigned long long)entry.byteLength, expected);
+                return false;
+            }
+            if (!InBounds(entry.byteOffset, entry.byteLength, size))
+            {
+                LOGE("KTX2: level %u truncated", i);
+                return false;
+            }
+
+            level.offset = (size_t)entry.byteOffset;
+            level.size = (size_t)entry.byteLength;
+            image.levels.push_back(level);
+        }
+
+        return true;
+    }
+}
+
+bool Ktx::IsKtx(const unsigned char* data, size_t size)
+{
+    return size >= sizeof(g_Ktx1Identifier)
+        && (memcmp(data, g_Ktx1Identifier, sizeof(g_Ktx1Identifier)) == 0
+            || memcmp(data, g_Ktx2Identifier, sizeof(g_Ktx2Identifier)) == 0);
+}
+
+bool Ktx::Parse(const unsigned char* data, size_t size, Image& image)
+{
+    if (!data || size < sizeof(g_Ktx1Identifier))
+    {
+        LOGE("KTX: no data");
+        return false;
+    }
+
+    if (memcmp(data, g_Ktx1Identifier, sizeof(g_Ktx1Identifier)) == 0)
+    {
+        return ParseKtx1(data, size, image);
+    }
+    if (memcmp(data, g_Ktx2Identifier, sizeof(g_Ktx2Identifier)) == 0)
+    {
+        return ParseKtx2(data, size, image);
+    }
+
+    LOGE("KTX: unknown identifier");
+    return false;
+}
+
+bool Ktx::GetBlockInfo(uint32_t glInternalFormat, BlockInfo& info)
+{
+    switch (glInternalFormat)
+    {
+        case GL_RGBA:
+        case GL_RGBA8:
+            info = {1, 1, 4};
+            return true;
+        case GL_RGB:
+        case GL_RGB8:
+            info = {1, 1, 3};
+            return true;
+        case ETC1_RGB8:
+        case R11_EAC:
+        case SIGNED_R11_EAC:
+        case RGB8_ETC2:
+        case SRGB8_ETC2:
+        case RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+        case SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+            info = {4, 4, 8};
+            return true;
+        case RG11_EAC:
+        case SIGNED_RG11_EAC:
+        case RGBA8_ETC2_EAC:
+        case SRGB8_ALPHA8_ETC2_EAC:
+            info = {4, 4, 16};
+            return true;
+    }
+
+    uint32_t astc = 0xFFFFFFFF;
+    if (glInternalFormat >= RGBA_ASTC_4x4 && glInternalFormat <= RGBA_ASTC_12x12)
+    {
+        astc = glInternalFormat - RGBA_ASTC_4x4;
+    }
+    else if (glInternalFormat >= SRGB8_ALPHA8_ASTC_4x4 && glInternalFormat <= SRGB8_ALPHA8_ASTC_12x12)
+    {
+        astc = glInternalFormat - SRGB8_ALPHA8_ASTC_4x4;
+    }
+    if (astc != 0xFFFFFFFF)
+    {
+        // every ASTC block is 128 bits
+        info = {g_AstcBlocks[astc][0], g_AstcBlocks[astc][1], 16};
+        return true;
+    }
+
+    return false;
+}
+
+uint32_t Ktx::FullMipCount(uint32_t width, uint32_t height)
+{
+    uint32_t largest = width > height ? width : height;
+    uint32_t levels = 1;
+    while (largest > 1)
+    {
+        largest >>= 1;
+        levels++;
+    }
+    return levels;
+}
+
+uint32_t Ktx::MipDimension(uint32_t size, uint32_t level)
+{
+    const uint32_t dimension = level < 32 ? size >> level : 0;
+    return dimension > 0 ? dimension : 1;
+}
+
+size_t Ktx::LevelSize(const BlockInfo& info, uint32_t width, uint32_t height)
+{
+    const size_t blocksWide = (width + info.width - 1) / info.width;
+    const size_t blocksHigh = (height + info.height - 1) / info.height;
+    return blocksWide * blocksHigh * info.bytes;
+}
+
+uint32_t Ktx::FromVkFormat(uint32_t vkFormat)
+{
+    switch (vkFormat)
+    {
+        case VK_R8G8B8_UNORM:
+            return GL_RGB8;
+        case VK_R8G8B8A8_UNORM:
+            return GL_RGBA8;
+    }
+
+    // ETC2 and EAC are listed in the same order in both APIs, srgb or snorm
+    // right after each unorm format
+    static const uint32_t etc[] = {
+        RGB8_ETC2, SRGB8_ETC2,
+        RGB8_PUNCHTHROUGH_ALPHA1_ETC2, SRGB8_PUNCHTHROUGH_ALPHA1_ETC2,
+        RGBA8_ETC2_EAC, SRGB8_ALPHA8_ETC2_EAC,
+        R11_EAC, SIGNED_R11_EAC,
+        RG11_EAC, SIGNED_RG11_EAC,
+    };
+    if (vkFormat >= VK_ETC2_R8G8B8_UNORM && vkFormat <= VK_EAC_R11G11_SNORM)
+    {
+        return etc[vkFormat - VK_ETC2_R8G8B8_UNORM];
+    }
+
+    // ASTC alternates unorm and srgb per block size
+    if (vkFormat >= VK_ASTC_4x4_UNORM && vkFormat <= VK_ASTC_12x12_SRGB)
+    {
+        const uint32_t index = vkFormat - VK_ASTC_4x4_UNORM;
+        return (index & 1 ? SRGB8_ALPHA8_ASTC_4x4 : RGBA_ASTC_4x4) + index / 2;
+    }
+
+    return 0;
+}
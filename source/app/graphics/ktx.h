@@ -0,0 +1,93 @@
+/* KTX / KTX2 containers
+ *
+ * Parses the header and the mip level table of a KTX 1.1 or KTX 2.0 file
+ * held in memory; the level data is referenced in place, not copied. Only
+ * plain 2D textures are accepted: one face, one layer, no depth and, for
+ * KTX2, no supercompression.
+ *
+ * Formats are described by their GL internal format (KTX2's vkFormat is
+ * translated), which is all Texture needs to pick an upload path. Nothing
+ * in here touches GL.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Ktx
+{
+	// compressed formats this parser knows the block layout of
+	enum : uint32_t
+	{
+		ETC1_RGB8 = 0x8D64,
+		R11_EAC = 0x9270,
+		SIGNED_R11_EAC = 0x9271,
+		RG11_EAC = 0x9272,
+		SIGNED_RG11_EAC = 0x9273,
+		RGB8_ETC2 = 0x9274,
+		SRGB8_ETC2 = 0x9275,
+		RGB8_PUNCHTHROUGH_ALPHA1_ETC2 = 0x9276,
+		SRGB8_PUNCHTHROUGH_ALPHA1_ETC2 = 0x9277,
+		RGBA8_ETC2_EAC = 0x9278,
+		SRGB8_ALPHA8_ETC2_EAC = 0x9279,
+		// 4x4, 5x4, 5x5, 6x5, 6x6, 8x5, 8x6, 8x8, 10x5, 10x6, 10x8, 10x10, 12x10, 12x12
+		RGBA_ASTC_4x4 = 0x93B0,
+		RGBA_ASTC_12x12 = 0x93BD,
+		SRGB8_ALPHA8_ASTC_4x4 = 0x93D0,
+		SRGB8_ALPHA8_ASTC_12x12 = 0x93DD,
+	};
+
+	enum class Container
+	{
+		Ktx1,
+		Ktx2
+	};
+
+	struct BlockInfo
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t bytes;
+	};
+
+	struct Level
+	{
+		uint32_t width;
+		uint32_t height;
+		size_t offset; // from the start of the file
+		size_t size;
+	};
+
+	struct Image
+	{
+		Container container;
+		uint32_t glInternalFormat;
+		// 0 for compressed formats
+		uint32_t glFormat;
+		uint32_t glType;
+		uint32_t width;
+		uint32_t height;
+		bool compressed;
+		// KTX1 with numberOfMipmapLevels == 0: the loader should build the chain
+		bool generateMipmaps;
+		std::vector<Level> levels;
+	};
+
+	bool IsKtx(const unsigned char* data, size_t size);
+
+	// false and a log line on anything malformed or unsupported
+	bool Parse(const unsigned char* data, size_t size, Image& image);
+
+	// block dimensions of a compressed format, or 1x1 and the pixel size for
+	// the uncompressed ones (RGBA8, RGB8); false if unknown
+	bool GetBlockInfo(uint32_t glInternalFormat, BlockInfo& info);
+
+	// levels down to 1x1
+	uint32_t FullMipCount(uint32_t width, uint32_t height);
+	uint32_t MipDimension(uint32_t size, uint32_t level);
+	size_t LevelSize(const BlockInfo& info, uint32_t width, uint32_t height);
+
+	// GL internal format for a VkFormat value, 0 if not one we upload
+	uint32_t FromVkFormat(uint32_t vkFormat);
+}
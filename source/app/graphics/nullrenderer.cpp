@@ -0,0 +1,142 @@
+#include "nullrenderer.h"
+
+Renderer::NullBackend::NullBackend()
+{
+}
+
+Renderer::Api Renderer::NullBackend::GetApi() const
+{
+    return Api::Null;
+}
+
+bool Renderer::NullBackend::Initialize(ANativeWindow* window)
+{
+    return true;
+}
+
+void Renderer::NullBackend::Destroy()
+{
+    m_Buffers = Slots<Buffer>();
+    m_Textures = Slots<uint32_t>();
+    m_Pipelines = Slots<PipelineDesc>();
+    m_Recorded.clear();
+}
+
+Renderer::BufferId Renderer::NullBackend::CreateBuffer(BufferUsage usage, uint32_t size, bool dynamic)
+{
+    return m_Buffers.Add({usage, size});
+}
+
+bool Renderer::NullBackend::UpdateBuffer(BufferId buffer, uint32_t offset, const void* data, uint32_t size)
+{
+    Buffer* target = m_Buffers.Get(buffer);
+    if (!target || offset + size > target->size)
+    {
+        return false;
+    }
+    m_Stats.uploadBytes += size;
+    return true;
+}
+
+void Renderer::NullBackend::DestroyBuffer(BufferId buffer)
+{
+    m_Buffers.Remove(buffer);
+}
+
+Renderer::TextureId Renderer::NullBackend::CreateTexture(uint32_t width, uint32_t height, const unsigned char* pixels)
+{
+    m_Stats.uploadBytes += uint64_t(width) * height * 4;
+    return m_Textures.Add(width * height);
+}
+
+void Renderer::NullBackend::DestroyTexture(TextureId texture)
+{
+    m_Textures.Remove(texture);
+}
+
+Renderer::PipelineId Renderer::NullBackend::CreatePipeline(const PipelineDesc& desc)
+{
+    PipelineDesc copy = desc;
+    return m_Pipelines.Add(std::move(copy));
+}
+
+void Renderer::NullBackend::DestroyPipeline(PipelineId pipeline)
+{
+    m_Pipelines.Remove(pipeline);
+}
+
+bool Renderer::NullBackend::BeginFrame()
+{
+    ResetFrameState();
+    m_Recorded.clear();
+    return true;
+}
+
+void Renderer::NullBackend::Submit(const DrawList& list)
+{
+    Execute(list);
+}
+
+void Renderer::NullBackend::EndFrame()
+{
+    FinishFrameStats();
+}
+
+const std::vector<Renderer::DrawList::Command>& Renderer::NullBackend::Recorded() const
+{
+    return m_Recorded;
+}
+
+bool Renderer::NullBackend::ApplyPipeline(PipelineId pipeline)
+{
+    Record(DrawList::Op::Pipeline, pipeline);
+    return m_Pipelines.Get(pipeline) != nullptr;
+}
+
+bool Renderer::NullBackend::ApplyVertexBuffer(BufferId buffer, uint32_t offset)
+{
+    Record(DrawList::Op::VertexBuffer, buffer, offset);
+    Buffer* target = m_Buffers.Get(buffer);
+    return target && target->usage == BufferUsage::Vertex;
+}
+
+bool Renderer::NullBackend::ApplyIndexBuffer(BufferId buffer, uint32_t offset)
+{
+    Record(DrawList::Op::IndexBuffer, buffer, offset);
+    Buffer* target = m_Buffers.Get(buffer);
+    return target && target->usage == BufferUsage::Index;
+}
+
+bool Renderer::NullBackend::ApplyTexture(TextureId texture)
+{
+    Record(DrawList::Op::Texture, texture);
+    return m_Textures.Get(texture) != nullptr;
+}
+
+void Renderer::NullBackend::ApplyScissor(int32_t x, int32_t y, uint32_t width, uint32_t height)
+{
+    if (width == 0)
+    {
+        Record(DrawList::Op::NoScissor);
+    }
+    else
+    {
+        Record(DrawList::Op::Scissor, (uint32_t)x, (uint32_t)y, width, height);
+    }
+}
+
+void Renderer::NullBackend::ApplyDraw(uint32_t vertexCount, uint32_t firstVertex)
+{
+    Record(DrawList::Op::Draw, vertexCount, firstVertex);
+}
+
+void Renderer::NullBackend::ApplyDrawIndexed(uint32_t indexCount, uint32_t firstIndex, uint32_t vertexOffset)
+{
+    Record(DrawList::Op::DrawIndexed, indexCount, firstIndex, vertexOffset);
+}
+
+void Renderer::NullBackend::Record(DrawList::Op op, uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+{
+    DrawList::Command command = {op, {a, b, c, d}};
+    m_Recorded.push_back(command);
+}
@@ -0,0 +1,61 @@
+/* Null renderer backend
+ *
+ * Needs no window or GPU: resources are only bookkept, and what gets past
+ * the filtering in Backend::Execute is recorded, so draw submission can be
+ * measured and compared on a host.
+ */
+#pragma once
+
+#include "renderer.h"
+#include "slots.h"
+
+namespace Renderer
+{
+	class NullBackend : public Backend
+	{
+	public:
+		NullBackend();
+
+		virtual Api GetApi() const;
+		virtual bool Initialize(ANativeWindow* window);
+		virtual void Destroy();
+
+		virtual BufferId CreateBuffer(BufferUsage usage, uint32_t size, bool dynamic);
+		virtual bool UpdateBuffer(BufferId buffer, uint32_t offset, const void* data, uint32_t size);
+		virtual void DestroyBuffer(BufferId buffer);
+		virtual TextureId CreateTexture(uint32_t width, uint32_t height, const unsigned char* pixels);
+		virtual void DestroyTexture(TextureId texture);
+		virtual PipelineId CreatePipeline(const PipelineDesc& desc);
+		virtual void DestroyPipeline(PipelineId pipeline);
+
+		virtual bool BeginFrame();
+		virtual void Submit(const DrawList& list);
+		virtual void EndFrame();
+
+		// what got past the filtering in the current (or last) frame
+		const std::vector<DrawList::Command>& Recorded() const;
+
+	protected:
+		virtual bool ApplyPipeline(PipelineId pipeline);
+		virtual bool ApplyVertexBuffer(BufferId buffer, uint32_t offset);
+		virtual bool ApplyIndexBuffer(BufferId buffer, uint32_t offset);
+		virtual bool ApplyTexture(TextureId texture);
+		virtual void ApplyScissor(int32_t x, int32_t y, uint32_t width, uint32_t height);
+		virtual void ApplyDraw(uint32_t vertexCount, uint32_t firstVertex);
+		virtual void ApplyDrawIndexed(uint32_t indexCount, uint32_t firstIndex, uint32_t vertexOffset);
+
+	private:
+		struct Buffer
+		{
+			BufferUsage usage;
+			uint32_t size;
+		};
+
+		void Record(DrawList::Op op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0, uint32_t d = 0);
+
+		Slots<Buffer> m_Buffers;
+		Slots<uint32_t> m_Textures;
+		Slots<PipelineDesc> m_Pipelines;
+		std::vector<DrawList::Command> m_Recorded;
+	};
+}
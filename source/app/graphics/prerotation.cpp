@@ -0,0 +1,76 @@
+#include "prerotation.h"
+#include <algorithm>
+#include <iterator>
+
+namespace {
+    // cos / sin of the quarter turns, indexed by Rotation
+    const float g_Cos[] = { 1.0f,  0.0f, -1.0f,  0.0f };
+    const float g_Sin[] = { 0.0f,  1.0f,  0.0f, -1.0f };
+}
+
+bool PreRotation::SwapsExtent(Rotation rotation)
+{
+    return rotation == Rotation::Rotate90 || rotation == Rotation::Rotate270;
+}
+
+PreRotation::Extent PreRotation::NativeExtent(const Extent& current, Rotation rotation)
+{
+    if (SwapsExtent(rotation))
+    {
+        return {current.height, current.width};
+    }
+    return current;
+}
+
+void PreRotation::Matrix(Rotation rotation, float out[16])
+{
+    unsigned index = static_cast<unsigned>(rotation) % static_cast<unsigned>(Rotation::Count);
+    const float c = g_Cos[index];
+    const float s = g_Sin[index];
+    const float matrix[16] = {
+           c,    s, 0.0f, 0.0f,
+          -s,    c, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        0.0f, 0.0f, 0.0f, 1.0f,
+    };
+    std::copy(std::begin(matrix), std::end(matrix), out);
+}
+
+void PreRotation::Apply(Rotation rotation, const float projection[16], float out[16])
+{
+    float rotate[16];
+    Matrix(rotation, rotate);
+
+    float result[16];
+    for (int column = 0; column < 4; ++column)
+    {
+        for (int row = 0; row < 4; ++row)
+        {
+            float sum = 0.0f;
+            for (int k = 0; k < 4; ++k)
+            {
+                sum += rotate[k * 4 + row] * projection[column * 4 + k];
+            }
+            result[column * 4 + row] = sum;
+        }
+    }
+    // allow out == projection
+    std::copy(std::begin(result), std::end(result), out);
+}
+
+PreRotation::Rect PreRotation::NativeRect(const Rect& rect, const Extent& window, Rotation rotation)
+{
+    const int32_t width = (int32_t)window.width;
+    const int32_t height = (int32_t)window.height;
+    switch (rotation)
+    {
+    case Rotation::Rotate90:
+        return {height - rect.y - (int32_t)rect.height, rect.x, rect.height, rect.width};
+    case Rotation::Rotate180:
+        return {width - rect.x - (int32_t)rect.width, height - rect.y - (int32_t)rect.height, rect.width, rect.height};
+    case Rotation::Rotate270:
+        return {rect.y, width - rect.x - (int32_t)rect.width, rect.height, rect.width};
+    default:
+        return rect;
+    }
+}
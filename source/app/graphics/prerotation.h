@@ -0,0 +1,53 @@
+/* Swapchain pre-rotation
+ *
+ * When the display is rotated relative to its native orientation, the
+ * compositor would otherwise rotate every presented image with an extra
+ * full-screen pass. Instead we render in the native orientation and rotate
+ * the projection ourselves, so presenting is a plain scanout.
+ *
+ * Only plain math lives here (no Vulkan types), so it can be checked on a host.
+ */
+#pragma once
+#include <cstdint>
+
+namespace PreRotation
+{
+	enum class Rotation : unsigned
+	{
+		Identity = 0,
+		Rotate90,
+		Rotate180,
+		Rotate270,
+
+		Count
+	};
+
+	struct Extent
+	{
+		uint32_t width;
+		uint32_t height;
+	};
+
+	struct Rect
+	{
+		int32_t x;
+		int32_t y;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	// true for quarter turns, where width and height trade places
+	bool SwapsExtent(Rotation rotation);
+
+	// the extent of the swapchain images for a window of 'current' size
+	Extent NativeExtent(const Extent& current, Rotation rotation);
+
+	// column-major 4x4 rotation around z, to be applied after the projection
+	void Matrix(Rotation rotation, float out[16]);
+
+	// out = Matrix(rotation) * projection, both column-major
+	void Apply(Rotation rotation, const float projection[16], float out[16]);
+
+	// a rectangle in window pixels (origin top left) in the swapchain images, e.g. for scissors
+	Rect NativeRect(const Rect& rect, const Extent& window, Rotation rotation);
+}
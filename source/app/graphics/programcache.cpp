@@ -0,0 +1,193 @@
+#include "programcache.h"
+#include "graphics.h"
+#include "utils/contentcache.h"
+#include "utils/log.h"
+#include <GLES2/gl2ext.h>
+#include <EGL/egl.h>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace {
+    const uint32_t g_Magic = 0x42505347; // "GSPB"
+    const uint64_t g_FnvOffset = 14695981039346656037ULL;
+    const uint64_t g_FnvPrime = 1099511628211ULL;
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t format;
+        uint32_t length;
+        uint32_t reserved;
+        uint64_t key;
+    };
+
+    //a few hundred programs of a large app
+    const uint64_t g_MaxBytes = 16 << 20;
+
+    std::unique_ptr<Vfs::ContentCache> g_Cache;
+    bool g_Supported = false;
+    uint64_t g_DriverHash = g_FnvOffset;
+    ProgramCache::Stats g_Stats = {0, 0, 0, 0};
+
+    PFNGLGETPROGRAMBINARYOESPROC g_GetProgramBinary = nullptr;
+    PFNGLPROGRAMBINARYOESPROC g_ProgramBinary = nullptr;
+
+    // FNV-1a, including the terminator so "ab" + "c" and "a" + "bc" differ
+    uint64_t Hash(uint64_t hash, const char* text)
+    {
+        if (text)
+        {
+            for (const char* c = text; *c; ++c)
+            {
+                hash ^= (unsigned char)*c;
+                hash *= g_FnvPrime;
+            }
+        }
+        hash *= g_FnvPrime;
+        return hash;
+    }
+
+    Vfs::Hash128 EntryKey(uint64_t key)
+    {
+        const Vfs::Span source = {reinterpret_cast<const unsigned char*>(&key), sizeof(key)};
+        return Vfs::ContentCache::Key(source, "program binary");
+    }
+}
+
+void ProgramCache::SetDirectory(const std::string& directory)
+{
+    g_Cache.reset(new Vfs::ContentCache(std::make_shared<Vfs::PosixFileSystem>(directory, true), "programs", g_MaxBytes));
+}
+
+bool ProgramCache::Initialize()
+{
+    g_Supported = false;
+    g_Stats = {0, 0, 0, 0};
+
+    if (!g_Cache)
+    {
+        LOGI("Program cache: no cache directory set");
+        return false;
+    }
+
+    if (!Graphics::HasExtension("GL_OES_get_program_binary"))
+    {
+        LOGI("Program cache: GL_OES_get_program_binary not supported");
+        return false;
+    }
+
+    GLint formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS_OES, &formatCount);
+    if (formatCount <= 0)
+    {
+        LOGI("Program cache: the driver offers no binary formats");
+        return false;
+    }
+
+    g_GetProgramBinary = (PFNGLGETPROGRAMBINARYOESPROC)eglGetProcAddress("glGetProgramBinaryOES");
+    g_ProgramBinary = (PFNGLPROGRAMBINARYOESPROC)eglGetProcAddress("glProgramBinaryOES");
+    if (!g_GetProgramBinary || !g_ProgramBinary)
+    {
+        LOGW("Program cache: extension advertised but entry points missing");
+        return false;
+    }
+
+    g_DriverHash = g_FnvOffset;
+    g_DriverHash = Hash(g_DriverHash, (const char*)glGetString(GL_VENDOR));
+    g_DriverHash = Hash(g_DriverHash, (const char*)glGetString(GL_RENDERER));
+    g_DriverHash = Hash(g_DriverHash, (const char*)glGetString(GL_VERSION));
+
+    g_Supported = true;
+    return true;
+}
+
+uint64_t ProgramCache::Key(const char* vertexShaderSource, const char* fragmentShaderSource)
+{
+    return Hash(Hash(g_DriverHash, vertexShaderSource), fragmentShaderSource);
+}
+
+bool ProgramCache::Load(uint64_t key, GLuint program)
+{
+    if (!g_Supported || program == 0)
+    {
+        return false;
+    }
+
+    std::vector<unsigned char> blob;
+    if (!g_Cache->Load(EntryKey(key), blob))
+    {
+        g_Stats.misses++;
+        return false;
+    }
+
+    Header header;
+    bool valid = blob.size() > sizeof(header);
+    if (valid)
+    {
+        memcpy(&header, blob.data(), sizeof(header));
+        valid = header.magic == g_Magic
+            && header.key == key
+            && header.length == blob.size() - sizeof(header);
+    }
+
+    if (valid)
+    {
+        g_ProgramBinary(program, header.format, blob.data() + sizeof(header), (GLint)header.length);
+
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        valid = linked == GL_TRUE;
+    }
+
+    if (!valid)
+    {
+        LOGW("Program cache: rejected %016llx, building from source", (unsigned long long)key);
+        g_Cache->Remove(EntryKey(key));
+        g_Stats.rejected++;
+        return false;
+    }
+
+    g_Stats.hits++;
+    return true;
+}
+
+void ProgramCache::Store(uint64_t key, GLuint program)
+{
+    if (!g_Supported)
+    {
+        return;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH_OES, &length);
+    if (length <= 0)
+    {
+        return;
+    }
+
+    std::vector<unsigned char> blob(sizeof(Header) + length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    g_GetProgramBinary(program, length, &written, &format, blob.data() + sizeof(Header));
+    if (written <= 0)
+    {
+        return;
+    }
+
+    const Header header = {g_Magic, format, (uint32_t)written, 0, key};
+    memcpy(blob.data(), &header, sizeof(header));
+    blob.resize(sizeof(header) + written);
+    if (!g_Cache->Store(EntryKey(key), blob.data(), blob.size()))
+    {
+        LOGW("Program cache: unable to store %016llx", (unsigned long long)key);
+        return;
+    }
+
+    g_Stats.stored++;
+}
+
+const ProgramCache::Stats& ProgramCache::GetStats()
+{
+    return g_Stats;
+}
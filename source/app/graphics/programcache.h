@@ -0,0 +1,46 @@
+/* Program binary cache
+ *
+ * Linked programs are saved through GL_OES_get_program_binary and loaded
+ * back on the next Graphics::Initialize instead of compiling from source.
+ * Blobs are keyed by a hash of both sources and the GL vendor, renderer and
+ * version strings, so a driver update never sees an old binary. A blob the
+ * driver rejects is deleted and the program is built from source again.
+ *
+ * The blobs live in a Vfs::ContentCache in "programs" below the directory,
+ * which checks them for damage, writes them atomically and keeps them under
+ * a few MB by dropping the least recently used.
+ *
+ * Without the extension, or before SetDirectory, every Load misses and
+ * Store does nothing.
+ */
+#pragma once
+
+#include <GLES2/gl2.h>
+#include <cstdint>
+#include <string>
+
+namespace ProgramCache
+{
+	struct Stats
+	{
+		unsigned int hits;
+		unsigned int misses;
+		unsigned int rejected;
+		unsigned int stored;
+	};
+
+	// where the blobs go, the app's cache dir
+	void SetDirectory(const std::string& directory);
+
+	// with a current context, before the first program is created
+	bool Initialize();
+
+	uint64_t Key(const char* vertexShaderSource, const char* fragmentShaderSource);
+
+	// program is a fresh glCreateProgram object; true if it is linked from the cache
+	bool Load(uint64_t key, GLuint program);
+	// program has to be linked
+	void Store(uint64_t key, GLuint program);
+
+	const Stats& GetStats();
+}
@@ -0,0 +1,219 @@
+#include "renderer.h"
+#include <cstring>
+
+namespace {
+    const char* g_ApiNames[] = { "gles", "vulkan", "null" };
+
+    const uint32_t Unset = 0xFFFFFFFF;
+
+    Renderer::DrawList::Command UnsetCommand(Renderer::DrawList::Op op)
+    {
+        Renderer::DrawList::Command command = {op, {Unset, Unset, Unset, Unset}};
+        return command;
+    }
+}
+
+const char* Renderer::ApiName(Api api)
+{
+    return api < Api::Count ? g_ApiNames[(unsigned)api] : "unknown";
+}
+
+bool Renderer::ParseApi(const char* name, Api& api)
+{
+    for (unsigned i = 0; i < (unsigned)Api::Count; ++i)
+    {
+        if (strcmp(name, g_ApiNames[i]) == 0)
+        {
+            api = (Api)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+void Renderer::DrawList::Clear()
+{
+    m_Commands.clear();
+}
+
+void Renderer::DrawList::SetPipeline(PipelineId pipeline)
+{
+    Add(Op::Pipeline, pipeline);
+}
+
+void Renderer::DrawList::SetVertexBuffer(BufferId buffer, uint32_t offset)
+{
+    Add(Op::VertexBuffer, buffer, offset);
+}
+
+void Renderer::DrawList::SetIndexBuffer(BufferId buffer, uint32_t offset)
+{
+    Add(Op::IndexBuffer, buffer, offset);
+}
+
+void Renderer::DrawList::SetTexture(TextureId texture)
+{
+    Add(Op::Texture, texture);
+}
+
+void Renderer::DrawList::SetScissor(int32_t x, int32_t y, uint32_t width, uint32_t height)
+{
+    Add(Op::Scissor, (uint32_t)x, (uint32_t)y, width, height);
+}
+
+void Renderer::DrawList::ClearScissor()
+{
+    Add(Op::NoScissor);
+}
+
+void Renderer::DrawList::Draw(uint32_t vertexCount, uint32_t firstVertex)
+{
+    Add(Op::Draw, vertexCount, firstVertex);
+}
+
+void Renderer::DrawList::DrawIndexed(uint32_t indexCount, uint32_t firstIndex, uint32_t vertexOffset)
+{
+    Add(Op::DrawIndexed, indexCount, firstIndex, vertexOffset);
+}
+
+const std::vector<Renderer::DrawList::Command>& Renderer::DrawList::Commands() const
+{
+    return m_Commands;
+}
+
+void Renderer::DrawList::Add(Op op, uint32_t a, uint32_t b, uint32_t c, uint32_t d)
+{
+    Command command = {op, {a, b, c, d}};
+    m_Commands.push_back(command);
+}
+
+Renderer::Backend::Backend()
+{
+    m_Stats = {};
+    m_LastStats = {};
+    ResetFrameState();
+}
+
+const Renderer::FrameStats& Renderer::Backend::GetStats() const
+{
+    return m_LastStats;
+}
+
+void Renderer::Backend::ResetFrameState()
+{
+    m_Bound.pipeline = UnsetCommand(DrawList::Op::Pipeline);
+    m_Bound.vertexBuffer = UnsetCommand(DrawList::Op::VertexBuffer);
+    m_Bound.indexBuffer = UnsetCommand(DrawList::Op::IndexBuffer);
+    m_Bound.texture = UnsetCommand(DrawList::Op::Texture);
+    //every frame starts without a scissor
+    m_Bound.scissor = {DrawList::Op::NoScissor, {0, 0, 0, 0}};
+    m_Bound.pipelineOk = false;
+    m_Bound.vertexBufferOk = false;
+    m_Bound.indexBufferOk = false;
+    m_Bound.textureOk = false;
+
+    //uploads before BeginFrame count towards the frame
+    const uint64_t uploadBytes = m_Stats.uploadBytes;
+    m_Stats = {};
+    m_Stats.uploadBytes = uploadBytes;
+}
+
+void Renderer::Backend::FinishFrameStats()
+{
+    m_LastStats = m_Stats;
+    m_Stats = {};
+}
+
+bool Renderer::Backend::Changes(DrawList::Command& bound, const DrawList::Command& command)
+{
+    if (bound.op == command.op && memcmp(bound.args, command.args, sizeof(command.args)) == 0)
+    {
+        m_Stats.redundant++;
+        return false;
+    }
+    bound = command;
+    return true;
+}
+
+void Renderer::Backend::Execute(const DrawList& list)
+{
+    const std::vector<DrawList::Command>& commands = list.Commands();
+    m_Stats.commands += (uint32_t)commands.size();
+
+    for (const DrawList::Command& command : commands)
+    {
+        const uint32_t* args = command.args;
+        switch (command.op)
+        {
+        case DrawList::Op::Pipeline:
+            if (Changes(m_Bound.pipeline, command))
+            {
+                m_Bound.pipelineOk = ApplyPipeline(args[0]);
+                m_Stats.pipelineChanges++;
+            }
+            break;
+        case DrawList::Op::VertexBuffer:
+            if (Changes(m_Bound.vertexBuffer, command))
+            {
+                m_Bound.vertexBufferOk = ApplyVertexBuffer(args[0], args[1]);
+                m_Stats.bufferChanges++;
+            }
+            break;
+        case DrawList::Op::IndexBuffer:
+            if (Changes(m_Bound.indexBuffer, command))
+            {
+                m_Bound.indexBufferOk = ApplyIndexBuffer(args[0], args[1]);
+                m_Stats.bufferChanges++;
+            }
+            break;
+        case DrawList::Op::Texture:
+            if (Changes(m_Bound.texture, command))
+            {
+                m_Bound.textureOk = ApplyTexture(args[0]);
+                m_Stats.textureChanges++;
+            }
+            break;
+        case DrawList::Op::Scissor:
+        case DrawList::Op::NoScissor:
+            if (Changes(m_Bound.scissor, command))
+            {
+                if (command.op == DrawList::Op::Scissor)
+                {
+                    ApplyScissor((int32_t)args[0], (int32_t)args[1], args[2], args[3]);
+                }
+                else
+                {
+                    ApplyScissor(0, 0, 0, 0);
+                }
+                m_Stats.scissorChanges++;
+            }
+            break;
+        case DrawList::Op::Draw:
+        case DrawList::Op::DrawIndexed:
+        {
+            const bool indexed = command.op == DrawList::Op::DrawIndexed;
+            if (!m_Bound.pipelineOk || !m_Bound.vertexBufferOk || !m_Bound.textureOk || (indexed && !m_Bound.indexBufferOk))
+            {
+                m_Stats.invalid++;
+                break;
+            }
+            if (args[0] == 0)
+            {
+                break;
+            }
+
+            if (indexed)
+            {
+                ApplyDrawIndexed(args[0], args[1], args[2]);
+            }
+            else
+            {
+                ApplyDraw(args[0], args[1]);
+            }
+            m_Stats.drawCalls++;
+            m_Stats.vertices += args[0];
+            break;
+        }
+        }
+    }
+}
@@ -0,0 +1,220 @@
+/* Renderer
+ *
+ * One interface over the GLES and the Vulkan path. Resources are created
+ * through the backend and named by small ids; drawing is recorded into
+ * DrawLists, plain arrays of commands that a backend replays between
+ * BeginFrame() and EndFrame(). Redundant state in the lists (the same
+ * pipeline, buffer, texture or scissor again) is dropped before it reaches
+ * the API, the same way for every backend, and counted in FrameStats.
+ *
+ * Everything is 2D: one vertex layout (the same as ImGui's), 16 bit indices,
+ * and positions in window pixels with the origin top left.
+ *
+ * NullBackend (nullrenderer.h) needs no window or GPU; it keeps what
+ * reaches it, so draw submission can be measured and compared on a host.
+ * This interface and the filtering build on a host too; Create() and
+ * CreateForWindow() live with the real backends, in rendererfactory.cpp.
+ */
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct ANativeWindow;
+
+namespace Renderer
+{
+	enum class Api : unsigned
+	{
+		Gles = 0,
+		Vulkan,
+		Null,
+
+		Count
+	};
+
+	const char* ApiName(Api api);
+	// "gles", "vulkan" or "null"
+	bool ParseApi(const char* name, Api& api);
+
+	typedef uint32_t BufferId;
+	typedef uint32_t TextureId;
+	typedef uint32_t PipelineId;
+	const uint32_t InvalidId = 0;
+
+	struct Vertex
+	{
+		float x;
+		float y;
+		float u;
+		float v;
+		uint32_t color; // RGBA8, red in the lowest byte
+	};
+
+	enum class BufferUsage : unsigned
+	{
+		Vertex = 0,
+		Index,
+	};
+
+	enum class Blend : unsigned
+	{
+		Opaque = 0,
+		Alpha,
+		Additive,
+	};
+
+	struct PipelineDesc
+	{
+		// GLES: a program known to Graphics::GetShader; Vulkan: shaders/<shader>.vert.spv and .frag.spv
+		std::string shader;
+		Blend blend;
+	};
+
+	class DrawList
+	{
+	public:
+		enum class Op : uint8_t
+		{
+			Pipeline = 0,
+			VertexBuffer,
+			IndexBuffer,
+			Texture,
+			Scissor,
+			NoScissor,
+			Draw,
+			DrawIndexed,
+		};
+
+		struct Command
+		{
+			Op op;
+			uint32_t args[4];
+		};
+
+		void Clear();
+
+		void SetPipeline(PipelineId pipeline);
+		// offsets in bytes
+		void SetVertexBuffer(BufferId buffer, uint32_t offset = 0);
+		void SetIndexBuffer(BufferId buffer, uint32_t offset = 0);
+		void SetTexture(TextureId texture);
+		// window pixels, origin top left
+		void SetScissor(int32_t x, int32_t y, uint32_t width, uint32_t height);
+		void ClearScissor();
+		void Draw(uint32_t vertexCount, uint32_t firstVertex = 0);
+		// vertexOffset is added to every index
+		void DrawIndexed(uint32_t indexCount, uint32_t firstIndex = 0, uint32_t vertexOffset = 0);
+
+		const std::vector<Command>& Commands() const;
+
+	private:
+		void Add(Op op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0, uint32_t d = 0);
+
+		std::vector<Command> m_Commands;
+	};
+
+	struct FrameStats
+	{
+		uint32_t commands;
+		uint32_t drawCalls;
+		// drawn, indexed or not
+		uint32_t vertices;
+		uint32_t pipelineChanges;
+		uint32_t bufferChanges;
+		uint32_t textureChanges;
+		uint32_t scissorChanges;
+		// state commands that changed nothing
+		uint32_t redundant;
+		// draws skipped for a pipeline, buffer or texture that doesn't exist (or isn't ready yet)
+		uint32_t invalid;
+		uint64_t uploadBytes;
+	};
+
+	class Backend
+	{
+	public:
+		virtual ~Backend() {}
+
+		virtual Api GetApi() const = 0;
+		// only the null backend does without a window
+		virtual bool Initialize(ANativeWindow* window) = 0;
+		virtual void Destroy() = 0;
+		// the window is gone or back; resources live on
+		virtual void ReleaseSurface() {}
+		virtual bool AcquireSurface(ANativeWindow* window) { return true; }
+
+		// dynamic buffers are rewritten every frame, after BeginFrame(); updating a
+		// static one may wait for the GPU
+		virtual BufferId CreateBuffer(BufferUsage usage, uint32_t size, bool dynamic) = 0;
+		virtual bool UpdateBuffer(BufferId buffer, uint32_t offset, const void* data, uint32_t size) = 0;
+		virtual void DestroyBuffer(BufferId buffer) = 0;
+		// RGBA8, tightly packed
+		virtual TextureId CreateTexture(uint32_t width, uint32_t height, const unsigned char* pixels) = 0;
+		virtual void DestroyTexture(TextureId texture) = 0;
+		virtual PipelineId CreatePipeline(const PipelineDesc& desc) = 0;
+		virtual void DestroyPipeline(PipelineId pipeline) = 0;
+		// Vfs paths of changed files, for hot reloading: the pipelines built
+		// from them are rebuilt, keeping their ids; the number rebuilt
+		virtual unsigned ReloadShaders(const std::vector<std::string>& paths) { return 0; }
+
+		// false when there is nothing to draw to, skip the frame then
+		virtual bool BeginFrame() = 0;
+		// the list may be reused as soon as this returns
+		virtual void Submit(const DrawList& list) = 0;
+		virtual void EndFrame() = 0;
+
+		// of the last finished frame
+		const FrameStats& GetStats() const;
+
+	protected:
+		Backend();
+
+		// for BeginFrame: forgets the bound state, starts counting
+		void ResetFrameState();
+		// for EndFrame
+		void FinishFrameStats();
+		// filters and counts, then hands on to the Apply functions. A draw needs a
+		// pipeline, a texture and a vertex buffer (and an index buffer if indexed)
+		void Execute(const DrawList& list);
+
+		// false if the object is unknown or not ready; draws with it are skipped
+		virtual bool ApplyPipeline(PipelineId pipeline) = 0;
+		virtual bool ApplyVertexBuffer(BufferId buffer, uint32_t offset) = 0;
+		virtual bool ApplyIndexBuffer(BufferId buffer, uint32_t offset) = 0;
+		virtual bool ApplyTexture(TextureId texture) = 0;
+		// width 0: no scissor
+		virtual void ApplyScissor(int32_t x, int32_t y, uint32_t width, uint32_t height) = 0;
+		virtual void ApplyDraw(uint32_t vertexCount, uint32_t firstVertex) = 0;
+		virtual void ApplyDrawIndexed(uint32_t indexCount, uint32_t firstIndex, uint32_t vertexOffset) = 0;
+
+		FrameStats m_Stats;
+
+	private:
+		struct Bound
+		{
+			DrawList::Command pipeline;
+			DrawList::Command vertexBuffer;
+			DrawList::Command indexBuffer;
+			DrawList::Command texture;
+			DrawList::Command scissor;
+			// whether the last one applied took
+			bool pipelineOk;
+			bool vertexBufferOk;
+			bool indexBufferOk;
+			bool textureOk;
+		};
+
+		bool Changes(DrawList::Command& bound, const DrawList::Command& command);
+
+		Bound m_Bound;
+		FrameStats m_LastStats;
+	};
+
+	std::unique_ptr<Backend> Create(Api api);
+	// the API from the debug.vulkansink.renderer property if set, otherwise Vulkan;
+	// GLES when Vulkan doesn't come up. nullptr if nothing does
+	std::unique_ptr<Backend> CreateForWindow(ANativeWindow* window);
+}
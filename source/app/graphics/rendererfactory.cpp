@@ -0,0 +1,57 @@
+#include "renderer.h"
+#include "glesrenderer.h"
+#include "vulkanrenderer.h"
+#include "nullrenderer.h"
+#include "utils/log.h"
+
+#ifdef __ANDROID__
+#include <sys/system_properties.h>
+#endif
+
+std::unique_ptr<Renderer::Backend> Renderer::Create(Api api)
+{
+    switch (api)
+    {
+    case Api::Gles:
+        return std::unique_ptr<Backend>(new GlesBackend());
+    case Api::Vulkan:
+        return std::unique_ptr<Backend>(new VulkanBackend());
+    case Api::Null:
+        return std::unique_ptr<Backend>(new NullBackend());
+    default:
+        return std::unique_ptr<Backend>();
+    }
+}
+
+std::unique_ptr<Renderer::Backend> Renderer::CreateForWindow(ANativeWindow* window)
+{
+    Api api = Api::Vulkan;
+#ifdef __ANDROID__
+    char value[PROP_VALUE_MAX] = {};
+    if (__system_property_get("debug.vulkansink.renderer", value) > 0 && !ParseApi(value, api))
+    {
+        LOGW("Renderer: unknown renderer '%s'", value);
+    }
+#endif
+
+    std::unique_ptr<Backend> backend = Create(api);
+    if (backend && backend->Initialize(window))
+    {
+        LOGI("Renderer: %s", ApiName(api));
+        return backend;
+    }
+
+    if (api == Api::Vulkan)
+    {
+        LOGW("Renderer: Vulkan didn't come up, falling back to GLES");
+        backend = Create(Api::Gles);
+        if (backend && backend->Initialize(window))
+        {
+            LOGI("Renderer: %s", ApiName(Api::Gles));
+            return backend;
+        }
+    }
+
+    LOGE("Renderer: unable to initialize %s", ApiName(api));
+    return std::unique_ptr<Backend>();
+}
@@ -0,0 +1,628 @@
+#include "rendergraph.h"
+#include <algorithm>
+
+namespace {
+    using namespace RenderGraph;
+
+    struct UseInfo
+    {
+        Layout layout;
+        unsigned stage;
+        unsigned access;
+        bool write;
+    };
+
+    // what happened last to a resource, for working out the next barrier
+    struct ResourceState
+    {
+        Layout layout;
+        unsigned stage;
+        unsigned access;
+        bool written;
+        bool accessed;
+    };
+
+    bool IsAttachment(Usage usage)
+    {
+        return usage != Usage::Sampled;
+    }
+
+    UseInfo GetUseInfo(Usage usage, bool write)
+    {
+        switch (usage)
+        {
+            case Usage::ColorAttachment:
+                return {Layout::ColorAttachment, StageColorOutput, write ? AccessColorWrite | AccessColorRead : AccessColorRead, write};
+            case Usage::DepthAttachment:
+                return {Layout::DepthStencilAttachment, StageEarlyFragmentTests | StageLateFragmentTests, write ? AccessDepthWrite | AccessDepthRead : AccessDepthRead, write};
+            case Usage::InputAttachment:
+                return {Layout::ShaderReadOnly, StageFragmentShader, AccessInputAttachmentRead, false};
+            case Usage::Sampled:
+            default:
+                return {Layout::ShaderReadOnly, StageFragmentShader, AccessShaderRead, false};
+        }
+    }
+
+    unsigned FindAttachment(PhysicalPass& physical, Resource resource)
+    {
+        for (unsigned i = 0; i < physical.attachments.size(); ++i)
+        {
+            if (physical.attachments[i].resource == resource)
+            {
+                return i;
+            }
+        }
+
+        Attachment attachment = {};
+        attachment.resource = resource;
+        physical.attachments.push_back(attachment);
+        return static_cast<unsigned>(physical.attachments.size() - 1);
+    }
+}
+
+RenderGraph::Resource RenderGraph::Graph::CreateTexture(const std::string& name, const TextureDesc& desc)
+{
+    ResourceInfo info = {};
+    info.name = name;
+    info.desc = desc;
+    info.imported = false;
+    info.initialLayout = Layout::Undefined;
+    info.finalLayout = Layout::Undefined;
+    info.memorySlot = -1;
+    m_Resources.push_back(info);
+    return static_cast<Resource>(m_Resources.size() - 1);
+}
+
+RenderGraph::Resource RenderGraph::Graph::Import(const std::string& name, const TextureDesc& desc, Layout initialLayout, Layout finalLayout)
+{
+    Resource resource = CreateTexture(name, desc);
+    m_Resources[resource].imported = true;
+    m_Resources[resource].initialLayout = initialLayout;
+    m_Resources[resource].finalLayout = finalLayout;
+    return resource;
+}
+
+unsigned RenderGraph::Graph::AddPass(const std::string& name, const ExecuteCallback& execute)
+{
+    Pass pass;
+    pass.name = name;
+    pass.execute = execute;
+    pass.culled = false;
+    m_Passes.push_back(pass);
+    return static_cast<unsigned>(m_Passes.size() - 1);
+}
+
+void RenderGraph::Graph::Read(unsigned pass, Resource resource, Usage usage)
+{
+    PassAccess access = {resource, usage, false, false, {}};
+    m_Passes[pass].accesses.push_back(access);
+}
+
+void RenderGraph::Graph::Write(unsigned pass, Resource resource, Usage usage)
+{
+    PassAccess access = {resource, usage, true, false, {}};
+    m_Passes[pass].accesses.push_back(access);
+}
+
+void RenderGraph::Graph::Write(unsigned pass, Resource resource, Usage usage, const ClearValue& clear)
+{
+    PassAccess access = {resource, usage, true, true, clear};
+    m_Passes[pass].accesses.push_back(access);
+}
+
+void RenderGraph::Graph::Reset()
+{
+    m_Resources.clear();
+    m_Passes.clear();
+    m_PhysicalPasses.clear();
+    m_FinalBarriers.clear();
+    m_MemorySlots.clear();
+}
+
+void RenderGraph::Graph::Cull()
+{
+    // walk backwards: a pass survives when an imported resource or a surviving pass needs what it writes
+    std::vector<bool> needed(m_Resources.size(), false);
+    for (size_t p = m_Passes.size(); p-- > 0;)
+    {
+        Pass& pass = m_Passes[p];
+        pass.culled = true;
+        for (const auto& access : pass.accesses)
+        {
+            if (access.write && (m_Resources[access.resource].imported || needed[access.resource]))
+            {
+                pass.culled = false;
+            }
+        }
+
+        if (pass.culled)
+        {
+            continue;
+        }
+
+        for (const auto& access : pass.accesses)
+        {
+            // a write without clear keeps the previous contents, so whoever wrote them is needed too
+            if (!access.write || !access.clear)
+            {
+                needed[access.resource] = true;
+            }
+        }
+    }
+}
+
+bool RenderGraph::Graph::CanMerge(const PhysicalPass& physical, const Pass& pass, const Backend& backend) const
+{
+    if (!backend.IsTiler())
+    {
+        return false;
+    }
+
+    for (const auto& access : pass.accesses)
+    {
+        const TextureDesc& desc = m_Resources[access.resource].desc;
+        if (IsAttachment(access.usage) && (desc.width != physical.width || desc.height != physical.height))
+        {
+            return false;
+        }
+
+        // sampling needs the whole image, so anything rendered in this render pass has to be stored first
+        if (access.usage == Usage::Sampled)
+        {
+            for (const auto& attachment : physical.attachments)
+            {
+                if (attachment.resource == access.resource)
+                {
+                    return false;
+                }
+            }
+        }
+
+        // and the other way around: what an earlier subpass sampled can't become an attachment
+        if (IsAttachment(access.usage))
+        {
+            for (const auto& subpass : physical.subpasses)
+            {
+                for (const auto& previous : m_Passes[subpass.pass].accesses)
+                {
+                    if (previous.resource == access.resource && previous.usage == Usage::Sampled)
+                    {
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+void RenderGraph::Graph::AssignMemory(const Backend& backend, const std::vector<int>& firstUse, const std::vector<int>& lastUse, std::vector<Resource>& aliased)
+{
+    struct Slot
+    {
+        uint64_t size;
+        int lastUse;
+        Resource occupant;
+    };
+    std::vector<Slot> slots;
+
+    std::vector<Resource> order;
+    for (Resource r = 0; r < m_Resources.size(); ++r)
+    {
+        if (!m_Resources[r].imported && firstUse[r] >= 0)
+        {
+            order.push_back(r);
+        }
+    }
+    std::stable_sort(order.begin(), order.end(), [&firstUse](Resource a, Resource b) {
+        return firstUse[a] < firstUse[b];
+    });
+
+    aliased.assign(m_Resources.size(), InvalidResource);
+    for (Resource r : order)
+    {
+        const uint64_t size = backend.Size(m_Resources[r].desc);
+
+        // prefer the smallest free slot that fits, else grow the biggest free one
+        int best = -1;
+        for (int s = 0; s < (int)slots.size(); ++s)
+        {
+            if (slots[s].lastUse >= firstUse[r])
+            {
+                continue;
+            }
+            if (best < 0)
+            {
+                best = s;
+                continue;
+            }
+
+            const bool fits = slots[s].size >= size;
+            const bool bestFits = slots[best].size >= size;
+            if ((fits && (!bestFits || slots[s].size < slots[best].size)) || (!fits && !bestFits && slots[s].size > slots[best].size))
+            {
+                best = s;
+            }
+        }
+
+        if (best < 0)
+        {
+            slots.push_back({size, lastUse[r], r});
+            m_Resources[r].memorySlot = static_cast<int>(slots.size() - 1);
+            continue;
+        }
+
+        aliased[r] = slots[best].occupant;
+        slots[best].size = std::max(slots[best].size, size);
+        slots[best].lastUse = lastUse[r];
+        slots[best].occupant = r;
+        m_Resources[r].memorySlot = best;
+    }
+
+    m_MemorySlots.clear();
+    for (const auto& slot : slots)
+    {
+        m_MemorySlots.push_back(slot.size);
+    }
+}
+
+bool RenderGraph::Graph::Compile(const Backend& backend)
+{
+    m_PhysicalPasses.clear();
+    m_FinalBarriers.clear();
+    m_MemorySlots.clear();
+
+    for (auto& resource : m_Resources)
+    {
+        resource.usage = 0;
+        resource.transient = false;
+        resource.memorySlot = -1;
+    }
+
+    //validate
+    std::vector<bool> written(m_Resources.size(), false);
+    for (const auto& pass : m_Passes)
+    {
+        bool hasAttachment = false;
+        for (const auto& access : pass.accesses)
+        {
+            if (access.resource >= m_Resources.size())
+            {
+                return false;
+            }
+            if (!access.write && !written[access.resource] && !m_Resources[access.resource].imported)
+            {
+                return false;
+            }
+            hasAttachment = hasAttachment || IsAttachment(access.usage);
+        }
+        if (!hasAttachment)
+        {
+            return false;
+        }
+        for (const auto& access : pass.accesses)
+        {
+            written[access.resource] = written[access.resource] || access.write;
+        }
+    }
+
+    Cull();
+
+    //group passes into render passes
+    for (unsigned p = 0; p < m_Passes.size(); ++p)
+    {
+        const Pass& pass = m_Passes[p];
+        if (pass.culled)
+        {
+            continue;
+        }
+
+        if (m_PhysicalPasses.empty() || !CanMerge(m_PhysicalPasses.back(), pass, backend))
+        {
+            PhysicalPass physical;
+            physical.width = 0;
+            physical.height = 0;
+            for (const auto& access : pass.accesses)
+            {
+                if (IsAttachment(access.usage))
+                {
+                    physical.width = m_Resources[access.resource].desc.width;
+                    physical.height = m_Resources[access.resource].desc.height;
+                    break;
+                }
+            }
+            m_PhysicalPasses.push_back(physical);
+        }
+
+        PhysicalPass& physical = m_PhysicalPasses.back();
+        Subpass subpass = {};
+        subpass.pass = p;
+        subpass.hasDepth = false;
+        for (const auto& access : pass.accesses)
+        {
+            m_Resources[access.resource].usage |= 1u << static_cast<unsigned>(access.usage);
+            if (!IsAttachment(access.usage))
+            {
+                continue;
+            }
+
+            AttachmentReference reference = {FindAttachment(physical, access.resource), GetUseInfo(access.usage, access.write).layout};
+            switch (access.usage)
+            {
+                case Usage::ColorAttachment:
+                    subpass.colors.push_back(reference);
+                    break;
+                case Usage::DepthAttachment:
+                    subpass.hasDepth = true;
+                    subpass.depth = reference;
+                    break;
+                case Usage::InputAttachment:
+                    subpass.inputs.push_back(reference);
+                    break;
+                default:
+                    break;
+            }
+        }
+        physical.subpasses.push_back(subpass);
+    }
+
+    //lifetimes, in render pass indices
+    std::vector<int> firstUse(m_Resources.size(), -1);
+    std::vector<int> lastUse(m_Resources.size(), -1);
+    for (int i = 0; i < (int)m_PhysicalPasses.size(); ++i)
+    {
+        for (const auto& subpass : m_PhysicalPasses[i].subpasses)
+        {
+            for (const auto& access : m_Passes[subpass.pass].accesses)
+            {
+                if (firstUse[access.resource] < 0)
+                {
+                    firstUse[access.resource] = i;
+                }
+                lastUse[access.resource] = i;
+            }
+        }
+    }
+
+    for (Resource r = 0; r < m_Resources.size(); ++r)
+    {
+        ResourceInfo& info = m_Resources[r];
+        info.transient = !info.imported && firstUse[r] >= 0 && firstUse[r] == lastUse[r] && !(info.usage & UsageSampled);
+    }
+
+    std::vector<Resource> aliased;
+    AssignMemory(backend, firstUse, lastUse, aliased);
+
+    //barriers, layouts and load/store ops
+    std::vector<ResourceState> states(m_Resources.size());
+    for (Resource r = 0; r < m_Resources.size(); ++r)
+    {
+        // imported images come from the presentation engine, which we wait for at color output
+        states[r] = {m_Resources[r].initialLayout, m_Resources[r].imported ? (unsigned)StageColorOutput : (unsigned)StageTop, AccessNone, false, false};
+    }
+
+    for (int i = 0; i < (int)m_PhysicalPasses.size(); ++i)
+    {
+        PhysicalPass& physical = m_PhysicalPasses[i];
+
+        // where each attachment was last touched inside this render pass
+        std::vector<int> lastSubpass(physical.attachments.size(), -1);
+        std::vector<UseInfo> lastInfo(physical.attachments.size());
+        std::vector<bool> barrierDone(m_Resources.size(), false);
+
+        for (unsigned s = 0; s < physical.subpasses.size(); ++s)
+        {
+            for (const auto& access : m_Passes[physical.subpasses[s].pass].accesses)
+            {
+                const Resource r = access.resource;
+                const UseInfo use = GetUseInfo(access.usage, access.write);
+
+                if (!barrierDone[r])
+                {
+                    barrierDone[r] = true;
+                    ResourceState& state = states[r];
+                    const bool firstTime = firstUse[r] == i && !m_Resources[r].imported;
+
+                    Barrier barrier = {r, state.layout, use.layout, state.stage, state.written ? state.access : (unsigned)AccessNone, use.stage, use.access, InvalidResource};
+                    if (firstTime && aliased[r] != InvalidResource)
+                    {
+                        const ResourceState& previous = states[aliased[r]];
+                        barrier.aliased = aliased[r];
+                        barrier.srcStage = previous.stage;
+                        barrier.srcAccess = previous.written ? previous.access : (unsigned)AccessNone;
+                    }
+                    if (firstTime)
+                    {
+                        barrier.oldLayout = Layout::Undefined;
+                    }
+
+                    const bool hazard = state.written || (use.write && state.accessed) || barrier.aliased != InvalidResource;
+                    if (barrier.oldLayout != barrier.newLayout || hazard)
+                    {
+                        physical.barriers.push_back(barrier);
+                    }
+
+                    if (IsAttachment(access.usage))
+                    {
+                        Attachment& attachment = physical.attachments[FindAttachment(physical, r)];
+                        attachment.initialLayout = use.layout;
+                        if (access.write && access.clear)
+                        {
+                            attachment.load = LoadOp::Clear;
+                            attachment.clear = access.clearValue;
+                        }
+                        else if (access.write && barrier.oldLayout == Layout::Undefined)
+                        {
+                            attachment.load = LoadOp::DontCare;
+                        }
+                        else
+                        {
+                            attachment.load = LoadOp::Load;
+                        }
+                    }
+                }
+
+                if (!IsAttachment(access.usage))
+                {
+                    states[r] = {use.layout, use.stage, use.access, false, true};
+                    continue;
+                }
+
+                const unsigned a = FindAttachment(physical, r);
+                if (lastSubpass[a] >= 0 && lastSubpass[a] != (int)s && (lastInfo[a].write || use.write))
+                {
+                    SubpassDependency dependency = {(unsigned)lastSubpass[a], s, lastInfo[a].stage, lastInfo[a].write ? lastInfo[a].access : (unsigned)AccessNone, use.stage, use.access};
+                    physical.dependencies.push_back(dependency);
+                }
+                lastSubpass[a] = s;
+                lastInfo[a] = use;
+                states[r] = {use.layout, use.stage, use.access, use.write, true};
+            }
+        }
+
+        for (auto& attachment : physical.attachments)
+        {
+            const Resource r = attachment.resource;
+            attachment.finalLayout = states[r].layout;
+            attachment.store = (m_Resources[r].imported || lastUse[r] > i) ? StoreOp::Store : StoreOp::DontCare;
+        }
+    }
+
+    for (Resource r = 0; r < m_Resources.size(); ++r)
+    {
+        const ResourceInfo& info = m_Resources[r];
+        const ResourceState& state = states[r];
+        if (info.imported && info.finalLayout != Layout::Undefined && info.finalLayout != state.layout)
+        {
+            Barrier barrier = {r, state.layout, info.finalLayout, state.stage, state.written ? state.access : (unsigned)AccessNone, StageBottom, AccessNone, InvalidResource};
+            m_FinalBarriers.push_back(barrier);
+        }
+    }
+
+    return true;
+}
+
+void RenderGraph::Graph::Execute(Backend& backend) const
+{
+    for (unsigned i = 0; i < m_PhysicalPasses.size(); ++i)
+    {
+        const PhysicalPass& physical = m_PhysicalPasses[i];
+        if (!physical.barriers.empty())
+        {
+            backend.Barriers(physical.barriers);
+        }
+
+        backend.BeginPass(physical, i);
+        for (unsigned s = 0; s < physical.subpasses.size(); ++s)
+        {
+            if (s > 0)
+            {
+                backend.NextSubpass();
+            }
+
+            const Pass& pass = m_Passes[physical.subpasses[s].pass];
+            if (pass.execute)
+            {
+                pass.execute();
+            }
+        }
+        backend.EndPass();
+    }
+
+    if (!m_FinalBarriers.empty())
+    {
+        backend.Barriers(m_FinalBarriers);
+    }
+}
+
+const RenderGraph::ResourceInfo& RenderGraph::Graph::GetResource(Resource resource) const
+{
+    return m_Resources[resource];
+}
+
+unsigned RenderGraph::Graph::ResourceCount() const
+{
+    return static_cast<unsigned>(m_Resources.size());
+}
+
+const std::vector<RenderGraph::PhysicalPass>& RenderGraph::Graph::PhysicalPasses() const
+{
+    return m_PhysicalPasses;
+}
+
+const std::vector<RenderGraph::Barrier>& RenderGraph::Graph::FinalBarriers() const
+{
+    return m_FinalBarriers;
+}
+
+const std::vector<uint64_t>& RenderGraph::Graph::MemorySlots() const
+{
+    return m_MemorySlots;
+}
+
+bool RenderGraph::Graph::IsCulled(unsigned pass) const
+{
+    return m_Passes[pass].culled;
+}
+
+RenderGraph::RecordingBackend::RecordingBackend(bool tiler, uint32_t bytesPerPixel)
+    : m_Tiler(tiler)
+    , m_BytesPerPixel(bytesPerPixel)
+{
+}
+
+bool RenderGraph::RecordingBackend::IsTiler() const
+{
+    return m_Tiler;
+}
+
+uint64_t RenderGraph::RecordingBackend::Size(const TextureDesc& desc) const
+{
+    return static_cast<uint64_t>(desc.width) * desc.height * m_BytesPerPixel;
+}
+
+void RenderGraph::RecordingBackend::Barriers(const std::vector<Barrier>& barriers)
+{
+    m_Events.push_back(Event::Barriers);
+    m_Barriers.insert(m_Barriers.end(), barriers.begin(), barriers.end());
+}
+
+void RenderGraph::RecordingBackend::BeginPass(const PhysicalPass& pass, unsigned index)
+{
+    m_Events.push_back(Event::BeginPass);
+    RecordedPass recorded = {index, pass.width, pass.height, pass.attachments, static_cast<unsigned>(pass.subpasses.size())};
+    m_Passes.push_back(recorded);
+}
+
+void RenderGraph::RecordingBackend::NextSubpass()
+{
+    m_Events.push_back(Event::NextSubpass);
+}
+
+void RenderGraph::RecordingBackend::EndPass()
+{
+    m_Events.push_back(Event::EndPass);
+}
+
+const std::vector<RenderGraph::RecordingBackend::Event>& RenderGraph::RecordingBackend::Events() const
+{
+    return m_Events;
+}
+
+const std::vector<RenderGraph::Barrier>& RenderGraph::RecordingBackend::RecordedBarriers() const
+{
+    return m_Barriers;
+}
+
+const std::vector<RenderGraph::RecordingBackend::RecordedPass>& RenderGraph::RecordingBackend::RecordedPasses() const
+{
+    return m_Passes;
+}
+
+void RenderGraph::RecordingBackend::Clear()
+{
+    m_Events.clear();
+    m_Barriers.clear();
+    m_Passes.clear();
+}
@@ -0,0 +1,283 @@
+/* Frame render graph
+ *
+ * Passes declare which textures they read and write. Compiling the graph
+ * culls passes nobody consumes, works out layout transitions and barriers,
+ * gives transient textures with disjoint lifetimes the same memory and, on
+ * tiled GPUs, merges consecutive compatible passes into subpasses of a single
+ * render pass so their attachments never leave tile memory.
+ *
+ * The graph itself knows nothing about Vulkan; a Backend turns the compiled
+ * result into API calls. RecordingBackend just keeps what it was asked to do.
+ */
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+
+namespace RenderGraph
+{
+	typedef unsigned Resource;
+	const Resource InvalidResource = 0xFFFFFFFF;
+
+	enum class Layout : unsigned
+	{
+		Undefined = 0,
+		ColorAttachment,
+		DepthStencilAttachment,
+		ShaderReadOnly,
+		Present,
+	};
+
+	enum class Usage : unsigned
+	{
+		ColorAttachment = 0,
+		DepthAttachment,
+		Sampled,
+		InputAttachment,
+	};
+
+	enum UsageFlag : unsigned
+	{
+		UsageColorAttachment = 1 << static_cast<unsigned>(Usage::ColorAttachment),
+		UsageDepthAttachment = 1 << static_cast<unsigned>(Usage::DepthAttachment),
+		UsageSampled = 1 << static_cast<unsigned>(Usage::Sampled),
+		UsageInputAttachment = 1 << static_cast<unsigned>(Usage::InputAttachment),
+	};
+
+	enum Stage : unsigned
+	{
+		StageNone = 0,
+		StageTop = 1,
+		StageFragmentShader = 2,
+		StageEarlyFragmentTests = 4,
+		StageLateFragmentTests = 8,
+		StageColorOutput = 16,
+		StageBottom = 32,
+	};
+
+	enum Access : unsigned
+	{
+		AccessNone = 0,
+		AccessShaderRead = 1,
+		AccessInputAttachmentRead = 2,
+		AccessColorRead = 4,
+		AccessColorWrite = 8,
+		AccessDepthRead = 16,
+		AccessDepthWrite = 32,
+	};
+
+	enum class LoadOp : unsigned
+	{
+		Load,
+		Clear,
+		DontCare,
+	};
+
+	enum class StoreOp : unsigned
+	{
+		Store,
+		DontCare,
+	};
+
+	struct TextureDesc
+	{
+		uint32_t width;
+		uint32_t height;
+		uint32_t format; // backend defined
+		bool depth;
+	};
+
+	struct ClearValue
+	{
+		float color[4];
+		float depth;
+		uint32_t stencil;
+	};
+
+	struct Barrier
+	{
+		Resource resource;
+		Layout oldLayout;
+		Layout newLayout;
+		unsigned srcStage;
+		unsigned srcAccess;
+		unsigned dstStage;
+		unsigned dstAccess;
+		// the resource that used the same memory before, or InvalidResource
+		Resource aliased;
+	};
+
+	struct Attachment
+	{
+		Resource resource;
+		LoadOp load;
+		StoreOp store;
+		Layout initialLayout;
+		Layout finalLayout;
+		ClearValue clear;
+	};
+
+	struct AttachmentReference
+	{
+		unsigned attachment; // index into PhysicalPass::attachments
+		Layout layout;
+	};
+
+	struct Subpass
+	{
+		unsigned pass; // the logical pass this subpass executes
+		std::vector<AttachmentReference> colors;
+		std::vector<AttachmentReference> inputs;
+		bool hasDepth;
+		AttachmentReference depth;
+	};
+
+	struct SubpassDependency
+	{
+		unsigned srcSubpass;
+		unsigned dstSubpass;
+		unsigned srcStage;
+		unsigned srcAccess;
+		unsigned dstStage;
+		unsigned dstAccess;
+	};
+
+	// one render pass worth of work, with one subpass per merged logical pass
+	struct PhysicalPass
+	{
+		uint32_t width;
+		uint32_t height;
+		std::vector<Barrier> barriers; // issued before the render pass begins
+		std::vector<Attachment> attachments;
+		std::vector<Subpass> subpasses;
+		std::vector<SubpassDependency> dependencies;
+	};
+
+	struct ResourceInfo
+	{
+		std::string name;
+		TextureDesc desc;
+		bool imported;
+		Layout initialLayout;
+		Layout finalLayout;
+
+		// filled in by Graph::Compile
+		unsigned usage;     // UsageFlag bits
+		bool transient;     // never leaves the render pass it lives in
+		int memorySlot;     // -1 for imported or unused resources
+	};
+
+	class Backend
+	{
+	public:
+		virtual ~Backend() {}
+
+		virtual bool IsTiler() const = 0;
+		virtual uint64_t Size(const TextureDesc& desc) const = 0;
+
+		virtual void Barriers(const std::vector<Barrier>& barriers) = 0;
+		virtual void BeginPass(const PhysicalPass& pass, unsigned index) = 0;
+		virtual void NextSubpass() = 0;
+		virtual void EndPass() = 0;
+	};
+
+	class Graph
+	{
+	public:
+		typedef std::function<void()> ExecuteCallback;
+
+		Resource CreateTexture(const std::string& name, const TextureDesc& desc);
+		// a texture owned outside the graph, e.g. the swapchain image
+		Resource Import(const std::string& name, const TextureDesc& desc, Layout initialLayout, Layout finalLayout);
+
+		unsigned AddPass(const std::string& name, const ExecuteCallback& execute);
+		void Read(unsigned pass, Resource resource, Usage usage);
+		void Write(unsigned pass, Resource resource, Usage usage);
+		void Write(unsigned pass, Resource resource, Usage usage, const ClearValue& clear);
+
+		bool Compile(const Backend& backend);
+		void Execute(Backend& backend) const;
+		void Reset();
+
+		const ResourceInfo& GetResource(Resource resource) const;
+		unsigned ResourceCount() const;
+		const std::vector<PhysicalPass>& PhysicalPasses() const;
+		const std::vector<Barrier>& FinalBarriers() const;
+		const std::vector<uint64_t>& MemorySlots() const;
+		bool IsCulled(unsigned pass) const;
+
+	private:
+		struct PassAccess
+		{
+			Resource resource;
+			Usage usage;
+			bool write;
+			bool clear;
+			ClearValue clearValue;
+		};
+
+		struct Pass
+		{
+			std::string name;
+			ExecuteCallback execute;
+			std::vector<PassAccess> accesses;
+			bool culled;
+		};
+
+		void Cull();
+		bool CanMerge(const PhysicalPass& physical, const Pass& pass, const Backend& backend) const;
+		void AssignMemory(const Backend& backend, const std::vector<int>& firstUse, const std::vector<int>& lastUse, std::vector<Resource>& aliased);
+
+		std::vector<ResourceInfo> m_Resources;
+		std::vector<Pass> m_Passes;
+		std::vector<PhysicalPass> m_PhysicalPasses;
+		std::vector<Barrier> m_FinalBarriers;
+		std::vector<uint64_t> m_MemorySlots;
+	};
+
+	// Records everything instead of talking to a GPU, for checking compiled graphs
+	class RecordingBackend : public Backend
+	{
+	public:
+		enum class Event : unsigned
+		{
+			Barriers,
+			BeginPass,
+			NextSubpass,
+			EndPass,
+		};
+
+		// what a render pass was begun with
+		struct RecordedPass
+		{
+			unsigned index;
+			uint32_t width;
+			uint32_t height;
+			std::vector<Attachment> attachments; // with their load and store ops
+			unsigned subpasses;
+		};
+
+		explicit RecordingBackend(bool tiler, uint32_t bytesPerPixel = 4);
+
+		virtual bool IsTiler() const;
+		virtual uint64_t Size(const TextureDesc& desc) const;
+
+		virtual void Barriers(const std::vector<Barrier>& barriers);
+		virtual void BeginPass(const PhysicalPass& pass, unsigned index);
+		virtual void NextSubpass();
+		virtual void EndPass();
+
+		const std::vector<Event>& Events() const;
+		const std::vector<Barrier>& RecordedBarriers() const;
+		const std::vector<RecordedPass>& RecordedPasses() const;
+		void Clear();
+
+	private:
+		bool m_Tiler;
+		uint32_t m_BytesPerPixel;
+		std::vector<Event> m_Events;
+		std::vector<Barrier> m_Barriers;
+		std::vector<RecordedPass> m_Passes;
+	};
+}
@@ -0,0 +1,259 @@
+#include "residency.h"
+#include "profiler/profiler.h"
+#include <algorithm>
+#include <cstdio>
+
+Residency::Manager::Manager(Backend& backend, const Settings& settings)
+    : m_Backend(backend)
+    , m_Settings(settings)
+    , m_Frame(1)
+    , m_InFrame(false)
+{
+    m_Stats = {0, 0, 0, 0, 0, 0};
+}
+
+Residency::TextureId Residency::Manager::Register(const std::vector<uint64_t>& levelSizes)
+{
+    if (levelSizes.empty())
+    {
+        return InvalidTexture;
+    }
+
+    TextureId texture;
+    if (!m_FreeIds.empty())
+    {
+        texture = m_FreeIds.back();
+        m_FreeIds.pop_back();
+    }
+    else
+    {
+        texture = TextureId(m_Entries.size());
+        m_Entries.push_back(Entry());
+    }
+
+    Entry& entry = m_Entries[texture];
+    entry.levelSizes = levelSizes;
+    entry.residentLevel = uint32_t(levelSizes.size());
+    entry.residentBytes = 0;
+    entry.lastUsedFrame = 0;
+    entry.registered = true;
+    return texture;
+}
+
+void Residency::Manager::Unregister(TextureId texture)
+{
+    if (texture >= m_Entries.size() || !m_Entries[texture].registered)
+    {
+        return;
+    }
+
+    Evict(texture);
+    m_Entries[texture].registered = false;
+    m_FreeIds.push_back(texture);
+}
+
+void Residency::Manager::SetBudget(uint64_t bytes)
+{
+    m_Settings.budgetBytes = bytes;
+    MakeRoom(0, InvalidTexture);
+}
+
+void Residency::Manager::BeginFrame()
+{
+    m_Frame++;
+    m_InFrame = true;
+    m_UsedThisFrame.clear();
+    m_Stats.evictions = 0;
+    m_Stats.stalls = 0;
+    m_Stats.upgrades = 0;
+    m_Stats.uploadedBytes = 0;
+}
+
+bool Residency::Manager::Use(TextureId texture)
+{
+    if (texture >= m_Entries.size() || !m_Entries[texture].registered)
+    {
+        return false;
+    }
+
+    Entry& entry = m_Entries[texture];
+    if (entry.lastUsedFrame != m_Frame)
+    {
+        entry.lastUsedFrame = m_Frame;
+        m_UsedThisFrame.push_back(texture);
+    }
+
+    if (entry.residentLevel < entry.levelSizes.size())
+    {
+        return true;
+    }
+
+    m_Stats.stalls++;
+    return SetResidentLevel(texture, TailLevel(entry));
+}
+
+void Residency::Manager::EndFrame()
+{
+    // the blurriest ones first
+    std::sort(m_UsedThisFrame.begin(), m_UsedThisFrame.end(), [this](TextureId a, TextureId b) {
+        const uint32_t missingA = m_Entries[a].residentLevel;
+        const uint32_t missingB = m_Entries[b].residentLevel;
+        return missingA != missingB ? missingA > missingB : a < b;
+    });
+
+    for (TextureId texture : m_UsedThisFrame)
+    {
+        const Entry& entry = m_Entries[texture];
+        if (!entry.registered || entry.residentLevel == 0 || entry.residentLevel >= entry.levelSizes.size())
+        {
+            continue;
+        }
+
+        // the whole chain is uploaded again; one over the limit by itself goes in a frame of its own
+        const uint64_t upload = BytesFrom(entry, entry.residentLevel - 1);
+        if (m_Stats.uploadedBytes > 0 && m_Stats.uploadedBytes + upload > m_Settings.uploadBytesPerFrame)
+        {
+            continue;
+        }
+        if (SetResidentLevel(texture, entry.residentLevel - 1))
+        {
+            m_Stats.upgrades++;
+        }
+    }
+
+    PROFILE_COUNTER("Residency resident bytes", double(m_Stats.residentBytes));
+    PROFILE_COUNTER("Residency evictions", double(m_Stats.evictions));
+    PROFILE_COUNTER("Residency stalls", double(m_Stats.stalls));
+    PROFILE_COUNTER("Residency uploaded bytes", double(m_Stats.uploadedBytes));
+
+    m_InFrame = false;
+}
+
+uint32_t Residency::Manager::ResidentLevel(TextureId texture) const
+{
+    if (texture >= m_Entries.size())
+    {
+        return 0;
+    }
+    return m_Entries[texture].residentLevel;
+}
+
+const Residency::Stats& Residency::Manager::GetStats() const
+{
+    return m_Stats;
+}
+
+uint64_t Residency::Manager::BytesFrom(const Entry& entry, uint32_t level) const
+{
+    uint64_t bytes = 0;
+    for (uint32_t i = level; i < entry.levelSizes.size(); ++i)
+    {
+        bytes += entry.levelSizes[i];
+    }
+    return bytes;
+}
+
+// the smallest levels up to tailBytes, and at least the last one
+uint32_t Residency::Manager::TailLevel(const Entry& entry) const
+{
+    uint32_t level = uint32_t(entry.levelSizes.size()) - 1;
+    uint64_t bytes = entry.levelSizes[level];
+    while (level > 0 && bytes + entry.levelSizes[level - 1] <= m_Settings.tailBytes)
+    {
+        level--;
+        bytes += entry.levelSizes[level];
+    }
+    return level;
+}
+
+// evicts the least recently used textures until bytes more fit; inside a frame
+// (and while EndFrame streams) the ones drawn in it stay
+bool Residency::Manager::MakeRoom(uint64_t bytes, TextureId keep)
+{
+    while (m_Stats.residentBytes + bytes > m_Settings.budgetBytes)
+    {
+        TextureId victim = InvalidTexture;
+        uint64_t oldest = m_InFrame ? m_Frame : m_Frame + 1;
+        for (TextureId texture = 0; texture < m_Entries.size(); ++texture)
+        {
+            const Entry& entry = m_Entries[texture];
+            if (texture != keep && entry.residentBytes > 0 && entry.lastUsedFrame < oldest)
+            {
+                oldest = entry.lastUsedFrame;
+                victim = texture;
+            }
+        }
+
+        if (victim == InvalidTexture)
+        {
+            return false;
+        }
+        Evict(victim);
+        m_Stats.evictions++;
+    }
+    return true;
+}
+
+bool Residency::Manager::SetResidentLevel(TextureId texture, uint32_t level)
+{
+    Entry& entry = m_Entries[texture];
+    const uint64_t bytes = BytesFrom(entry, level);
+    const uint64_t extra = bytes > entry.residentBytes ? bytes - entry.residentBytes : 0;
+    if (!MakeRoom(extra, texture))
+    {
+        return false;
+    }
+    if (!m_Backend.MakeResident(texture, level))
+    {
+        return false;
+    }
+
+    m_Stats.residentBytes = m_Stats.residentBytes - entry.residentBytes + bytes;
+    if (entry.residentBytes == 0)
+    {
+        m_Stats.residentTextures++;
+    }
+    // GLES2 re-specifies the whole chain, so everything counts as uploaded
+    m_Stats.uploadedBytes += bytes;
+    entry.residentLevel = level;
+    entry.residentBytes = bytes;
+    return true;
+}
+
+void Residency::Manager::Evict(TextureId texture)
+{
+    Entry& entry = m_Entries[texture];
+    if (entry.residentBytes == 0)
+    {
+        return;
+    }
+
+    m_Backend.Evict(texture);
+    m_Stats.residentBytes -= entry.residentBytes;
+    m_Stats.residentTextures--;
+    entry.residentBytes = 0;
+    entry.residentLevel = uint32_t(entry.levelSizes.size());
+}
+
+Residency::FakeBackend::FakeBackend()
+    : failNext(false)
+{
+}
+
+bool Residency::FakeBackend::MakeResident(TextureId texture, uint32_t firstLevel)
+{
+    char call[64];
+    snprintf(call, sizeof(call), "resident %u from %u%s", texture, firstLevel, failNext ? " failed" : "");
+    calls.push_back(call);
+
+    const bool ok = !failNext;
+    failNext = false;
+    return ok;
+}
+
+void Residency::FakeBackend::Evict(TextureId texture)
+{
+    char call[64];
+    snprintf(call, sizeof(call), "evict %u", texture);
+    calls.push_back(call);
+}
@@ -0,0 +1,116 @@
+/* Texture residency
+ *
+ * Keeps the textures registered with it under a memory budget. A texture
+ * first becomes resident with only its smallest mips (up to tailBytes); each
+ * frame it is drawn with, EndFrame() streams in one more detailed level,
+ * within uploadBytesPerFrame; a chain bigger than that on its own is still
+ * streamed in a frame with nothing else uploaded. When the budget runs out,
+ * the least recently used textures not drawn this frame are evicted as a
+ * whole.
+ *
+ * Drawing a texture with nothing resident is a stall: its tail is made
+ * resident on the spot, before the draw.
+ *
+ * The manager only decides; a Backend does the uploads. FakeBackend records
+ * the calls, so the policy runs without a GPU.
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace Residency
+{
+	typedef uint32_t TextureId;
+	const TextureId InvalidTexture = 0xFFFFFFFF;
+
+	class Backend
+	{
+	public:
+		virtual ~Backend() {}
+		// levels firstLevel and smaller resident, anything more detailed dropped
+		virtual bool MakeResident(TextureId texture, uint32_t firstLevel) = 0;
+		virtual void Evict(TextureId texture) = 0;
+	};
+
+	struct Settings
+	{
+		uint64_t budgetBytes;
+		uint64_t uploadBytesPerFrame;
+		uint64_t tailBytes;
+	};
+
+	struct Stats
+	{
+		uint64_t residentBytes;
+		uint32_t residentTextures;
+		// over the last frame
+		uint32_t evictions;
+		uint32_t stalls;
+		uint32_t upgrades;
+		uint64_t uploadedBytes;
+	};
+
+	class Manager
+	{
+	public:
+		Manager(Backend& backend, const Settings& settings);
+
+		// level 0 is the most detailed one
+		TextureId Register(const std::vector<uint64_t>& levelSizes);
+		void Unregister(TextureId texture);
+
+		// evicts right away when lowered below what is resident
+		void SetBudget(uint64_t bytes);
+
+		void BeginFrame();
+		// before drawing with it; false if not even its tail fits
+		bool Use(TextureId texture);
+		// streams in the next level of what was drawn and reports to the profiler
+		void EndFrame();
+
+		// the level count when nothing is resident
+		uint32_t ResidentLevel(TextureId texture) const;
+		const Stats& GetStats() const;
+
+	private:
+		struct Entry
+		{
+			std::vector<uint64_t> levelSizes;
+			uint32_t residentLevel;
+			uint64_t residentBytes;
+			uint64_t lastUsedFrame;
+			bool registered;
+		};
+
+		uint64_t BytesFrom(const Entry& entry, uint32_t level) const;
+		uint32_t TailLevel(const Entry& entry) const;
+		bool MakeRoom(uint64_t bytes, TextureId keep);
+		bool SetResidentLevel(TextureId texture, uint32_t level);
+		void Evict(TextureId texture);
+
+		Backend& m_Backend;
+		Settings m_Settings;
+		std::vector<Entry> m_Entries;
+		std::vector<TextureId> m_FreeIds;
+		std::vector<TextureId> m_UsedThisFrame;
+		uint64_t m_Frame;
+		bool m_InFrame;
+		Stats m_Stats;
+	};
+
+	class FakeBackend : public Backend
+	{
+	public:
+		FakeBackend();
+
+		virtual bool MakeResident(TextureId texture, uint32_t firstLevel);
+		virtual void Evict(TextureId texture);
+
+		// e.g. "resident 3 from 2", "evict 3"
+		std::vector<std::string> calls;
+		// the next MakeResident fails, like a failed allocation
+		bool failNext;
+	};
+}
@@ -1,15 +1,35 @@
 #include "shader.h"
+#include "glstate.h"
+#include "programcache.h"
+#include "graphics.h"
 #include "utils/log.h"
 #include "utils/make_unique.h"
+#include <EGL/egl.h>
+#include <GLES2/gl2ext.h>
 #include <memory>
 
-Shader::Shader::Shader(const char* source, ShaderType type)
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+namespace {
+    typedef void (GL_APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+
+    bool g_ParallelCompile = false;
+
+    const char* const g_AttributeNames[] = {"aPos", "aTex", "aColor"};
+    const char* const g_UniformNames[] = {"uProjMatrix", "uTexture"};
+
+    static_assert(sizeof(g_AttributeNames) / sizeof(g_AttributeNames[0]) == (unsigned)Shader::Attribute::Count, "attribute names out of sync");
+    static_assert(sizeof(g_UniformNames) / sizeof(g_UniformNames[0]) == (unsigned)Shader::Uniform::Count, "uniform names out of sync");
+}
+
+Shader::Shader::Shader(const char* source, ShaderType type, bool wait)
     : m_ShaderSource(source)
     , m_IsOk(false)
+    , m_Pending(false)
     , m_ShaderObject(0xFFFFFFFF)
 {
-    GLint compiled;
-
     // Create the shader object
     m_ShaderObject = glCreateShader((GLenum)type);
 
@@ -24,7 +44,24 @@ Shader::Shader::Shader(const char* source, ShaderType type)
 
     // Compile the shader
     glCompileShader(m_ShaderObject);
+    m_Pending = true;
+
+    if (wait)
+    {
+        Finish();
+    }
+}
+
+bool Shader::Shader::Finish()
+{
+    if (!m_Pending)
+    {
+        return m_IsOk;
+    }
+    m_Pending = false;
+
     // Check the compile status
+    GLint compiled;
     glGetShaderiv(m_ShaderObject, GL_COMPILE_STATUS, &compiled);
 
     if (!compiled)
@@ -41,10 +78,30 @@ Shader::Shader::Shader(const char* source, ShaderType type)
         }
         glDeleteShader(m_ShaderObject);
         m_ShaderObject = 0xFFFFFFFF;
-        return;
+        return false;
     }
 
     m_IsOk = true;
+    return true;
+}
+
+bool Shader::EnableParallelCompile()
+{
+    g_ParallelCompile = false;
+    if (!Graphics::HasExtension("GL_KHR_parallel_shader_compile"))
+    {
+        return false;
+    }
+
+    MaxShaderCompilerThreadsProc maxShaderCompilerThreads = (MaxShaderCompilerThreadsProc)eglGetProcAddress("glMaxShaderCompilerThreadsKHR");
+    if (maxShaderCompilerThreads)
+    {
+        // let the driver pick
+        maxShaderCompilerThreads(0xFFFFFFFF);
+    }
+
+    g_ParallelCompile = true;
+    return true;
 }
 
 Shader::Shader::~Shader()
@@ -52,6 +109,11 @@ Shader::Shader::~Shader()
     m_IsOk = false;
 }
 
+bool Shader::Shader::Failed()
+{
+    return m_ShaderObject == 0 || (!m_Pending && !m_IsOk);
+}
+
 GLuint Shader::Shader::GetObject()
 {
     return m_ShaderObject;
@@ -62,45 +124,119 @@ bool Shader::Shader::Ok()
     return m_IsOk;
 }
 
-Shader::Program::Program(const char* vertexShaderSource, const char* fragmentShaderSource)
-    : Program(
-        std::make_shared<Shader>(vertexShaderSource, ShaderType::Vertex),
-        std::make_shared<Shader>(fragmentShaderSource, ShaderType::Fragment)
-    )
+Shader::Program::Program(const char* vertexShaderSource, const char* fragmentShaderSource, bool wait)
+    : m_ProgramObject(0)
+    , m_CacheKey(0)
+    , m_LoadedFromCache(false)
+    , m_StoreInCache(false)
+    , m_Pending(false)
+    , m_IsOk(false)
 {
+    ClearLocations();
+
+    // Try the binary cache before compiling anything
+    m_CacheKey = ProgramCache::Key(vertexShaderSource, fragmentShaderSource);
+    m_ProgramObject = glCreateProgram();
+    if (m_ProgramObject == 0)
+    {
+        return;
+    }
+
+    if (ProgramCache::Load(m_CacheKey, m_ProgramObject))
+    {
+        ResolveLocations();
+        m_LoadedFromCache = true;
+        m_IsOk = true;
+        return;
+    }
+
+    m_StoreInCache = true;
+    m_VertexShader = std::make_shared<Shader>(vertexShaderSource, ShaderType::Vertex, false);
+    m_FragmentShader = std::make_shared<Shader>(fragmentShaderSource, ShaderType::Fragment, false);
+    Link();
+
+    if (wait)
+    {
+        Finish();
+    }
 }
 
 Shader::Program::Program(std::shared_ptr<Shader> vertexShader, std::shared_ptr<Shader> fragmentShader)
     : m_VertexShader(vertexShader)
     , m_FragmentShader(fragmentShader)
+    , m_ProgramObject(0)
+    , m_CacheKey(0)
+    , m_LoadedFromCache(false)
+    , m_StoreInCache(false)
+    , m_Pending(false)
     , m_IsOk(false)
 {
-    if (!m_VertexShader || !m_VertexShader->Ok())
+    ClearLocations();
+
+    // Create the program object
+    m_ProgramObject = glCreateProgram();
+    if (m_ProgramObject == 0)
     {
-        LOGE("Error: Unable to create program: VertexShader not OK!");
         return;
     }
-    if (!m_FragmentShader || !m_FragmentShader->Ok())
+
+    Link();
+    Finish();
+}
+
+void Shader::Program::ClearLocations()
+{
+    for (auto& location : m_AttributeLocations)
+        location = -1;
+    for (auto& location : m_UniformLocations)
+        location = -1;
+}
+
+// only issues the link, Finish() collects the result
+void Shader::Program::Link()
+{
+    if (!m_VertexShader || m_VertexShader->Failed())
     {
-        LOGE("Error: Unable to create program: FragmentShader not OK!");
+        LOGE("Error: Unable to create program: VertexShader not OK!");
         return;
     }
-
-    // Create the program object
-    m_ProgramObject = glCreateProgram();
-    if (m_ProgramObject == 0)
+    if (!m_FragmentShader || m_FragmentShader->Failed())
     {
+        LOGE("Error: Unable to create program: FragmentShader not OK!");
         return;
     }
 
     glAttachShader(m_ProgramObject, m_VertexShader->GetObject());
     glAttachShader(m_ProgramObject, m_FragmentShader->GetObject());
 
-    // Bind vPosition to attribute 0
-    //glBindAttribLocation(programObject, 0, "vPosition");
+    // Bind the known attributes to their fixed slots
+    for (GLuint i = 0; i < (GLuint)Attribute::Count; ++i)
+    {
+        glBindAttribLocation(m_ProgramObject, i, g_AttributeNames[i]);
+    }
 
     // Link the program
     glLinkProgram(m_ProgramObject);
+    m_Pending = true;
+}
+
+bool Shader::Program::Finish()
+{
+    if (!m_Pending)
+    {
+        return m_IsOk;
+    }
+    m_Pending = false;
+
+    // the compile logs are more useful than the link error they cause
+    const bool vertexOk = m_VertexShader->Finish();
+    const bool fragmentOk = m_FragmentShader->Finish();
+    if (!vertexOk || !fragmentOk)
+    {
+        LOGE("Error: Unable to link program: %s not OK!", vertexOk ? "FragmentShader" : "VertexShader");
+        glDeleteProgram(m_ProgramObject);
+        return false;
+    }
 
     // Check the link status
     GLint linked;
@@ -117,10 +253,53 @@ Shader::Program::Program(std::shared_ptr<Shader> vertexShader, std::shared_ptr<S
             LOGE("Error linking program:\n%s\n", infoLog.get());
         }
         glDeleteProgram(m_ProgramObject);
-        return;
+        return false;
     }
 
+    ResolveLocations();
     m_IsOk = true;
+
+    if (m_StoreInCache)
+    {
+        ProgramCache::Store(m_CacheKey, m_ProgramObject);
+    }
+    return true;
+}
+
+bool Shader::Program::IsReady()
+{
+    if (!m_Pending)
+    {
+        return true;
+    }
+
+    // without the extension this is where the render thread waits
+    if (g_ParallelCompile)
+    {
+        GLint completed = GL_FALSE;
+        glGetProgramiv(m_ProgramObject, GL_COMPLETION_STATUS_KHR, &completed);
+        if (!completed)
+        {
+            return false;
+        }
+    }
+
+    Finish();
+    return true;
+}
+
+void Shader::Program::ResolveLocations()
+{
+    // unused ones stay at -1
+    for (GLuint i = 0; i < (GLuint)Attribute::Count; ++i)
+    {
+        if (glGetAttribLocation(m_ProgramObject, g_AttributeNames[i]) >= 0)
+            m_AttributeLocations[i] = (GLint)i;
+    }
+    for (unsigned int i = 0; i < (unsigned int)Uniform::Count; ++i)
+    {
+        m_UniformLocations[i] = glGetUniformLocation(m_ProgramObject, g_UniformNames[i]);
+    }
 }
 
 Shader::Program::~Program()
@@ -139,6 +318,15 @@ Shader::Program::~Program()
 
 bool Shader::Program::Ok()
 {
+    if (m_Pending)
+    {
+        return false;
+    }
+    // programs from the binary cache never had shader objects
+    if (m_LoadedFromCache)
+    {
+        return m_IsOk;
+    }
     if (m_VertexShader && m_VertexShader->Ok() && m_FragmentShader && m_FragmentShader->Ok())
     {
         return m_IsOk;
@@ -155,7 +343,25 @@ GLuint Shader::Program::GetObject()
     return m_ProgramObject;
 }
 
-GLint Shader::Program::GetAttribute(std::string attributeName)
+GLint Shader::Program::GetAttribute(Attribute attribute)
+{
+    if (!m_IsOk)
+    {
+        return -1;
+    }
+    return m_AttributeLocations[(unsigned)attribute];
+}
+
+GLint Shader::Program::GetUniform(Uniform uniform)
+{
+    if (!m_IsOk)
+    {
+        return -1;
+    }
+    return m_UniformLocations[(unsigned)uniform];
+}
+
+GLint Shader::Program::GetAttribute(const std::string& attributeName)
 {
     if (!Ok())
     {
@@ -169,7 +375,7 @@ GLint Shader::Program::GetAttribute(std::string attributeName)
     return m_CachedAttributeLocations[attributeName];
 }
 
-GLint Shader::Program::GetUniform(std::string uniformName)
+GLint Shader::Program::GetUniform(const std::string& uniformName)
 {
     if (!Ok())
     {
@@ -189,5 +395,5 @@ void Shader::Program::Use()
     {
         return;
     }
-    glUseProgram(m_ProgramObject);
+    GlState::UseProgram(m_ProgramObject);
 }
@@ -4,6 +4,7 @@
 #include <string>
 #include <memory>
 #include <map>
+#include <cstdint>
 
 namespace Shader
 {
@@ -14,43 +15,87 @@ namespace Shader
 		Fragment = GL_FRAGMENT_SHADER,
 	};
 
+	// fixed attribute locations, bound before linking so every program agrees on them
+	enum class Attribute : GLuint
+	{
+		Position = 0, // aPos
+		TexCoord,     // aTex
+		Color,        // aColor
+
+		Count
+	};
+
+	// uniform locations, resolved once after linking
+	enum class Uniform : unsigned
+	{
+		ProjMatrix = 0, // uProjMatrix
+		Texture,        // uTexture
+
+		Count
+	};
+
 	class Program;
 
+	// with a current context: lets compiles and links finish on driver threads
+	// (GL_KHR_parallel_shader_compile), false if the driver can't
+	bool EnableParallelCompile();
+
 	class Shader
 	{
 	public:
 		friend class Program;
 
-		Shader(const char* source, ShaderType type);
+		// without wait the compile status is only checked by Finish()
+		Shader(const char* source, ShaderType type, bool wait = true);
 		~Shader();
 		bool Ok();
 
 	private:
 		GLuint GetObject();
+		bool Finish();
+		bool Failed();
 
 		std::string m_ShaderSource;
 		GLuint m_ShaderObject;
 		bool m_IsOk;
+		bool m_Pending;
 	};
 
 	class Program
 	{
 	public:
-		Program(const char* vertexShaderSource, const char* fragmentShaderSource);
+		// without wait, compile and link are only issued; IsReady() tells when they are done
+		Program(const char* vertexShaderSource, const char* fragmentShaderSource, bool wait = true);
 		Program(std::shared_ptr<Shader> vertexShader, std::shared_ptr<Shader> fragmentShader);
 		~Program();
 		bool Ok();
+		// never blocks with parallel compile, otherwise waits for the driver the first time
+		bool IsReady();
 		GLuint GetObject();
-		GLint GetAttribute(std::string attributeName);
-		GLint GetUniform(std::string uniformName);
+		// draw path: plain array lookups, -1 if the program doesn't use it
+		GLint GetAttribute(Attribute attribute);
+		GLint GetUniform(Uniform uniform);
+		// anything else, looked up by name and cached
+		GLint GetAttribute(const std::string& attributeName);
+		GLint GetUniform(const std::string& uniformName);
 		void Use();
 
 	private:
+		void ClearLocations();
+		void Link();
+		bool Finish();
+		void ResolveLocations();
 
 		std::shared_ptr<Shader> m_VertexShader;
 		std::shared_ptr<Shader> m_FragmentShader;
 		GLuint m_ProgramObject;
+		uint64_t m_CacheKey;
+		bool m_LoadedFromCache;
+		bool m_StoreInCache;
+		bool m_Pending;
 
+		GLint m_AttributeLocations[(unsigned)Attribute::Count];
+		GLint m_UniformLocations[(unsigned)Uniform::Count];
 		std::map<std::string, GLint> m_CachedAttributeLocations;
 		std::map<std::string, GLint> m_CachedUniformLocations;
 		bool m_IsOk;
@@ -0,0 +1,70 @@
+/* Renderer object slots
+ *
+ * The id tables every backend keeps its buffers, textures and pipelines in.
+ */
+#pragma once
+
+#include "renderer.h"
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace Renderer
+{
+	// ids for one kind of object; 0 is never handed out
+	template <typename T>
+	class Slots
+	{
+	public:
+		uint32_t Add(T&& object)
+		{
+			uint32_t index;
+			if (!m_Free.empty())
+			{
+				index = m_Free.back();
+				m_Free.pop_back();
+				m_Objects[index] = std::move(object);
+				m_Used[index] = true;
+			}
+			else
+			{
+				index = (uint32_t)m_Objects.size();
+				m_Objects.push_back(std::move(object));
+				m_Used.push_back(true);
+			}
+			return index + 1;
+		}
+
+		T* Get(uint32_t id)
+		{
+			return id != InvalidId && id <= m_Objects.size() && m_Used[id - 1] ? &m_Objects[id - 1] : nullptr;
+		}
+
+		void Remove(uint32_t id)
+		{
+			if (Get(id))
+			{
+				m_Objects[id - 1] = T();
+				m_Used[id - 1] = false;
+				m_Free.push_back(id - 1);
+			}
+		}
+
+		template <typename F>
+		void ForEach(F f)
+		{
+			for (size_t i = 0; i < m_Objects.size(); ++i)
+			{
+				if (m_Used[i])
+				{
+					f((uint32_t)i + 1, m_Objects[i]);
+				}
+			}
+		}
+
+	private:
+		std::vector<T> m_Objects;
+		std::vector<bool> m_Used;
+		std::vector<uint32_t> m_Free;
+	};
+}
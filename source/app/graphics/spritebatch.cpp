@@ -0,0 +1,239 @@
+#include "spritebatch.h"
+#include "utils/timing.h"
+#include <cmath>
+
+namespace {
+    const unsigned RadixBits = 8;
+    const unsigned RadixBuckets = 1 << RadixBits;
+
+    uint64_t sortKey(uint16_t layer, uint16_t pipeline, uint32_t texture)
+    {
+        return (uint64_t(layer) << 48) | (uint64_t(pipeline) << 32) | texture;
+    }
+
+    uint32_t keyPipeline(uint64_t key)
+    {
+        return uint32_t(key >> 32) & 0xFFFF;
+    }
+
+    uint32_t keyTexture(uint64_t key)
+    {
+        return uint32_t(key);
+    }
+
+    // xorshift, so the benchmark scene is the same on every run
+    uint32_t nextRandom(uint32_t& state)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+
+    float randomFloat(uint32_t& state, float low, float high)
+    {
+        return low + (high - low) * (nextRandom(state) & 0xFFFFFF) / float(0xFFFFFF);
+    }
+}
+
+void Sprites::Batcher::Reserve(size_t sprites)
+{
+    m_Keys.reserve(sprites);
+    m_SortedKeys.reserve(sprites);
+    m_Order.reserve(sprites);
+    m_Instances.reserve(sprites);
+    m_ScratchKeys.reserve(sprites);
+    m_ScratchOrder.reserve(sprites);
+}
+
+void Sprites::Batcher::Begin()
+{
+    m_Keys.clear();
+    m_Instances.clear();
+    m_Batches.clear();
+}
+
+void Sprites::Batcher::Submit(uint16_t layer, uint16_t pipeline, uint32_t texture, const Instance& instance)
+{
+    m_Keys.push_back(sortKey(layer, pipeline, texture));
+    m_Instances.push_back(instance);
+}
+
+// LSD radix sort of the keys, carrying the submission index along. It's stable,
+// so sprites with equal keys keep their submission order, and bytes that are the
+// same for every sprite (usually most of the layer and pipeline bits) are skipped.
+void Sprites::Batcher::Sort()
+{
+    size_t count = m_Keys.size();
+    m_SortedKeys.assign(m_Keys.begin(), m_Keys.end());
+    m_Order.resize(count);
+    for (size_t i = 0; i < count; i++)
+        m_Order[i] = uint32_t(i);
+
+    m_ScratchKeys.resize(count);
+    m_ScratchOrder.resize(count);
+
+    for (unsigned shift = 0; shift < 64; shift += RadixBits)
+    {
+        size_t histogram[RadixBuckets] = {};
+        for (size_t i = 0; i < count; i++)
+            histogram[(m_SortedKeys[i] >> shift) & (RadixBuckets - 1)]++;
+
+        if (histogram[(m_SortedKeys[0] >> shift) & (RadixBuckets - 1)] == count)
+            continue;
+
+        size_t offset = 0;
+        for (unsigned bucket = 0; bucket < RadixBuckets; bucket++)
+        {
+            size_t size = histogram[bucket];
+            histogram[bucket] = offset;
+            offset += size;
+        }
+
+        for (size_t i = 0; i < count; i++)
+        {
+            size_t destination = histogram[(m_SortedKeys[i] >> shift) & (RadixBuckets - 1)]++;
+            m_ScratchKeys[destination] = m_SortedKeys[i];
+            m_ScratchOrder[destination] = m_Order[i];
+        }
+        m_SortedKeys.swap(m_ScratchKeys);
+        m_Order.swap(m_ScratchOrder);
+    }
+}
+
+uint32_t Sprites::Batcher::Build(Instance* out, uint32_t capacity)
+{
+    m_Batches.clear();
+    if (m_Keys.empty())
+        return 0;
+
+    Sort();
+
+    uint32_t count = uint32_t(m_Keys.size());
+    if (count > capacity)
+        count = capacity;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t pipeline = keyPipeline(m_SortedKeys[i]);
+        uint32_t texture = keyTexture(m_SortedKeys[i]);
+
+        // a layer change alone doesn't need a new draw, the instances are in order anyway
+        if (m_Batches.empty() || m_Batches.back().pipeline != pipeline || m_Batches.back().texture != texture)
+            m_Batches.push_back({pipeline, texture, i, 0});
+        m_Batches.back().instanceCount++;
+
+        out[i] = m_Instances[m_Order[i]];
+    }
+
+    return count;
+}
+
+const std::vector<Sprites::Batch>& Sprites::Batcher::Batches() const
+{
+    return m_Batches;
+}
+
+size_t Sprites::Batcher::Count() const
+{
+    return m_Keys.size();
+}
+
+Sprites::BenchmarkScene::BenchmarkScene(uint32_t spriteCount, uint32_t textureCount, uint32_t pipelineCount, float width, float height)
+: m_Width(width)
+, m_Height(height)
+{
+    for (uint32_t i = 0; i < textureCount; i++)
+        m_Textures.push_back(i);
+    for (uint32_t i = 0; i < pipelineCount; i++)
+        m_Pipelines.push_back(uint16_t(i));
+
+    uint32_t random = 0x12345678;
+    m_Sprites.resize(spriteCount);
+    for (Sprite& sprite : m_Sprites)
+    {
+        float size = randomFloat(random, 4.0f, 24.0f);
+        sprite.instance = {
+            randomFloat(random, 0.0f, width), randomFloat(random, 0.0f, height),
+            size, size,
+            0.0f, 0.0f, 1.0f, 1.0f,
+            randomFloat(random, 0.0f, 6.2831853f),
+            nextRandom(random) | 0xFF000000
+        };
+        sprite.velocityX = randomFloat(random, -100.0f, 100.0f);
+        sprite.velocityY = randomFloat(random, -100.0f, 100.0f);
+        sprite.spin = randomFloat(random, -3.0f, 3.0f);
+        sprite.layer = uint16_t(nextRandom(random) % 4);
+        sprite.pipeline = uint16_t(nextRandom(random) % (pipelineCount ? pipelineCount : 1));
+        sprite.texture = nextRandom(random) % (textureCount ? textureCount : 1);
+    }
+}
+
+void Sprites::BenchmarkScene::SetTextures(const std::vector<uint32_t>& textures)
+{
+    m_Textures = textures;
+}
+
+void Sprites::BenchmarkScene::SetPipelines(const std::vector<uint16_t>& pipelines)
+{
+    m_Pipelines = pipelines;
+}
+
+void Sprites::BenchmarkScene::Update(float deltaTime)
+{
+    for (Sprite& sprite : m_Sprites)
+    {
+        Instance& instance = sprite.instance;
+        instance.x += sprite.velocityX * deltaTime;
+        instance.y += sprite.velocityY * deltaTime;
+        instance.rotation = std::fmod(instance.rotation + sprite.spin * deltaTime, 6.2831853f);
+
+        if (instance.x < 0.0f || instance.x > m_Width)
+            sprite.velocityX = -sprite.velocityX;
+        if (instance.y < 0.0f || instance.y > m_Height)
+            sprite.velocityY = -sprite.velocityY;
+    }
+}
+
+void Sprites::BenchmarkScene::Submit(Batcher& batcher) const
+{
+    if (m_Textures.empty() || m_Pipelines.empty())
+        return;
+
+    for (const Sprite& sprite : m_Sprites)
+    {
+        uint32_t texture = m_Textures[sprite.texture % m_Textures.size()];
+        uint16_t pipeline = m_Pipelines[sprite.pipeline % m_Pipelines.size()];
+        batcher.Submit(sprite.layer, pipeline, texture, sprite.instance);
+    }
+}
+
+Sprites::Stats Sprites::RunCpuBenchmark(uint32_t spriteCount, uint32_t frames)
+{
+    BenchmarkScene scene(spriteCount, 8, 2, 1920.0f, 1080.0f);
+    Batcher batcher;
+    batcher.Reserve(spriteCount);
+    std::vector<Instance> memory(spriteCount);
+
+    Stats stats = {spriteCount, 0, 0.0};
+    if (frames == 0)
+        return stats;
+
+    uint64_t draws = 0;
+    for (uint32_t frame = 0; frame < frames; frame++)
+    {
+        scene.Update(1.0f / 60.0f);
+
+        Timewatcher timer = Timing::Start();
+        batcher.Begin();
+        scene.Submit(batcher);
+        batcher.Build(memory.data(), uint32_t(memory.size()));
+        stats.buildMilliseconds += timer->GetNanoseconds() * 1000.0;
+
+        draws += batcher.Batches().size();
+    }
+
+    stats.draws = uint32_t(draws / frames);
+    stats.buildMilliseconds /= frames;
+    return stats;
+}
@@ -0,0 +1,104 @@
+/* Sprite batching
+ *
+ * Sprites are submitted in any order with a layer, a pipeline and a texture.
+ * Build() sorts them by (layer, pipeline, texture), writes the instance data
+ * straight into the caller's (mapped) buffer and returns one Batch per run of
+ * equal pipeline and texture, each of which becomes one instanced draw.
+ *
+ * No graphics API in here, so the batcher and the benchmark scene also run on
+ * a host without a GPU.
+ */
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Sprites
+{
+	// per-instance vertex data, as the sprite vertex shader reads it
+	struct Instance
+	{
+		float x, y;             // centre
+		float width, height;
+		float u0, v0, u1, v1;
+		float rotation;         // radians, around the centre
+		uint32_t color; // RGBA8, R in the lowest byte
+	};
+
+	struct Batch
+	{
+		uint32_t pipeline;
+		uint32_t texture;
+		uint32_t firstInstance;
+		uint32_t instanceCount;
+	};
+
+	struct Stats
+	{
+		uint32_t sprites;
+		uint32_t draws;
+		double buildMilliseconds;
+	};
+
+	class Batcher
+	{
+	public:
+		void Reserve(size_t sprites);
+		void Begin();
+		// layers are drawn in order, inside a layer the order is up to the batcher
+		void Submit(uint16_t layer, uint16_t pipeline, uint32_t texture, const Instance& instance);
+
+		// returns the number of instances written, sprites that don't fit are dropped.
+		// Submissions stay until the next Begin(), so a frame's sprites can be built again
+		uint32_t Build(Instance* out, uint32_t capacity);
+
+		const std::vector<Batch>& Batches() const;
+		size_t Count() const;
+
+	private:
+		void Sort();
+
+		std::vector<uint64_t> m_Keys;       // in submission order
+		std::vector<uint64_t> m_SortedKeys;
+		std::vector<uint32_t> m_Order;      // submission index for each sorted key
+		std::vector<Instance> m_Instances;
+		std::vector<Batch> m_Batches;
+
+		// radix sort scratch
+		std::vector<uint64_t> m_ScratchKeys;
+		std::vector<uint32_t> m_ScratchOrder;
+	};
+
+	// Lots of moving sprites spread over a handful of textures and pipelines
+	class BenchmarkScene
+	{
+	public:
+		BenchmarkScene(uint32_t spriteCount, uint32_t textureCount, uint32_t pipelineCount, float width, float height);
+
+		void Update(float deltaTime);
+		void Submit(Batcher& batcher) const;
+
+		void SetTextures(const std::vector<uint32_t>& textures);
+		void SetPipelines(const std::vector<uint16_t>& pipelines);
+
+	private:
+		struct Sprite
+		{
+			Instance instance;
+			float velocityX, velocityY;
+			float spin;
+			uint16_t layer;
+			uint16_t pipeline;
+			uint32_t texture;
+		};
+
+		std::vector<Sprite> m_Sprites;
+		std::vector<uint32_t> m_Textures;
+		std::vector<uint16_t> m_Pipelines;
+		float m_Width;
+		float m_Height;
+	};
+
+	// runs the scene without a GPU, building into plain memory; averages over 'frames'
+	Stats RunCpuBenchmark(uint32_t spriteCount, uint32_t frames);
+}
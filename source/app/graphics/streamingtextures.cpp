@@ -0,0 +1,124 @@
+#include "streamingtextures.h"
+#include "texture.h"
+#include "ktx.h"
+#include "utils/log.h"
+
+StreamingTextures::StreamingTextures(const Residency::Settings& settings)
+    : m_Manager(*this, settings)
+{
+}
+
+StreamingTextures::~StreamingTextures()
+{
+}
+
+Residency::TextureId StreamingTextures::Add(std::vector<unsigned char> ktxFile)
+{
+    Source source;
+    source.file = std::move(ktxFile);
+    const Vfs::Span ktx = {source.file.data(), source.file.size()};
+    return Add(ktx, std::move(source));
+}
+
+Residency::TextureId StreamingTextures::Add(std::shared_ptr<Vfs::VirtualFile> ktxFile)
+{
+    const Vfs::Span ktx = ktxFile ? ktxFile->Data() : Vfs::Span();
+    if (ktx.Empty())
+    {
+        LOGE("StreamingTextures: no view of %s", ktxFile ? ktxFile->Path().c_str() : "(null)");
+        return Residency::InvalidTexture;
+    }
+
+    Source source;
+    source.openFile = std::move(ktxFile);
+    return Add(ktx, std::move(source));
+}
+
+Residency::TextureId StreamingTextures::Add(Vfs::Span ktx, Source&& source)
+{
+    Ktx::Image image;
+    if (!Ktx::Parse(ktx.data, ktx.size, image))
+    {
+        return Residency::InvalidTexture;
+    }
+
+    std::vector<uint64_t> levelSizes;
+    for (const Ktx::Level& level : image.levels)
+    {
+        levelSizes.push_back(level.size);
+    }
+
+    Residency::TextureId texture = m_Manager.Register(levelSizes);
+    if (texture >= m_Sources.size())
+    {
+        m_Sources.resize(texture + 1);
+    }
+    m_Sources[texture] = std::move(source);
+    m_Sources[texture].texture.reset(new Texture());
+    return texture;
+}
+
+void StreamingTextures::Remove(Residency::TextureId texture)
+{
+    if (texture >= m_Sources.size())
+    {
+        return;
+    }
+
+    m_Manager.Unregister(texture);
+    m_Sources[texture].file.clear();
+    m_Sources[texture].file.shrink_to_fit();
+    m_Sources[texture].openFile.reset();
+    m_Sources[texture].texture.reset();
+}
+
+void StreamingTextures::BeginFrame()
+{
+    m_Manager.BeginFrame();
+}
+
+Texture* StreamingTextures::Use(Residency::TextureId texture)
+{
+    if (!m_Manager.Use(texture))
+    {
+        return nullptr;
+    }
+    return m_Sources[texture].texture.get();
+}
+
+void StreamingTextures::EndFrame()
+{
+    m_Manager.EndFrame();
+}
+
+Residency::Manager& StreamingTextures::GetManager()
+{
+    return m_Manager;
+}
+
+bool StreamingTextures::MakeResident(Residency::TextureId texture, uint32_t firstLevel)
+{
+    Source& source = m_Sources[texture];
+    const Vfs::Span file = source.Bytes();
+    if (!source.texture->LoadFromBuffer(TextureFormat::Ktx, file.data, file.size, firstLevel))
+    {
+        LOGE("StreamingTextures: unable to upload texture %u from level %u", texture, firstLevel);
+        return false;
+    }
+    return true;
+}
+
+Vfs::Span StreamingTextures::Source::Bytes() const
+{
+    if (openFile)
+    {
+        //stays put while the file is open
+        return openFile->Data();
+    }
+    return {file.data(), file.size()};
+}
+
+void StreamingTextures::Evict(Residency::TextureId texture)
+{
+    m_Sources[texture].texture->Unload();
+}
@@ -0,0 +1,55 @@
+/* Streamed KTX textures
+ *
+ * The GL side of Residency: keeps every registered KTX file in memory and
+ * re-creates the texture from the requested level down whenever the
+ * manager moves it, dropping the GL texture on eviction. Files added open
+ * are kept open and read through their Data() view, so an asset stored
+ * uncompressed is never copied into the heap.
+ */
+#pragma once
+
+#include "residency.h"
+#include "utils/vfs.h"
+#include <memory>
+#include <vector>
+
+class Texture;
+
+class StreamingTextures : public Residency::Backend
+{
+public:
+	explicit StreamingTextures(const Residency::Settings& settings);
+	~StreamingTextures();
+
+	// InvalidTexture if the file doesn't parse
+	Residency::TextureId Add(std::vector<unsigned char> ktxFile);
+	// InvalidTexture as well if the file has no Data() view
+	Residency::TextureId Add(std::shared_ptr<Vfs::VirtualFile> ktxFile);
+	void Remove(Residency::TextureId texture);
+
+	void BeginFrame();
+	// the texture to bind, nullptr if it couldn't be made resident
+	Texture* Use(Residency::TextureId texture);
+	void EndFrame();
+
+	Residency::Manager& GetManager();
+
+	virtual bool MakeResident(Residency::TextureId texture, uint32_t firstLevel);
+	virtual void Evict(Residency::TextureId texture);
+
+private:
+	struct Source
+	{
+		// one or the other
+		std::vector<unsigned char> file;
+		std::shared_ptr<Vfs::VirtualFile> openFile;
+		std::unique_ptr<Texture> texture;
+
+		Vfs::Span Bytes() const;
+	};
+
+	Residency::TextureId Add(Vfs::Span ktx, Source&& source);
+
+	Residency::Manager m_Manager;
+	std::vector<Source> m_Sources;
+};
@@ -1,19 +1,93 @@
 #include "texture.h"
 #include "gldebug.h"
 #include "shader.h"
+#include "glstate.h"
+#include "graphics.h"
+#include "ktx.h"
+#include "utils/log.h"
 #include <GLES2/gl2.h>
+#include <cstring>
+#include <vector>
+
+#ifndef GL_TEXTURE_MAX_LEVEL
+#define GL_TEXTURE_MAX_LEVEL 0x813D
+#endif
+
+namespace {
+    struct Capabilities
+    {
+        bool detected;
+        bool gles3;
+        bool etc1;
+        bool astc;
+        std::vector<GLint> compressedFormats;
+    };
+    Capabilities g_Capabilities = {false, false, false, false, {}};
+
+    void DetectCapabilities()
+    {
+        // ETC2/EAC are core in GLES3, even when we asked EGL for a 2.0 context
+        const char* version = (const char*)glGetString(GL_VERSION);
+        g_Capabilities.gles3 = version && strncmp(version, "OpenGL ES ", 10) == 0 && version[10] >= '3';
+        g_Capabilities.etc1 = Graphics::HasExtension("GL_OES_compressed_ETC1_RGB8_texture");
+        g_Capabilities.astc = Graphics::HasExtension("GL_KHR_texture_compression_astc_ldr");
+
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &count);
+        g_Capabilities.compressedFormats.resize(count > 0 ? count : 0);
+        if (count > 0)
+        {
+            glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, g_Capabilities.compressedFormats.data());
+        }
+
+        g_Capabilities.detected = true;
+        LOGI("Texture formats: ETC1 %s, ETC2 %s, ASTC %s, %d compressed formats listed",
+            g_Capabilities.etc1 ? "yes" : "no", g_Capabilities.gles3 ? "yes" : "no",
+            g_Capabilities.astc ? "yes" : "no", count);
+    }
+
+    bool IsEtc2(unsigned int format)
+    {
+        return format >= Ktx::R11_EAC && format <= Ktx::SRGB8_ALPHA8_ETC2_EAC;
+    }
+
+    bool IsAstc(unsigned int format)
+    {
+        return (format >= Ktx::RGBA_ASTC_4x4 && format <= Ktx::RGBA_ASTC_12x12)
+            || (format >= Ktx::SRGB8_ALPHA8_ASTC_4x4 && format <= Ktx::SRGB8_ALPHA8_ASTC_12x12);
+    }
+}
 
 Texture::Texture()
 	: m_Loaded(false)
 	, m_TextureId(0)
+	, m_Width(0)
+	, m_Height(0)
+	, m_MipLevels(0)
+{
+}
+
+Texture::~Texture()
+{
+    Unload();
+}
+
+void Texture::Unload()
 {
+    if (m_TextureId != 0)
+    {
+        GlState::ForgetTexture(m_TextureId);
+        CHECK_GL(glDeleteTextures(1, &m_TextureId));
+        m_TextureId = 0;
+    }
+    m_Loaded = false;
 }
 
 void Texture::LoadFromBuffer(TextureFormat format, unsigned char* data, unsigned int width, unsigned int height)
 {
     CHECK_GL(glGenTextures(1, &m_TextureId));
 
-    CHECK_GL(glBindTexture(GL_TEXTURE_2D, m_TextureId));
+    CHECK_GL(GlState::BindTexture(0, m_TextureId));
 
 	if (format == TextureFormat::Raw)
 	{
@@ -23,14 +97,179 @@ void Texture::LoadFromBuffer(TextureFormat format, unsigned char* data, unsigned
     CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST));
     CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST));
 
-    CHECK_GL(glBindTexture(GL_TEXTURE_2D, 0));
+    CHECK_GL(GlState::BindTexture(0, 0));
+
+    m_Width = width;
+    m_Height = height;
+    m_MipLevels = 1;
+    m_Loaded = true;
+}
+
+bool Texture::LoadFromBuffer(TextureFormat format, const unsigned char* data, size_t size, unsigned int firstLevel)
+{
+    if (format != TextureFormat::Ktx)
+    {
+        LOGE("Texture: format %u has no container", (unsigned)format);
+        return false;
+    }
+
+    Ktx::Image image;
+    if (!Ktx::Parse(data, size, image))
+    {
+        return false;
+    }
+    if (!IsFormatSupported(image.glInternalFormat))
+    {
+        LOGE("Texture: format 0x%04x is not supported on this device", image.glInternalFormat);
+        return false;
+    }
+    if (firstLevel >= image.levels.size())
+    {
+        LOGE("Texture: level %u requested from a %u level image", firstLevel, (unsigned)image.levels.size());
+        return false;
+    }
+
+    // the first uploaded level becomes level 0, which works without GL_TEXTURE_BASE_LEVEL
+    image.levels.erase(image.levels.begin(), image.levels.begin() + firstLevel);
+    image.width = image.levels.front().width;
+    image.height = image.levels.front().height;
+
+    Unload();
+    CHECK_GL(glGenTextures(1, &m_TextureId));
+    CHECK_GL(GlState::BindTexture(0, m_TextureId));
+
+    // KTX1 pads uncompressed rows to 4 bytes, KTX2 packs them
+    const GLint alignment = image.container == Ktx::Container::Ktx1 ? 4 : 1;
+    CHECK_GL(glPixelStorei(GL_UNPACK_ALIGNMENT, alignment));
+
+    for (size_t i = 0; i < image.levels.size(); ++i)
+    {
+        const Ktx::Level& level = image.levels[i];
+        if (image.compressed)
+        {
+            CHECK_GL(glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, image.glInternalFormat, level.width, level.height, 0, (GLsizei)level.size, data + level.offset));
+        }
+        else
+        {
+            // GLES2 wants the unsized format on both sides
+            CHECK_GL(glTexImage2D(GL_TEXTURE_2D, (GLint)i, image.glFormat, level.width, level.height, 0, image.glFormat, image.glType, data + level.offset));
+        }
+    }
+
+    CHECK_GL(glPixelStorei(GL_UNPACK_ALIGNMENT, 4));
+
+    m_Width = image.width;
+    m_Height = image.height;
+    m_MipLevels = (unsigned int)image.levels.size();
+
+    // compressed formats can't be rendered to, so no generated chain for those
+    if (image.generateMipmaps && !image.compressed)
+    {
+        CHECK_GL(glGenerateMipmap(GL_TEXTURE_2D));
+        m_MipLevels = Ktx::FullMipCount(image.width, image.height);
+    }
+
+    // a chain that stops early is only complete on GLES3, where it can be capped
+    bool mipmapped = m_MipLevels > 1;
+    if (mipmapped && m_MipLevels < Ktx::FullMipCount(image.width, image.height))
+    {
+        if (g_Capabilities.gles3)
+        {
+            CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, m_MipLevels - 1));
+        }
+        else
+        {
+            LOGW("Texture: partial mip chain (%u levels) sampled without mipmaps", m_MipLevels);
+            mipmapped = false;
+        }
+    }
+
+    CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR));
+    CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, mipmapped ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR));
+    // GLES2 only samples non-power-of-two textures with clamping
+    CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE));
+    CHECK_GL(glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE));
+
+    CHECK_GL(GlState::BindTexture(0, 0));
 
     m_Loaded = true;
+    return true;
+}
+
+void Texture::UpdateRegion(unsigned int x, unsigned int y, unsigned int width, unsigned int height, const unsigned char* data)
+{
+    if (!m_Loaded)
+    {
+        return;
+    }
+
+    CHECK_GL(GlState::BindTexture(0, m_TextureId));
+    CHECK_GL(glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, data));
 }
 
 void Texture::Bind(Shader::Program* shader, unsigned int textureUnit)
 {
-    CHECK_GL(glBindTexture(GL_TEXTURE_2D, m_TextureId));
-	CHECK_GL(glActiveTexture(GL_TEXTURE1 + textureUnit));
-    CHECK_GL(glUniform1i(shader->GetUniform("uTexture"), textureUnit));
-}
\ No newline at end of file
+    //selects the unit before binding
+    CHECK_GL(GlState::BindTexture(textureUnit, m_TextureId));
+    CHECK_GL(glUniform1i(shader->GetUniform(Shader::Uniform::Texture), textureUnit));
+}
+
+unsigned int Texture::GetObject() const
+{
+    return m_TextureId;
+}
+
+unsigned int Texture::GetWidth() const
+{
+    return m_Width;
+}
+
+unsigned int Texture::GetHeight() const
+{
+    return m_Height;
+}
+
+unsigned int Texture::GetMipLevels() const
+{
+    return m_MipLevels;
+}
+
+bool Texture::IsFormatSupported(unsigned int glInternalFormat)
+{
+    if (!g_Capabilities.detected)
+    {
+        DetectCapabilities();
+    }
+
+    Ktx::BlockInfo block;
+    if (!Ktx::GetBlockInfo(glInternalFormat, block))
+    {
+        return false;
+    }
+    if (block.width == 1 && block.height == 1)
+    {
+        return true;
+    }
+
+    if (IsEtc2(glInternalFormat) && g_Capabilities.gles3)
+    {
+        return true;
+    }
+    if (IsAstc(glInternalFormat) && g_Capabilities.astc)
+    {
+        return true;
+    }
+    if (glInternalFormat == Ktx::ETC1_RGB8 && (g_Capabilities.etc1 || g_Capabilities.gles3))
+    {
+        return true;
+    }
+
+    for (GLint supported : g_Capabilities.compressedFormats)
+    {
+        if ((unsigned int)supported == glInternalFormat)
+        {
+            return true;
+        }
+    }
+    return false;
+}
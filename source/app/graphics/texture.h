@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+
 namespace Shader
 {
 	class Program;
@@ -8,6 +10,7 @@ namespace Shader
 enum class TextureFormat : unsigned
 {
 	Raw = 0,
+	Ktx, // KTX 1.1 or KTX 2.0, told apart by the identifier
 
 	Count
 };
@@ -16,10 +19,31 @@ class Texture
 {
 public:
 	Texture();
+	~Texture();
 
 	void LoadFromBuffer(TextureFormat format, unsigned char* data, unsigned int width, unsigned int height);
+	// containers describe their own size, format and mip chain; false if the
+	// file is malformed or the device can't sample its format
+	// firstLevel skips the most detailed levels, for streaming
+	bool LoadFromBuffer(TextureFormat format, const unsigned char* data, size_t size, unsigned int firstLevel = 0);
+	// frees the GL texture, a later LoadFromBuffer brings it back
+	void Unload();
+	// RGBA8 rows, tightly packed, into a texture loaded as Raw
+	void UpdateRegion(unsigned int x, unsigned int y, unsigned int width, unsigned int height, const unsigned char* data);
 	void Bind(Shader::Program* shader, unsigned int textureUnit);
+
+	// the GL texture name, 0 while not loaded
+	unsigned int GetObject() const;
+	unsigned int GetWidth() const;
+	unsigned int GetHeight() const;
+	unsigned int GetMipLevels() const;
+
+	// with a current context; detected once
+	static bool IsFormatSupported(unsigned int glInternalFormat);
 private:
 	unsigned int m_TextureId;
 	bool m_Loaded;
+	unsigned int m_Width;
+	unsigned int m_Height;
+	unsigned int m_MipLevels;
 };
@@ -0,0 +1,116 @@
+#include "textureatlas.h"
+#include "texture.h"
+#include "utils/log.h"
+#include <cstring>
+
+namespace {
+    const uint32_t BytesPerPixel = 4;
+}
+
+TextureAtlas::TextureAtlas(uint32_t pageSize, uint32_t maxPages)
+    : m_Packer(pageSize, 1, maxPages)
+{
+}
+
+TextureAtlas::~TextureAtlas()
+{
+}
+
+void TextureAtlas::CopyIn(std::vector<unsigned char>& page, const Atlas::Region& region, const unsigned char* pixels, uint32_t stride)
+{
+    const uint32_t pageStride = m_Packer.PageSize() * BytesPerPixel;
+    for (uint32_t row = 0; row < region.height; ++row)
+    {
+        memcpy(&page[(region.y + row) * pageStride + region.x * BytesPerPixel], pixels + row * stride, region.width * BytesPerPixel);
+    }
+}
+
+void TextureAtlas::AddPages(uint32_t count)
+{
+    const uint32_t pageSize = m_Packer.PageSize();
+    while (m_Pages.size() < count)
+    {
+        // zeroed, so the padding around every image is transparent
+        m_Pixels.push_back(std::vector<unsigned char>(pageSize * pageSize * BytesPerPixel, 0));
+        m_Pages.push_back(std::unique_ptr<Texture>(new Texture()));
+        m_Pages.back()->LoadFromBuffer(TextureFormat::Raw, m_Pixels.back().data(), pageSize, pageSize);
+    }
+}
+
+Atlas::Handle TextureAtlas::Insert(const unsigned char* pixels, uint32_t width, uint32_t height)
+{
+    Atlas::Handle handle = m_Packer.Insert(width, height);
+    if (handle == Atlas::InvalidHandle)
+    {
+        LOGW("TextureAtlas: no room for a %ux%u image", width, height);
+        return handle;
+    }
+
+    const Atlas::Region& region = m_Packer.Get(handle);
+    AddPages(region.page + 1);
+
+    CopyIn(m_Pixels[region.page], region, pixels, width * BytesPerPixel);
+    m_Pages[region.page]->UpdateRegion(region.x, region.y, width, height, pixels);
+    return handle;
+}
+
+void TextureAtlas::Remove(Atlas::Handle handle)
+{
+    m_Packer.Remove(handle);
+}
+
+TextureAtlas::Image TextureAtlas::Get(Atlas::Handle handle) const
+{
+    Image image = {nullptr, 0.0f, 0.0f, 0.0f, 0.0f};
+    if (!m_Packer.IsValid(handle))
+    {
+        return image;
+    }
+
+    const Atlas::Region& region = m_Packer.Get(handle);
+    const float scale = 1.0f / m_Packer.PageSize();
+    image.texture = m_Pages[region.page].get();
+    image.u0 = region.x * scale;
+    image.v0 = region.y * scale;
+    image.u1 = (region.x + region.width) * scale;
+    image.v1 = (region.y + region.height) * scale;
+    return image;
+}
+
+void TextureAtlas::Defragment()
+{
+    std::vector<Atlas::Move> moves = m_Packer.Defragment();
+    const uint32_t pageCount = m_Packer.PageCount();
+    const uint32_t pageStride = m_Packer.PageSize() * BytesPerPixel;
+
+    // moved images are read from the old pages and written over copies of them;
+    // the new layout never overlaps an image that stayed, only free space.
+    // Repacked in another order the images may need a page more than before
+    std::vector<std::vector<unsigned char> > oldPixels = m_Pixels;
+    AddPages(pageCount);
+    std::vector<bool> dirty(pageCount, false);
+    for (const Atlas::Move& move : moves)
+    {
+        const unsigned char* source = &oldPixels[move.from.page][move.from.y * pageStride + move.from.x * BytesPerPixel];
+        CopyIn(m_Pixels[move.to.page], move.to, source, pageStride);
+        dirty[move.to.page] = true;
+    }
+
+    m_Pixels.resize(pageCount);
+    m_Pages.resize(pageCount);
+
+    for (uint32_t page = 0; page < pageCount; ++page)
+    {
+        if (dirty[page])
+        {
+            m_Pages[page]->UpdateRegion(0, 0, m_Packer.PageSize(), m_Packer.PageSize(), m_Pixels[page].data());
+        }
+    }
+
+    LOGI("TextureAtlas: defragmented, %u images moved, %u pages left", (unsigned)moves.size(), pageCount);
+}
+
+Atlas::Stats TextureAtlas::GetStats() const
+{
+    return m_Packer.GetStats();
+}
@@ -0,0 +1,50 @@
+/* Texture atlas
+ *
+ * Small RGBA images share a few page textures, so drawing them only switches
+ * textures when the page changes. Pass Image::texture as the ImTextureID and
+ * its UVs to ImGui::Image, or use them as a sprite's sub-rect.
+ *
+ * Every page keeps a CPU copy of its pixels: GLES2 can't copy between
+ * textures, and Defragment() rebuilds the pages from those copies.
+ */
+#pragma once
+
+#include "atlas.h"
+#include <memory>
+#include <vector>
+
+class Texture;
+
+class TextureAtlas
+{
+public:
+	struct Image
+	{
+		Texture* texture;
+		float u0, v0;
+		float u1, v1;
+	};
+
+	TextureAtlas(uint32_t pageSize = 1024, uint32_t maxPages = 8);
+	~TextureAtlas();
+
+	// with a current context; RGBA8, tightly packed
+	Atlas::Handle Insert(const unsigned char* pixels, uint32_t width, uint32_t height);
+	void Remove(Atlas::Handle handle);
+	// texture is nullptr for a stale handle
+	Image Get(Atlas::Handle handle) const;
+
+	// repacks and uploads the pages that changed; UVs from Get() are stale afterwards
+	void Defragment();
+
+	Atlas::Stats GetStats() const;
+
+private:
+	// with a current context, zeroed
+	void AddPages(uint32_t count);
+	void CopyIn(std::vector<unsigned char>& page, const Atlas::Region& region, const unsigned char* pixels, uint32_t stride);
+
+	Atlas::Packer m_Packer;
+	std::vector<std::unique_ptr<Texture> > m_Pages;
+	std::vector<std::vector<unsigned char> > m_Pixels;
+};
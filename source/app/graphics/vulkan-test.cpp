@@ -1,14 +1,23 @@
 #include "vulkan-test.h"
 #include "utils/log.h"
-#include "utils/fs_android.h"
+#include "utils/vfs.h"
 #include "graphics/wsi.h"
 #include "vulkandebug.h"
+#include "prerotation.h"
+#include "rendergraph.h"
+#include "vulkanrendergraph.h"
+#include "vulkandescriptors.h"
+#include "vulkansprites.h"
+#include "spritebatch.h"
 
 #include <vulkan/vulkan.h>
 #include <vector>
 #include <set>
 #include <chrono>
 #include <thread>
+#include <memory>
+#include <cstring>
+#include <algorithm>
 
 namespace {
 
@@ -44,9 +53,12 @@ namespace {
     VkSwapchainKHR swapChain;
     VkFormat swapChainImageFormat;
     VkExtent2D swapChainExtent;
+    PreRotation::Rotation swapChainPreRotation = PreRotation::Rotation::Identity;
     std::vector<VkImage> swapChainImages;
     std::vector<VkImageView> swapChainImageViews;
-    std::vector<VkFramebuffer> swapChainFramebuffers;
+    RenderGraph::Graph renderGraph;
+    RenderGraph::Resource backbuffer = RenderGraph::InvalidResource;
+    std::unique_ptr<Vulkan::RenderGraphBackend> renderGraphBackend;
     VkRenderPass renderPass;
     VkPipelineLayout pipelineLayout;
     VkPipeline graphicsPipeline;
@@ -55,8 +67,17 @@ namespace {
     std::vector<VkSemaphore> imageAvailableSemaphores;
     std::vector<VkSemaphore> renderFinishedSemaphores;
     std::vector<VkFence> inFlightFences;
+    std::unique_ptr<Vulkan::DescriptorAllocator> descriptorAllocator;
+    std::unique_ptr<Vulkan::BindlessTextures> bindlessTextures;
+    const uint32_t BINDLESS_TEXTURE_CAPACITY = 4096;
+    std::unique_ptr<Vulkan::SpriteRenderer> spriteRenderer;
+    std::unique_ptr<Sprites::BenchmarkScene> spriteBenchmark;
+    const uint32_t MAX_SPRITES = 100000;
+    uint32_t frameCount = 0;
+    Vulkan::Hooks hooks;
 
     bool debugEnabled = true;
+    bool spriteBenchmarkEnabled = false;
 
     static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
         VkDebugReportFlagsEXT flags,
@@ -279,13 +300,78 @@ namespace {
         }
     }
 
+    VkSurfaceTransformFlagBitsKHR choosePreTransform(const VkSurfaceCapabilitiesKHR& capabilities)
+    {
+        //We handle the quarter turns ourselves, so the compositor does not need a rotation pass
+        switch (capabilities.currentTransform)
+        {
+            case VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR:
+            case VK_SURFACE_TRANSFORM_ROTATE_90_BIT_KHR:
+            case VK_SURFACE_TRANSFORM_ROTATE_180_BIT_KHR:
+            case VK_SURFACE_TRANSFORM_ROTATE_270_BIT_KHR:
+                return capabilities.currentTransform;
+            default:
+                break;
+        }
+
+        //Mirrored transforms: leave them to the compositor
+        if (capabilities.supportedTransforms & VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR)
+        {
+            return VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+        }
+        return capabilities.currentTransform;
+    }
+
+    PreRotation::Rotation toPreRotation(VkSurfaceTransformFlagBitsKHR transform)
+    {
+        switch (transform)
+        {
+            case VK_SURFACE_TRANSFORM_ROTATE_90_BIT_KHR:
+                return PreRotation::Rotation::Rotate90;
+            case VK_SURFACE_TRANSFORM_ROTATE_180_BIT_KHR:
+                return PreRotation::Rotation::Rotate180;
+            case VK_SURFACE_TRANSFORM_ROTATE_270_BIT_KHR:
+                return PreRotation::Rotation::Rotate270;
+            default:
+                return PreRotation::Rotation::Identity;
+        }
+    }
+
+    VkCompositeAlphaFlagBitsKHR chooseCompositeAlpha(const VkSurfaceCapabilitiesKHR& capabilities)
+    {
+        const VkCompositeAlphaFlagBitsKHR preferred[] = {
+            VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
+            VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR,
+            VK_COMPOSITE_ALPHA_PRE_MULTIPLIED_BIT_KHR,
+            VK_COMPOSITE_ALPHA_POST_MULTIPLIED_BIT_KHR,
+        };
+
+        for (auto compositeAlpha : preferred)
+        {
+            if (capabilities.supportedCompositeAlpha & compositeAlpha)
+            {
+                return compositeAlpha;
+            }
+        }
+
+        //The spec guarantees at least one bit, this is just to be safe
+        return VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
+    }
+
     bool createSwapChain()
     {
         SwapChainSupportDetails swapChainSupport = querySwapChainSupport(physicalDevice);
 
         VkSurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
         VkPresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
-        VkExtent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
+        VkSurfaceTransformFlagBitsKHR preTransform = choosePreTransform(swapChainSupport.capabilities);
+        VkCompositeAlphaFlagBitsKHR compositeAlpha = chooseCompositeAlpha(swapChainSupport.capabilities);
+        PreRotation::Rotation preRotation = toPreRotation(preTransform);
+
+        //The surface reports its extent in the current (rotated) orientation, images are in the native one
+        VkExtent2D windowExtent = chooseSwapExtent(swapChainSupport.capabilities);
+        PreRotation::Extent nativeExtent = PreRotation::NativeExtent({windowExtent.width, windowExtent.height}, preRotation);
+        VkExtent2D extent = {nativeExtent.width, nativeExtent.height};
 
         uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
         if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount) {
@@ -304,8 +390,8 @@ namespace {
             , .imageSharingMode = VK_SHARING_MODE_EXCLUSIVE
             , .queueFamilyIndexCount = 0
             , .pQueueFamilyIndices = nullptr
-            , .preTransform = swapChainSupport.capabilities.currentTransform
-            , .compositeAlpha = VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR
+            , .preTransform = preTransform
+            , .compositeAlpha = compositeAlpha
             , .presentMode = presentMode
             , .clipped = VK_TRUE
             , .oldSwapchain = VK_NULL_HANDLE
@@ -326,6 +412,9 @@ namespace {
 
         swapChainImageFormat = surfaceFormat.format;
         swapChainExtent = extent;
+        swapChainPreRotation = preRotation;
+
+        LOGI("Swapchain %ux%u, pre-rotation %u", extent.width, extent.height, (unsigned)preRotation);
 
         return true;
     }
@@ -365,6 +454,25 @@ namespace {
         return true;
     }
 
+    //through whatever filesystem has it, the assets or the writable layer over them
+    bool readShader(const std::string& path, std::vector<char>& code)
+    {
+        auto file = Vfs::Open<Vfs::VirtualFile>(path);
+        if (!file)
+        {
+            LOGE("No shader %s", path.c_str());
+            return false;
+        }
+        const int64_t size = file->Size();
+        code.resize(size > 0 ? size_t(size) : 0);
+        if (code.empty() || file->ReadAt(0, code.data(), size) != size)
+        {
+            LOGE("Unable to read shader %s", path.c_str());
+            return false;
+        }
+        return true;
+    }
+
     bool createShaderModule(VkShaderModule& shaderModule, const std::vector<char>& code)
     {
         VkShaderModuleCreateInfo createInfo = {
@@ -382,63 +490,77 @@ namespace {
         return true;
     }
 
-    bool createRenderPass() {
-        VkAttachmentDescription colorAttachment = {
-            .format = swapChainImageFormat,
-            .samples = VK_SAMPLE_COUNT_1_BIT,
-            .loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-            .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-            .stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
-            .stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-            .finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-        };
+    void drawMainPass()
+    {
+        VkCommandBuffer commandBuffer = renderGraphBackend->CommandBuffer();
 
-        VkAttachmentReference colorAttachmentRef = {
-            .attachment = 0,
-            .layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-        };
+        float preRotate[16];
+        PreRotation::Matrix(swapChainPreRotation, preRotate);
 
-        VkSubpassDescription subpass = {
-            .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
-            .colorAttachmentCount = 1,
-            .pColorAttachments = &colorAttachmentRef
-        };
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(preRotate), preRotate);
+        vkCmdDraw(commandBuffer, 3, 1, 0, 0);
 
-        VkSubpassDependency dependency = {
-            .srcSubpass = VK_SUBPASS_EXTERNAL,
-            .dstSubpass = 0,
-            .srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-            .srcAccessMask = 0,
-            .dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-            .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-        };
+        //sprites are placed in window coordinates, the pre-rotation takes them to the native orientation
+        if (spriteRenderer)
+        {
+            PreRotation::Extent window = PreRotation::NativeExtent({swapChainExtent.width, swapChainExtent.height}, swapChainPreRotation);
+            float ortho[16] = {
+                2.0f / window.width, 0.0f, 0.0f, 0.0f,
+                0.0f, 2.0f / window.height, 0.0f, 0.0f,
+                0.0f, 0.0f, 1.0f, 0.0f,
+                -1.0f, -1.0f, 0.0f, 1.0f,
+            };
+            float projection[16];
+            PreRotation::Apply(swapChainPreRotation, ortho, projection);
 
-        VkRenderPassCreateInfo renderPassInfo = {
-            .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-            .attachmentCount = 1,
-            .pAttachments = &colorAttachment,
-            .subpassCount = 1,
-            .pSubpasses = &subpass,
-            .dependencyCount = 1,
-            .pDependencies = &dependency,
-        };
+            spriteRenderer->Record(commandBuffer, (uint32_t)currentFrame, projection);
+        }
+
+        if (hooks.mainPass)
+        {
+            Vulkan::MainPass pass = {commandBuffer, (uint32_t)currentFrame, renderPass, swapChainExtent, swapChainPreRotation};
+            hooks.mainPass(pass);
+        }
+    }
 
-        if (vkCreateRenderPass(device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS) {
+    bool createRenderPass() {
+        //Describe the frame, the graph works out the render passes and barriers
+        renderGraph.Reset();
+
+        RenderGraph::TextureDesc backbufferDesc = {swapChainExtent.width, swapChainExtent.height, (uint32_t)swapChainImageFormat, false};
+        backbuffer = renderGraph.Import("backbuffer", backbufferDesc, RenderGraph::Layout::Undefined, RenderGraph::Layout::Present);
+
+        RenderGraph::ClearValue clearColor = {{0.0f, 0.0f, 0.0f, 1.0f}, 1.0f, 0};
+        unsigned mainPass = renderGraph.AddPass("main", drawMainPass);
+        renderGraph.Write(mainPass, backbuffer, RenderGraph::Usage::ColorAttachment, clearColor);
+
+        renderGraphBackend.reset(new Vulkan::RenderGraphBackend(device, physicalDevice));
+        if (!renderGraph.Compile(*renderGraphBackend))
+        {
+            LOGE("failed to compile the render graph!");
+            return false;
+        }
+
+        if (!renderGraphBackend->Realize(renderGraph)) {
             LOGE("failed to create render pass!");
             return false;
         }
 
+        //the pipeline is built against the render pass that draws the main pass
+        renderPass = renderGraphBackend->RenderPass(0);
+
         return true;
     }
 
     bool createGraphicsPipeline()
     {
-        auto vertShaderFile = Vfs::Open<Vfs::AndroidFile>("shaders/tutorial4.vert.spv");
-        auto fragShaderFile = Vfs::Open<Vfs::AndroidFile>("shaders/tutorial4.frag.spv");
-
-        auto vertShaderCode = vertShaderFile->ToBuffer<char>();
-        auto fragShaderCode = fragShaderFile->ToBuffer<char>();
+        std::vector<char> vertShaderCode;
+        std::vector<char> fragShaderCode;
+        if (!readShader("shaders/tutorial4.vert.spv", vertShaderCode) || !readShader("shaders/tutorial4.frag.spv", fragShaderCode))
+        {
+            return false;
+        }
 
         VkShaderModule vertShaderModule;
         VkShaderModule fragShaderModule;
@@ -575,12 +697,26 @@ namespace {
             .pDynamicStates = dynamicStates,
         };
 
+        //Pre-rotation matrix
+        VkPushConstantRange preRotateRange = {
+            .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+            .offset = 0,
+            .size = sizeof(float) * 16,
+        };
+
+        //Set 0: the bindless texture table, when the device has one
+        std::vector<VkDescriptorSetLayout> setLayouts;
+        if (bindlessTextures)
+        {
+            setLayouts.push_back(bindlessTextures->Layout());
+        }
+
         VkPipelineLayoutCreateInfo pipelineLayoutInfo = {
             .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-            .setLayoutCount = 0, // Optional
-            .pSetLayouts = nullptr, // Optional
-            .pushConstantRangeCount = 0, // Optional
-            .pPushConstantRanges = nullptr, // Optional
+            .setLayoutCount = (uint32_t)setLayouts.size(),
+            .pSetLayouts = setLayouts.data(),
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &preRotateRange,
         };
 
         if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
@@ -622,34 +758,6 @@ namespace {
         return true;
     }
 
-    bool createFramebuffers()
-    {
-        swapChainFramebuffers.resize(swapChainImageViews.size());
-
-        for (size_t i = 0; i < swapChainImageViews.size(); i++)
-        {
-            VkImageView attachments[] = {
-                swapChainImageViews[i]
-            };
-
-            VkFramebufferCreateInfo framebufferInfo = {
-                .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-                .renderPass = renderPass,
-                .attachmentCount = 1,
-                .pAttachments = attachments,
-                .width = swapChainExtent.width,
-                .height = swapChainExtent.height,
-                .layers = 1,
-            };
-
-            if (vkCreateFramebuffer(device, &framebufferInfo, nullptr, &swapChainFramebuffers[i]) != VK_SUCCESS) {
-                LOGE("failed to create framebuffer!");
-                return false;
-            }
-        }
-        return true;
-    }
-
     bool createCommandPool()
     {
         QueueFamilyIndices queueFamilyIndices = findQueueFamilies(physicalDevice);
@@ -657,7 +765,7 @@ namespace {
         VkCommandPoolCreateInfo poolInfo = {
             .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
             .queueFamilyIndex = (uint32_t)queueFamilyIndices.graphicsFamily,
-            .flags = 0,
+            .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
         };
 
         if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
@@ -668,9 +776,10 @@ namespace {
         return true;
     }
 
+    //one command buffer per frame in flight, recorded again every frame
     bool createCommandBuffers()
     {
-        commandBuffers.resize(swapChainFramebuffers.size());
+        commandBuffers.resize(MAX_FRAMES_IN_FLIGHT);
 
         VkCommandBufferAllocateInfo allocInfo = {
             .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
@@ -685,47 +794,124 @@ namespace {
             return false;
         }
 
-        VkClearValue clearColor = {0.0f, 0.0f, 0.0f, 1.0f};
+        return true;
+    }
 
-        for (size_t i = 0; i < commandBuffers.size(); i++)
+    bool recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+    {
+        VkCommandBufferBeginInfo beginInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+            .pInheritanceInfo = nullptr, // Optional
+        };
+
+        if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
         {
-            VkCommandBufferBeginInfo beginInfo = {
-                .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-                .flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT,
-                .pInheritanceInfo = nullptr, // Optional
-            };
+            LOGE("failed to begin recording command buffer!");
+            return false;
+        }
+
+        renderGraphBackend->Bind(backbuffer, swapChainImages[imageIndex], swapChainImageViews[imageIndex]);
+        renderGraphBackend->Record(commandBuffer);
+        renderGraph.Execute(*renderGraphBackend);
 
-            if (vkBeginCommandBuffer(commandBuffers[i], &beginInfo) != VK_SUCCESS)
+        if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+        {
+            LOGE("failed to record command buffer!");
+            return false;
+        }
+
+        return true;
+    }
+
+    bool createSprites()
+    {
+        if (!spriteRenderer)
+        {
+            spriteRenderer.reset(new Vulkan::SpriteRenderer(device, physicalDevice, *descriptorAllocator, MAX_FRAMES_IN_FLIGHT, MAX_SPRITES));
+            if (!spriteRenderer->Initialize(commandPool, graphicsQueue))
             {
-                LOGE("failed to begin recording command buffer!");
+                spriteRenderer.reset();
                 return false;
             }
+        }
 
-            VkRenderPassBeginInfo renderPassInfo = {
-                .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-                .renderPass = renderPass,
-                .framebuffer = swapChainFramebuffers[i],
-                .renderArea = {
-                    .offset = {0, 0},
-                    .extent = swapChainExtent,
-                },
-                .clearValueCount = 1,
-                .pClearValues = &clearColor,
-            };
+        std::vector<char> vertShaderCode;
+        std::vector<char> fragShaderCode;
+        if (!readShader("shaders/sprite.vert.spv", vertShaderCode) || !readShader("shaders/sprite.frag.spv", fragShaderCode)
+            || !spriteRenderer->CreatePipelines(renderPass, swapChainExtent, vertShaderCode, fragShaderCode))
+        {
+            return false;
+        }
+
+        if (spriteBenchmarkEnabled && !spriteBenchmark)
+        {
+            PreRotation::Extent window = PreRotation::NativeExtent({swapChainExtent.width, swapChainExtent.height}, swapChainPreRotation);
+            spriteBenchmark.reset(new Sprites::BenchmarkScene(MAX_SPRITES, 1, Vulkan::SpriteRenderer::PipelineCount, (float)window.width, (float)window.height));
+            spriteBenchmark->SetTextures({spriteRenderer->WhiteTexture()});
+        }
+
+        return true;
+    }
+
+    bool changed(const std::vector<std::string>& paths, const char* shader)
+    {
+        const std::string prefix = std::string("shaders/") + shader;
+        return std::find(paths.begin(), paths.end(), prefix + ".vert.spv") != paths.end()
+            || std::find(paths.begin(), paths.end(), prefix + ".frag.spv") != paths.end();
+    }
+
+    unsigned reloadShaders(const std::vector<std::string>& paths)
+    {
+        //without a swapchain there is nothing built, it's built from the new files when there is one
+        const bool tutorial = changed(paths, "tutorial4");
+        const bool sprites = changed(paths, "sprite") && spriteRenderer;
+        if (renderPass == VK_NULL_HANDLE || (!tutorial && !sprites))
+        {
+            return 0;
+        }
 
-            vkCmdBeginRenderPass(commandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-            vkCmdBindPipeline(commandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-            vkCmdDraw(commandBuffers[i], 3, 1, 0, 0);
-            vkCmdEndRenderPass(commandBuffers[i]);
+        //earlier frames may still use the pipelines
+        vkDeviceWaitIdle(device);
 
-            if (vkEndCommandBuffer(commandBuffers[i]) != VK_SUCCESS)
+        unsigned reloaded = 0;
+        if (tutorial)
+        {
+            //one that doesn't build leaves the old one in place
+            const VkPipeline oldPipeline = graphicsPipeline;
+            const VkPipelineLayout oldLayout = pipelineLayout;
+            if (createGraphicsPipeline())
             {
-                LOGE("failed to record command buffer!");
-                return false;
+                vkDestroyPipeline(device, oldPipeline, nullptr);
+                vkDestroyPipelineLayout(device, oldLayout, nullptr);
+                reloaded++;
+            }
+            else
+            {
+                if (pipelineLayout != oldLayout)
+                {
+                    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+                }
+                graphicsPipeline = oldPipeline;
+                pipelineLayout = oldLayout;
+                LOGW("Keeping the tutorial4 pipeline");
             }
         }
 
-        return true;
+        if (sprites)
+        {
+            //sprites are skipped until a shader that builds is saved
+            spriteRenderer->DestroyPipelines();
+            if (createSprites())
+            {
+                reloaded++;
+            }
+            else
+            {
+                LOGW("Sprites have no pipelines until their shaders build");
+            }
+        }
+        return reloaded;
     }
 
     bool createSyncObjects() {
@@ -757,15 +943,24 @@ namespace {
 
     void cleanupSwapChain() {
 
-        for (auto framebuffer : swapChainFramebuffers) {
-            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        //vkDestroyCommandPool(device, commandPool, nullptr);
+
+        if (hooks.swapchainDestroyed)
+        {
+            hooks.swapchainDestroyed();
         }
 
-        //vkDestroyCommandPool(device, commandPool, nullptr);
+        if (spriteRenderer)
+        {
+            spriteRenderer->DestroyPipelines();
+        }
 
         vkDestroyPipeline(device, graphicsPipeline, nullptr);
         vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-        vkDestroyRenderPass(device, renderPass, nullptr);
+
+        //render passes, framebuffers and transient images
+        renderGraphBackend.reset();
+        renderPass = VK_NULL_HANDLE;
 
         for (auto imageView : swapChainImageViews) {
             vkDestroyImageView(device, imageView, nullptr);
@@ -805,13 +1000,6 @@ namespace {
             return false;
         }
 
-        //Framebuffers
-        if (!createFramebuffers())
-        {
-            LOGE("Failed to create the framebuffers");
-            return false;
-        }
-
         //Command Pool
         if (!createCommandPool())
         {
@@ -828,6 +1016,14 @@ namespace {
             return false;
         }
 
+        //sprites
+        if (!createSprites())
+        {
+            LOGE("failed to create the sprite renderer");
+
+            return false;
+        }
+
         return true;
     }
 
@@ -887,14 +1083,35 @@ namespace {
             LOGI("\t%s", devExt.extensionName);
         }
 
+        std::vector<const char*> deviceExtensions = enabledDeviceExtensions;
+        const void* deviceCreateNext = nullptr;
+        bool bindlessSupported = Vulkan::BindlessTextures::Supported(instance, physicalDevice);
+#ifdef VK_EXT_descriptor_indexing
+        VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT,
+            .shaderSampledImageArrayNonUniformIndexing = VK_TRUE,
+            .descriptorBindingSampledImageUpdateAfterBind = VK_TRUE,
+            .descriptorBindingUpdateUnusedWhilePending = VK_TRUE,
+            .descriptorBindingPartiallyBound = VK_TRUE,
+            .runtimeDescriptorArray = VK_TRUE,
+        };
+        if (bindlessSupported)
+        {
+            deviceExtensions.push_back(VK_KHR_MAINTENANCE3_EXTENSION_NAME);
+            deviceExtensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+            deviceCreateNext = &indexingFeatures;
+        }
+#endif
+        LOGI("Bindless textures %s", bindlessSupported ? "supported" : "not supported");
+
         VkDeviceCreateInfo deviceCreateInfo = {
                 .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO
-                , .pNext = nullptr
+                , .pNext = deviceCreateNext
                 , .queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size())
                 , .pQueueCreateInfos = queueCreateInfos.data()
                 , .pEnabledFeatures = &deviceFeatures
-                , .enabledExtensionCount = (uint32_t)enabledDeviceExtensions.size()
-                , .ppEnabledExtensionNames = enabledDeviceExtensions.data()
+                , .enabledExtensionCount = (uint32_t)deviceExtensions.size()
+                , .ppEnabledExtensionNames = deviceExtensions.data()
                 , .enabledLayerCount = (uint32_t)validationLayers.size()
                 , .ppEnabledLayerNames = validationLayers.data()
         };
@@ -908,6 +1125,17 @@ namespace {
         vkGetDeviceQueue(device, indices.presentFamily, 0, &presentQueue);
         vkGetDeviceQueue(device, indices.graphicsFamily, 0, &graphicsQueue);
 
+        //Descriptors
+        descriptorAllocator.reset(new Vulkan::DescriptorAllocator(device, MAX_FRAMES_IN_FLIGHT));
+        if (bindlessSupported)
+        {
+            bindlessTextures.reset(new Vulkan::BindlessTextures(device, BINDLESS_TEXTURE_CAPACITY, MAX_FRAMES_IN_FLIGHT));
+            if (!bindlessTextures->Initialize())
+            {
+                bindlessTextures.reset();
+            }
+        }
+
         return true;
     }
 
@@ -949,13 +1177,6 @@ namespace {
             return false;
         }
 
-        //Framebuffers
-        if (!createFramebuffers())
-        {
-            LOGE("Failed to create the framebuffers");
-            return false;
-        }
-
         //Command Pool
         if (!createCommandPool())
         {
@@ -972,6 +1193,14 @@ namespace {
             return false;
         }
 
+        //sprites
+        if (!createSprites())
+        {
+            LOGE("failed to create the sprite renderer");
+
+            return false;
+        }
+
         //semaphores + fences
         if (!createSyncObjects())
         {
@@ -980,6 +1209,11 @@ namespace {
             return false;
         }
 
+        if (hooks.deviceCreated)
+        {
+            hooks.deviceCreated();
+        }
+
         return true;
     }
 
@@ -987,8 +1221,18 @@ namespace {
     {
         vkDeviceWaitIdle(device);
 
+        if (hooks.deviceDestroyed)
+        {
+            hooks.deviceDestroyed();
+        }
+
         cleanupSwapChain();
 
+        spriteBenchmark.reset();
+        spriteRenderer.reset();
+        bindlessTextures.reset();
+        descriptorAllocator.reset();
+
         vkDestroyDevice(device, nullptr);
 
         WSI::Destroy(instance);
@@ -1012,6 +1256,13 @@ bool Vulkan::Initialize(ANativeWindow* window) {
 
     vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, supportedExtensions.data());
 
+    //needed to query descriptor indexing support
+    for (const auto &ext : supportedExtensions) {
+        if (strcmp(ext.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0) {
+            enabledExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+        }
+    }
+
     LOGI("Vulkan: %d extensions supported! Extensions:", extensionCount);
     for (const auto &ext : supportedExtensions) {
         LOGI("\t%s", ext.extensionName);
@@ -1071,6 +1322,13 @@ bool Vulkan::Initialize(ANativeWindow* window) {
 void Vulkan::Draw() {
     vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
 
+    //the GPU is done with this frame's transient descriptor sets, and with the bindless slots removed back then
+    descriptorAllocator->BeginFrame(currentFrame);
+    if (bindlessTextures)
+    {
+        bindlessTextures->BeginFrame(currentFrame);
+    }
+
     uint32_t imageIndex;
     VkResult result = vkAcquireNextImageKHR(device, swapChain, std::numeric_limits<uint64_t>::max(),
                           imageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
@@ -1084,6 +1342,31 @@ void Vulkan::Draw() {
         return;
     }
 
+    if (spriteBenchmark)
+    {
+        spriteBenchmark->Update(1.0f / 60.0f);
+        spriteRenderer->Batcher().Begin();
+        spriteBenchmark->Submit(spriteRenderer->Batcher());
+    }
+
+    //descriptor writes have to land before the sets are bound
+    descriptorAllocator->Flush();
+    if (bindlessTextures)
+    {
+        bindlessTextures->Flush();
+    }
+
+    if (!recordCommandBuffer(commandBuffers[currentFrame], imageIndex))
+    {
+        return;
+    }
+
+    if (spriteBenchmark && ++frameCount % 120 == 0)
+    {
+        const Sprites::Stats& stats = spriteRenderer->Stats();
+        LOGI("Sprites: %u sprites, %u draws/frame, %.2f ms/frame to build", stats.sprites, stats.draws, stats.buildMilliseconds);
+    }
+
     VkSemaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
     VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
     VkSemaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
@@ -1094,7 +1377,7 @@ void Vulkan::Draw() {
         .pWaitSemaphores = waitSemaphores,
         .pWaitDstStageMask = waitStages,
         .commandBufferCount = 1,
-        .pCommandBuffers = &commandBuffers[imageIndex],
+        .pCommandBuffers = &commandBuffers[currentFrame],
         .signalSemaphoreCount = 1,
         .pSignalSemaphores = signalSemaphores,
     };
@@ -1132,6 +1415,29 @@ void Vulkan::Draw() {
     currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
+unsigned Vulkan::ReloadShaders(const std::vector<std::string>& paths)
+{
+    return reloadShaders(paths);
+}
+
+void Vulkan::SetHooks(const Hooks& newHooks)
+{
+    hooks = newHooks;
+}
+
+Vulkan::Context Vulkan::GetContext()
+{
+    Context context = {device, physicalDevice, graphicsQueue, commandPool, descriptorAllocator.get(), MAX_FRAMES_IN_FLIGHT};
+    return context;
+}
+
+uint32_t Vulkan::WaitForFrame()
+{
+    //Draw() waits on the same fence, it's signalled by then
+    vkWaitForFences(device, 1, &inFlightFences[currentFrame], VK_TRUE, std::numeric_limits<uint64_t>::max());
+    return (uint32_t)currentFrame;
+}
+
 void Vulkan::ReleaseSurface()
 {
     LOGI("Vulkan::ReleaseSurface");
@@ -1,12 +1,60 @@
+#pragma once
 
 #include <android/native_window.h>
+#include <vulkan/vulkan.h>
+#include <functional>
+#include <string>
+#include <vector>
+#include "prerotation.h"
 
 namespace Vulkan
 {
+	class DescriptorAllocator;
+
+	// for code that draws next to the test scene, on the same device
+	struct Context
+	{
+		VkDevice device;
+		VkPhysicalDevice physicalDevice;
+		VkQueue queue;
+		VkCommandPool commandPool;
+		DescriptorAllocator* descriptors;
+		uint32_t framesInFlight;
+	};
+
+	struct MainPass
+	{
+		VkCommandBuffer commandBuffer;
+		uint32_t frame;
+		VkRenderPass renderPass;
+		VkExtent2D extent; // of the swapchain images
+		PreRotation::Rotation rotation;
+	};
+
+	struct Hooks
+	{
+		// the device is up, or about to go (idle by then)
+		std::function<void()> deviceCreated;
+		std::function<void()> deviceDestroyed;
+		// the render pass is about to go, with the swapchain
+		std::function<void()> swapchainDestroyed;
+		// recorded at the end of the main pass
+		std::function<void(const MainPass&)> mainPass;
+	};
+
+	void SetHooks(const Hooks& hooks);
+	Context GetContext();
+	// waits for the GPU to finish the frame the next Draw() records; its index
+	uint32_t WaitForFrame();
+
 	void ReleaseSurface();
 	void ReAcquireSurface(ANativeWindow* window);
 
 	bool Initialize(ANativeWindow* window);
 	void Draw();
 	void Destroy();
+
+	// rebuilds the test scene's pipelines whose SPIR-V is among paths, for
+	// hot reloading; the number rebuilt
+	unsigned ReloadShaders(const std::vector<std::string>& paths);
 }
\ No newline at end of file
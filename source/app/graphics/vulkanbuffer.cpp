@@ -0,0 +1,131 @@
+#include "vulkanbuffer.h"
+#include "utils/log.h"
+
+int Vulkan::FindMemoryType(const VkPhysicalDeviceMemoryProperties& properties, uint32_t typeBits, VkMemoryPropertyFlags flags)
+{
+    for (uint32_t i = 0; i < properties.memoryTypeCount; ++i)
+    {
+        if ((typeBits & (1u << i)) && (properties.memoryTypes[i].propertyFlags & flags) == flags)
+        {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+bool Vulkan::CreateBuffer(VkDevice device, const VkPhysicalDeviceMemoryProperties& properties, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags flags, Buffer& buffer)
+{
+    buffer = {VK_NULL_HANDLE, VK_NULL_HANDLE, size, nullptr, false};
+
+    VkBufferCreateInfo bufferInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer.buffer) != VK_SUCCESS)
+    {
+        LOGE("failed to create a buffer of %u bytes", (unsigned)size);
+        return false;
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetBufferMemoryRequirements(device, buffer.buffer, &requirements);
+
+    bool hostVisible = (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+    int memoryType = -1;
+    if (hostVisible)
+    {
+        memoryType = FindMemoryType(properties, requirements.memoryTypeBits, flags | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    }
+    if (memoryType < 0)
+    {
+        memoryType = FindMemoryType(properties, requirements.memoryTypeBits, flags);
+    }
+
+    if (memoryType < 0)
+    {
+        LOGE("no memory type for a buffer with flags 0x%x", (unsigned)flags);
+        DestroyBuffer(device, buffer);
+        return false;
+    }
+
+    VkMemoryAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = requirements.size,
+        .memoryTypeIndex = (uint32_t)memoryType,
+    };
+
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &buffer.memory) != VK_SUCCESS)
+    {
+        LOGE("failed to allocate %u bytes of buffer memory", (unsigned)requirements.size);
+        DestroyBuffer(device, buffer);
+        return false;
+    }
+
+    vkBindBufferMemory(device, buffer.buffer, buffer.memory, 0);
+
+    if (hostVisible)
+    {
+        buffer.coherent = (properties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+        if (vkMapMemory(device, buffer.memory, 0, VK_WHOLE_SIZE, 0, &buffer.mapped) != VK_SUCCESS)
+        {
+            LOGE("failed to map buffer memory");
+            DestroyBuffer(device, buffer);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void Vulkan::DestroyBuffer(VkDevice device, Buffer& buffer)
+{
+    if (buffer.mapped)
+    {
+        vkUnmapMemory(device, buffer.memory);
+    }
+    if (buffer.buffer != VK_NULL_HANDLE)
+    {
+        vkDestroyBuffer(device, buffer.buffer, nullptr);
+    }
+    if (buffer.memory != VK_NULL_HANDLE)
+    {
+        vkFreeMemory(device, buffer.memory, nullptr);
+    }
+    buffer = {VK_NULL_HANDLE, VK_NULL_HANDLE, 0, nullptr, false};
+}
+
+void Vulkan::FlushBuffer(VkDevice device, const Buffer& buffer)
+{
+    if (buffer.coherent || !buffer.mapped)
+    {
+        return;
+    }
+
+    //flushing the whole allocation avoids aligning ranges to nonCoherentAtomSize
+    VkMappedMemoryRange range = {
+        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        .memory = buffer.memory,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+    };
+    vkFlushMappedMemoryRanges(device, 1, &range);
+}
+
+void Vulkan::InvalidateBuffer(VkDevice device, const Buffer& buffer)
+{
+    if (buffer.coherent || !buffer.mapped)
+    {
+        return;
+    }
+
+    VkMappedMemoryRange range = {
+        .sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+        .memory = buffer.memory,
+        .offset = 0,
+        .size = VK_WHOLE_SIZE,
+    };
+    vkInvalidateMappedMemoryRanges(device, 1, &range);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+namespace Vulkan
+{
+	struct Buffer
+	{
+		VkBuffer buffer;
+		VkDeviceMemory memory;
+		VkDeviceSize size;
+		void* mapped;   // non-null for host visible buffers, mapped for their whole life
+		bool coherent;
+	};
+
+	// -1 when no memory type in 'typeBits' has all of 'flags'
+	int FindMemoryType(const VkPhysicalDeviceMemoryProperties& properties, uint32_t typeBits, VkMemoryPropertyFlags flags);
+
+	// host visible memory is mapped right away; coherent memory is preferred when it exists
+	bool CreateBuffer(VkDevice device, const VkPhysicalDeviceMemoryProperties& properties, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags flags, Buffer& buffer);
+	void DestroyBuffer(VkDevice device, Buffer& buffer);
+
+	// makes host writes visible to the device, a no-op for coherent memory
+	void FlushBuffer(VkDevice device, const Buffer& buffer);
+	// makes device writes visible to the host, a no-op for coherent memory
+	void InvalidateBuffer(VkDevice device, const Buffer& buffer);
+}
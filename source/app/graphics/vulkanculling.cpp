@@ -0,0 +1,345 @@
+#include "vulkanculling.h"
+#include "vulkandescriptors.h"
+#include "utils/log.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace {
+    const uint32_t g_WorkGroupSize = 64;
+
+    // matches the push constant block of cull.comp
+    struct CullConstants
+    {
+        float planes[6][4];
+        uint32_t count;
+        uint32_t compact;
+    };
+
+    bool drawLess(const Culling::DrawCommand& a, const Culling::DrawCommand& b)
+    {
+        if (a.firstIndex != b.firstIndex) return a.firstIndex < b.firstIndex;
+        if (a.vertexOffset != b.vertexOffset) return a.vertexOffset < b.vertexOffset;
+        if (a.firstInstance != b.firstInstance) return a.firstInstance < b.firstInstance;
+        if (a.indexCount != b.indexCount) return a.indexCount < b.indexCount;
+        return a.instanceCount < b.instanceCount;
+    }
+}
+
+Vulkan::IndirectCuller::IndirectCuller(VkDevice device, VkPhysicalDevice physicalDevice, const VkPhysicalDeviceFeatures& enabledFeatures, DescriptorAllocator& descriptors, uint32_t framesInFlight, uint32_t maxDraws)
+: m_Device(device)
+, m_MultiDrawIndirect(enabledFeatures.multiDrawIndirect == VK_TRUE)
+, m_Descriptors(descriptors)
+, m_FramesInFlight(framesInFlight)
+, m_MaxDraws(maxDraws)
+, m_Mode(Mode::Gpu)
+, m_SetLayout(VK_NULL_HANDLE)
+, m_PipelineLayout(VK_NULL_HANDLE)
+, m_Pipeline(VK_NULL_HANDLE)
+, m_Bounds()
+, m_Draws()
+, m_DrawCount(0)
+{
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_MemoryProperties);
+
+#ifdef VK_KHR_draw_indirect_count
+    //only non-null when the device was created with the extension
+    m_DrawIndexedIndirectCount = (PFN_vkCmdDrawIndexedIndirectCountKHR)vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR");
+#endif
+}
+
+Vulkan::IndirectCuller::~IndirectCuller()
+{
+    Destroy();
+}
+
+bool Vulkan::IndirectCuller::Initialize(const std::vector<char>& computeCode)
+{
+    //mobile GPUs share memory with the CPU, so everything stays host visible: the
+    //CPU fallback writes the indirect buffer directly and Validate reads it back
+    const VkBufferUsageFlags indirectUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT;
+    bool created = CreateBuffer(m_Device, m_MemoryProperties, m_MaxDraws * sizeof(Culling::Bounds), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, m_Bounds)
+                && CreateBuffer(m_Device, m_MemoryProperties, m_MaxDraws * sizeof(Culling::DrawCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, m_Draws);
+
+    m_Frames.resize(m_FramesInFlight);
+    for (Frame& frame : m_Frames)
+    {
+        frame.cpuVisible = 0;
+        created = created
+            && CreateBuffer(m_Device, m_MemoryProperties, m_MaxDraws * sizeof(Culling::DrawCommand), indirectUsage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, frame.visible)
+            && CreateBuffer(m_Device, m_MemoryProperties, sizeof(uint32_t), indirectUsage | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, frame.count);
+    }
+
+    if (!created)
+    {
+        LOGE("Culling: failed to create the buffers");
+        return false;
+    }
+
+    m_SetLayout = m_Descriptors.GetLayout({
+        {0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        {1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        {2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+        {3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr},
+    });
+
+    VkPushConstantRange constantRange = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset = 0,
+        .size = sizeof(CullConstants),
+    };
+
+    VkPipelineLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &m_SetLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &constantRange,
+    };
+
+    if (m_SetLayout == VK_NULL_HANDLE || vkCreatePipelineLayout(m_Device, &layoutInfo, nullptr, &m_PipelineLayout) != VK_SUCCESS)
+    {
+        LOGE("Culling: failed to create the pipeline layout");
+        return false;
+    }
+
+    VkShaderModuleCreateInfo moduleInfo = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize = computeCode.size(),
+        .pCode = reinterpret_cast<const uint32_t*>(computeCode.data()),
+    };
+
+    VkShaderModule computeModule;
+    if (vkCreateShaderModule(m_Device, &moduleInfo, nullptr, &computeModule) != VK_SUCCESS)
+    {
+        LOGE("Culling: unable to create the compute shader module");
+        return false;
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = computeModule,
+            .pName = "main",
+        },
+        .layout = m_PipelineLayout,
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex = -1,
+    };
+
+    bool pipelineCreated = vkCreateComputePipelines(m_Device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_Pipeline) == VK_SUCCESS;
+    vkDestroyShaderModule(m_Device, computeModule, nullptr);
+
+    if (!pipelineCreated)
+    {
+        LOGE("Culling: failed to create the compute pipeline");
+        m_Pipeline = VK_NULL_HANDLE;
+        return false;
+    }
+
+    LOGI("Culling: %s, %s", Compacting() ? "compacting with draw count" : "zeroing culled draws",
+         m_MultiDrawIndirect ? "multi draw indirect" : "one indirect draw per call");
+    return true;
+}
+
+void Vulkan::IndirectCuller::Destroy()
+{
+    if (m_Pipeline != VK_NULL_HANDLE)
+    {
+        vkDestroyPipeline(m_Device, m_Pipeline, nullptr);
+        m_Pipeline = VK_NULL_HANDLE;
+    }
+
+    if (m_PipelineLayout != VK_NULL_HANDLE)
+    {
+        vkDestroyPipelineLayout(m_Device, m_PipelineLayout, nullptr);
+        m_PipelineLayout = VK_NULL_HANDLE;
+    }
+
+    for (Frame& frame : m_Frames)
+    {
+        DestroyBuffer(m_Device, frame.visible);
+        DestroyBuffer(m_Device, frame.count);
+    }
+    m_Frames.clear();
+
+    if (m_Bounds.buffer != VK_NULL_HANDLE)
+    {
+        DestroyBuffer(m_Device, m_Bounds);
+    }
+    if (m_Draws.buffer != VK_NULL_HANDLE)
+    {
+        DestroyBuffer(m_Device, m_Draws);
+    }
+
+    //the set layout belongs to the descriptor allocator
+    m_SetLayout = VK_NULL_HANDLE;
+    m_DrawCount = 0;
+}
+
+void Vulkan::IndirectCuller::SetDraws(const Culling::Bounds* bounds, const Culling::DrawCommand* draws, uint32_t count)
+{
+    if (count > m_MaxDraws)
+    {
+        LOGW("Culling: %u draws, only %u fit", count, m_MaxDraws);
+        count = m_MaxDraws;
+    }
+
+    std::memcpy(m_Bounds.mapped, bounds, count * sizeof(Culling::Bounds));
+    std::memcpy(m_Draws.mapped, draws, count * sizeof(Culling::DrawCommand));
+    FlushBuffer(m_Device, m_Bounds);
+    FlushBuffer(m_Device, m_Draws);
+    m_DrawCount = count;
+}
+
+void Vulkan::IndirectCuller::SetMode(Mode mode)
+{
+    m_Mode = mode;
+}
+
+Vulkan::IndirectCuller::Mode Vulkan::IndirectCuller::GetMode() const
+{
+    return m_Mode;
+}
+
+bool Vulkan::IndirectCuller::Compacting() const
+{
+#ifdef VK_KHR_draw_indirect_count
+    return m_DrawIndexedIndirectCount != nullptr;
+#else
+    return false;
+#endif
+}
+
+void Vulkan::IndirectCuller::RecordCull(VkCommandBuffer commandBuffer, uint32_t frame, const Culling::Frustum& frustum)
+{
+    Frame& current = m_Frames[frame % m_Frames.size()];
+
+    if (m_Mode == Mode::Cpu)
+    {
+        //the GPU is done with this frame's buffers once its fence has signalled
+        Culling::DrawCommand* visible = static_cast<Culling::DrawCommand*>(current.visible.mapped);
+        current.cpuVisible = Culling::Cull(frustum, static_cast<const Culling::Bounds*>(m_Bounds.mapped),
+                                           static_cast<const Culling::DrawCommand*>(m_Draws.mapped), m_DrawCount, visible);
+        std::memcpy(current.count.mapped, &current.cpuVisible, sizeof(uint32_t));
+        FlushBuffer(m_Device, current.visible);
+        FlushBuffer(m_Device, current.count);
+        return;
+    }
+
+    if (m_DrawCount == 0)
+    {
+        return;
+    }
+
+    VkDescriptorSet set = m_Descriptors.GetPersistent(m_SetLayout, {
+        BufferBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_Bounds.buffer, 0, VK_WHOLE_SIZE),
+        BufferBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, m_Draws.buffer, 0, VK_WHOLE_SIZE),
+        BufferBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, current.visible.buffer, 0, VK_WHOLE_SIZE),
+        BufferBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, current.count.buffer, 0, VK_WHOLE_SIZE),
+    });
+    m_Descriptors.Flush();
+
+    vkCmdFillBuffer(commandBuffer, current.count.buffer, 0, sizeof(uint32_t), 0);
+
+    VkMemoryBarrier clearBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+    CullConstants constants;
+    std::memcpy(constants.planes, frustum.planes, sizeof(constants.planes));
+    constants.count = m_DrawCount;
+    constants.compact = Compacting() ? 1 : 0;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_Pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_PipelineLayout, 0, 1, &set, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+    vkCmdDispatch(commandBuffer, (m_DrawCount + g_WorkGroupSize - 1) / g_WorkGroupSize, 1, 1);
+
+    //the draws read what the dispatch wrote; host read is for Validate
+    VkMemoryBarrier cullBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT,
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &cullBarrier, 0, nullptr, 0, nullptr);
+}
+
+void Vulkan::IndirectCuller::RecordDraws(VkCommandBuffer commandBuffer, uint32_t frame)
+{
+    const Frame& current = m_Frames[frame % m_Frames.size()];
+    const uint32_t stride = sizeof(Culling::DrawCommand);
+
+#ifdef VK_KHR_draw_indirect_count
+    if (m_Mode == Mode::Gpu && Compacting())
+    {
+        m_DrawIndexedIndirectCount(commandBuffer, current.visible.buffer, 0, current.count.buffer, 0, m_DrawCount, stride);
+        return;
+    }
+#endif
+
+    //the CPU knows how many survived, the non-compacting shader leaves every slot in place
+    uint32_t drawCount = m_Mode == Mode::Cpu ? current.cpuVisible : m_DrawCount;
+    if (drawCount == 0)
+    {
+        return;
+    }
+
+    if (m_MultiDrawIndirect)
+    {
+        vkCmdDrawIndexedIndirect(commandBuffer, current.visible.buffer, 0, drawCount, stride);
+        return;
+    }
+
+    for (uint32_t i = 0; i < drawCount; ++i)
+    {
+        vkCmdDrawIndexedIndirect(commandBuffer, current.visible.buffer, VkDeviceSize(i) * stride, 1, stride);
+    }
+}
+
+uint32_t Vulkan::IndirectCuller::Validate(uint32_t frame, const Culling::Frustum& frustum)
+{
+    const Frame& current = m_Frames[frame % m_Frames.size()];
+    InvalidateBuffer(m_Device, current.visible);
+    InvalidateBuffer(m_Device, current.count);
+
+    const Culling::DrawCommand* output = static_cast<const Culling::DrawCommand*>(current.visible.mapped);
+    std::vector<Culling::DrawCommand> gpu;
+    if (m_Mode == Mode::Gpu && Compacting())
+    {
+        uint32_t count = std::min(*static_cast<const uint32_t*>(current.count.mapped), m_DrawCount);
+        gpu.assign(output, output + count);
+    }
+    else
+    {
+        uint32_t count = m_Mode == Mode::Cpu ? current.cpuVisible : m_DrawCount;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (output[i].instanceCount != 0)
+                gpu.push_back(output[i]);
+        }
+    }
+
+    std::vector<Culling::DrawCommand> reference(m_DrawCount);
+    reference.resize(Culling::CullScalar(frustum, static_cast<const Culling::Bounds*>(m_Bounds.mapped),
+                                         static_cast<const Culling::DrawCommand*>(m_Draws.mapped), m_DrawCount, reference.data()));
+    reference.erase(std::remove_if(reference.begin(), reference.end(), [](const Culling::DrawCommand& draw) { return draw.instanceCount == 0; }), reference.end());
+
+    //compaction order depends on the order the invocations ran in
+    std::sort(gpu.begin(), gpu.end(), drawLess);
+    std::sort(reference.begin(), reference.end(), drawLess);
+
+    std::vector<Culling::DrawCommand> difference;
+    std::set_symmetric_difference(gpu.begin(), gpu.end(), reference.begin(), reference.end(), std::back_inserter(difference), drawLess);
+
+    if (!difference.empty())
+    {
+        LOGW("Culling: %u of %u draws differ from the CPU reference", (unsigned)difference.size(), m_DrawCount);
+    }
+    return (uint32_t)difference.size();
+}
@@ -0,0 +1,88 @@
+/* GPU-driven indirect drawing
+ *
+ * Object bounds and their draw commands live in storage buffers; cull.comp
+ * tests every sphere against the frustum and appends the visible draws to an
+ * indirect buffer, which one vkCmdDrawIndexedIndirectCountKHR consumes
+ * without the CPU ever seeing the result.
+ *
+ * Without VK_KHR_draw_indirect_count the shader keeps every draw in place
+ * and zeroes the instance count of the culled ones instead. In Cpu mode the
+ * same buffer is filled by Culling::Cull, which is also what Validate checks
+ * the GPU output against.
+ *
+ * Draws with a non-zero firstInstance need the drawIndirectFirstInstance
+ * feature; without multiDrawIndirect every draw is issued on its own.
+ */
+#pragma once
+
+#include "culling.h"
+#include "vulkanbuffer.h"
+#include <vulkan/vulkan.h>
+#include <vector>
+
+namespace Vulkan
+{
+	class DescriptorAllocator;
+
+	class IndirectCuller
+	{
+	public:
+		enum class Mode
+		{
+			Gpu,
+			Cpu
+		};
+
+		IndirectCuller(VkDevice device, VkPhysicalDevice physicalDevice, const VkPhysicalDeviceFeatures& enabledFeatures, DescriptorAllocator& descriptors, uint32_t framesInFlight, uint32_t maxDraws);
+		~IndirectCuller();
+
+		bool Initialize(const std::vector<char>& computeCode);
+		void Destroy();
+
+		// bounds[i] belongs to draws[i]; only while none of the culler's frames are in flight
+		void SetDraws(const Culling::Bounds* bounds, const Culling::DrawCommand* draws, uint32_t count);
+
+		void SetMode(Mode mode);
+		Mode GetMode() const;
+
+		// outside of a render pass
+		void RecordCull(VkCommandBuffer commandBuffer, uint32_t frame, const Culling::Frustum& frustum);
+		// inside a render pass, with the pipeline, vertex and index buffers bound
+		void RecordDraws(VkCommandBuffer commandBuffer, uint32_t frame);
+
+		// once the frame's commands have completed: how many draws the GPU got
+		// wrong compared to the CPU reference (spheres touching a plane may differ)
+		uint32_t Validate(uint32_t frame, const Culling::Frustum& frustum);
+
+	private:
+		bool Compacting() const;
+
+		VkDevice m_Device;
+		VkPhysicalDeviceMemoryProperties m_MemoryProperties;
+		bool m_MultiDrawIndirect;
+		DescriptorAllocator& m_Descriptors;
+		uint32_t m_FramesInFlight;
+		uint32_t m_MaxDraws;
+		Mode m_Mode;
+
+#ifdef VK_KHR_draw_indirect_count
+		PFN_vkCmdDrawIndexedIndirectCountKHR m_DrawIndexedIndirectCount;
+#endif
+
+		VkDescriptorSetLayout m_SetLayout;
+		VkPipelineLayout m_PipelineLayout;
+		VkPipeline m_Pipeline;
+
+		Buffer m_Bounds;
+		Buffer m_Draws;
+		uint32_t m_DrawCount;
+
+		struct Frame
+		{
+			Buffer visible;
+			Buffer count;
+			uint32_t cpuVisible;
+		};
+		std::vector<Frame> m_Frames;
+	};
+}
@@ -0,0 +1,590 @@
+#include "vulkandescriptors.h"
+#include "utils/log.h"
+#include <cstring>
+
+namespace {
+    const uint32_t g_SetsPerPool = 256;
+
+    // how many descriptors of each type a pool gets, per set
+    const struct {
+        VkDescriptorType type;
+        float perSet;
+    } g_PoolRatios[] = {
+        {VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f},
+        {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1.0f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0.5f},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f},
+        {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f},
+        {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+        {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 0.5f},
+    };
+
+    bool isImageDescriptor(VkDescriptorType type)
+    {
+        return type == VK_DESCRIPTOR_TYPE_SAMPLER
+            || type == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+            || type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE
+            || type == VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+            || type == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+    }
+
+    // Vulkan handles are pointers on 64 bit and uint64_t on 32 bit
+    template <typename T>
+    uint64_t handleToKey(T handle)
+    {
+        uint64_t key = 0;
+        std::memcpy(&key, &handle, sizeof(handle) < sizeof(key) ? sizeof(handle) : sizeof(key));
+        return key;
+    }
+}
+
+Vulkan::DescriptorBinding Vulkan::BufferBinding(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+{
+    DescriptorBinding result = {};
+    result.binding = binding;
+    result.type = type;
+    result.buffer = buffer;
+    result.offset = offset;
+    result.range = range;
+    return result;
+}
+
+Vulkan::DescriptorBinding Vulkan::ImageBinding(uint32_t binding, VkDescriptorType type, VkImageView view, VkSampler sampler, VkImageLayout layout)
+{
+    DescriptorBinding result = {};
+    result.binding = binding;
+    result.type = type;
+    result.view = view;
+    result.sampler = sampler;
+    result.layout = layout;
+    return result;
+}
+
+Vulkan::DescriptorAllocator::DescriptorAllocator(VkDevice device, uint32_t framesInFlight)
+    : m_Device(device)
+    , m_Frames(framesInFlight)
+    , m_Frame(0)
+    , m_Stats()
+{
+    for (auto& frame : m_Frames)
+    {
+        frame.current = 0;
+    }
+    m_Persistent.current = 0;
+}
+
+Vulkan::DescriptorAllocator::~DescriptorAllocator()
+{
+    Destroy();
+}
+
+void Vulkan::DescriptorAllocator::Destroy()
+{
+    for (auto& frame : m_Frames)
+    {
+        DestroyChain(frame);
+    }
+    DestroyChain(m_Persistent);
+    m_PersistentSets.clear();
+    m_PendingWrites.clear();
+
+    for (auto& layout : m_Layouts)
+    {
+        vkDestroyDescriptorSetLayout(m_Device, layout.second, nullptr);
+    }
+    m_Layouts.clear();
+}
+
+VkDescriptorSetLayout Vulkan::DescriptorAllocator::GetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+{
+    std::vector<uint32_t> key;
+    for (const auto& binding : bindings)
+    {
+        key.push_back(binding.binding);
+        key.push_back((uint32_t)binding.descriptorType);
+        key.push_back(binding.descriptorCount);
+        key.push_back(binding.stageFlags);
+    }
+
+    auto cached = m_Layouts.find(key);
+    if (cached != m_Layouts.end())
+    {
+        return cached->second;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = (uint32_t)bindings.size(),
+        .pBindings = bindings.data(),
+    };
+
+    VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+    if (vkCreateDescriptorSetLayout(m_Device, &layoutInfo, nullptr, &layout) != VK_SUCCESS)
+    {
+        LOGE("failed to create descriptor set layout!");
+        return VK_NULL_HANDLE;
+    }
+
+    m_Layouts[key] = layout;
+    return layout;
+}
+
+VkDescriptorPool Vulkan::DescriptorAllocator::CreatePool()
+{
+    std::vector<VkDescriptorPoolSize> sizes;
+    for (const auto& ratio : g_PoolRatios)
+    {
+        sizes.push_back({ratio.type, (uint32_t)(ratio.perSet * g_SetsPerPool)});
+    }
+
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags = 0,
+        .maxSets = g_SetsPerPool,
+        .poolSizeCount = (uint32_t)sizes.size(),
+        .pPoolSizes = sizes.data(),
+    };
+
+    VkDescriptorPool pool = VK_NULL_HANDLE;
+    if (vkCreateDescriptorPool(m_Device, &poolInfo, nullptr, &pool) != VK_SUCCESS)
+    {
+        LOGE("failed to create descriptor pool!");
+        return VK_NULL_HANDLE;
+    }
+
+    m_Stats.pools++;
+    return pool;
+}
+
+VkDescriptorSet Vulkan::DescriptorAllocator::Allocate(PoolChain& chain, VkDescriptorSetLayout layout)
+{
+    //try the current pool, then move on to the next one (creating it if needed)
+    while (true)
+    {
+        if (chain.current >= chain.pools.size())
+        {
+            VkDescriptorPool pool = CreatePool();
+            if (pool == VK_NULL_HANDLE)
+            {
+                return VK_NULL_HANDLE;
+            }
+            chain.pools.push_back(pool);
+        }
+
+        VkDescriptorSetAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+            .descriptorPool = chain.pools[chain.current],
+            .descriptorSetCount = 1,
+            .pSetLayouts = &layout,
+        };
+
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        VkResult result = vkAllocateDescriptorSets(m_Device, &allocInfo, &set);
+        if (result == VK_SUCCESS)
+        {
+            return set;
+        }
+
+        if (result != VK_ERROR_OUT_OF_POOL_MEMORY_KHR && result != VK_ERROR_FRAGMENTED_POOL)
+        {
+            LOGE("failed to allocate descriptor set: %d", (int)result);
+            return VK_NULL_HANDLE;
+        }
+
+        chain.current++;
+    }
+}
+
+void Vulkan::DescriptorAllocator::ResetChain(PoolChain& chain)
+{
+    //resetting a pool frees all of its sets at once, no vkFreeDescriptorSets per set
+    for (size_t i = 0; i < chain.pools.size() && i <= chain.current; ++i)
+    {
+        vkResetDescriptorPool(m_Device, chain.pools[i], 0);
+    }
+    chain.current = 0;
+}
+
+void Vulkan::DescriptorAllocator::DestroyChain(PoolChain& chain)
+{
+    for (auto pool : chain.pools)
+    {
+        vkDestroyDescriptorPool(m_Device, pool, nullptr);
+    }
+    chain.pools.clear();
+    chain.current = 0;
+}
+
+void Vulkan::DescriptorAllocator::BeginFrame(uint32_t frame)
+{
+    m_Frame = frame % m_Frames.size();
+    ResetChain(m_Frames[m_Frame]);
+
+    const uint32_t pools = m_Stats.pools;
+    m_Stats = DescriptorStats();
+    m_Stats.pools = pools;
+}
+
+VkDescriptorSet Vulkan::DescriptorAllocator::AllocateTransient(VkDescriptorSetLayout layout)
+{
+    m_Stats.transientSets++;
+    return Allocate(m_Frames[m_Frame], layout);
+}
+
+VkDescriptorSet Vulkan::DescriptorAllocator::GetPersistent(VkDescriptorSetLayout layout, const std::vector<DescriptorBinding>& bindings)
+{
+    std::vector<uint64_t> key;
+    key.push_back(handleToKey(layout));
+    for (const auto& binding : bindings)
+    {
+        key.push_back(((uint64_t)binding.binding << 32) | binding.arrayElement);
+        key.push_back((uint64_t)binding.type);
+        key.push_back(handleToKey(binding.buffer));
+        key.push_back(binding.offset);
+        key.push_back(binding.range);
+        key.push_back(handleToKey(binding.view));
+        key.push_back(handleToKey(binding.sampler));
+        key.push_back((uint64_t)binding.layout);
+    }
+
+    auto cached = m_PersistentSets.find(key);
+    if (cached != m_PersistentSets.end())
+    {
+        m_Stats.persistentHits++;
+        return cached->second;
+    }
+
+    m_Stats.persistentMisses++;
+    VkDescriptorSet set = Allocate(m_Persistent, layout);
+    if (set == VK_NULL_HANDLE)
+    {
+        return VK_NULL_HANDLE;
+    }
+
+    for (const auto& binding : bindings)
+    {
+        Write(set, binding);
+    }
+
+    m_PersistentSets[key] = set;
+    return set;
+}
+
+void Vulkan::DescriptorAllocator::ResetPersistent()
+{
+    ResetChain(m_Persistent);
+    m_PersistentSets.clear();
+}
+
+void Vulkan::DescriptorAllocator::Write(VkDescriptorSet set, const DescriptorBinding& binding)
+{
+    m_PendingWrites.push_back({set, binding});
+}
+
+void Vulkan::DescriptorAllocator::Flush()
+{
+    if (m_PendingWrites.empty())
+    {
+        return;
+    }
+
+    //the info arrays are complete before any pointer into them is taken
+    std::vector<VkDescriptorBufferInfo> bufferInfos;
+    std::vector<VkDescriptorImageInfo> imageInfos;
+    for (const auto& pending : m_PendingWrites)
+    {
+        const DescriptorBinding& binding = pending.binding;
+        if (isImageDescriptor(binding.type))
+        {
+            imageInfos.push_back({binding.sampler, binding.view, binding.layout});
+        }
+        else
+        {
+            bufferInfos.push_back({binding.buffer, binding.offset, binding.range});
+        }
+    }
+
+    std::vector<VkWriteDescriptorSet> writes;
+    size_t bufferIndex = 0;
+    size_t imageIndex = 0;
+    for (const auto& pending : m_PendingWrites)
+    {
+        const DescriptorBinding& binding = pending.binding;
+        const bool image = isImageDescriptor(binding.type);
+
+        VkWriteDescriptorSet write = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = pending.set,
+            .dstBinding = binding.binding,
+            .dstArrayElement = binding.arrayElement,
+            .descriptorCount = 1,
+            .descriptorType = binding.type,
+            .pImageInfo = image ? &imageInfos[imageIndex++] : nullptr,
+            .pBufferInfo = image ? nullptr : &bufferInfos[bufferIndex++],
+            .pTexelBufferView = nullptr,
+        };
+        writes.push_back(write);
+    }
+
+    vkUpdateDescriptorSets(m_Device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+    m_Stats.updateCalls++;
+    m_Stats.writes += (uint32_t)writes.size();
+    m_PendingWrites.clear();
+}
+
+const Vulkan::DescriptorStats& Vulkan::DescriptorAllocator::Stats() const
+{
+    return m_Stats;
+}
+
+bool Vulkan::BindlessTextures::Supported(VkInstance instance, VkPhysicalDevice physicalDevice)
+{
+#ifdef VK_EXT_descriptor_indexing
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> extensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, extensions.data());
+
+    bool hasExtension = false;
+    for (const auto& extension : extensions)
+    {
+        if (strcmp(extension.extensionName, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME) == 0)
+        {
+            hasExtension = true;
+        }
+    }
+    if (!hasExtension)
+    {
+        return false;
+    }
+
+    auto getFeatures2 = (PFN_vkGetPhysicalDeviceFeatures2KHR) vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceFeatures2KHR");
+    if (getFeatures2 == nullptr)
+    {
+        return false;
+    }
+
+    VkPhysicalDeviceDescriptorIndexingFeaturesEXT indexingFeatures = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT,
+    };
+    VkPhysicalDeviceFeatures2KHR features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2_KHR,
+        .pNext = &indexingFeatures,
+    };
+    getFeatures2(physicalDevice, &features);
+
+    return indexingFeatures.runtimeDescriptorArray
+        && indexingFeatures.descriptorBindingPartiallyBound
+        && indexingFeatures.descriptorBindingSampledImageUpdateAfterBind
+        && indexingFeatures.descriptorBindingUpdateUnusedWhilePending
+        && indexingFeatures.shaderSampledImageArrayNonUniformIndexing;
+#else
+    return false;
+#endif
+}
+
+Vulkan::BindlessTextures::BindlessTextures(VkDevice device, uint32_t capacity, uint32_t framesInFlight)
+    : m_Device(device)
+    , m_Capacity(capacity)
+    , m_Layout(VK_NULL_HANDLE)
+    , m_Pool(VK_NULL_HANDLE)
+    , m_Set(VK_NULL_HANDLE)
+    , m_NextIndex(0)
+    , m_Used(capacity, false)
+    , m_Retired(framesInFlight > 0 ? framesInFlight : 1)
+    , m_Frame(0)
+{
+}
+
+Vulkan::BindlessTextures::~BindlessTextures()
+{
+    Destroy();
+}
+
+bool Vulkan::BindlessTextures::Initialize()
+{
+#ifdef VK_EXT_descriptor_indexing
+    VkDescriptorSetLayoutBinding binding = {
+        .binding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+        .descriptorCount = m_Capacity,
+        .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT,
+        .pImmutableSamplers = nullptr,
+    };
+
+    //slots may be empty, and the ones no frame in flight uses may be written while those frames are pending
+    VkDescriptorBindingFlagsEXT bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT
+        | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT bindingFlagsInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT,
+        .bindingCount = 1,
+        .pBindingFlags = &bindingFlags,
+    };
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext = &bindingFlagsInfo,
+        .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT,
+        .bindingCount = 1,
+        .pBindings = &binding,
+    };
+
+    if (vkCreateDescriptorSetLayout(m_Device, &layoutInfo, nullptr, &m_Layout) != VK_SUCCESS)
+    {
+        LOGE("failed to create bindless descriptor set layout!");
+        return false;
+    }
+
+    VkDescriptorPoolSize poolSize = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_Capacity};
+    VkDescriptorPoolCreateInfo poolInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT,
+        .maxSets = 1,
+        .poolSizeCount = 1,
+        .pPoolSizes = &poolSize,
+    };
+
+    if (vkCreateDescriptorPool(m_Device, &poolInfo, nullptr, &m_Pool) != VK_SUCCESS)
+    {
+        LOGE("failed to create bindless descriptor pool!");
+        return false;
+    }
+
+    VkDescriptorSetAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = m_Pool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &m_Layout,
+    };
+
+    if (vkAllocateDescriptorSets(m_Device, &allocInfo, &m_Set) != VK_SUCCESS)
+    {
+        LOGE("failed to allocate bindless descriptor set!");
+        return false;
+    }
+
+    LOGI("Bindless textures: %u slots", m_Capacity);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void Vulkan::BindlessTextures::Destroy()
+{
+    if (m_Pool != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorPool(m_Device, m_Pool, nullptr);
+        m_Pool = VK_NULL_HANDLE;
+        m_Set = VK_NULL_HANDLE;
+    }
+    if (m_Layout != VK_NULL_HANDLE)
+    {
+        vkDestroyDescriptorSetLayout(m_Device, m_Layout, nullptr);
+        m_Layout = VK_NULL_HANDLE;
+    }
+
+    m_FreeIndices.clear();
+    m_NextIndex = 0;
+    m_Used.assign(m_Capacity, false);
+    for (auto& retired : m_Retired)
+    {
+        retired.clear();
+    }
+    m_PendingInfos.clear();
+    m_PendingIndices.clear();
+}
+
+void Vulkan::BindlessTextures::BeginFrame(uint32_t frame)
+{
+    m_Frame = frame % m_Retired.size();
+    std::vector<uint32_t>& retired = m_Retired[m_Frame];
+    m_FreeIndices.insert(m_FreeIndices.end(), retired.begin(), retired.end());
+    retired.clear();
+}
+
+uint32_t Vulkan::BindlessTextures::Add(VkImageView view, VkSampler sampler)
+{
+    uint32_t index = InvalidIndex;
+    if (!m_FreeIndices.empty())
+    {
+        index = m_FreeIndices.back();
+        m_FreeIndices.pop_back();
+    }
+    else if (m_NextIndex < m_Capacity)
+    {
+        index = m_NextIndex++;
+    }
+    else
+    {
+        LOGE("Bindless textures: out of slots");
+        return InvalidIndex;
+    }
+
+    m_Used[index] = true;
+    m_PendingInfos.push_back({sampler, view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+    m_PendingIndices.push_back(index);
+    return index;
+}
+
+void Vulkan::BindlessTextures::Remove(uint32_t index)
+{
+    if (index >= m_NextIndex || !m_Used[index])
+    {
+        LOGW("Bindless textures: slot %u removed but not in use", index);
+        return;
+    }
+    m_Used[index] = false;
+
+    //a write still queued for it would point the slot at a view that may be destroyed next
+    for (size_t i = m_PendingIndices.size(); i-- > 0;)
+    {
+        if (m_PendingIndices[i] == index)
+        {
+            m_PendingIndices.erase(m_PendingIndices.begin() + i);
+            m_PendingInfos.erase(m_PendingInfos.begin() + i);
+        }
+    }
+
+    //partially bound: the stale descriptor is never read once nobody uses the index,
+    //but frames in flight may still sample it, so it isn't rewritten before they are done
+    m_Retired[m_Frame].push_back(index);
+}
+
+void Vulkan::BindlessTextures::Flush()
+{
+    if (m_PendingIndices.empty())
+    {
+        return;
+    }
+
+    std::vector<VkWriteDescriptorSet> writes;
+    for (size_t i = 0; i < m_PendingIndices.size(); ++i)
+    {
+        VkWriteDescriptorSet write = {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = m_Set,
+            .dstBinding = 0,
+            .dstArrayElement = m_PendingIndices[i],
+            .descriptorCount = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+            .pImageInfo = &m_PendingInfos[i],
+        };
+        writes.push_back(write);
+    }
+
+    vkUpdateDescriptorSets(m_Device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+    m_PendingInfos.clear();
+    m_PendingIndices.clear();
+}
+
+VkDescriptorSetLayout Vulkan::BindlessTextures::Layout()
+{
+    return m_Layout;
+}
+
+VkDescriptorSet Vulkan::BindlessTextures::Set()
+{
+    return m_Set;
+}
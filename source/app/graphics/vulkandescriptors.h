@@ -0,0 +1,146 @@
+/* Descriptor management
+ *
+ * Transient sets come from per-frame pools that are reset as a whole once the
+ * frame's fence has signalled; sets that describe the same resources every
+ * frame are cached. Writes are queued and go out in a single
+ * vkUpdateDescriptorSets per Flush, so the number of update calls per frame
+ * does not grow with the number of draws.
+ *
+ * With VK_EXT_descriptor_indexing, BindlessTextures keeps every texture in
+ * one big array that shaders index into, so most draws need no set at all.
+ */
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <map>
+
+namespace Vulkan
+{
+	struct DescriptorBinding
+	{
+		uint32_t binding;
+		uint32_t arrayElement;
+		VkDescriptorType type;
+
+		// buffers
+		VkBuffer buffer;
+		VkDeviceSize offset;
+		VkDeviceSize range;
+
+		// images
+		VkImageView view;
+		VkSampler sampler;
+		VkImageLayout layout;
+	};
+
+	DescriptorBinding BufferBinding(uint32_t binding, VkDescriptorType type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range);
+	DescriptorBinding ImageBinding(uint32_t binding, VkDescriptorType type, VkImageView view, VkSampler sampler, VkImageLayout layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+	struct DescriptorStats
+	{
+		uint32_t updateCalls;
+		uint32_t writes;
+		uint32_t transientSets;
+		uint32_t persistentHits;
+		uint32_t persistentMisses;
+		uint32_t pools;
+	};
+
+	class DescriptorAllocator
+	{
+	public:
+		DescriptorAllocator(VkDevice device, uint32_t framesInFlight);
+		~DescriptorAllocator();
+		void Destroy();
+
+		// layouts are cached, the allocator owns them
+		VkDescriptorSetLayout GetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+
+		// call once the fence of 'frame' has signalled: every transient set of that frame becomes invalid
+		void BeginFrame(uint32_t frame);
+		VkDescriptorSet AllocateTransient(VkDescriptorSetLayout layout);
+		// same layout and bindings give the same set, written only the first time
+		VkDescriptorSet GetPersistent(VkDescriptorSetLayout layout, const std::vector<DescriptorBinding>& bindings);
+		// drops all persistent sets, e.g. when the resources they point to are destroyed
+		void ResetPersistent();
+
+		void Write(VkDescriptorSet set, const DescriptorBinding& binding);
+		void Flush();
+
+		const DescriptorStats& Stats() const;
+
+	private:
+		struct PoolChain
+		{
+			std::vector<VkDescriptorPool> pools;
+			size_t current;
+		};
+
+		struct PendingWrite
+		{
+			VkDescriptorSet set;
+			DescriptorBinding binding;
+		};
+
+		VkDescriptorPool CreatePool();
+		VkDescriptorSet Allocate(PoolChain& chain, VkDescriptorSetLayout layout);
+		void ResetChain(PoolChain& chain);
+		void DestroyChain(PoolChain& chain);
+
+		VkDevice m_Device;
+		std::vector<PoolChain> m_Frames;
+		uint32_t m_Frame;
+		PoolChain m_Persistent;
+
+		std::map<std::vector<uint32_t>, VkDescriptorSetLayout> m_Layouts;
+		std::map<std::vector<uint64_t>, VkDescriptorSet> m_PersistentSets;
+		std::vector<PendingWrite> m_PendingWrites;
+		DescriptorStats m_Stats;
+	};
+
+	class BindlessTextures
+	{
+	public:
+		static const uint32_t InvalidIndex = 0xFFFFFFFF;
+
+		// needs VK_KHR_get_physical_device_properties2 on the instance; slots
+		// are written while frames using the set are in flight, so this needs
+		// descriptorBindingUpdateUnusedWhilePending too
+		static bool Supported(VkInstance instance, VkPhysicalDevice physicalDevice);
+
+		BindlessTextures(VkDevice device, uint32_t capacity, uint32_t framesInFlight);
+		~BindlessTextures();
+		bool Initialize();
+		void Destroy();
+
+		// call once the fence of 'frame' has signalled: the slots removed
+		// while it was recorded can be handed out again
+		void BeginFrame(uint32_t frame);
+		uint32_t Add(VkImageView view, VkSampler sampler);
+		// the slot is reused only after every frame in flight is done with it
+		void Remove(uint32_t index);
+		// writes everything added since the last flush with one update call
+		void Flush();
+
+		VkDescriptorSetLayout Layout();
+		VkDescriptorSet Set();
+
+	private:
+		VkDevice m_Device;
+		uint32_t m_Capacity;
+		VkDescriptorSetLayout m_Layout;
+		VkDescriptorPool m_Pool;
+		VkDescriptorSet m_Set;
+
+		std::vector<uint32_t> m_FreeIndices;
+		uint32_t m_NextIndex;
+		// per index, so a second Remove is caught
+		std::vector<bool> m_Used;
+		// removed per frame, freed when that frame comes around again
+		std::vector<std::vector<uint32_t> > m_Retired;
+		uint32_t m_Frame;
+		std::vector<VkDescriptorImageInfo> m_PendingInfos;
+		std::vector<uint32_t> m_PendingIndices;
+	};
+}
@@ -0,0 +1,898 @@
+#include "vulkanrenderer.h"
+#include "vulkandescriptors.h"
+#include "prerotation.h"
+#include "utils/log.h"
+#include "utils/vfs.h"
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+namespace {
+    bool createShaderModule(VkDevice device, const std::vector<char>& code, VkShaderModule& shaderModule)
+    {
+        VkShaderModuleCreateInfo createInfo = {
+            .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+            .codeSize = code.size(),
+            .pCode = reinterpret_cast<const uint32_t*>(code.data()),
+        };
+
+        return vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) == VK_SUCCESS;
+    }
+
+    //from whichever filesystem has it, the writable layer over the assets too
+    bool readShader(const std::string& path, std::vector<char>& code)
+    {
+        auto file = Vfs::Open<Vfs::VirtualFile>(path);
+        if (!file)
+        {
+            LOGE("Renderer: no shader %s", path.c_str());
+            return false;
+        }
+        const int64_t size = file->Size();
+        code.resize(size > 0 ? size_t(size) : 0);
+        return !code.empty() && file->ReadAt(0, code.data(), size) == size;
+    }
+
+    VkPipelineColorBlendAttachmentState blendState(Renderer::Blend blend)
+    {
+        VkPipelineColorBlendAttachmentState state = {
+            .blendEnable = blend == Renderer::Blend::Opaque ? VK_FALSE : VK_TRUE,
+            .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
+            .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+            .colorBlendOp = VK_BLEND_OP_ADD,
+            .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+            .dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+            .alphaBlendOp = VK_BLEND_OP_ADD,
+            .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+        };
+
+        if (blend == Renderer::Blend::Additive)
+        {
+            state.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+            state.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        }
+
+        return state;
+    }
+
+    // one-off upload through a staging buffer; waits for the queue
+    bool uploadImage(const Vulkan::Context& context, const VkPhysicalDeviceMemoryProperties& memoryProperties,
+        VkImage image, uint32_t width, uint32_t height, const unsigned char* pixels)
+    {
+        Vulkan::Buffer staging;
+        VkDeviceSize size = VkDeviceSize(width) * height * 4;
+        if (!Vulkan::CreateBuffer(context.device, memoryProperties, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, staging))
+        {
+            return false;
+        }
+        std::memcpy(staging.mapped, pixels, size);
+        Vulkan::FlushBuffer(context.device, staging);
+
+        VkCommandBufferAllocateInfo commandInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = context.commandPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        };
+
+        VkCommandBuffer commandBuffer;
+        if (vkAllocateCommandBuffers(context.device, &commandInfo, &commandBuffer) != VK_SUCCESS)
+        {
+            Vulkan::DestroyBuffer(context.device, staging);
+            return false;
+        }
+
+        VkCommandBufferBeginInfo beginInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+            .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        };
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+        VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+        VkImageMemoryBarrier toTransfer = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = image,
+            .subresourceRange = range,
+        };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+        VkBufferImageCopy copy = {
+            .bufferOffset = 0,
+            .bufferRowLength = 0,
+            .bufferImageHeight = 0,
+            .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+            .imageOffset = {0, 0, 0},
+            .imageExtent = {width, height, 1},
+        };
+        vkCmdCopyBufferToImage(commandBuffer, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+
+        VkImageMemoryBarrier toShader = toTransfer;
+        toShader.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        toShader.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        toShader.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        toShader.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toShader);
+
+        vkEndCommandBuffer(commandBuffer);
+
+        VkSubmitInfo submitInfo = {
+            .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .commandBufferCount = 1,
+            .pCommandBuffers = &commandBuffer,
+        };
+
+        bool submitted = vkQueueSubmit(context.queue, 1, &submitInfo, VK_NULL_HANDLE) == VK_SUCCESS;
+        if (submitted)
+        {
+            vkQueueWaitIdle(context.queue);
+        }
+
+        vkFreeCommandBuffers(context.device, context.commandPool, 1, &commandBuffer);
+        Vulkan::DestroyBuffer(context.device, staging);
+        return submitted;
+    }
+}
+
+Renderer::VulkanBackend::VulkanBackend()
+    : m_Initialized(false)
+    , m_DeviceReady(false)
+    , m_Context()
+    , m_MemoryProperties()
+    , m_Sampler(VK_NULL_HANDLE)
+    , m_SetLayout(VK_NULL_HANDLE)
+    , m_PipelineLayout(VK_NULL_HANDLE)
+    , m_Frame(0)
+    , m_ListCount(0)
+    , m_Pass()
+{
+}
+
+Renderer::VulkanBackend::~VulkanBackend()
+{
+    Destroy();
+}
+
+Renderer::Api Renderer::VulkanBackend::GetApi() const
+{
+    return Api::Vulkan;
+}
+
+bool Renderer::VulkanBackend::Initialize(ANativeWindow* window)
+{
+    Vulkan::Hooks hooks;
+    hooks.deviceCreated = [this]() { OnDeviceCreated(); };
+    hooks.deviceDestroyed = [this]() { OnDeviceDestroyed(); };
+    hooks.swapchainDestroyed = [this]() { OnSwapchainDestroyed(); };
+    hooks.mainPass = [this](const Vulkan::MainPass& pass) { OnMainPass(pass); };
+    Vulkan::SetHooks(hooks);
+
+    if (!Vulkan::Initialize(window))
+    {
+        LOGE("Unable to initialize Vulkan!");
+        Vulkan::SetHooks(Vulkan::Hooks());
+        return false;
+    }
+
+    m_Initialized = true;
+    return true;
+}
+
+void Renderer::VulkanBackend::Destroy()
+{
+    if (!m_Initialized)
+    {
+        return;
+    }
+
+    //releases everything on the GPU through the device hook
+    Vulkan::Destroy();
+    Vulkan::SetHooks(Vulkan::Hooks());
+
+    m_Buffers = Slots<Buffer>();
+    m_Textures = Slots<Texture>();
+    m_Pipelines = Slots<Pipeline>();
+    m_Initialized = false;
+}
+
+void Renderer::VulkanBackend::ReleaseSurface()
+{
+    Vulkan::ReleaseSurface();
+}
+
+bool Renderer::VulkanBackend::AcquireSurface(ANativeWindow* window)
+{
+    Vulkan::ReAcquireSurface(window);
+    return m_DeviceReady;
+}
+
+void Renderer::VulkanBackend::OnDeviceCreated()
+{
+    m_Context = Vulkan::GetContext();
+    vkGetPhysicalDeviceMemoryProperties(m_Context.physicalDevice, &m_MemoryProperties);
+
+    m_SetLayout = m_Context.descriptors->GetLayout({
+        {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr},
+    });
+
+    VkPushConstantRange projectionRange = {
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .offset = 0,
+        .size = sizeof(float) * 16,
+    };
+
+    VkPipelineLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &m_SetLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &projectionRange,
+    };
+
+    if (m_SetLayout == VK_NULL_HANDLE || vkCreatePipelineLayout(m_Context.device, &layoutInfo, nullptr, &m_PipelineLayout) != VK_SUCCESS)
+    {
+        LOGE("Renderer: failed to create the pipeline layout");
+        return;
+    }
+
+    VkSamplerCreateInfo samplerInfo = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .maxLod = 16.0f,
+        .borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+    };
+
+    if (vkCreateSampler(m_Context.device, &samplerInfo, nullptr, &m_Sampler) != VK_SUCCESS)
+    {
+        LOGE("Renderer: failed to create the sampler");
+        return;
+    }
+
+    m_DeviceReady = true;
+
+    //everything created before (or kept through a lost surface) comes back
+    m_Buffers.ForEach([this](BufferId, Buffer& buffer) { Realize(buffer); });
+    m_Textures.ForEach([this](TextureId, Texture& texture) { Realize(texture); });
+}
+
+void Renderer::VulkanBackend::OnDeviceDestroyed()
+{
+    m_Buffers.ForEach([this](BufferId, Buffer& buffer) { Release(buffer); });
+    m_Textures.ForEach([this](TextureId, Texture& texture) { Release(texture); });
+    m_Pipelines.ForEach([this](PipelineId, Pipeline& pipeline) { Release(pipeline); });
+
+    if (m_Sampler != VK_NULL_HANDLE)
+    {
+        vkDestroySampler(m_Context.device, m_Sampler, nullptr);
+        m_Sampler = VK_NULL_HANDLE;
+    }
+    if (m_PipelineLayout != VK_NULL_HANDLE)
+    {
+        vkDestroyPipelineLayout(m_Context.device, m_PipelineLayout, nullptr);
+        m_PipelineLayout = VK_NULL_HANDLE;
+    }
+    //the descriptor allocator owns the set layout
+    m_SetLayout = VK_NULL_HANDLE;
+    m_DeviceReady = false;
+}
+
+void Renderer::VulkanBackend::OnSwapchainDestroyed()
+{
+    //built against the old render pass
+    m_Pipelines.ForEach([this](PipelineId, Pipeline& pipeline) { Release(pipeline); });
+}
+
+bool Renderer::VulkanBackend::Realize(Buffer& buffer)
+{
+    if (buffer.gpu.buffer != VK_NULL_HANDLE)
+    {
+        return true;
+    }
+
+    VkBufferUsageFlags usage = buffer.usage == BufferUsage::Index ? VK_BUFFER_USAGE_INDEX_BUFFER_BIT : VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+    VkDeviceSize size = VkDeviceSize(buffer.size) * (buffer.dynamic ? m_Context.framesInFlight : 1);
+    if (!Vulkan::CreateBuffer(m_Context.device, m_MemoryProperties, size, usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, buffer.gpu))
+    {
+        LOGE("Renderer: failed to create a %u byte buffer", buffer.size);
+        buffer.gpu = Vulkan::Buffer();
+        return false;
+    }
+
+    if (!buffer.dynamic)
+    {
+        std::memcpy(buffer.gpu.mapped, buffer.contents.data(), buffer.size);
+        Vulkan::FlushBuffer(m_Context.device, buffer.gpu);
+    }
+    return true;
+}
+
+void Renderer::VulkanBackend::Release(Buffer& buffer)
+{
+    if (buffer.gpu.buffer != VK_NULL_HANDLE)
+    {
+        Vulkan::DestroyBuffer(m_Context.device, buffer.gpu);
+        buffer.gpu = Vulkan::Buffer();
+    }
+}
+
+bool Renderer::VulkanBackend::Realize(Texture& texture)
+{
+    if (texture.view != VK_NULL_HANDLE)
+    {
+        return true;
+    }
+
+    VkImageCreateInfo imageInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .extent = {texture.width, texture.height, 1},
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+
+    if (vkCreateImage(m_Context.device, &imageInfo, nullptr, &texture.image) != VK_SUCCESS)
+    {
+        texture.image = VK_NULL_HANDLE;
+        LOGE("Renderer: failed to create a %ux%u image", texture.width, texture.height);
+        return false;
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(m_Context.device, texture.image, &requirements);
+    int memoryType = Vulkan::FindMemoryType(m_MemoryProperties, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    VkMemoryAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = requirements.size,
+        .memoryTypeIndex = (uint32_t)memoryType,
+    };
+
+    if (memoryType < 0 || vkAllocateMemory(m_Context.device, &allocInfo, nullptr, &texture.memory) != VK_SUCCESS)
+    {
+        texture.memory = VK_NULL_HANDLE;
+        Release(texture);
+        LOGE("Renderer: out of memory for a %ux%u image", texture.width, texture.height);
+        return false;
+    }
+    vkBindImageMemory(m_Context.device, texture.image, texture.memory, 0);
+
+    VkImageViewCreateInfo viewInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = texture.image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+
+    if (!uploadImage(m_Context, m_MemoryProperties, texture.image, texture.width, texture.height, texture.pixels.data())
+        || vkCreateImageView(m_Context.device, &viewInfo, nullptr, &texture.view) != VK_SUCCESS)
+    {
+        texture.view = VK_NULL_HANDLE;
+        Release(texture);
+        LOGE("Renderer: failed to upload a %ux%u image", texture.width, texture.height);
+        return false;
+    }
+    return true;
+}
+
+void Renderer::VulkanBackend::Release(Texture& texture)
+{
+    if (texture.view != VK_NULL_HANDLE)
+    {
+        vkDestroyImageView(m_Context.device, texture.view, nullptr);
+        texture.view = VK_NULL_HANDLE;
+    }
+    if (texture.image != VK_NULL_HANDLE)
+    {
+        vkDestroyImage(m_Context.device, texture.image, nullptr);
+        texture.image = VK_NULL_HANDLE;
+    }
+    if (texture.memory != VK_NULL_HANDLE)
+    {
+        vkFreeMemory(m_Context.device, texture.memory, nullptr);
+        texture.memory = VK_NULL_HANDLE;
+    }
+}
+
+bool Renderer::VulkanBackend::Realize(Pipeline& pipeline)
+{
+    if (pipeline.pipeline != VK_NULL_HANDLE)
+    {
+        return true;
+    }
+
+    VkShaderModule vertexModule = VK_NULL_HANDLE;
+    VkShaderModule fragmentModule = VK_NULL_HANDLE;
+    if (!createShaderModule(m_Context.device, pipeline.vertexCode, vertexModule) || !createShaderModule(m_Context.device, pipeline.fragmentCode, fragmentModule))
+    {
+        LOGE("Renderer: unable to create the shader modules of %s", pipeline.desc.shader.c_str());
+        vkDestroyShaderModule(m_Context.device, vertexModule, nullptr);
+        vkDestroyShaderModule(m_Context.device, fragmentModule, nullptr);
+        return false;
+    }
+
+    VkPipelineShaderStageCreateInfo stages[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vertexModule,
+            .pName = "main",
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = fragmentModule,
+            .pName = "main",
+        },
+    };
+
+    VkVertexInputBindingDescription binding = {0, sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX};
+    VkVertexInputAttributeDescription attributes[] = {
+        {0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, x)},
+        {1, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, u)},
+        {2, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(Vertex, color)},
+    };
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = 1,
+        .pVertexBindingDescriptions = &binding,
+        .vertexAttributeDescriptionCount = sizeof(attributes) / sizeof(attributes[0]),
+        .pVertexAttributeDescriptions = attributes,
+    };
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+        .primitiveRestartEnable = VK_FALSE,
+    };
+
+    //set per pass, so the pipeline outlives extent changes
+    VkPipelineViewportStateCreateInfo viewportState = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .scissorCount = 1,
+    };
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .depthClampEnable = VK_FALSE,
+        .rasterizerDiscardEnable = VK_FALSE,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .cullMode = VK_CULL_MODE_NONE,
+        .frontFace = VK_FRONT_FACE_CLOCKWISE,
+        .depthBiasEnable = VK_FALSE,
+        .lineWidth = 1.0f,
+    };
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+        .sampleShadingEnable = VK_FALSE,
+    };
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = blendState(pipeline.desc.blend);
+
+    VkPipelineColorBlendStateCreateInfo colorBlending = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+        .logicOpEnable = VK_FALSE,
+        .attachmentCount = 1,
+        .pAttachments = &colorBlendAttachment,
+    };
+
+    VkDynamicState dynamicStates[] = {
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR,
+    };
+
+    VkPipelineDynamicStateCreateInfo dynamicState = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+        .dynamicStateCount = 2,
+        .pDynamicStates = dynamicStates,
+    };
+
+    VkGraphicsPipelineCreateInfo pipelineInfo = {
+        .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+        .stageCount = 2,
+        .pStages = stages,
+        .pVertexInputState = &vertexInputInfo,
+        .pInputAssemblyState = &inputAssembly,
+        .pViewportState = &viewportState,
+        .pRasterizationState = &rasterizer,
+        .pMultisampleState = &multisampling,
+        .pColorBlendState = &colorBlending,
+        .pDynamicState = &dynamicState,
+        .layout = m_PipelineLayout,
+        .renderPass = m_Pass.renderPass,
+        .subpass = 0,
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex = -1,
+    };
+
+    bool created = vkCreateGraphicsPipelines(m_Context.device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline.pipeline) == VK_SUCCESS;
+    if (!created)
+    {
+        LOGE("Renderer: failed to create the %s pipeline", pipeline.desc.shader.c_str());
+        pipeline.pipeline = VK_NULL_HANDLE;
+    }
+
+    vkDestroyShaderModule(m_Context.device, vertexModule, nullptr);
+    vkDestroyShaderModule(m_Context.device, fragmentModule, nullptr);
+    return created;
+}
+
+void Renderer::VulkanBackend::Release(Pipeline& pipeline)
+{
+    if (pipeline.pipeline != VK_NULL_HANDLE)
+    {
+        vkDestroyPipeline(m_Context.device, pipeline.pipeline, nullptr);
+        pipeline.pipeline = VK_NULL_HANDLE;
+    }
+}
+
+Renderer::BufferId Renderer::VulkanBackend::CreateBuffer(BufferUsage usage, uint32_t size, bool dynamic)
+{
+    Buffer buffer;
+    buffer.usage = usage;
+    buffer.size = size;
+    buffer.dynamic = dynamic;
+    if (!dynamic)
+    {
+        buffer.contents.resize(size);
+    }
+    buffer.gpu = Vulkan::Buffer();
+
+    if (m_DeviceReady && !Realize(buffer))
+    {
+        return InvalidId;
+    }
+    return m_Buffers.Add(std::move(buffer));
+}
+
+bool Renderer::VulkanBackend::UpdateBuffer(BufferId buffer, uint32_t offset, const void* data, uint32_t size)
+{
+    Buffer* target = m_Buffers.Get(buffer);
+    if (!target || offset + size > target->size)
+    {
+        return false;
+    }
+
+    m_Stats.uploadBytes += size;
+    if (!target->dynamic)
+    {
+        std::memcpy(target->contents.data() + offset, data, size);
+    }
+    if (target->gpu.buffer == VK_NULL_HANDLE)
+    {
+        //comes in with the device
+        return true;
+    }
+
+    size_t base = 0;
+    if (target->dynamic)
+    {
+        //the slice of the frame being built, BeginFrame made sure the GPU is done with it
+        base = size_t(m_Frame) * target->size;
+    }
+    else
+    {
+        //earlier frames may still read it
+        vkDeviceWaitIdle(m_Context.device);
+    }
+
+    std::memcpy(static_cast<unsigned char*>(target->gpu.mapped) + base + offset, data, size);
+    Vulkan::FlushBuffer(m_Context.device, target->gpu);
+    return true;
+}
+
+void Renderer::VulkanBackend::DestroyBuffer(BufferId buffer)
+{
+    Buffer* target = m_Buffers.Get(buffer);
+    if (target)
+    {
+        if (target->gpu.buffer != VK_NULL_HANDLE)
+        {
+            vkDeviceWaitIdle(m_Context.device);
+            Release(*target);
+        }
+        m_Buffers.Remove(buffer);
+    }
+}
+
+Renderer::TextureId Renderer::VulkanBackend::CreateTexture(uint32_t width, uint32_t height, const unsigned char* pixels)
+{
+    Texture texture;
+    texture.width = width;
+    texture.height = height;
+    texture.pixels.assign(pixels, pixels + size_t(width) * height * 4);
+    texture.image = VK_NULL_HANDLE;
+    texture.memory = VK_NULL_HANDLE;
+    texture.view = VK_NULL_HANDLE;
+
+    if (m_DeviceReady && !Realize(texture))
+    {
+        return InvalidId;
+    }
+    m_Stats.uploadBytes += texture.pixels.size();
+    return m_Textures.Add(std::move(texture));
+}
+
+void Renderer::VulkanBackend::DestroyTexture(TextureId texture)
+{
+    Texture* target = m_Textures.Get(texture);
+    if (target)
+    {
+        if (target->view != VK_NULL_HANDLE)
+        {
+            vkDeviceWaitIdle(m_Context.device);
+            Release(*target);
+        }
+        m_Textures.Remove(texture);
+    }
+}
+
+Renderer::PipelineId Renderer::VulkanBackend::CreatePipeline(const PipelineDesc& desc)
+{
+    Pipeline pipeline;
+    pipeline.desc = desc;
+    pipeline.pipeline = VK_NULL_HANDLE;
+    if (!readShader("shaders/" + desc.shader + ".vert.spv", pipeline.vertexCode) || !readShader("shaders/" + desc.shader + ".frag.spv", pipeline.fragmentCode))
+    {
+        return InvalidId;
+    }
+    //built on first use, against the render pass it's used in
+    return m_Pipelines.Add(std::move(pipeline));
+}
+
+void Renderer::VulkanBackend::DestroyPipeline(PipelineId pipeline)
+{
+    Pipeline* target = m_Pipelines.Get(pipeline);
+    if (target)
+    {
+        if (target->pipeline != VK_NULL_HANDLE)
+        {
+            vkDeviceWaitIdle(m_Context.device);
+            Release(*target);
+        }
+        m_Pipelines.Remove(pipeline);
+    }
+}
+
+unsigned Renderer::VulkanBackend::ReloadShaders(const std::vector<std::string>& paths)
+{
+    unsigned reloaded = 0;
+    bool idle = false;
+    m_Pipelines.ForEach([&](PipelineId, Pipeline& pipeline) {
+        const std::string vertexPath = "shaders/" + pipeline.desc.shader + ".vert.spv";
+        const std::string fragmentPath = "shaders/" + pipeline.desc.shader + ".frag.spv";
+        if (std::find(paths.begin(), paths.end(), vertexPath) == paths.end() &&
+            std::find(paths.begin(), paths.end(), fragmentPath) == paths.end())
+        {
+            return;
+        }
+
+        //a shader that's gone or half-written leaves the old pipeline in place
+        std::vector<char> vertexCode;
+        std::vector<char> fragmentCode;
+        if (!readShader(vertexPath, vertexCode) || !readShader(fragmentPath, fragmentCode))
+        {
+            LOGW("Renderer: keeping shader %s", pipeline.desc.shader.c_str());
+            return;
+        }
+
+        pipeline.vertexCode.swap(vertexCode);
+        pipeline.fragmentCode.swap(fragmentCode);
+        if (pipeline.pipeline != VK_NULL_HANDLE)
+        {
+            //earlier frames may still use it
+            if (!idle)
+            {
+                vkDeviceWaitIdle(m_Context.device);
+                idle = true;
+            }
+            Release(pipeline);
+        }
+        //built again on first use
+        reloaded++;
+    });
+
+    //the test scene draws with pipelines of its own
+    if (m_Initialized && m_DeviceReady)
+    {
+        reloaded += Vulkan::ReloadShaders(paths);
+    }
+
+    if (reloaded > 0)
+    {
+        LOGI("Renderer: reloaded %u pipelines", reloaded);
+    }
+    return reloaded;
+}
+
+bool Renderer::VulkanBackend::BeginFrame()
+{
+    if (!m_Initialized || !m_DeviceReady)
+    {
+        return false;
+    }
+
+    m_Frame = Vulkan::WaitForFrame();
+    ResetFrameState();
+    m_ListCount = 0;
+    return true;
+}
+
+void Renderer::VulkanBackend::Submit(const DrawList& list)
+{
+    //copied, the commands are recorded in EndFrame
+    if (m_ListCount == m_Lists.size())
+    {
+        m_Lists.push_back(list);
+    }
+    else
+    {
+        m_Lists[m_ListCount] = list;
+    }
+    m_ListCount++;
+}
+
+void Renderer::VulkanBackend::EndFrame()
+{
+    //records the lists through the main pass hook
+    Vulkan::Draw();
+    m_ListCount = 0;
+    FinishFrameStats();
+}
+
+void Renderer::VulkanBackend::OnMainPass(const Vulkan::MainPass& pass)
+{
+    if (!m_DeviceReady || m_ListCount == 0)
+    {
+        return;
+    }
+    m_Pass = pass;
+
+    //one transient set per texture used this frame, written in one go before recording
+    m_TextureSets.assign(m_TextureSets.size(), VK_NULL_HANDLE);
+    for (size_t i = 0; i < m_ListCount; ++i)
+    {
+        for (const DrawList::Command& command : m_Lists[i].Commands())
+        {
+            Texture* texture = command.op == DrawList::Op::Texture ? m_Textures.Get(command.args[0]) : nullptr;
+            if (!texture || texture->view == VK_NULL_HANDLE)
+            {
+                continue;
+            }
+
+            const uint32_t index = command.args[0] - 1;
+            if (index >= m_TextureSets.size())
+            {
+                m_TextureSets.resize(index + 1, VK_NULL_HANDLE);
+            }
+            if (m_TextureSets[index] == VK_NULL_HANDLE)
+            {
+                m_TextureSets[index] = m_Context.descriptors->AllocateTransient(m_SetLayout);
+                m_Context.descriptors->Write(m_TextureSets[index], Vulkan::ImageBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, texture->view, m_Sampler));
+            }
+        }
+    }
+    m_Context.descriptors->Flush();
+
+    //the test scene drew before us, nothing of its state carries over
+    ResetFrameState();
+
+    VkViewport viewport = {0.0f, 0.0f, (float)pass.extent.width, (float)pass.extent.height, 0.0f, 1.0f};
+    vkCmdSetViewport(pass.commandBuffer, 0, 1, &viewport);
+    ApplyScissor(0, 0, 0, 0);
+
+    //window pixels, origin top left, then turned to the native orientation
+    PreRotation::Extent window = PreRotation::NativeExtent({pass.extent.width, pass.extent.height}, pass.rotation);
+    float ortho[16] = {
+        2.0f / window.width, 0.0f, 0.0f, 0.0f,
+        0.0f, 2.0f / window.height, 0.0f, 0.0f,
+        0.0f, 0.0f, 1.0f, 0.0f,
+        -1.0f, -1.0f, 0.0f, 1.0f,
+    };
+    float projection[16];
+    PreRotation::Apply(pass.rotation, ortho, projection);
+    vkCmdPushConstants(pass.commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(projection), projection);
+
+    for (size_t i = 0; i < m_ListCount; ++i)
+    {
+        Execute(m_Lists[i]);
+    }
+}
+
+bool Renderer::VulkanBackend::ApplyPipeline(PipelineId pipeline)
+{
+    Pipeline* target = m_Pipelines.Get(pipeline);
+    if (!target || !Realize(*target))
+    {
+        return false;
+    }
+
+    vkCmdBindPipeline(m_Pass.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, target->pipeline);
+    return true;
+}
+
+bool Renderer::VulkanBackend::ApplyVertexBuffer(BufferId buffer, uint32_t offset)
+{
+    Buffer* target = m_Buffers.Get(buffer);
+    if (!target || target->usage != BufferUsage::Vertex || target->gpu.buffer == VK_NULL_HANDLE)
+    {
+        return false;
+    }
+
+    VkDeviceSize base = offset + (target->dynamic ? VkDeviceSize(m_Pass.frame) * target->size : 0);
+    vkCmdBindVertexBuffers(m_Pass.commandBuffer, 0, 1, &target->gpu.buffer, &base);
+    return true;
+}
+
+bool Renderer::VulkanBackend::ApplyIndexBuffer(BufferId buffer, uint32_t offset)
+{
+    Buffer* target = m_Buffers.Get(buffer);
+    if (!target || target->usage != BufferUsage::Index || target->gpu.buffer == VK_NULL_HANDLE)
+    {
+        return false;
+    }
+
+    VkDeviceSize base = offset + (target->dynamic ? VkDeviceSize(m_Pass.frame) * target->size : 0);
+    vkCmdBindIndexBuffer(m_Pass.commandBuffer, target->gpu.buffer, base, VK_INDEX_TYPE_UINT16);
+    return true;
+}
+
+bool Renderer::VulkanBackend::ApplyTexture(TextureId texture)
+{
+    if (texture == InvalidId || texture > m_TextureSets.size() || m_TextureSets[texture - 1] == VK_NULL_HANDLE)
+    {
+        return false;
+    }
+
+    vkCmdBindDescriptorSets(m_Pass.commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, 1, &m_TextureSets[texture - 1], 0, nullptr);
+    return true;
+}
+
+void Renderer::VulkanBackend::ApplyScissor(int32_t x, int32_t y, uint32_t width, uint32_t height)
+{
+    VkRect2D scissor = {{0, 0}, m_Pass.extent};
+    if (width != 0)
+    {
+        PreRotation::Extent window = PreRotation::NativeExtent({m_Pass.extent.width, m_Pass.extent.height}, m_Pass.rotation);
+        PreRotation::Rect rect = PreRotation::NativeRect({x, y, width, height}, window, m_Pass.rotation);
+
+        //Vulkan wants it on the image
+        int32_t x0 = std::max(rect.x, 0);
+        int32_t y0 = std::max(rect.y, 0);
+        int32_t x1 = std::min(rect.x + (int32_t)rect.width, (int32_t)m_Pass.extent.width);
+        int32_t y1 = std::min(rect.y + (int32_t)rect.height, (int32_t)m_Pass.extent.height);
+        scissor.offset = {x0, y0};
+        scissor.extent = {(uint32_t)std::max(x1 - x0, 0), (uint32_t)std::max(y1 - y0, 0)};
+    }
+    vkCmdSetScissor(m_Pass.commandBuffer, 0, 1, &scissor);
+}
+
+void Renderer::VulkanBackend::ApplyDraw(uint32_t vertexCount, uint32_t firstVertex)
+{
+    vkCmdDraw(m_Pass.commandBuffer, vertexCount, 1, firstVertex, 0);
+}
+
+void Renderer::VulkanBackend::ApplyDrawIndexed(uint32_t indexCount, uint32_t firstIndex, uint32_t vertexOffset)
+{
+    vkCmdDrawIndexed(m_Pass.commandBuffer, indexCount, 1, firstIndex, (int32_t)vertexOffset, 0);
+}
@@ -0,0 +1,117 @@
+/* Vulkan renderer backend
+ *
+ * Drives the Vulkan path in vulkan-test.cpp: the lists submitted during a
+ * frame are copied and recorded at the end of its main pass, after the
+ * test scene. Dynamic buffers get a slice per frame in flight; static ones
+ * and textures keep a CPU copy, so they come back by themselves when the
+ * device is recreated with the surface. Pipelines are built on first use
+ * against the current render pass and rebuilt after swapchain recreation.
+ */
+#pragma once
+
+#include "renderer.h"
+#include "slots.h"
+#include "vulkanbuffer.h"
+#include "vulkan-test.h"
+#include <vulkan/vulkan.h>
+#include <vector>
+
+namespace Renderer
+{
+	class VulkanBackend : public Backend
+	{
+	public:
+		VulkanBackend();
+		virtual ~VulkanBackend();
+
+		virtual Api GetApi() const;
+		virtual bool Initialize(ANativeWindow* window);
+		virtual void Destroy();
+		virtual void ReleaseSurface();
+		virtual bool AcquireSurface(ANativeWindow* window);
+
+		virtual BufferId CreateBuffer(BufferUsage usage, uint32_t size, bool dynamic);
+		virtual bool UpdateBuffer(BufferId buffer, uint32_t offset, const void* data, uint32_t size);
+		virtual void DestroyBuffer(BufferId buffer);
+		virtual TextureId CreateTexture(uint32_t width, uint32_t height, const unsigned char* pixels);
+		virtual void DestroyTexture(TextureId texture);
+		virtual PipelineId CreatePipeline(const PipelineDesc& desc);
+		virtual void DestroyPipeline(PipelineId pipeline);
+		virtual unsigned ReloadShaders(const std::vector<std::string>& paths);
+
+		virtual bool BeginFrame();
+		virtual void Submit(const DrawList& list);
+		virtual void EndFrame();
+
+	protected:
+		virtual bool ApplyPipeline(PipelineId pipeline);
+		virtual bool ApplyVertexBuffer(BufferId buffer, uint32_t offset);
+		virtual bool ApplyIndexBuffer(BufferId buffer, uint32_t offset);
+		virtual bool ApplyTexture(TextureId texture);
+		virtual void ApplyScissor(int32_t x, int32_t y, uint32_t width, uint32_t height);
+		virtual void ApplyDraw(uint32_t vertexCount, uint32_t firstVertex);
+		virtual void ApplyDrawIndexed(uint32_t indexCount, uint32_t firstIndex, uint32_t vertexOffset);
+
+	private:
+		struct Buffer
+		{
+			BufferUsage usage;
+			uint32_t size;
+			bool dynamic;
+			// static buffers only
+			std::vector<unsigned char> contents;
+			Vulkan::Buffer gpu;
+		};
+
+		struct Texture
+		{
+			uint32_t width;
+			uint32_t height;
+			std::vector<unsigned char> pixels;
+			VkImage image;
+			VkDeviceMemory memory;
+			VkImageView view;
+		};
+
+		struct Pipeline
+		{
+			PipelineDesc desc;
+			std::vector<char> vertexCode;
+			std::vector<char> fragmentCode;
+			VkPipeline pipeline;
+		};
+
+		void OnDeviceCreated();
+		void OnDeviceDestroyed();
+		void OnSwapchainDestroyed();
+		void OnMainPass(const Vulkan::MainPass& pass);
+
+		bool Realize(Buffer& buffer);
+		void Release(Buffer& buffer);
+		bool Realize(Texture& texture);
+		void Release(Texture& texture);
+		bool Realize(Pipeline& pipeline);
+		void Release(Pipeline& pipeline);
+
+		bool m_Initialized;
+		bool m_DeviceReady;
+		Vulkan::Context m_Context;
+		VkPhysicalDeviceMemoryProperties m_MemoryProperties;
+		VkSampler m_Sampler;
+		VkDescriptorSetLayout m_SetLayout;
+		VkPipelineLayout m_PipelineLayout;
+
+		Slots<Buffer> m_Buffers;
+		Slots<Texture> m_Textures;
+		Slots<Pipeline> m_Pipelines;
+
+		// the frame being built, and its lists until EndFrame()
+		uint32_t m_Frame;
+		std::vector<DrawList> m_Lists;
+		size_t m_ListCount;
+
+		// while recording the main pass
+		Vulkan::MainPass m_Pass;
+		std::vector<VkDescriptorSet> m_TextureSets;
+	};
+}
@@ -0,0 +1,548 @@
+#include "vulkanrendergraph.h"
+#include "utils/log.h"
+#include <algorithm>
+#include <iterator>
+
+namespace {
+    using namespace RenderGraph;
+
+    VkImageLayout toVkLayout(Layout layout)
+    {
+        switch (layout)
+        {
+            case Layout::ColorAttachment:
+                return VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+            case Layout::DepthStencilAttachment:
+                return VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+            case Layout::ShaderReadOnly:
+                return VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            case Layout::Present:
+                return VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            case Layout::Undefined:
+            default:
+                return VK_IMAGE_LAYOUT_UNDEFINED;
+        }
+    }
+
+    VkPipelineStageFlags toVkStages(unsigned stages)
+    {
+        VkPipelineStageFlags flags = 0;
+        if (stages & StageTop)                  flags |= VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        if (stages & StageFragmentShader)       flags |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        if (stages & StageEarlyFragmentTests)   flags |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
+        if (stages & StageLateFragmentTests)    flags |= VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+        if (stages & StageColorOutput)          flags |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        if (stages & StageBottom)               flags |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        return flags ? flags : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+    }
+
+    VkAccessFlags toVkAccess(unsigned access)
+    {
+        VkAccessFlags flags = 0;
+        if (access & AccessShaderRead)          flags |= VK_ACCESS_SHADER_READ_BIT;
+        if (access & AccessInputAttachmentRead) flags |= VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+        if (access & AccessColorRead)           flags |= VK_ACCESS_COLOR_ATTACHMENT_READ_BIT;
+        if (access & AccessColorWrite)          flags |= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        if (access & AccessDepthRead)           flags |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+        if (access & AccessDepthWrite)          flags |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+        return flags;
+    }
+
+    VkAttachmentLoadOp toVkLoadOp(LoadOp op)
+    {
+        switch (op)
+        {
+            case LoadOp::Clear:
+                return VK_ATTACHMENT_LOAD_OP_CLEAR;
+            case LoadOp::DontCare:
+                return VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+            case LoadOp::Load:
+            default:
+                return VK_ATTACHMENT_LOAD_OP_LOAD;
+        }
+    }
+
+    VkAttachmentStoreOp toVkStoreOp(StoreOp op)
+    {
+        return op == StoreOp::Store ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    }
+
+    VkAttachmentReference toVkReference(const AttachmentReference& reference)
+    {
+        return {reference.attachment, toVkLayout(reference.layout)};
+    }
+
+    uint32_t bytesPerPixel(VkFormat format)
+    {
+        switch (format)
+        {
+            case VK_FORMAT_D16_UNORM:
+            case VK_FORMAT_R5G6B5_UNORM_PACK16:
+                return 2;
+            case VK_FORMAT_R16G16B16A16_SFLOAT:
+                return 8;
+            case VK_FORMAT_R32G32B32A32_SFLOAT:
+                return 16;
+            default:
+                return 4;
+        }
+    }
+
+    bool isTilingVendor(uint32_t vendorId)
+    {
+        //ARM, Qualcomm, Imagination, Apple
+        return vendorId == 0x13B5 || vendorId == 0x5143 || vendorId == 0x1010 || vendorId == 0x106B;
+    }
+}
+
+Vulkan::RenderGraphBackend::RenderGraphBackend(VkDevice device, VkPhysicalDevice physicalDevice)
+    : m_Device(device)
+    , m_PhysicalDevice(physicalDevice)
+    , m_Tiler(false)
+    , m_Graph(nullptr)
+    , m_CommandBuffer(VK_NULL_HANDLE)
+{
+    vkGetPhysicalDeviceMemoryProperties(m_PhysicalDevice, &m_MemoryProperties);
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(m_PhysicalDevice, &properties);
+    m_Tiler = isTilingVendor(properties.vendorID);
+
+    //lazily allocated memory only makes sense on tilers
+    for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; ++i)
+    {
+        if (m_MemoryProperties.memoryTypes[i].propertyFlags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT)
+        {
+            m_Tiler = true;
+        }
+    }
+
+    LOGI("RenderGraph: %s GPU", m_Tiler ? "tiling" : "immediate");
+}
+
+Vulkan::RenderGraphBackend::~RenderGraphBackend()
+{
+    Destroy();
+}
+
+bool Vulkan::RenderGraphBackend::IsTiler() const
+{
+    return m_Tiler;
+}
+
+uint64_t Vulkan::RenderGraphBackend::Size(const TextureDesc& desc) const
+{
+    return static_cast<uint64_t>(desc.width) * desc.height * bytesPerPixel(static_cast<VkFormat>(desc.format));
+}
+
+bool Vulkan::RenderGraphBackend::CreateRenderPass(const PhysicalPass& pass, VkRenderPass& renderPass)
+{
+    std::vector<VkAttachmentDescription> attachments;
+    for (const auto& attachment : pass.attachments)
+    {
+        const ResourceInfo& info = m_Graph->GetResource(attachment.resource);
+        VkAttachmentDescription description = {
+            .format = static_cast<VkFormat>(info.desc.format),
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .loadOp = toVkLoadOp(attachment.load),
+            .storeOp = toVkStoreOp(attachment.store),
+            .stencilLoadOp = info.desc.depth ? toVkLoadOp(attachment.load) : VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+            .stencilStoreOp = info.desc.depth ? toVkStoreOp(attachment.store) : VK_ATTACHMENT_STORE_OP_DONT_CARE,
+            .initialLayout = toVkLayout(attachment.initialLayout),
+            .finalLayout = toVkLayout(attachment.finalLayout),
+        };
+        attachments.push_back(description);
+    }
+
+    //the references have to stay alive until the render pass is created
+    std::vector<std::vector<VkAttachmentReference> > colorReferences(pass.subpasses.size());
+    std::vector<std::vector<VkAttachmentReference> > inputReferences(pass.subpasses.size());
+    std::vector<VkAttachmentReference> depthReferences(pass.subpasses.size());
+    std::vector<VkSubpassDescription> subpasses;
+
+    for (size_t i = 0; i < pass.subpasses.size(); ++i)
+    {
+        const Subpass& subpass = pass.subpasses[i];
+        std::transform(subpass.colors.begin(), subpass.colors.end(), std::back_inserter(colorReferences[i]), toVkReference);
+        std::transform(subpass.inputs.begin(), subpass.inputs.end(), std::back_inserter(inputReferences[i]), toVkReference);
+        if (subpass.hasDepth)
+        {
+            depthReferences[i] = toVkReference(subpass.depth);
+        }
+
+        VkSubpassDescription description = {
+            .pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
+            .inputAttachmentCount = (uint32_t)inputReferences[i].size(),
+            .pInputAttachments = inputReferences[i].data(),
+            .colorAttachmentCount = (uint32_t)colorReferences[i].size(),
+            .pColorAttachments = colorReferences[i].data(),
+            .pDepthStencilAttachment = subpass.hasDepth ? &depthReferences[i] : nullptr,
+        };
+        subpasses.push_back(description);
+    }
+
+    std::vector<VkSubpassDependency> dependencies;
+    for (const auto& dependency : pass.dependencies)
+    {
+        VkSubpassDependency vkDependency = {
+            .srcSubpass = dependency.srcSubpass,
+            .dstSubpass = dependency.dstSubpass,
+            .srcStageMask = toVkStages(dependency.srcStage),
+            .dstStageMask = toVkStages(dependency.dstStage),
+            .srcAccessMask = toVkAccess(dependency.srcAccess),
+            .dstAccessMask = toVkAccess(dependency.dstAccess),
+            //merged subpasses only ever read the pixel they are shading, so this stays in tile memory
+            .dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT,
+        };
+        dependencies.push_back(vkDependency);
+    }
+
+    VkRenderPassCreateInfo renderPassInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
+        .attachmentCount = (uint32_t)attachments.size(),
+        .pAttachments = attachments.data(),
+        .subpassCount = (uint32_t)subpasses.size(),
+        .pSubpasses = subpasses.data(),
+        .dependencyCount = (uint32_t)dependencies.size(),
+        .pDependencies = dependencies.data(),
+    };
+
+    if (vkCreateRenderPass(m_Device, &renderPassInfo, nullptr, &renderPass) != VK_SUCCESS)
+    {
+        LOGE("RenderGraph: failed to create render pass!");
+        return false;
+    }
+
+    return true;
+}
+
+bool Vulkan::RenderGraphBackend::CreateImages(const RenderGraph::Graph& graph)
+{
+    struct SlotMemory
+    {
+        VkDeviceSize size;
+        uint32_t typeBits;
+        bool lazy;
+    };
+    std::vector<SlotMemory> slots(graph.MemorySlots().size(), {0, 0xFFFFFFFF, true});
+
+    m_Images.assign(graph.ResourceCount(), {VK_NULL_HANDLE, VK_NULL_HANDLE, false});
+    for (Resource r = 0; r < graph.ResourceCount(); ++r)
+    {
+        const ResourceInfo& info = graph.GetResource(r);
+        if (info.imported || info.memorySlot < 0)
+        {
+            continue;
+        }
+
+        VkImageUsageFlags usage = 0;
+        if (info.usage & UsageColorAttachment) usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        if (info.usage & UsageDepthAttachment) usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        if (info.usage & UsageSampled)         usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+        if (info.usage & UsageInputAttachment) usage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+        if (info.transient)                    usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+
+        VkImageCreateInfo imageInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            //aliasing optimal-tiling images needs no flag, the barrier from UNDEFINED takes care of it
+            .flags = 0,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = static_cast<VkFormat>(info.desc.format),
+            .extent = {info.desc.width, info.desc.height, 1},
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_OPTIMAL,
+            .usage = usage,
+            .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        };
+
+        if (vkCreateImage(m_Device, &imageInfo, nullptr, &m_Images[r].image) != VK_SUCCESS)
+        {
+            LOGE("RenderGraph: failed to create image %s", info.name.c_str());
+            return false;
+        }
+        m_Images[r].owned = true;
+
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(m_Device, m_Images[r].image, &requirements);
+        SlotMemory& slot = slots[info.memorySlot];
+        slot.size = std::max(slot.size, requirements.size);
+        slot.typeBits &= requirements.memoryTypeBits;
+        slot.lazy = slot.lazy && info.transient;
+    }
+
+    m_Memory.assign(slots.size(), VK_NULL_HANDLE);
+    for (size_t s = 0; s < slots.size(); ++s)
+    {
+        //prefer lazily allocated memory for attachments that never leave tile memory
+        const VkMemoryPropertyFlags wanted[] = {
+            slots[s].lazy ? (VkMemoryPropertyFlags)(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) : (VkMemoryPropertyFlags)VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+        };
+
+        int memoryType = -1;
+        for (auto flags : wanted)
+        {
+            for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount && memoryType < 0; ++i)
+            {
+                if ((slots[s].typeBits & (1u << i)) && (m_MemoryProperties.memoryTypes[i].propertyFlags & flags) == flags)
+                {
+                    memoryType = (int)i;
+                }
+            }
+        }
+
+        if (memoryType < 0)
+        {
+            LOGE("RenderGraph: no memory type for slot %u", (unsigned)s);
+            return false;
+        }
+
+        VkMemoryAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .allocationSize = slots[s].size,
+            .memoryTypeIndex = (uint32_t)memoryType,
+        };
+
+        if (vkAllocateMemory(m_Device, &allocInfo, nullptr, &m_Memory[s]) != VK_SUCCESS)
+        {
+            LOGE("RenderGraph: failed to allocate %u bytes", (unsigned)slots[s].size);
+            return false;
+        }
+    }
+
+    for (Resource r = 0; r < graph.ResourceCount(); ++r)
+    {
+        const ResourceInfo& info = graph.GetResource(r);
+        if (!m_Images[r].owned)
+        {
+            continue;
+        }
+
+        vkBindImageMemory(m_Device, m_Images[r].image, m_Memory[info.memorySlot], 0);
+
+        VkImageViewCreateInfo viewInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = m_Images[r].image,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = static_cast<VkFormat>(info.desc.format),
+            .components = {
+                .r = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .g = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .b = VK_COMPONENT_SWIZZLE_IDENTITY,
+                .a = VK_COMPONENT_SWIZZLE_IDENTITY,
+            },
+            .subresourceRange = {
+                .aspectMask = info.desc.depth ? (VkImageAspectFlags)VK_IMAGE_ASPECT_DEPTH_BIT : (VkImageAspectFlags)VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+        };
+
+        if (vkCreateImageView(m_Device, &viewInfo, nullptr, &m_Images[r].view) != VK_SUCCESS)
+        {
+            LOGE("RenderGraph: failed to create image view %s", info.name.c_str());
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool Vulkan::RenderGraphBackend::Realize(const RenderGraph::Graph& graph)
+{
+    Destroy();
+    m_Graph = &graph;
+
+    for (const auto& pass : graph.PhysicalPasses())
+    {
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        if (!CreateRenderPass(pass, renderPass))
+        {
+            return false;
+        }
+        m_RenderPasses.push_back(renderPass);
+    }
+
+    if (!CreateImages(graph))
+    {
+        return false;
+    }
+
+    uint64_t total = 0;
+    for (auto size : graph.MemorySlots())
+    {
+        total += size;
+    }
+    LOGI("RenderGraph: %u render passes, %u memory slots, ~%u KB transient memory",
+        (unsigned)m_RenderPasses.size(), (unsigned)graph.MemorySlots().size(), (unsigned)(total / 1024));
+
+    return true;
+}
+
+void Vulkan::RenderGraphBackend::Destroy()
+{
+    for (auto& framebuffer : m_Framebuffers)
+    {
+        vkDestroyFramebuffer(m_Device, framebuffer.second, nullptr);
+    }
+    m_Framebuffers.clear();
+
+    for (auto renderPass : m_RenderPasses)
+    {
+        vkDestroyRenderPass(m_Device, renderPass, nullptr);
+    }
+    m_RenderPasses.clear();
+
+    for (auto& image : m_Images)
+    {
+        if (image.owned)
+        {
+            vkDestroyImageView(m_Device, image.view, nullptr);
+            vkDestroyImage(m_Device, image.image, nullptr);
+        }
+    }
+    m_Images.clear();
+
+    for (auto memory : m_Memory)
+    {
+        vkFreeMemory(m_Device, memory, nullptr);
+    }
+    m_Memory.clear();
+
+    m_Graph = nullptr;
+}
+
+void Vulkan::RenderGraphBackend::Bind(RenderGraph::Resource resource, VkImage image, VkImageView view)
+{
+    if (resource >= m_Images.size())
+    {
+        return;
+    }
+    m_Images[resource] = {image, view, false};
+}
+
+void Vulkan::RenderGraphBackend::Record(VkCommandBuffer commandBuffer)
+{
+    m_CommandBuffer = commandBuffer;
+}
+
+VkCommandBuffer Vulkan::RenderGraphBackend::CommandBuffer()
+{
+    return m_CommandBuffer;
+}
+
+VkRenderPass Vulkan::RenderGraphBackend::RenderPass(unsigned physicalPass)
+{
+    if (physicalPass >= m_RenderPasses.size())
+    {
+        return VK_NULL_HANDLE;
+    }
+    return m_RenderPasses[physicalPass];
+}
+
+void Vulkan::RenderGraphBackend::Barriers(const std::vector<Barrier>& barriers)
+{
+    std::vector<VkImageMemoryBarrier> imageBarriers;
+    VkPipelineStageFlags srcStages = 0;
+    VkPipelineStageFlags dstStages = 0;
+
+    for (const auto& barrier : barriers)
+    {
+        const ResourceInfo& info = m_Graph->GetResource(barrier.resource);
+        VkImageMemoryBarrier imageBarrier = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = toVkAccess(barrier.srcAccess),
+            .dstAccessMask = toVkAccess(barrier.dstAccess),
+            .oldLayout = toVkLayout(barrier.oldLayout),
+            .newLayout = toVkLayout(barrier.newLayout),
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = m_Images[barrier.resource].image,
+            .subresourceRange = {
+                .aspectMask = info.desc.depth ? (VkImageAspectFlags)VK_IMAGE_ASPECT_DEPTH_BIT : (VkImageAspectFlags)VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = 0,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1,
+            },
+        };
+        imageBarriers.push_back(imageBarrier);
+        srcStages |= toVkStages(barrier.srcStage);
+        dstStages |= toVkStages(barrier.dstStage);
+    }
+
+    vkCmdPipelineBarrier(m_CommandBuffer, srcStages, dstStages, 0, 0, nullptr, 0, nullptr, (uint32_t)imageBarriers.size(), imageBarriers.data());
+}
+
+void Vulkan::RenderGraphBackend::BeginPass(const PhysicalPass& pass, unsigned index)
+{
+    std::vector<VkImageView> views;
+    std::vector<VkClearValue> clearValues;
+    for (const auto& attachment : pass.attachments)
+    {
+        views.push_back(m_Images[attachment.resource].view);
+
+        VkClearValue clearValue;
+        if (m_Graph->GetResource(attachment.resource).desc.depth)
+        {
+            clearValue.depthStencil = {attachment.clear.depth, attachment.clear.stencil};
+        }
+        else
+        {
+            std::copy(std::begin(attachment.clear.color), std::end(attachment.clear.color), clearValue.color.float32);
+        }
+        clearValues.push_back(clearValue);
+    }
+
+    const VkRenderPass renderPass = m_RenderPasses[index];
+    auto key = std::make_pair(renderPass, views);
+    auto framebuffer = m_Framebuffers.find(key);
+    if (framebuffer == m_Framebuffers.end())
+    {
+        VkFramebufferCreateInfo framebufferInfo = {
+            .sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+            .renderPass = renderPass,
+            .attachmentCount = (uint32_t)views.size(),
+            .pAttachments = views.data(),
+            .width = pass.width,
+            .height = pass.height,
+            .layers = 1,
+        };
+
+        VkFramebuffer vkFramebuffer = VK_NULL_HANDLE;
+        if (vkCreateFramebuffer(m_Device, &framebufferInfo, nullptr, &vkFramebuffer) != VK_SUCCESS)
+        {
+            LOGE("RenderGraph: failed to create framebuffer!");
+        }
+        framebuffer = m_Framebuffers.insert(std::make_pair(key, vkFramebuffer)).first;
+    }
+
+    VkRenderPassBeginInfo renderPassInfo = {
+        .sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+        .renderPass = renderPass,
+        .framebuffer = framebuffer->second,
+        .renderArea = {
+            .offset = {0, 0},
+            .extent = {pass.width, pass.height},
+        },
+        .clearValueCount = (uint32_t)clearValues.size(),
+        .pClearValues = clearValues.data(),
+    };
+
+    vkCmdBeginRenderPass(m_CommandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+}
+
+void Vulkan::RenderGraphBackend::NextSubpass()
+{
+    vkCmdNextSubpass(m_CommandBuffer, VK_SUBPASS_CONTENTS_INLINE);
+}
+
+void Vulkan::RenderGraphBackend::EndPass()
+{
+    vkCmdEndRenderPass(m_CommandBuffer);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "rendergraph.h"
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <map>
+
+namespace Vulkan
+{
+	// Turns a compiled RenderGraph into render passes, transient images and barriers
+	class RenderGraphBackend : public RenderGraph::Backend
+	{
+	public:
+		RenderGraphBackend(VkDevice device, VkPhysicalDevice physicalDevice);
+		virtual ~RenderGraphBackend();
+
+		// creates the render passes and the (aliased) memory for the graph's own textures
+		bool Realize(const RenderGraph::Graph& graph);
+		void Destroy();
+
+		// imported resources are bound before every recording, e.g. to the current swapchain image
+		void Bind(RenderGraph::Resource resource, VkImage image, VkImageView view);
+		void Record(VkCommandBuffer commandBuffer);
+		VkCommandBuffer CommandBuffer();
+		VkRenderPass RenderPass(unsigned physicalPass);
+
+		virtual bool IsTiler() const;
+		virtual uint64_t Size(const RenderGraph::TextureDesc& desc) const;
+
+		virtual void Barriers(const std::vector<RenderGraph::Barrier>& barriers);
+		virtual void BeginPass(const RenderGraph::PhysicalPass& pass, unsigned index);
+		virtual void NextSubpass();
+		virtual void EndPass();
+
+	private:
+		struct Image
+		{
+			VkImage image;
+			VkImageView view;
+			bool owned;
+		};
+
+		bool CreateRenderPass(const RenderGraph::PhysicalPass& pass, VkRenderPass& renderPass);
+		bool CreateImages(const RenderGraph::Graph& graph);
+
+		VkDevice m_Device;
+		VkPhysicalDevice m_PhysicalDevice;
+		VkPhysicalDeviceMemoryProperties m_MemoryProperties;
+		bool m_Tiler;
+
+		const RenderGraph::Graph* m_Graph;
+		VkCommandBuffer m_CommandBuffer;
+		std::vector<VkRenderPass> m_RenderPasses;
+		std::vector<Image> m_Images;
+		std::vector<VkDeviceMemory> m_Memory;
+		std::map<std::pair<VkRenderPass, std::vector<VkImageView> >, VkFramebuffer> m_Framebuffers;
+	};
+}
@@ -0,0 +1,532 @@
+#include "vulkansprites.h"
+#include "vulkandescriptors.h"
+#include "utils/log.h"
+#include "utils/timing.h"
+#include <cstddef>
+#include <cstring>
+
+namespace {
+    bool createShaderModule(VkDevice device, const std::vector<char>& code, VkShaderModule& shaderModule)
+    {
+        VkShaderModuleCreateInfo createInfo = {
+            .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+            .codeSize = code.size(),
+            .pCode = reinterpret_cast<const uint32_t*>(code.data()),
+        };
+
+        return vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) == VK_SUCCESS;
+    }
+
+    VkPipelineColorBlendAttachmentState blendState(Vulkan::SpriteRenderer::Pipeline pipeline)
+    {
+        VkPipelineColorBlendAttachmentState state = {
+            .blendEnable = VK_TRUE,
+            .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
+            .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+            .colorBlendOp = VK_BLEND_OP_ADD,
+            .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+            .dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+            .alphaBlendOp = VK_BLEND_OP_ADD,
+            .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+        };
+
+        if (pipeline == Vulkan::SpriteRenderer::Additive)
+        {
+            state.dstColorBlendFactor = VK_BLEND_FACTOR_ONE;
+            state.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        }
+
+        return state;
+    }
+}
+
+Vulkan::SpriteRenderer::SpriteRenderer(VkDevice device, VkPhysicalDevice physicalDevice, DescriptorAllocator& descriptors, uint32_t framesInFlight, uint32_t maxSprites)
+: m_Device(device)
+, m_Descriptors(descriptors)
+, m_FramesInFlight(framesInFlight)
+, m_MaxSprites(maxSprites)
+, m_Stats()
+, m_Instances()
+, m_SetLayout(VK_NULL_HANDLE)
+, m_PipelineLayout(VK_NULL_HANDLE)
+, m_Sampler(VK_NULL_HANDLE)
+, m_WhiteImage(VK_NULL_HANDLE)
+, m_WhiteMemory(VK_NULL_HANDLE)
+, m_WhiteView(VK_NULL_HANDLE)
+, m_WhiteTexture(0)
+{
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_MemoryProperties);
+    for (VkPipeline& pipeline : m_Pipelines)
+    {
+        pipeline = VK_NULL_HANDLE;
+    }
+    m_Batcher.Reserve(maxSprites);
+}
+
+Vulkan::SpriteRenderer::~SpriteRenderer()
+{
+    Destroy();
+}
+
+bool Vulkan::SpriteRenderer::Initialize(VkCommandPool commandPool, VkQueue queue)
+{
+    //one slice of instances per frame in flight
+    VkDeviceSize size = VkDeviceSize(m_FramesInFlight) * m_MaxSprites * sizeof(Sprites::Instance);
+    if (!CreateBuffer(m_Device, m_MemoryProperties, size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, m_Instances))
+    {
+        LOGE("Sprites: failed to create the instance buffer");
+        return false;
+    }
+
+    m_SetLayout = m_Descriptors.GetLayout({
+        {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr},
+    });
+
+    VkPushConstantRange projectionRange = {
+        .stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+        .offset = 0,
+        .size = sizeof(float) * 16,
+    };
+
+    VkPipelineLayoutCreateInfo layoutInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &m_SetLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &projectionRange,
+    };
+
+    if (m_SetLayout == VK_NULL_HANDLE || vkCreatePipelineLayout(m_Device, &layoutInfo, nullptr, &m_PipelineLayout) != VK_SUCCESS)
+    {
+        LOGE("Sprites: failed to create the pipeline layout");
+        return false;
+    }
+
+    VkSamplerCreateInfo samplerInfo = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .magFilter = VK_FILTER_LINEAR,
+        .minFilter = VK_FILTER_LINEAR,
+        .mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+        .addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .maxLod = 16.0f,
+        .borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+    };
+
+    if (vkCreateSampler(m_Device, &samplerInfo, nullptr, &m_Sampler) != VK_SUCCESS)
+    {
+        LOGE("Sprites: failed to create the sampler");
+        return false;
+    }
+
+    if (!CreateWhiteTexture(commandPool, queue))
+    {
+        LOGE("Sprites: failed to create the white texture");
+        return false;
+    }
+    m_WhiteTexture = AddTexture(m_WhiteView);
+
+    return true;
+}
+
+bool Vulkan::SpriteRenderer::CreateWhiteTexture(VkCommandPool commandPool, VkQueue queue)
+{
+    VkImageCreateInfo imageInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .extent = {1, 1, 1},
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+
+    if (vkCreateImage(m_Device, &imageInfo, nullptr, &m_WhiteImage) != VK_SUCCESS)
+    {
+        return false;
+    }
+
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(m_Device, m_WhiteImage, &requirements);
+    int memoryType = FindMemoryType(m_MemoryProperties, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (memoryType < 0)
+    {
+        return false;
+    }
+
+    VkMemoryAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = requirements.size,
+        .memoryTypeIndex = (uint32_t)memoryType,
+    };
+
+    if (vkAllocateMemory(m_Device, &allocInfo, nullptr, &m_WhiteMemory) != VK_SUCCESS)
+    {
+        return false;
+    }
+    vkBindImageMemory(m_Device, m_WhiteImage, m_WhiteMemory, 0);
+
+    VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+    VkImageViewCreateInfo viewInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = m_WhiteImage,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .subresourceRange = range,
+    };
+
+    if (vkCreateImageView(m_Device, &viewInfo, nullptr, &m_WhiteView) != VK_SUCCESS)
+    {
+        return false;
+    }
+
+    Buffer staging;
+    if (!CreateBuffer(m_Device, m_MemoryProperties, 4, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, staging))
+    {
+        return false;
+    }
+    std::memset(staging.mapped, 0xFF, 4);
+    FlushBuffer(m_Device, staging);
+
+    VkCommandBufferAllocateInfo commandInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = commandPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1,
+    };
+
+    VkCommandBuffer commandBuffer;
+    if (vkAllocateCommandBuffers(m_Device, &commandInfo, &commandBuffer) != VK_SUCCESS)
+    {
+        DestroyBuffer(m_Device, staging);
+        return false;
+    }
+
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+    VkImageMemoryBarrier toTransfer = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = m_WhiteImage,
+        .subresourceRange = range,
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toTransfer);
+
+    VkBufferImageCopy copy = {
+        .bufferOffset = 0,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .imageOffset = {0, 0, 0},
+        .imageExtent = {1, 1, 1},
+    };
+    vkCmdCopyBufferToImage(commandBuffer, staging.buffer, m_WhiteImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+
+    VkImageMemoryBarrier toShader = toTransfer;
+    toShader.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    toShader.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    toShader.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    toShader.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &toShader);
+
+    vkEndCommandBuffer(commandBuffer);
+
+    VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &commandBuffer,
+    };
+
+    bool submitted = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE) == VK_SUCCESS;
+    if (submitted)
+    {
+        vkQueueWaitIdle(queue);
+    }
+
+    vkFreeCommandBuffers(m_Device, commandPool, 1, &commandBuffer);
+    DestroyBuffer(m_Device, staging);
+    return submitted;
+}
+
+void Vulkan::SpriteRenderer::Destroy()
+{
+    DestroyPipelines();
+
+    if (m_PipelineLayout != VK_NULL_HANDLE)
+    {
+        vkDestroyPipelineLayout(m_Device, m_PipelineLayout, nullptr);
+        m_PipelineLayout = VK_NULL_HANDLE;
+    }
+
+    if (m_Sampler != VK_NULL_HANDLE)
+    {
+        vkDestroySampler(m_Device, m_Sampler, nullptr);
+        m_Sampler = VK_NULL_HANDLE;
+    }
+
+    if (m_WhiteView != VK_NULL_HANDLE)
+    {
+        vkDestroyImageView(m_Device, m_WhiteView, nullptr);
+        m_WhiteView = VK_NULL_HANDLE;
+    }
+    if (m_WhiteImage != VK_NULL_HANDLE)
+    {
+        vkDestroyImage(m_Device, m_WhiteImage, nullptr);
+        m_WhiteImage = VK_NULL_HANDLE;
+    }
+    if (m_WhiteMemory != VK_NULL_HANDLE)
+    {
+        vkFreeMemory(m_Device, m_WhiteMemory, nullptr);
+        m_WhiteMemory = VK_NULL_HANDLE;
+    }
+
+    if (m_Instances.buffer != VK_NULL_HANDLE)
+    {
+        DestroyBuffer(m_Device, m_Instances);
+    }
+
+    //the set layout and the persistent sets belong to the descriptor allocator
+    m_SetLayout = VK_NULL_HANDLE;
+    m_Textures.clear();
+    m_TextureSets.clear();
+}
+
+bool Vulkan::SpriteRenderer::CreatePipelines(VkRenderPass renderPass, VkExtent2D extent, const std::vector<char>& vertexCode, const std::vector<char>& fragmentCode)
+{
+    VkShaderModule vertexModule = VK_NULL_HANDLE;
+    VkShaderModule fragmentModule = VK_NULL_HANDLE;
+    if (!createShaderModule(m_Device, vertexCode, vertexModule) || !createShaderModule(m_Device, fragmentCode, fragmentModule))
+    {
+        LOGE("Sprites: unable to create the shader modules");
+        vkDestroyShaderModule(m_Device, vertexModule, nullptr);
+        vkDestroyShaderModule(m_Device, fragmentModule, nullptr);
+        return false;
+    }
+
+    VkPipelineShaderStageCreateInfo stages[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_VERTEX_BIT,
+            .module = vertexModule,
+            .pName = "main",
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .stage = VK_SHADER_STAGE_FRAGMENT_BIT,
+            .module = fragmentModule,
+            .pName = "main",
+        },
+    };
+
+    //everything per sprite comes in per instance
+    VkVertexInputBindingDescription binding = {0, sizeof(Sprites::Instance), VK_VERTEX_INPUT_RATE_INSTANCE};
+    VkVertexInputAttributeDescription attributes[] = {
+        {0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Sprites::Instance, x)},
+        {1, 0, VK_FORMAT_R32G32B32A32_SFLOAT, offsetof(Sprites::Instance, u0)},
+        {2, 0, VK_FORMAT_R32_SFLOAT, offsetof(Sprites::Instance, rotation)},
+        {3, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(Sprites::Instance, color)},
+    };
+
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+        .vertexBindingDescriptionCount = 1,
+        .pVertexBindingDescriptions = &binding,
+        .vertexAttributeDescriptionCount = sizeof(attributes) / sizeof(attributes[0]),
+        .pVertexAttributeDescriptions = attributes,
+    };
+
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+        .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
+        .primitiveRestartEnable = VK_FALSE,
+    };
+
+    VkViewport viewport = {0.0f, 0.0f, (float)extent.width, (float)extent.height, 0.0f, 1.0f};
+    VkRect2D scissor = {{0, 0}, extent};
+
+    VkPipelineViewportStateCreateInfo viewportState = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+        .viewportCount = 1,
+        .pViewports = &viewport,
+        .scissorCount = 1,
+        .pScissors = &scissor,
+    };
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+        .depthClampEnable = VK_FALSE,
+        .rasterizerDiscardEnable = VK_FALSE,
+        .polygonMode = VK_POLYGON_MODE_FILL,
+        .cullMode = VK_CULL_MODE_NONE,
+        .frontFace = VK_FRONT_FACE_CLOCKWISE,
+        .depthBiasEnable = VK_FALSE,
+        .lineWidth = 1.0f,
+    };
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+        .rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+        .sampleShadingEnable = VK_FALSE,
+    };
+
+    bool created = true;
+    for (uint16_t p = 0; p < PipelineCount && created; ++p)
+    {
+        VkPipelineColorBlendAttachmentState colorBlendAttachment = blendState((Pipeline)p);
+
+        VkPipelineColorBlendStateCreateInfo colorBlending = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+            .logicOpEnable = VK_FALSE,
+            .attachmentCount = 1,
+            .pAttachments = &colorBlendAttachment,
+        };
+
+        VkGraphicsPipelineCreateInfo pipelineInfo = {
+            .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+            .stageCount = 2,
+            .pStages = stages,
+            .pVertexInputState = &vertexInputInfo,
+            .pInputAssemblyState = &inputAssembly,
+            .pViewportState = &viewportState,
+            .pRasterizationState = &rasterizer,
+            .pMultisampleState = &multisampling,
+            .pColorBlendState = &colorBlending,
+            .layout = m_PipelineLayout,
+            .renderPass = renderPass,
+            .subpass = 0,
+            .basePipelineHandle = VK_NULL_HANDLE,
+            .basePipelineIndex = -1,
+        };
+
+        if (vkCreateGraphicsPipelines(m_Device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &m_Pipelines[p]) != VK_SUCCESS)
+        {
+            LOGE("Sprites: failed to create pipeline %u", (unsigned)p);
+            m_Pipelines[p] = VK_NULL_HANDLE;
+            created = false;
+        }
+    }
+
+    vkDestroyShaderModule(m_Device, vertexModule, nullptr);
+    vkDestroyShaderModule(m_Device, fragmentModule, nullptr);
+    return created;
+}
+
+void Vulkan::SpriteRenderer::DestroyPipelines()
+{
+    for (VkPipeline& pipeline : m_Pipelines)
+    {
+        if (pipeline != VK_NULL_HANDLE)
+        {
+            vkDestroyPipeline(m_Device, pipeline, nullptr);
+            pipeline = VK_NULL_HANDLE;
+        }
+    }
+}
+
+uint32_t Vulkan::SpriteRenderer::AddTexture(VkImageView view)
+{
+    m_Textures.push_back(view);
+    m_TextureSets.push_back(VK_NULL_HANDLE);
+    return uint32_t(m_Textures.size() - 1);
+}
+
+uint32_t Vulkan::SpriteRenderer::WhiteTexture() const
+{
+    return m_WhiteTexture;
+}
+
+Sprites::Batcher& Vulkan::SpriteRenderer::Batcher()
+{
+    return m_Batcher;
+}
+
+const Sprites::Stats& Vulkan::SpriteRenderer::Stats() const
+{
+    return m_Stats;
+}
+
+VkDescriptorSet Vulkan::SpriteRenderer::TextureSet(uint32_t texture)
+{
+    if (texture >= m_Textures.size())
+    {
+        texture = m_WhiteTexture;
+    }
+
+    if (m_TextureSets[texture] == VK_NULL_HANDLE)
+    {
+        m_TextureSets[texture] = m_Descriptors.GetPersistent(m_SetLayout, {
+            ImageBinding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_Textures[texture], m_Sampler),
+        });
+    }
+
+    return m_TextureSets[texture];
+}
+
+void Vulkan::SpriteRenderer::Record(VkCommandBuffer commandBuffer, uint32_t frame, const float projection[16])
+{
+    m_Stats.sprites = 0;
+    m_Stats.draws = 0;
+
+    Timewatcher timer = Timing::Start();
+
+    VkDeviceSize sliceOffset = VkDeviceSize(frame % m_FramesInFlight) * m_MaxSprites * sizeof(Sprites::Instance);
+    Sprites::Instance* slice = reinterpret_cast<Sprites::Instance*>(static_cast<char*>(m_Instances.mapped) + sliceOffset);
+    m_Stats.sprites = m_Batcher.Build(slice, m_MaxSprites);
+    FlushBuffer(m_Device, m_Instances);
+
+    const std::vector<Sprites::Batch>& batches = m_Batcher.Batches();
+
+    //new texture sets have to be written before they are bound
+    for (const Sprites::Batch& batch : batches)
+    {
+        TextureSet(batch.texture);
+    }
+    m_Descriptors.Flush();
+
+    m_Stats.buildMilliseconds = timer->GetNanoseconds() * 1000.0;
+
+    if (batches.empty() || m_Pipelines[AlphaBlend] == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    vkCmdBindVertexBuffers(commandBuffer, 0, 1, &m_Instances.buffer, &sliceOffset);
+    vkCmdPushConstants(commandBuffer, m_PipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(float) * 16, projection);
+
+    uint32_t boundPipeline = PipelineCount;
+    uint32_t boundTexture = ~0u;
+    for (const Sprites::Batch& batch : batches)
+    {
+        if (batch.pipeline != boundPipeline)
+        {
+            uint32_t pipeline = batch.pipeline < PipelineCount ? batch.pipeline : AlphaBlend;
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_Pipelines[pipeline]);
+            boundPipeline = batch.pipeline;
+        }
+
+        if (batch.texture != boundTexture)
+        {
+            VkDescriptorSet set = TextureSet(batch.texture);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_PipelineLayout, 0, 1, &set, 0, nullptr);
+            boundTexture = batch.texture;
+        }
+
+        vkCmdDraw(commandBuffer, 4, batch.instanceCount, 0, batch.firstInstance);
+        m_Stats.draws++;
+    }
+}
@@ -0,0 +1,80 @@
+/* Instanced sprite rendering
+ *
+ * Every frame the batcher's output is written straight into that frame's
+ * slice of a persistently mapped instance buffer, and each batch is drawn
+ * as one instanced 4-vertex strip; the quad corners come from gl_VertexIndex,
+ * so there is no vertex buffer besides the instances.
+ */
+#pragma once
+
+#include "spritebatch.h"
+#include "vulkanbuffer.h"
+#include <vulkan/vulkan.h>
+#include <vector>
+
+namespace Vulkan
+{
+	class DescriptorAllocator;
+
+	class SpriteRenderer
+	{
+	public:
+		// pipeline ids for Sprites::Batcher::Submit
+		enum Pipeline : uint16_t
+		{
+			AlphaBlend = 0,
+			Additive,
+
+			PipelineCount
+		};
+
+		SpriteRenderer(VkDevice device, VkPhysicalDevice physicalDevice, DescriptorAllocator& descriptors, uint32_t framesInFlight, uint32_t maxSprites);
+		~SpriteRenderer();
+
+		// the pool and queue are only used to upload the white texture
+		bool Initialize(VkCommandPool commandPool, VkQueue queue);
+		void Destroy();
+
+		// pipelines depend on the render pass, so they go with the swapchain
+		bool CreatePipelines(VkRenderPass renderPass, VkExtent2D extent, const std::vector<char>& vertexCode, const std::vector<char>& fragmentCode);
+		void DestroyPipelines();
+
+		// returns the texture id to submit sprites with, the view has to outlive the renderer
+		uint32_t AddTexture(VkImageView view);
+		uint32_t WhiteTexture() const;
+
+		Sprites::Batcher& Batcher();
+
+		// builds the frame's batches and records them, inside a render pass compatible with CreatePipelines
+		void Record(VkCommandBuffer commandBuffer, uint32_t frame, const float projection[16]);
+
+		const Sprites::Stats& Stats() const;
+
+	private:
+		bool CreateWhiteTexture(VkCommandPool commandPool, VkQueue queue);
+		VkDescriptorSet TextureSet(uint32_t texture);
+
+		VkDevice m_Device;
+		VkPhysicalDeviceMemoryProperties m_MemoryProperties;
+		DescriptorAllocator& m_Descriptors;
+		uint32_t m_FramesInFlight;
+		uint32_t m_MaxSprites;
+
+		Sprites::Batcher m_Batcher;
+		Sprites::Stats m_Stats;
+		Buffer m_Instances;
+
+		VkDescriptorSetLayout m_SetLayout;
+		VkPipelineLayout m_PipelineLayout;
+		VkPipeline m_Pipelines[PipelineCount];
+		VkSampler m_Sampler;
+
+		VkImage m_WhiteImage;
+		VkDeviceMemory m_WhiteMemory;
+		VkImageView m_WhiteView;
+		uint32_t m_WhiteTexture;
+
+		std::vector<VkImageView> m_Textures;
+		std::vector<VkDescriptorSet> m_TextureSets; // filled lazily, one persistent set per texture
+	};
+}
@@ -1,7 +1,7 @@
 #include "java_application.h"
 #include "utils/log.h"
 #include "graphics/graphics.h"
-#include "graphics/vulkan-test.h"
+#include "graphics/renderer.h"
 #include <unordered_map>
 #include <algorithm>
 #include <android/looper.h>
@@ -11,6 +11,10 @@
 #include <android/choreographer.h>
 #include <graphics/gui.h>
 #include <graphics/wsi.h>
+#include <graphics/programcache.h>
+#include "utils/fs_android.h"
+#include "utils/fs_overlay.h"
+#include "utils/fs_watch.h"
 
 namespace {
     typedef std::unordered_multimap<int32_t, App::CommandEventCallbackType > g_CommandEventHandlersType;
@@ -22,6 +26,9 @@ namespace {
     bool g_IsResumed = false;
     bool g_SurfaceReady = false;
     ANativeWindow* g_Window = nullptr;
+    std::unique_ptr<Renderer::Backend> g_Renderer;
+    // debug builds, hot reloading from the writable layer
+    std::unique_ptr<Vfs::FileWatcher> g_Watcher;
 }
 
 struct app_state {
@@ -103,9 +110,10 @@ namespace {
 
         return true;*/
 
-        if (!Vulkan::Initialize(window))
+        g_Renderer = Renderer::CreateForWindow(window);
+        if (!g_Renderer)
         {
-            LOGE("Unable to initialize Vulkan!");
+            LOGE("Unable to initialize a renderer!");
             return false;
         }
 
@@ -118,17 +126,27 @@ namespace {
     {
         if (App::GetAppState()->destroyRequested != 0)
         {
-            Vulkan::Destroy();
+            g_Renderer->Destroy();
+            g_Renderer.reset();
             g_AppState.initialized = false;
             return;
         }
 
+        //what was edited since, delivered once it's all saved
+        if (g_Watcher)
+        {
+            g_Watcher->Poll();
+        }
+
         //Simulation here
 
         //Render here
         if (App::HasFocus())
         {
-            Vulkan::Draw();
+            if (g_Renderer->BeginFrame())
+            {
+                g_Renderer->EndFrame();
+            }
             PostFrameCallback();
         }
     }
@@ -188,7 +206,7 @@ extern "C" JNIEXPORT void JNICALL Java_com_example_micha_vulkansink_VulkanActivi
         LOGI("Got window %p", window);
         if (App::GetAppState()->initialized)
         {
-            Vulkan::ReAcquireSurface(window);
+            g_Renderer->AcquireSurface(window);
         }
         else if (InitializeWindow(window))
         {
@@ -199,7 +217,7 @@ extern "C" JNIEXPORT void JNICALL Java_com_example_micha_vulkansink_VulkanActivi
  -----
 
          LOGI("Releasing window");
-        Vulkan::ReleaseSurface();
+        g_Renderer->ReleaseSurface();
 
  */
 
@@ -218,6 +236,35 @@ extern "C" JNIEXPORT void JNICALL Java_com_example_micha_vulkansink_VulkanActivi
     }
 }
 
+extern "C" JNIEXPORT void JNICALL Java_com_example_micha_vulkansink_VulkanActivity_nativeSetCacheDir(JNIEnv* jenv, jobject obj, jstring path)
+{
+    const char* cacheDir = jenv->GetStringUTFChars(path, nullptr);
+    LOGI("Cache dir %s", cacheDir);
+    ProgramCache::SetDirectory(cacheDir);
+    //what the app writes through Vfs goes over the assets
+    Vfs::AndroidFileSystemAddWritableLayer(std::string(cacheDir) + "/vfs");
+#ifndef NDEBUG
+    //files pushed there (adb push .../cache/vfs/shaders) replace the shipped ones while running:
+    //<name>.vert.spv/.frag.spv for vulkan, gles/<name>.vert/.frag for the gles programs
+    std::shared_ptr<Vfs::OverlayFileSystem> overlay = Vfs::AndroidFileSystemOverlay();
+    if (overlay)
+    {
+        g_Watcher.reset(new Vfs::FileWatcher(overlay->WritableLayer()));
+        //first, so the overlay finds new files and forgets removed ones before anything reloads
+        g_Watcher->Subscribe("", [overlay](const std::vector<std::string>&) {
+            overlay->Invalidate();
+        });
+        g_Watcher->Subscribe("shaders/", [](const std::vector<std::string>& paths) {
+            if (g_Renderer)
+            {
+                g_Renderer->ReloadShaders(paths);
+            }
+        });
+    }
+#endif
+    jenv->ReleaseStringUTFChars(path, cacheDir);
+}
+
 extern "C" JNIEXPORT void JNICALL Java_com_example_micha_vulkansink_VulkanActivity_nativeOnInput(JNIEnv* jenv, jobject obj, jint action, jfloat x, jfloat y)
 {
     LOGI("Got input %d %.1f %.1f", action, x, y);
@@ -0,0 +1,177 @@
+#include "utils/assetpack.h"
+#include "utils/lz4.h"
+#include "utils/log.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+	Vfs::PathView WithoutLeadingSlash(Vfs::PathView path)
+	{
+		while (path.size > 0 && path.data[0] == '/')
+		{
+			path = Vfs::PathView(path.data + 1, path.size - 1);
+		}
+		return path;
+	}
+
+	uint64_t Align(uint64_t offset)
+	{
+		return (offset + AssetPack::Alignment - 1) / AssetPack::Alignment * AssetPack::Alignment;
+	}
+
+	bool WriteZeros(FILE* file, uint64_t count)
+	{
+		static const unsigned char zeros[256] = {};
+		while (count > 0)
+		{
+			const size_t chunk = count < sizeof(zeros) ? size_t(count) : sizeof(zeros);
+			if (fwrite(zeros, 1, chunk, file) != chunk)
+			{
+				return false;
+			}
+			count -= chunk;
+		}
+		return true;
+	}
+}
+
+uint64_t AssetPack::HashPath(Vfs::PathView path)
+{
+	path = WithoutLeadingSlash(path);
+
+	uint64_t hash = 14695981039346656037ull;
+	for (size_t i = 0; i < path.size; i++)
+	{
+		hash ^= (unsigned char)path.data[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+void AssetPack::Writer::Add(const std::string& path, std::vector<unsigned char> data, bool compress)
+{
+	const Vfs::PathView name = WithoutLeadingSlash(path);
+
+	Pending entry;
+	entry.path.assign(name.data, name.size);
+	entry.size = data.size();
+	entry.compression = Compression::None;
+
+	if (compress && !data.empty())
+	{
+		std::vector<unsigned char> packed(Lz4::CompressBound(data.size()));
+		const size_t packedSize = Lz4::Compress(data.data(), data.size(), packed.data(), packed.size());
+		if (packedSize > 0 && packedSize <= data.size() - data.size() / 8)
+		{
+			packed.resize(packedSize);
+			data.swap(packed);
+			entry.compression = Compression::Lz4;
+		}
+	}
+	entry.stored = std::move(data);
+
+	auto existing = m_Indices.find(entry.path);
+	if (existing != m_Indices.end())
+	{
+		m_Entries[existing->second] = std::move(entry);
+		return;
+	}
+	m_Indices[entry.path] = m_Entries.size();
+	m_Entries.push_back(std::move(entry));
+}
+
+bool AssetPack::Writer::Write(const std::string& hostPath) const
+{
+	std::vector<const Pending*> sorted;
+	for (const Pending& entry : m_Entries)
+	{
+		sorted.push_back(&entry);
+	}
+	std::sort(sorted.begin(), sorted.end(), [](const Pending* a, const Pending* b)
+	{
+		const uint64_t hashA = HashPath(a->path);
+		const uint64_t hashB = HashPath(b->path);
+		return hashA != hashB ? hashA < hashB : a->path < b->path;
+	});
+
+	Header header = {};
+	header.magic = Magic;
+	header.version = Version;
+	header.entryCount = (uint32_t)sorted.size();
+	header.namesOffset = sizeof(Header) + sizeof(Entry) * sorted.size();
+
+	std::string names;
+	std::vector<Entry> entries;
+	for (const Pending* pending : sorted)
+	{
+		Entry entry = {};
+		entry.hash = HashPath(pending->path);
+		entry.storedSize = pending->stored.size();
+		entry.size = pending->size;
+		entry.nameOffset = (uint32_t)names.size();
+		entry.nameLength = (uint32_t)pending->path.size();
+		entry.compression = pending->compression;
+		names += pending->path;
+		entries.push_back(entry);
+	}
+	header.namesSize = names.size();
+
+	uint64_t offset = Align(header.namesOffset + header.namesSize);
+	for (Entry& entry : entries)
+	{
+		entry.offset = offset;
+		offset = Align(offset + entry.storedSize);
+	}
+
+	FILE* file = fopen(hostPath.c_str(), "wb");
+	if (file == nullptr)
+	{
+		LOGE("Unable to create %s", hostPath.c_str());
+		return false;
+	}
+
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+		&& (entries.empty() || fwrite(entries.data(), sizeof(Entry), entries.size(), file) == entries.size())
+		&& fwrite(names.data(), 1, names.size(), file) == names.size();
+
+	uint64_t written = header.namesOffset + header.namesSize;
+	for (size_t i = 0; ok && i < entries.size(); i++)
+	{
+		const std::vector<unsigned char>& stored = sorted[i]->stored;
+		ok = WriteZeros(file, entries[i].offset - written)
+			&& fwrite(stored.data(), 1, stored.size(), file) == stored.size();
+		written = entries[i].offset + stored.size();
+	}
+
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+	{
+		LOGE("Writing %s failed", hostPath.c_str());
+	}
+	return ok;
+}
+
+size_t AssetPack::Writer::EntryCount() const
+{
+	return m_Entries.size();
+}
+
+uint64_t AssetPack::Writer::OriginalBytes() const
+{
+	uint64_t bytes = 0;
+	for (const Pending& entry : m_Entries)
+	{
+		bytes += entry.size;
+	}
+	return bytes;
+}
+
+uint64_t AssetPack::Writer::StoredBytes() const
+{
+	uint64_t bytes = 0;
+	for (const Pending& entry : m_Entries)
+	{
+		bytes += entry.stored.size();
+	}
+	return bytes;
+}
@@ -0,0 +1,86 @@
+/* Asset packs
+ *
+ * One file holding many assets, so opening one is a binary search instead
+ * of a lookup in the APK's zip directory. Little endian throughout:
+ *
+ *   Header
+ *   Entry[entryCount]   sorted by hash, then by name
+ *   names               the paths, not terminated
+ *   data                every entry starts on an Alignment boundary
+ *
+ * An entry is stored as is or as one LZ4 block, whichever the packer found
+ * worth it. Stored entries can be handed out straight from a mapping of
+ * the pack; Vfs::PackFileSystem (fs_pack.h) reads them.
+ */
+#pragma once
+
+#include "pathindex.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace AssetPack
+{
+	const uint32_t Magic = 0x4B505356; // "VSPK"
+	const uint32_t Version = 1;
+	const uint64_t Alignment = 4096;
+
+	enum class Compression : uint32_t
+	{
+		None = 0,
+		Lz4,
+	};
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t reserved;
+		uint64_t namesOffset;
+		uint64_t namesSize;
+	};
+
+	struct Entry
+	{
+		uint64_t hash;
+		// from the start of the pack
+		uint64_t offset;
+		uint64_t storedSize;
+		uint64_t size;
+		// into the names
+		uint32_t nameOffset;
+		uint32_t nameLength;
+		Compression compression;
+		uint32_t reserved;
+	};
+
+	// FNV-1a over the path, a leading '/' left out
+	uint64_t HashPath(Vfs::PathView path);
+
+	class Writer
+	{
+	public:
+		// a path added again replaces the earlier one; compressed only if it saves an eighth
+		void Add(const std::string& path, std::vector<unsigned char> data, bool compress = true);
+		bool Write(const std::string& hostPath) const;
+
+		size_t EntryCount() const;
+		uint64_t OriginalBytes() const;
+		uint64_t StoredBytes() const;
+
+	private:
+		struct Pending
+		{
+			std::string path;
+			std::vector<unsigned char> stored;
+			uint64_t size;
+			Compression compression;
+		};
+
+		std::vector<Pending> m_Entries;
+		// path to its index in m_Entries
+		std::unordered_map<std::string, size_t> m_Indices;
+	};
+}
@@ -0,0 +1,360 @@
+#include "utils/contentcache.h"
+#include "utils/log.h"
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+namespace {
+	const uint32_t g_Magic = 0x41435356; // "VSCA"
+	const uint32_t g_Version = 1;
+	const char g_Extension[] = ".bin";
+	const size_t g_NameLength = 32;
+
+	struct EntryHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t size;
+		Vfs::Hash128 key;
+		// of the bytes after the header
+		Vfs::Hash128 content;
+	};
+
+	uint64_t Rotate(uint64_t x, int r)
+	{
+		return (x << r) | (x >> (64 - r));
+	}
+
+	uint64_t Mix(uint64_t k)
+	{
+		k ^= k >> 33;
+		k *= 0xff51afd7ed558ccdull;
+		k ^= k >> 33;
+		k *= 0xc4ceb9fe1a85ec53ull;
+		k ^= k >> 33;
+		return k;
+	}
+
+	std::string NameFor(const Vfs::Hash128& key)
+	{
+		char name[g_NameLength + sizeof(g_Extension)];
+		snprintf(name, sizeof(name), "%016llx%016llx%s", (unsigned long long)key.high, (unsigned long long)key.low, g_Extension);
+		return name;
+	}
+
+	bool IsEntryName(const std::string& name)
+	{
+		return name.size() == g_NameLength + strlen(g_Extension)
+			&& name.find_first_not_of("0123456789abcdef") == g_NameLength
+			&& name.compare(g_NameLength, std::string::npos, g_Extension) == 0;
+	}
+
+	int64_t Now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	}
+}
+
+Vfs::Hash128 Vfs::HashBytes(const void* data, size_t size, uint32_t seed)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	const uint64_t c1 = 0x87c37b91114253d5ull;
+	const uint64_t c2 = 0x4cf5ad432745937full;
+	uint64_t h1 = seed;
+	uint64_t h2 = seed;
+
+	const size_t blocks = size / 16;
+	for (size_t i = 0; i < blocks; i++)
+	{
+		//little endian, like every device this runs on
+		uint64_t k1;
+		uint64_t k2;
+		memcpy(&k1, bytes + i * 16, 8);
+		memcpy(&k2, bytes + i * 16 + 8, 8);
+
+		k1 *= c1; k1 = Rotate(k1, 31); k1 *= c2; h1 ^= k1;
+		h1 = Rotate(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+		k2 *= c2; k2 = Rotate(k2, 33); k2 *= c1; h2 ^= k2;
+		h2 = Rotate(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+	}
+
+	const unsigned char* tail = bytes + blocks * 16;
+	const size_t left = size & 15;
+	uint64_t k1 = 0;
+	uint64_t k2 = 0;
+	for (size_t i = left; i > 8; i--)
+	{
+		k2 ^= uint64_t(tail[i - 1]) << ((i - 9) * 8);
+	}
+	if (left > 8)
+	{
+		k2 *= c2; k2 = Rotate(k2, 33); k2 *= c1; h2 ^= k2;
+	}
+	for (size_t i = left < 8 ? left : 8; i > 0; i--)
+	{
+		k1 ^= uint64_t(tail[i - 1]) << ((i - 1) * 8);
+	}
+	if (left > 0)
+	{
+		k1 *= c1; k1 = Rotate(k1, 31); k1 *= c2; h1 ^= k1;
+	}
+
+	h1 ^= size;
+	h2 ^= size;
+	h1 += h2;
+	h2 += h1;
+	h1 = Mix(h1);
+	h2 = Mix(h2);
+	h1 += h2;
+	h2 += h1;
+	return {h1, h2};
+}
+
+Vfs::ContentCache::ContentCache(std::shared_ptr<PosixFileSystem> fs, const std::string& directory, uint64_t maxBytes)
+	: m_Fs(fs)
+	, m_Directory(directory)
+	, m_MaxBytes(maxBytes)
+	, m_Bytes(0)
+	, m_NextTemporary(0)
+	, m_Stats()
+{
+	if (!m_Fs || !m_Fs->IsWritable())
+	{
+		LOGE("Content cache: %s is not on a writable filesystem", directory.c_str());
+		m_Fs.reset();
+		return;
+	}
+	Scan();
+}
+
+Vfs::Hash128 Vfs::ContentCache::Key(Span source, const std::string& transform)
+{
+	const Hash128 sourceHash = HashBytes(source.data, source.Empty() ? 0 : source.size);
+	const Hash128 transformHash = HashBytes(transform.data(), transform.size());
+	const uint64_t both[4] = {sourceHash.low, sourceHash.high, transformHash.low, transformHash.high};
+	return HashBytes(both, sizeof(both));
+}
+
+std::string Vfs::ContentCache::PathFor(const std::string& name) const
+{
+	return m_Directory.empty() ? name : m_Directory + "/" + name;
+}
+
+void Vfs::ContentCache::Scan()
+{
+	for (const std::string& name : m_Fs->List(m_Directory, false))
+	{
+		const std::string path = m_Fs->HostPath(PathFor(name));
+		if (!IsEntryName(name))
+		{
+			//a store that didn't finish
+			if (name.size() > 4 && name.compare(name.size() - 4, 4, ".tmp") == 0)
+			{
+				remove(path.c_str());
+			}
+			continue;
+		}
+
+		struct stat info;
+		if (stat(path.c_str(), &info) != 0 || !S_ISREG(info.st_mode))
+		{
+			continue;
+		}
+
+		Entry entry;
+		entry.bytes = uint64_t(info.st_size);
+		entry.lastUse = int64_t(info.st_mtim.tv_sec) * 1000000000 + info.st_mtim.tv_nsec;
+		entry.verified = false;
+		m_Entries[name] = entry;
+		m_Bytes += entry.bytes;
+	}
+
+	//the cap may have come down since
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	Evict(std::string());
+}
+
+bool Vfs::ContentCache::Load(const Hash128& key, std::vector<unsigned char>& data)
+{
+	const std::string name = NameFor(key);
+	bool verified;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto entry = m_Entries.find(name);
+		if (entry == m_Entries.end())
+		{
+			m_Stats.misses++;
+			return false;
+		}
+		verified = entry->second.verified;
+	}
+
+	std::shared_ptr<VirtualFile> file = m_Fs->Open(PathFor(name));
+	EntryHeader header;
+	bool valid = file
+		&& file->ReadAt(0, &header, sizeof(header)) == int64_t(sizeof(header))
+		&& header.magic == g_Magic
+		&& header.version == g_Version
+		&& header.key == key
+		&& header.size == uint64_t(file->Size()) - sizeof(header);
+	if (valid)
+	{
+		data.resize(size_t(header.size));
+		valid = header.size == 0 || file->ReadAt(sizeof(header), data.data(), int64_t(header.size)) == int64_t(header.size);
+	}
+	if (valid && !verified)
+	{
+		valid = HashBytes(data.data(), data.size()) == header.content;
+	}
+	file.reset();
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	auto entry = m_Entries.find(name);
+	if (!valid)
+	{
+		LOGW("Content cache: %s doesn't check out, removed", name.c_str());
+		if (entry != m_Entries.end())
+		{
+			m_Bytes -= entry->second.bytes;
+			m_Entries.erase(entry);
+		}
+		m_Fs->Remove(PathFor(name));
+		m_Stats.rejected++;
+		m_Stats.misses++;
+		data.clear();
+		return false;
+	}
+
+	//the modification time is what orders them on the next launch
+	utimensat(AT_FDCWD, m_Fs->HostPath(PathFor(name)).c_str(), nullptr, 0);
+	if (entry != m_Entries.end())
+	{
+		entry->second.lastUse = Now();
+		entry->second.verified = true;
+	}
+	m_Stats.hits++;
+	return true;
+}
+
+bool Vfs::ContentCache::Store(const Hash128& key, const void* data, size_t size)
+{
+	if (!m_Fs)
+	{
+		return false;
+	}
+
+	const std::string name = NameFor(key);
+	std::string temporary;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		//unique, two threads may store the same key
+		temporary = PathFor(name + "." + std::to_string(m_NextTemporary++) + ".tmp");
+	}
+
+	EntryHeader header;
+	header.magic = g_Magic;
+	header.version = g_Version;
+	header.size = size;
+	header.key = key;
+	header.content = HashBytes(data, size);
+
+	std::shared_ptr<PosixFile> file = m_Fs->Create(temporary);
+	bool ok = file
+		&& file->WriteBytes(&header, sizeof(header)) == int64_t(sizeof(header))
+		&& (size == 0 || file->WriteBytes(data, int64_t(size)) == int64_t(size));
+	file.reset();
+
+	if (!ok || rename(m_Fs->HostPath(temporary).c_str(), m_Fs->HostPath(PathFor(name)).c_str()) != 0)
+	{
+		LOGW("Content cache: unable to store %s", name.c_str());
+		m_Fs->Remove(temporary);
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	Entry& entry = m_Entries[name];
+	m_Bytes -= entry.bytes;
+	entry.bytes = sizeof(header) + size;
+	entry.lastUse = Now();
+	entry.verified = true;
+	m_Bytes += entry.bytes;
+	m_Stats.stored++;
+	Evict(name);
+	return true;
+}
+
+bool Vfs::ContentCache::GetOrCreate(const Hash128& key, std::vector<unsigned char>& data,
+	const std::function<bool(std::vector<unsigned char>& data)>& produce)
+{
+	if (Load(key, data))
+	{
+		return true;
+	}
+
+	data.clear();
+	if (!produce(data))
+	{
+		return false;
+	}
+	Store(key, data.data(), data.size());
+	return true;
+}
+
+bool Vfs::ContentCache::Remove(const Hash128& key)
+{
+	const std::string name = NameFor(key);
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	auto entry = m_Entries.find(name);
+	if (entry == m_Entries.end())
+	{
+		return false;
+	}
+
+	m_Bytes -= entry->second.bytes;
+	m_Entries.erase(entry);
+	return m_Fs->Remove(PathFor(name));
+}
+
+void Vfs::ContentCache::Evict(const std::string& keep)
+{
+	while (m_Bytes > m_MaxBytes)
+	{
+		auto oldest = m_Entries.end();
+		for (auto entry = m_Entries.begin(); entry != m_Entries.end(); ++entry)
+		{
+			if (entry->first != keep && (oldest == m_Entries.end() || entry->second.lastUse < oldest->second.lastUse))
+			{
+				oldest = entry;
+			}
+		}
+		if (oldest == m_Entries.end())
+		{
+			break;
+		}
+
+		m_Fs->Remove(PathFor(oldest->first));
+		m_Bytes -= oldest->second.bytes;
+		m_Entries.erase(oldest);
+		m_Stats.evicted++;
+	}
+}
+
+Vfs::ContentCache::Stats Vfs::ContentCache::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Stats;
+}
+
+uint64_t Vfs::ContentCache::Bytes() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Bytes;
+}
+
+size_t Vfs::ContentCache::EntryCount() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Entries.size();
+}
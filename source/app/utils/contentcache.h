@@ -0,0 +1,101 @@
+/* Content-addressed cache
+ *
+ * Keeps the results of expensive steps (decoding, transcoding, extracting)
+ * on local storage across launches. An entry is keyed by a 128-bit hash of
+ * the bytes it was made from and of how it was made, so a changed source or
+ * a changed step never finds a stale result, and nothing has to be told to
+ * invalidate anything.
+ *
+ *   Vfs::ContentCache cache(writableFs, "cas", 64 << 20);
+ *   cache.GetOrCreate(Vfs::ContentCache::Key(png, "rgba8"), pixels, decode);
+ *
+ * Every entry carries a hash of its own bytes as well, checked the first time
+ * it's read after a launch; one that doesn't match is removed and counts as
+ * a miss. The cache stays under maxBytes by removing the least recently used
+ * entries, by file modification time, which a hit moves to now.
+ *
+ * Entries are written to a temporary file and renamed, so a crash never
+ * leaves half of one behind. Safe to use from several threads.
+ */
+#pragma once
+
+#include "vfs.h"
+#include "fs_posix.h"
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+
+namespace Vfs
+{
+	struct Hash128
+	{
+		uint64_t low;
+		uint64_t high;
+
+		bool operator==(const Hash128& other) const { return low == other.low && high == other.high; }
+		bool operator!=(const Hash128& other) const { return !(*this == other); }
+	};
+
+	// MurmurHash3 x64 128, several GB/s, not cryptographic
+	Hash128 HashBytes(const void* data, size_t size, uint32_t seed = 0);
+
+	class ContentCache
+	{
+	public:
+		struct Stats
+		{
+			uint32_t hits;
+			uint32_t misses;
+			// entries that failed their check, or weren't entries at all
+			uint32_t rejected;
+			uint32_t stored;
+			uint32_t evicted;
+		};
+
+		// entries go in directory on fs, which has to be writable; what is
+		// there from earlier launches is picked up
+		ContentCache(std::shared_ptr<PosixFileSystem> fs, const std::string& directory, uint64_t maxBytes);
+
+		// the source bytes and whatever else decides the result: the step,
+		// its version, its settings
+		static Hash128 Key(Span source, const std::string& transform);
+
+		// false on a miss
+		bool Load(const Hash128& key, std::vector<unsigned char>& data);
+		bool Store(const Hash128& key, const void* data, size_t size);
+		// the cached data, or what produce makes of it on a miss, which is
+		// stored then; false if produce fails
+		bool GetOrCreate(const Hash128& key, std::vector<unsigned char>& data,
+			const std::function<bool(std::vector<unsigned char>& data)>& produce);
+		bool Remove(const Hash128& key);
+
+		Stats GetStats() const;
+		// on storage, headers included
+		uint64_t Bytes() const;
+		size_t EntryCount() const;
+
+	private:
+		struct Entry
+		{
+			uint64_t bytes;
+			// nanoseconds since the epoch, the file's modification time
+			int64_t lastUse;
+			bool verified;
+		};
+
+		std::string PathFor(const std::string& name) const;
+		void Scan();
+		// under the lock; down to maxBytes, never the entry just stored
+		void Evict(const std::string& keep);
+
+		std::shared_ptr<PosixFileSystem> m_Fs;
+		std::string m_Directory;
+		uint64_t m_MaxBytes;
+
+		mutable std::mutex m_Mutex;
+		std::unordered_map<std::string, Entry> m_Entries;
+		uint64_t m_Bytes;
+		uint32_t m_NextTemporary;
+		Stats m_Stats;
+	};
+}
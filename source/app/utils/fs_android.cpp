@@ -1,11 +1,107 @@
 #include "utils/fs_android.h"
 #include "utils/make_unique.h"
 #include "utils/log.h"
+#include "utils/fs_pack.h"
+#include "utils/fs_overlay.h"
+#include <algorithm>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace {
+	const uint32_t g_Asset = 0;
+	const uint32_t g_ListedDirectory = 1;
+
+	//whichever is the root, for as long as the app runs
+	std::shared_ptr<Vfs::AndroidFileSystem> g_Assets;
+	std::shared_ptr<Vfs::OverlayFileSystem> g_Overlay;
+}
 
 Vfs::AndroidFile::AndroidFile(AAsset* handle, const AndroidFileSystem& vfs, const std::string& path)
 	: Vfs::VirtualFile(vfs, path, static_cast<char>(FileSystemFlag::Readable))
 	, m_Handle(handle)
+	, m_View()
+	, m_Mapping(nullptr)
+	, m_MappingSize(0)
+{
+}
+
+int64_t Vfs::AndroidFile::ReadBytes(void* data, int64_t size)
+{
+	if (m_Handle == nullptr || size < 0)
+	{
+		return -1;
+	}
+
+	//AAsset_read takes and returns an int
+	const int64_t maxChunk = 1 << 20;
+	char* bytes = static_cast<char*>(data);
+	int64_t read = 0;
+	while (read < size)
+	{
+		const int result = AAsset_read(m_Handle, bytes + read, size_t(std::min(size - read, maxChunk)));
+		if (result < 0)
+		{
+			LOGE("Read from %s failed", Path().c_str());
+			return -1;
+		}
+		if (result == 0)
+		{
+			break;
+		}
+		read += result;
+	}
+	return read;
+}
+
+int64_t Vfs::AndroidFile::ReadAt(int64_t offset, void* data, int64_t size)
+{
+	if (m_Handle == nullptr || offset < 0 || size < 0 || AAsset_seek64(m_Handle, offset, SEEK_SET) < 0)
+	{
+		return -1;
+	}
+	return ReadBytes(data, size);
+}
+
+Vfs::Span Vfs::AndroidFile::Data()
 {
+	if (m_Handle == nullptr || !m_View.Empty())
+	{
+		return m_View;
+	}
+
+	//stored uncompressed: map the range of the APK it's in
+	off64_t start = 0;
+	off64_t length = 0;
+	int fd = AAsset_openFileDescriptor64(m_Handle, &start, &length);
+	if (fd >= 0)
+	{
+		const off64_t pageSize = sysconf(_SC_PAGESIZE);
+		const off64_t alignedStart = start - start % pageSize;
+		const size_t mappingSize = size_t(length + (start - alignedStart));
+		void* mapping = length > 0 ? mmap64(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, alignedStart) : MAP_FAILED;
+		close(fd);
+
+		if (mapping != MAP_FAILED)
+		{
+			m_Mapping = mapping;
+			m_MappingSize = mappingSize;
+			m_View = {static_cast<const unsigned char*>(mapping) + (start - alignedStart), size_t(length)};
+			return m_View;
+		}
+	}
+
+	//compressed, or the mapping failed
+	const void* buffer = AAsset_getBuffer(m_Handle);
+	if (buffer != nullptr)
+	{
+		m_View = {static_cast<const unsigned char*>(buffer), size_t(AAsset_getLength64(m_Handle))};
+	}
+	return m_View;
+}
+
+bool Vfs::AndroidFile::IsMapped() const
+{
+	return m_Mapping != nullptr || (m_View.data != nullptr && !AAsset_isAllocated(m_Handle));
 }
 
 int64_t Vfs::AndroidFile::Size()
@@ -20,26 +116,48 @@ int64_t Vfs::AndroidFile::Size()
 
 Vfs::AndroidFile::~AndroidFile()
 {
+	if (m_Mapping != nullptr)
+	{
+		munmap(m_Mapping, m_MappingSize);
+	}
 	AAsset_close(m_Handle);
 }
 
 Vfs::AndroidFileSystem::AndroidFileSystem(AAssetManager* manager)
-	: m_Manager(manager)
+	: VirtualFileSystem(FileSystemType::AndroidAsset)
+	, m_Manager(manager)
 {}
 
-std::vector<std::string> Vfs::AndroidFileSystem::List()
+std::vector<std::string> Vfs::AndroidFileSystem::List(const std::string& directory, bool recursive)
 {
-	AAssetDir* assetDir = AAssetManager_openDir(m_Manager, "");
-	const char* filename;
 	std::vector<std::string> fileList;
+	std::string path = directory;
+	while (!path.empty() && path.back() == '/')
+	{
+		path.pop_back();
+	}
 
-	while ((filename = AAssetDir_getNextFileName(assetDir)) != NULL) 
+	if (m_Assets.Find(path) == g_ListedDirectory)
 	{
-		fileList.push_back(filename);
+		m_Assets.List(path, recursive, fileList);
+		return fileList;
 	}
 
-	AAssetDir_rewind(assetDir);
+	//not indexed: its files, the asset manager doesn't see directories
+	AAssetDir* assetDir = AAssetManager_openDir(m_Manager, path.c_str());
+	if (assetDir == nullptr)
+	{
+		return fileList;
+	}
 
+	const char* filename;
+	while ((filename = AAssetDir_getNextFileName(assetDir)) != nullptr)
+	{
+		fileList.push_back(filename);
+	}
+	AAssetDir_close(assetDir);
+
+	std::sort(fileList.begin(), fileList.end());
 	return fileList;
 }
 
@@ -51,6 +169,16 @@ std::shared_ptr<Vfs::VirtualFile> Vfs::AndroidFileSystem::Open(const std::string
 
 bool Vfs::AndroidFileSystem::Exists(const std::string& file)
 {
+	const uint32_t entry = m_Assets.Find(file);
+	if (entry == g_Asset)
+	{
+		return true;
+	}
+	if (entry == g_ListedDirectory || m_Assets.Find(PathView(file).Parent()) == g_ListedDirectory)
+	{
+		return false;
+	}
+
 	AAsset *asset = AAssetManager_open(m_Manager, file.c_str(), AASSET_MODE_RANDOM);
 	const bool exists = asset != nullptr;
 	if (exists)
@@ -60,11 +188,67 @@ bool Vfs::AndroidFileSystem::Exists(const std::string& file)
 	return exists;
 }
 
+void Vfs::AndroidFileSystem::Index(const std::vector<std::string>& directories)
+{
+	PathIndex::Builder builder;
+	for (const std::string& directory : directories)
+	{
+		AAssetDir* assetDir = AAssetManager_openDir(m_Manager, directory.c_str());
+		if (assetDir == nullptr)
+		{
+			continue;
+		}
+
+		builder.Add(directory, g_ListedDirectory);
+		const char* filename;
+		while ((filename = AAssetDir_getNextFileName(assetDir)) != nullptr)
+		{
+			builder.Add(directory.empty() ? std::string(filename) : directory + "/" + filename, g_Asset);
+		}
+		AAssetDir_close(assetDir);
+	}
+
+	m_Assets = builder.Build();
+}
+
 void Vfs::AndroidFileSystemSetAsRootJni(JNIEnv *env, jobject assetManagerInstance)
 {
 	AAssetManager* assetManager = AAssetManager_fromJava(env, assetManagerInstance);
-	Vfs::AndroidFileSystem* fs = new Vfs::AndroidFileSystem(assetManager);
-	Vfs::SetRoot(fs);
+	std::shared_ptr<Vfs::AndroidFileSystem> fs(new Vfs::AndroidFileSystem(assetManager));
+	//every directory the build puts assets in
+	fs->Index({"", "shaders"});
+
+	//kept uncompressed in the APK, so it's mapped
+	if (fs->Exists("assets.pack"))
+	{
+		std::shared_ptr<Vfs::PackFileSystem> pack = Vfs::PackFileSystem::Load(fs->Open("assets.pack"));
+		if (pack)
+		{
+			fs->Mount("pack", pack);
+		}
+	}
+	Vfs::SetRoot(fs.get());
+	g_Overlay.reset();
+	g_Assets = fs;
+}
+
+void Vfs::AndroidFileSystemAddWritableLayer(const std::string& directory)
+{
+	if (!g_Assets)
+	{
+		LOGE("No assets to put %s over", directory.c_str());
+		return;
+	}
+
+	std::shared_ptr<Vfs::OverlayFileSystem> overlay = std::make_shared<Vfs::OverlayFileSystem>(
+		std::make_shared<Vfs::PosixFileSystem>(directory, true), std::vector<std::shared_ptr<Vfs::VirtualFileSystem> >(1, g_Assets));
+	Vfs::SetRoot(overlay.get());
+	g_Overlay = overlay;
+}
+
+std::shared_ptr<Vfs::OverlayFileSystem> Vfs::AndroidFileSystemOverlay()
+{
+	return g_Overlay;
 }
 
 extern "C" JNIEXPORT void JNICALL Java_com_example_micha_vulkansink_VulkanActivity_nativeSetAssetManager(JNIEnv* jenv, void* reserved, jobject obj)
@@ -1,11 +1,18 @@
+#pragma once
+
 #include "vfs.h"
 #include <android/asset_manager.h>
 #include <android/asset_manager_jni.h>
-#include <cmath>
 
 namespace Vfs
 {
+	class OverlayFileSystem;
+
 	void AndroidFileSystemSetAsRootJni(JNIEnv *env, jobject assetManagerInstance);
+	// a writable layer in directory over the assets, which becomes the root; after the above
+	void AndroidFileSystemAddWritableLayer(const std::string& directory);
+	// the one made above, nullptr before
+	std::shared_ptr<OverlayFileSystem> AndroidFileSystemOverlay();
 
 	class AndroidFileSystem;
 
@@ -14,6 +21,10 @@ namespace Vfs
 		friend AndroidFileSystem;
 
 		AAsset* m_Handle;
+		// Data(): the asset's own buffer, or a mapping of the APK when it's stored uncompressed
+		Span m_View;
+		void* m_Mapping;
+		size_t m_MappingSize;
 	protected:
 		AndroidFile(AAsset* handle, const AndroidFileSystem& vfs, const std::string& path);
 
@@ -22,31 +33,29 @@ namespace Vfs
 		template <typename T>
 		int64_t Read(T* t, int N = 1)
 		{
-			if (m_Handle == nullptr)
-			{
-				return 0;
-			}
-
-			N = sizeof(T) * N;
-
-			//TODO: auto chunk on 1MB here, when N > 1024000
-			return AAsset_read(m_Handle, t, N);
+			return ReadBytes(t, int64_t(sizeof(T)) * N);
 		}
 
+		// the tail of the last T past the end of the asset is left zero
 		template <typename T>
 		std::vector<T> ToBuffer()
 		{
-			if (m_Handle == nullptr)
-			{
-				return std::vector<T>();
-			}
-
-			int requiredSize = (int)ceil((double)Size() / (double)sizeof(T));
-			std::vector<T> buffer(requiredSize);
-			Read(buffer.data(), requiredSize);
+			const int64_t size = Size();
+			std::vector<T> buffer(size_t((size + int64_t(sizeof(T)) - 1) / int64_t(sizeof(T))));
+			ReadAt(0, buffer.data(), size);
 			return buffer;
 		}
 
+		// at the current position, which it moves, a megabyte per AAsset_read; -1 on error
+		int64_t ReadBytes(void* data, int64_t size);
+		// seeks the asset, Read() goes on from there
+		virtual int64_t ReadAt(int64_t offset, void* data, int64_t size);
+		// no copy for assets stored uncompressed; compressed ones are inflated once,
+		// into memory owned by the asset
+		virtual Span Data();
+		// whether Data() came without a copy
+		bool IsMapped() const;
+
 		virtual int64_t Size();
 		virtual ~AndroidFile();
 	};
@@ -56,10 +65,20 @@ namespace Vfs
 		friend void AndroidFileSystemSetAsRootJni(JNIEnv *env, jobject assetManagerInstance);
 
 		AAssetManager* m_Manager;
+		// the files of the listed directories, and the directories themselves
+		PathIndex m_Assets;
+
 		AndroidFileSystem(AAssetManager*);
 	public:
-		virtual std::vector<std::string> List();
+		// from the index for indexed directories, which only goes as deep as those;
+		// the files of any other directory from the asset manager
+		virtual std::vector<std::string> List(const std::string& directory, bool recursive);
 		virtual std::shared_ptr<VirtualFile> Open(const std::string& file);
+		// answered from the index for files in an indexed directory, by opening them otherwise
 		virtual bool Exists(const std::string& file);
+
+		// lists the directories once, "" being the root; the asset manager can't
+		// find directories by itself
+		void Index(const std::vector<std::string>& directories);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,185 @@
+#include "utils/fs_overlay.h"
+#include "utils/log.h"
+#include <algorithm>
+
+Vfs::OverlayFileSystem::OverlayFileSystem(std::shared_ptr<PosixFileSystem> writable, std::vector<std::shared_ptr<VirtualFileSystem> > readOnly)
+	: VirtualFileSystem(FileSystemType::Overlay)
+	, m_Writable(writable)
+	, m_Misses(0)
+{
+	if (m_Writable)
+	{
+		m_Layers.push_back(m_Writable);
+	}
+	for (const std::shared_ptr<VirtualFileSystem>& layer : readOnly)
+	{
+		if (layer)
+		{
+			m_Layers.push_back(layer);
+		}
+	}
+	ResolveLayerMounts();
+}
+
+void Vfs::OverlayFileSystem::ResolveLayerMounts()
+{
+	//bottom first, a higher layer's mount at the same path replaces it
+	MountList layerMounts;
+	for (auto layer = m_Layers.rbegin(); layer != m_Layers.rend(); ++layer)
+	{
+		const MountList mounts = (*layer)->Mounts();
+		layerMounts.insert(layerMounts.end(), mounts.begin(), mounts.end());
+	}
+
+	//rebuilt only when they changed, like Mount() that isn't safe while other threads look paths up
+	if (layerMounts != m_LayerMounts)
+	{
+		m_LayerMounts.swap(layerMounts);
+		BuildMountIndex();
+	}
+}
+
+void Vfs::OverlayFileSystem::BuildMountIndex()
+{
+	VirtualDirectory::BuildMountIndex(m_LayerMounts);
+}
+
+int Vfs::OverlayFileSystem::Resolve(const std::string& file)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto resolved = m_Resolved.find(file);
+		if (resolved != m_Resolved.end())
+		{
+			return resolved->second;
+		}
+	}
+
+	int found = NoLayer;
+	for (size_t i = 0; i < m_Layers.size() && found == NoLayer; i++)
+	{
+		if (m_Layers[i]->Exists(file))
+		{
+			found = int(i);
+		}
+	}
+
+	Remember(file, found);
+	return found;
+}
+
+void Vfs::OverlayFileSystem::Remember(const std::string& file, int layer)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	//probes for files that aren't there would grow it without end
+	if (layer == NoLayer && m_Misses >= MaxMisses)
+	{
+		for (auto resolved = m_Resolved.begin(); resolved != m_Resolved.end();)
+		{
+			resolved = resolved->second == NoLayer ? m_Resolved.erase(resolved) : std::next(resolved);
+		}
+		m_Misses = 0;
+	}
+
+	auto resolved = m_Resolved.insert(std::make_pair(file, layer));
+	if (!resolved.second)
+	{
+		if (resolved.first->second == NoLayer)
+		{
+			m_Misses--;
+		}
+		resolved.first->second = layer;
+	}
+	if (layer == NoLayer)
+	{
+		m_Misses++;
+	}
+}
+
+void Vfs::OverlayFileSystem::Forget(const std::string& file)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	auto resolved = m_Resolved.find(file);
+	if (resolved != m_Resolved.end())
+	{
+		if (resolved->second == NoLayer)
+		{
+			m_Misses--;
+		}
+		m_Resolved.erase(resolved);
+	}
+}
+
+std::vector<std::string> Vfs::OverlayFileSystem::List(const std::string& directory, bool recursive)
+{
+	std::vector<std::string> fileList;
+	for (const std::shared_ptr<VirtualFileSystem>& layer : m_Layers)
+	{
+		std::vector<std::string> layerList = layer->List(directory, recursive);
+		fileList.insert(fileList.end(), layerList.begin(), layerList.end());
+	}
+
+	std::sort(fileList.begin(), fileList.end());
+	fileList.erase(std::unique(fileList.begin(), fileList.end()), fileList.end());
+	return fileList;
+}
+
+std::shared_ptr<Vfs::VirtualFile> Vfs::OverlayFileSystem::Open(const std::string& file)
+{
+	const int layer = Resolve(file);
+	if (layer == NoLayer)
+	{
+		return std::shared_ptr<VirtualFile>();
+	}
+
+	std::shared_ptr<VirtualFile> opened = m_Layers[layer]->Open(file);
+	if (!opened)
+	{
+		//gone since it was resolved
+		Forget(file);
+	}
+	return opened;
+}
+
+bool Vfs::OverlayFileSystem::Exists(const std::string& file)
+{
+	return Resolve(file) != NoLayer;
+}
+
+std::shared_ptr<Vfs::PosixFile> Vfs::OverlayFileSystem::Create(const std::string& file, WriteMode mode)
+{
+	if (!m_Writable)
+	{
+		LOGE("Unable to create %s, the overlay has no writable layer", file.c_str());
+		return std::shared_ptr<PosixFile>();
+	}
+
+	std::shared_ptr<PosixFile> created = m_Writable->Create(file, mode);
+	if (created)
+	{
+		Remember(file, 0);
+	}
+	return created;
+}
+
+bool Vfs::OverlayFileSystem::Remove(const std::string& file)
+{
+	const bool removed = m_Writable && m_Writable->Remove(file);
+	Forget(file);
+	return removed;
+}
+
+void Vfs::OverlayFileSystem::Invalidate()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Resolved.clear();
+		m_Misses = 0;
+	}
+	ResolveLayerMounts();
+}
+
+std::shared_ptr<Vfs::PosixFileSystem> Vfs::OverlayFileSystem::WritableLayer() const
+{
+	return m_Writable;
+}
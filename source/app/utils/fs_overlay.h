@@ -0,0 +1,72 @@
+/* Overlay filesystem
+ *
+ * A union of filesystems on one mount point: a writable POSIX directory on
+ * top of read-only layers, the APK assets say. A file in the writable layer
+ * hides one of the same path below it, so pipeline caches, program binaries,
+ * downloads and transcoded textures can be written next to (or over) what
+ * shipped, and read back through the same paths. Filesystems mounted in a
+ * layer (a pack in the assets) are still found through the overlay: they are
+ * put in the overlay's own mount index, with a higher layer's winning, when
+ * it's made and on Invalidate().
+ *
+ * Which layer has a path is remembered, and the last MaxMisses paths no
+ * layer has, so after the first lookup Open() and Exists() cost a hash
+ * lookup on top of what a single mount costs. Create() and Remove() keep
+ * that up to date; Invalidate() after writing to the layers (or mounting in
+ * them) behind the overlay's back.
+ *
+ * Removing a file only removes it from the writable layer; one of the same
+ * path below shows through again.
+ */
+#pragma once
+
+#include "vfs.h"
+#include "fs_posix.h"
+#include <mutex>
+#include <unordered_map>
+
+namespace Vfs
+{
+	class OverlayFileSystem : public VirtualFileSystem
+	{
+		std::shared_ptr<PosixFileSystem> m_Writable;
+		// top first, the writable one included
+		std::vector<std::shared_ptr<VirtualFileSystem> > m_Layers;
+
+		// what is mounted in the layers, by path in the overlay
+		MountList m_LayerMounts;
+
+		std::mutex m_Mutex;
+		// path to layer, NoLayer for paths no layer has
+		std::unordered_map<std::string, int> m_Resolved;
+		// NoLayer entries in m_Resolved, dropped all at once past MaxMisses
+		size_t m_Misses;
+
+		// the layer with file, NoLayer if none
+		int Resolve(const std::string& file);
+		void Remember(const std::string& file, int layer);
+		void Forget(const std::string& file);
+		void ResolveLayerMounts();
+	protected:
+		virtual void BuildMountIndex();
+	public:
+		static const int NoLayer = -1;
+		static const size_t MaxMisses = 4096;
+
+		// writable may be nullptr for a read-only union; layers are read top first
+		OverlayFileSystem(std::shared_ptr<PosixFileSystem> writable, std::vector<std::shared_ptr<VirtualFileSystem> > readOnly);
+
+		// every layer's files, each path once
+		virtual std::vector<std::string> List(const std::string& directory, bool recursive);
+		virtual std::shared_ptr<VirtualFile> Open(const std::string& file);
+		virtual bool Exists(const std::string& file);
+
+		// in the writable layer; nullptr without one
+		std::shared_ptr<PosixFile> Create(const std::string& file, WriteMode mode = WriteMode::Truncate);
+		bool Remove(const std::string& file);
+		// after the layers changed other than through Create() and Remove()
+		void Invalidate();
+
+		std::shared_ptr<PosixFileSystem> WritableLayer() const;
+	};
+}
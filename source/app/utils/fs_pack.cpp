@@ -0,0 +1,235 @@
+#include "utils/fs_pack.h"
+#include "utils/lz4.h"
+#include "utils/log.h"
+#include <algorithm>
+
+Vfs::PackFile::PackFile(std::shared_ptr<VirtualFile> pack, const AssetPack::Entry& entry, Span stored, const PackFileSystem& vfs, const std::string& path)
+	: Vfs::VirtualFile(vfs, path, static_cast<char>(FileSystemFlag::Readable))
+	, m_Pack(pack)
+	, m_Entry(entry)
+	, m_Stored(stored)
+	, m_Position(0)
+{
+}
+
+int64_t Vfs::PackFile::ReadBytes(void* data, int64_t size)
+{
+	const Span file = Data();
+	if (file.Empty() && m_Entry.size > 0)
+	{
+		return -1;
+	}
+
+	const int64_t left = int64_t(file.size) - m_Position;
+	if (size > left)
+	{
+		size = left;
+	}
+	if (size <= 0)
+	{
+		return 0;
+	}
+
+	memcpy(data, file.data + m_Position, (size_t)size);
+	m_Position += size;
+	return size;
+}
+
+bool Vfs::PackFile::Seek(int64_t position)
+{
+	if (position < 0)
+	{
+		return false;
+	}
+	m_Position = position;
+	return true;
+}
+
+int64_t Vfs::PackFile::Tell() const
+{
+	return m_Position;
+}
+
+Vfs::Span Vfs::PackFile::Data()
+{
+	if (m_Entry.compression == AssetPack::Compression::None)
+	{
+		return m_Stored;
+	}
+
+	if (m_Inflated.empty() && m_Entry.size > 0)
+	{
+		m_Inflated.resize((size_t)m_Entry.size);
+		if (!Lz4::Decompress(m_Stored.data, m_Stored.size, m_Inflated.data(), m_Inflated.size()))
+		{
+			LOGE("Pack entry %s doesn't inflate", Path().c_str());
+			m_Inflated.clear();
+		}
+	}
+	return {m_Inflated.data(), m_Inflated.size()};
+}
+
+bool Vfs::PackFile::IsCompressed() const
+{
+	return m_Entry.compression != AssetPack::Compression::None;
+}
+
+int64_t Vfs::PackFile::Size()
+{
+	return (int64_t)m_Entry.size;
+}
+
+Vfs::PackFileSystem::PackFileSystem(std::shared_ptr<VirtualFile> pack, Span data)
+	: VirtualFileSystem(FileSystemType::Pack)
+	, m_Pack(pack)
+	, m_Data(data)
+	, m_Names(nullptr)
+{
+}
+
+std::shared_ptr<Vfs::PackFileSystem> Vfs::PackFileSystem::Load(std::shared_ptr<VirtualFile> pack)
+{
+	if (!pack)
+	{
+		return std::shared_ptr<PackFileSystem>();
+	}
+
+	const Span data = pack->Data();
+	if (data.Empty())
+	{
+		LOGE("Pack %s can't be mapped", pack->Path().c_str());
+		return std::shared_ptr<PackFileSystem>();
+	}
+
+	std::shared_ptr<PackFileSystem> fs(new PackFileSystem(pack, data));
+	if (!fs->Validate())
+	{
+		LOGE("%s is not a valid pack", pack->Path().c_str());
+		return std::shared_ptr<PackFileSystem>();
+	}
+	return fs;
+}
+
+bool Vfs::PackFileSystem::Validate()
+{
+	AssetPack::Header header;
+	if (m_Data.size < sizeof(header))
+	{
+		return false;
+	}
+	//the view needn't be aligned for them, copied out
+	memcpy(&header, m_Data.data, sizeof(header));
+	if (header.magic != AssetPack::Magic || header.version != AssetPack::Version)
+	{
+		return false;
+	}
+
+	const uint64_t indexEnd = sizeof(header) + uint64_t(header.entryCount) * sizeof(AssetPack::Entry);
+	if (indexEnd > m_Data.size || header.namesOffset < indexEnd || header.namesOffset > m_Data.size
+		|| header.namesSize > m_Data.size - header.namesOffset)
+	{
+		return false;
+	}
+
+	m_Entries.resize(header.entryCount);
+	if (!m_Entries.empty())
+	{
+		memcpy(m_Entries.data(), m_Data.data + sizeof(header), m_Entries.size() * sizeof(AssetPack::Entry));
+	}
+	m_Names = reinterpret_cast<const char*>(m_Data.data + header.namesOffset);
+
+	for (size_t i = 0; i < m_Entries.size(); i++)
+	{
+		const AssetPack::Entry& entry = m_Entries[i];
+		if (entry.offset > m_Data.size || entry.storedSize > m_Data.size - entry.offset
+			|| uint64_t(entry.nameOffset) + entry.nameLength > header.namesSize
+			|| (entry.compression != AssetPack::Compression::None && entry.compression != AssetPack::Compression::Lz4)
+			|| (entry.compression == AssetPack::Compression::None && entry.storedSize != entry.size)
+			|| (i > 0 && m_Entries[i - 1].hash > entry.hash))
+		{
+			return false;
+		}
+	}
+
+	PathIndex::Builder tree;
+	for (size_t i = 0; i < m_Entries.size(); i++)
+	{
+		tree.Add(PathView(m_Names + m_Entries[i].nameOffset, m_Entries[i].nameLength), (uint32_t)i);
+	}
+	m_Tree = tree.Build();
+	return true;
+}
+
+const AssetPack::Entry* Vfs::PackFileSystem::Find(PathView path) const
+{
+	while (path.size > 0 && path.data[0] == '/')
+	{
+		path = PathView(path.data + 1, path.size - 1);
+	}
+
+	const uint64_t hash = AssetPack::HashPath(path);
+	std::vector<AssetPack::Entry>::const_iterator entry = std::lower_bound(m_Entries.begin(), m_Entries.end(), hash,
+		[](const AssetPack::Entry& entry, uint64_t hash)
+	{
+		return entry.hash < hash;
+	});
+
+	for (; entry != m_Entries.end() && entry->hash == hash; ++entry)
+	{
+		if (PathView(m_Names + entry->nameOffset, entry->nameLength) == path)
+		{
+			return &*entry;
+		}
+	}
+	return nullptr;
+}
+
+std::vector<std::string> Vfs::PackFileSystem::List(const std::string& directory, bool recursive)
+{
+	std::vector<std::string> fileList;
+	m_Tree.List(directory, recursive, fileList);
+	return fileList;
+}
+
+std::shared_ptr<Vfs::VirtualFile> Vfs::PackFileSystem::Open(const std::string& file)
+{
+	const AssetPack::Entry* entry = Find(file);
+	if (entry == nullptr)
+	{
+		return std::shared_ptr<VirtualFile>();
+	}
+
+	const Span stored = {m_Data.data + entry->offset, (size_t)entry->storedSize};
+	return std::shared_ptr<PackFile>(new PackFile(m_Pack, *entry, stored, *this, file));
+}
+
+bool Vfs::PackFileSystem::Exists(const std::string& file)
+{
+	return Find(file) != nullptr;
+}
+
+bool Vfs::PackFileSystem::Locate(const std::string& file, uint64_t& offset, uint64_t& size) const
+{
+	const AssetPack::Entry* entry = Find(file);
+	if (entry == nullptr || entry->compression != AssetPack::Compression::None)
+	{
+		return false;
+	}
+	offset = entry->offset;
+	size = entry->size;
+	return true;
+}
+
+int64_t Vfs::PackFileSystem::ReadRaw(uint64_t offset, void* data, uint64_t size) const
+{
+	if (offset >= m_Data.size)
+	{
+		return 0;
+	}
+	if (size > m_Data.size - offset)
+	{
+		size = m_Data.size - offset;
+	}
+	memcpy(data, m_Data.data + offset, (size_t)size);
+	return (int64_t)size;
+}
@@ -0,0 +1,94 @@
+/* Pack filesystem
+ *
+ * Serves an asset pack (assetpack.h) through Vfs. The pack is read through
+ * the Data() view of the file it lives in, so a pack stored uncompressed in
+ * the APK or lying on disk is mapped, never read in. Stored entries are
+ * views into that mapping; LZ4 ones are inflated the first time they're
+ * read, into memory the open file owns. Mount it like any filesystem:
+ *
+ *   root->Mount("pack", Vfs::PackFileSystem::Load(root->Open("assets.pack")));
+ *
+ * after which Vfs::Open("pack/shaders/...") comes out of the pack.
+ */
+#pragma once
+
+#include "vfs.h"
+#include "assetpack.h"
+#include <cstring>
+
+namespace Vfs
+{
+	class PackFileSystem;
+
+	class PackFile : public VirtualFile
+	{
+		friend PackFileSystem;
+
+		// keeps the mapping alive
+		std::shared_ptr<VirtualFile> m_Pack;
+		const AssetPack::Entry m_Entry;
+		Span m_Stored;
+		std::vector<unsigned char> m_Inflated;
+		int64_t m_Position;
+	protected:
+		PackFile(std::shared_ptr<VirtualFile> pack, const AssetPack::Entry& entry, Span stored, const PackFileSystem& vfs, const std::string& path);
+
+	public:
+		template <typename T>
+		int64_t Read(T* t, int N = 1)
+		{
+			return ReadBytes(t, int64_t(sizeof(T)) * N);
+		}
+
+		// the tail of the last T past the end of the entry is left zero
+		template <typename T>
+		std::vector<T> ToBuffer()
+		{
+			const Span data = Data();
+			const int64_t size = int64_t(data.size);
+			std::vector<T> buffer(size_t((size + int64_t(sizeof(T)) - 1) / int64_t(sizeof(T))));
+			if (!data.Empty())
+			{
+				memcpy(buffer.data(), data.data, data.size);
+			}
+			return buffer;
+		}
+
+		// at the current position, which it moves; -1 if the entry doesn't inflate
+		int64_t ReadBytes(void* data, int64_t size);
+		bool Seek(int64_t position);
+		int64_t Tell() const;
+
+		virtual Span Data();
+		bool IsCompressed() const;
+
+		virtual int64_t Size();
+	};
+
+	class PackFileSystem : public VirtualFileSystem
+	{
+		std::shared_ptr<VirtualFile> m_Pack;
+		Span m_Data;
+		std::vector<AssetPack::Entry> m_Entries;
+		const char* m_Names;
+		// the entry names as directories, for List()
+		PathIndex m_Tree;
+
+		PackFileSystem(std::shared_ptr<VirtualFile> pack, Span data);
+		bool Validate();
+		const AssetPack::Entry* Find(PathView path) const;
+	public:
+		// nullptr if there is no pack, it has no Data() view, or it doesn't check out
+		static std::shared_ptr<PackFileSystem> Load(std::shared_ptr<VirtualFile> pack);
+
+		// from a tree built when the pack is loaded
+		virtual std::vector<std::string> List(const std::string& directory, bool recursive);
+		virtual std::shared_ptr<VirtualFile> Open(const std::string& file);
+		virtual bool Exists(const std::string& file);
+
+		// where a stored entry is in the pack; false for compressed or unknown ones
+		bool Locate(const std::string& file, uint64_t& offset, uint64_t& size) const;
+		// straight from the pack, from any thread; the bytes read
+		int64_t ReadRaw(uint64_t offset, void* data, uint64_t size) const;
+	};
+}
@@ -0,0 +1,372 @@
+#include "utils/fs_posix.h"
+#include "utils/log.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+	char Flags(bool writable)
+	{
+		char flags = static_cast<char>(Vfs::FileSystemFlag::Readable);
+		if (writable)
+		{
+			flags |= static_cast<char>(Vfs::FileSystemFlag::Writeable);
+		}
+		return flags;
+	}
+
+	//what an unsized file is read to at most, so a device that never ends doesn't take all memory
+	const size_t g_MaxUnsizedBytes = size_t(64) << 20;
+}
+
+Vfs::PosixFile::PosixFile(int fd, int64_t size, bool writable, const PosixFileSystem& vfs, const std::string& path)
+	: Vfs::VirtualFile(vfs, path, Flags(writable))
+	, m_Fd(fd)
+	, m_Size(size)
+	, m_Position(0)
+	, m_Mapped(nullptr)
+{
+	//writable files change under a mapping, they stay on pread / pwrite
+	if (!writable && size > 0)
+	{
+		void* mapped = mmap(nullptr, (size_t)size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapped != MAP_FAILED)
+		{
+			m_Mapped = static_cast<const unsigned char*>(mapped);
+		}
+		else
+		{
+			LOGW("Unable to map %s (%s), reading it instead", path.c_str(), strerror(errno));
+		}
+	}
+}
+
+bool Vfs::PosixFile::Load()
+{
+	//from the descriptor's own position, which is the start: pipes can't pread
+	unsigned char buffer[16384];
+	for (;;)
+	{
+		ssize_t result = read(m_Fd, buffer, sizeof(buffer));
+		if (result < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			LOGE("Read from %s failed: %s", Path().c_str(), strerror(errno));
+			return false;
+		}
+		if (result == 0)
+		{
+			break;
+		}
+		m_Contents.insert(m_Contents.end(), buffer, buffer + result);
+		if (m_Contents.size() >= g_MaxUnsizedBytes)
+		{
+			LOGW("%s doesn't end, reading the first %zu bytes of it", Path().c_str(), g_MaxUnsizedBytes);
+			m_Contents.resize(g_MaxUnsizedBytes);
+			break;
+		}
+	}
+	m_Size = (int64_t)m_Contents.size();
+	return true;
+}
+
+int64_t Vfs::PosixFile::ReadBytes(void* data, int64_t size)
+{
+	int64_t read = ReadAt(m_Position, data, size);
+	if (read > 0)
+	{
+		m_Position += read;
+	}
+	return read;
+}
+
+int64_t Vfs::PosixFile::WriteBytes(const void* data, int64_t size)
+{
+	if (!HasFlag(FileSystemFlag::Writeable))
+	{
+		return -1;
+	}
+
+	const char* bytes = static_cast<const char*>(data);
+	int64_t written = 0;
+	while (written < size)
+	{
+		ssize_t result = pwrite(m_Fd, bytes + written, (size_t)(size - written), (off_t)(m_Position + written));
+		if (result < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			LOGE("Write to %s failed: %s", Path().c_str(), strerror(errno));
+			return -1;
+		}
+		written += result;
+	}
+
+	m_Position += written;
+	if (m_Position > m_Size)
+	{
+		m_Size = m_Position;
+	}
+	return written;
+}
+
+int64_t Vfs::PosixFile::ReadAt(int64_t offset, void* data, int64_t size)
+{
+	if (offset < 0 || size < 0 || (m_Size < 0 && !Load()))
+	{
+		return -1;
+	}
+	if (offset >= m_Size)
+	{
+		return 0;
+	}
+	if (size > m_Size - offset)
+	{
+		size = m_Size - offset;
+	}
+
+	if (m_Mapped)
+	{
+		memcpy(data, m_Mapped + offset, (size_t)size);
+		return size;
+	}
+	if (!m_Contents.empty())
+	{
+		memcpy(data, m_Contents.data() + offset, (size_t)size);
+		return size;
+	}
+
+	char* bytes = static_cast<char*>(data);
+	int64_t read = 0;
+	while (read < size)
+	{
+		ssize_t result = pread(m_Fd, bytes + read, (size_t)(size - read), (off_t)(offset + read));
+		if (result < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			LOGE("Read from %s failed: %s", Path().c_str(), strerror(errno));
+			return -1;
+		}
+		if (result == 0)
+		{
+			//shorter than it was, or than it says
+			break;
+		}
+		read += result;
+	}
+	return read;
+}
+
+bool Vfs::PosixFile::Seek(int64_t position)
+{
+	if (position < 0)
+	{
+		return false;
+	}
+	m_Position = position;
+	return true;
+}
+
+int64_t Vfs::PosixFile::Tell() const
+{
+	return m_Position;
+}
+
+Vfs::Span Vfs::PosixFile::Data()
+{
+	if (m_Mapped)
+	{
+		return {m_Mapped, (size_t)m_Size};
+	}
+	if ((m_Size < 0 && !Load()) || m_Contents.empty())
+	{
+		return {nullptr, 0};
+	}
+	return {m_Contents.data(), m_Contents.size()};
+}
+
+bool Vfs::PosixFile::IsMapped() const
+{
+	return m_Mapped != nullptr;
+}
+
+bool Vfs::PosixFile::IsWritable() const
+{
+	return HasFlag(FileSystemFlag::Writeable);
+}
+
+int64_t Vfs::PosixFile::Size()
+{
+	if (m_Size < 0 && !Load())
+	{
+		return 0;
+	}
+	return m_Size;
+}
+
+Vfs::PosixFile::~PosixFile()
+{
+	if (m_Mapped)
+	{
+		munmap(const_cast<unsigned char*>(m_Mapped), (size_t)m_Size);
+	}
+	close(m_Fd);
+}
+
+Vfs::PosixFileSystem::PosixFileSystem(const std::string& directory, bool writable)
+	: VirtualFileSystem(FileSystemType::Posix)
+	, m_Directory(directory)
+	, m_Writable(writable)
+{
+	while (m_Directory.size() > 1 && m_Directory.back() == '/')
+	{
+		m_Directory.pop_back();
+	}
+}
+
+std::vector<std::string> Vfs::PosixFileSystem::List(const std::string& directory, bool recursive)
+{
+	std::vector<std::string> fileList;
+	const std::string top = directory.empty() || directory.back() == '/' ? directory : directory + "/";
+
+	//read as it is, the directory may be written to; relative to top
+	std::vector<std::string> pending(1, std::string());
+	while (!pending.empty())
+	{
+		const std::string below = pending.back();
+		pending.pop_back();
+
+		const std::string path = HostPath(top + below);
+		DIR* dir = opendir(path.empty() ? "." : path.c_str());
+		if (dir == nullptr)
+		{
+			continue;
+		}
+
+		while (dirent* entry = readdir(dir))
+		{
+			if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+			{
+				continue;
+			}
+
+			std::string name = below + entry->d_name;
+			struct stat info;
+			if (stat(HostPath(top + name).c_str(), &info) == 0 && S_ISDIR(info.st_mode))
+			{
+				name += '/';
+				if (recursive)
+				{
+					pending.push_back(name);
+				}
+			}
+			fileList.push_back(name);
+		}
+		closedir(dir);
+	}
+
+	std::sort(fileList.begin(), fileList.end());
+	return fileList;
+}
+
+std::shared_ptr<Vfs::VirtualFile> Vfs::PosixFileSystem::Open(const std::string& file)
+{
+	const std::string path = HostPath(file);
+	int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return std::shared_ptr<VirtualFile>();
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || S_ISDIR(info.st_mode))
+	{
+		close(fd);
+		return std::shared_ptr<VirtualFile>();
+	}
+
+	//a regular file that says it's empty may be a /proc one that isn't
+	const int64_t size = S_ISREG(info.st_mode) && info.st_size > 0 ? (int64_t)info.st_size : -1;
+	return std::shared_ptr<PosixFile>(new PosixFile(fd, size, false, *this, file));
+}
+
+bool Vfs::PosixFileSystem::Exists(const std::string& file)
+{
+	return access(HostPath(file).c_str(), F_OK) == 0;
+}
+
+std::shared_ptr<Vfs::PosixFile> Vfs::PosixFileSystem::Create(const std::string& file, WriteMode mode)
+{
+	if (!m_Writable)
+	{
+		LOGE("Unable to create %s, the filesystem is read-only", file.c_str());
+		return std::shared_ptr<PosixFile>();
+	}
+
+	const std::string path = HostPath(file);
+	//the directories on the way, from the filesystem's own on
+	for (std::string::size_type slash = path.find('/', std::max(m_Directory.size(), size_t(1))); slash != std::string::npos; slash = path.find('/', slash + 1))
+	{
+		const std::string directory = path.substr(0, slash);
+		if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST)
+		{
+			LOGE("Unable to create %s: %s", directory.c_str(), strerror(errno));
+			return std::shared_ptr<PosixFile>();
+		}
+	}
+
+	//not O_APPEND, under which Linux pwrite ignores the offset: Append starts at the end instead
+	int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC | (mode == WriteMode::Truncate ? O_TRUNC : 0), 0644);
+	if (fd < 0)
+	{
+		LOGE("Unable to create %s: %s", path.c_str(), strerror(errno));
+		return std::shared_ptr<PosixFile>();
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || !S_ISREG(info.st_mode))
+	{
+		LOGE("Unable to write %s, not a regular file", path.c_str());
+		close(fd);
+		return std::shared_ptr<PosixFile>();
+	}
+
+	std::shared_ptr<PosixFile> created(new PosixFile(fd, (int64_t)info.st_size, true, *this, file));
+	if (mode == WriteMode::Append)
+	{
+		created->Seek(created->Size());
+	}
+	return created;
+}
+
+bool Vfs::PosixFileSystem::Remove(const std::string& file)
+{
+	return m_Writable && unlink(HostPath(file).c_str()) == 0;
+}
+
+std::string Vfs::PosixFileSystem::HostPath(const std::string& file) const
+{
+	if (m_Directory.empty())
+	{
+		return file;
+	}
+	return m_Directory + "/" + file;
+}
+
+bool Vfs::PosixFileSystem::IsWritable() const
+{
+	return m_Writable;
+}
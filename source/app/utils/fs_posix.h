@@ -0,0 +1,110 @@
+/* POSIX filesystem
+ *
+ * A Vfs backend over a directory of the host filesystem, so the same asset
+ * code runs (and can be measured) on a Linux host, or against the app's own
+ * files on the device. Read-only files are mapped whole; Data() hands out the
+ * mapping without a copy and Read() copies out of it. Writable files go
+ * through pread / pwrite instead, and Data() is empty for them. Files whose
+ * size isn't known up front (pipes, special files, /proc files that say 0)
+ * are read until EOF on the first Size() or read, and kept in memory.
+ */
+#pragma once
+
+#include "vfs.h"
+
+namespace Vfs
+{
+	class PosixFileSystem;
+
+	class PosixFile : public VirtualFile
+	{
+		friend PosixFileSystem;
+
+		int m_Fd;
+		// -1 until the unsized file is read
+		int64_t m_Size;
+		int64_t m_Position;
+		const unsigned char* m_Mapped;
+		std::vector<unsigned char> m_Contents;
+
+		// reads an unsized file whole
+		bool Load();
+	protected:
+		// size -1 if it isn't known
+		PosixFile(int fd, int64_t size, bool writable, const PosixFileSystem& vfs, const std::string& path);
+
+	public:
+		template <typename T>
+		int64_t Read(T* t, int N = 1)
+		{
+			return ReadBytes(t, int64_t(sizeof(T)) * N);
+		}
+
+		// Write(t) of a single T as well
+		using VirtualFile::Write;
+		template <typename T>
+		int64_t Write(const T* t, int N = 1)
+		{
+			return WriteBytes(t, int64_t(sizeof(T)) * N);
+		}
+
+		// the tail of the last T past the end of the file is left zero
+		template <typename T>
+		std::vector<T> ToBuffer()
+		{
+			const int64_t size = Size();
+			std::vector<T> buffer(size_t((size + int64_t(sizeof(T)) - 1) / int64_t(sizeof(T))));
+			ReadAt(0, buffer.data(), size);
+			return buffer;
+		}
+
+		// at the current position, which they move; -1 on error
+		int64_t ReadBytes(void* data, int64_t size);
+		virtual int64_t WriteBytes(const void* data, int64_t size);
+		virtual int64_t ReadAt(int64_t offset, void* data, int64_t size);
+
+		bool Seek(int64_t position);
+		int64_t Tell() const;
+
+		// empty unless it's mapped, or was read whole
+		virtual Span Data();
+		bool IsMapped() const;
+		bool IsWritable() const;
+
+		virtual int64_t Size();
+		virtual ~PosixFile();
+	};
+
+	enum class WriteMode
+	{
+		// emptied first
+		Truncate,
+		// kept as it is, written from the start
+		Update,
+		// kept as it is, written from its end on
+		Append,
+	};
+
+	class PosixFileSystem : public VirtualFileSystem
+	{
+		std::string m_Directory;
+		bool m_Writable;
+
+	public:
+		// paths are relative to 'directory'; only a writable one creates and writes files
+		PosixFileSystem(const std::string& directory, bool writable = false);
+
+		virtual std::vector<std::string> List(const std::string& directory, bool recursive);
+		virtual std::shared_ptr<VirtualFile> Open(const std::string& file);
+		virtual bool Exists(const std::string& file);
+
+		// opened for reading and writing, created with any missing directories on
+		// the way if it isn't there; nullptr if the filesystem is read-only. Open()
+		// is read-only whatever the filesystem is.
+		std::shared_ptr<PosixFile> Create(const std::string& file, WriteMode mode = WriteMode::Truncate);
+		bool Remove(const std::string& file);
+
+		std::string HostPath(const std::string& file) const;
+		bool IsWritable() const;
+	};
+}
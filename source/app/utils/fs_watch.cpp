@@ -0,0 +1,299 @@
+#include "utils/fs_watch.h"
+#include "utils/log.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
+
+namespace {
+#ifdef __linux__
+	//files are reported once written, not on creation, so a half-written one isn't picked up
+	const uint32_t g_WatchMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ONLYDIR;
+#endif
+
+	std::string HostDirectory(const Vfs::PosixFileSystem& fs, const std::string& directory)
+	{
+		const std::string path = fs.HostPath(directory);
+		return path.empty() ? "." : path;
+	}
+}
+
+Vfs::FileWatcher::FileWatcher(std::shared_ptr<PosixFileSystem> fs, const std::string& prefix,
+	unsigned debounceMilliseconds, unsigned maxDelayMilliseconds)
+	: m_Fs(fs)
+	, m_Prefix(prefix)
+	, m_DebounceSeconds(debounceMilliseconds / 1000.0)
+	, m_MaxDelaySeconds(maxDelayMilliseconds / 1000.0)
+	, m_Fd(-1)
+	, m_NextSubscription(InvalidSubscription + 1)
+	, m_Stats()
+{
+	if (!m_Fs)
+	{
+		LOGE("FileWatcher: no filesystem");
+		return;
+	}
+
+#ifdef __linux__
+	m_Fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_Fd < 0)
+	{
+		LOGW("FileWatcher: no inotify: %s", strerror(errno));
+		return;
+	}
+
+	//so what is put there later is seen
+	if (m_Fs->IsWritable() && mkdir(HostDirectory(*m_Fs, "").c_str(), 0755) != 0 && errno != EEXIST)
+	{
+		LOGW("FileWatcher: unable to create %s: %s", HostDirectory(*m_Fs, "").c_str(), strerror(errno));
+	}
+
+	Watch("", false);
+	if (m_Watches.empty())
+	{
+		close(m_Fd);
+		m_Fd = -1;
+		return;
+	}
+	LOGI("FileWatcher: watching %u directories in %s", m_Stats.directories, HostDirectory(*m_Fs, "").c_str());
+#else
+	LOGW("FileWatcher: no inotify on this platform");
+#endif
+}
+
+Vfs::FileWatcher::~FileWatcher()
+{
+	if (m_Fd >= 0)
+	{
+		close(m_Fd);
+	}
+}
+
+Vfs::SubscriptionId Vfs::FileWatcher::Subscribe(const std::string& prefix, ChangeCallback callback)
+{
+	const SubscriptionId id = m_NextSubscription++;
+	Subscription& subscription = m_Subscriptions[id];
+	subscription.prefix = prefix;
+	subscription.callback = callback;
+	return id;
+}
+
+void Vfs::FileWatcher::Unsubscribe(SubscriptionId subscription)
+{
+	m_Subscriptions.erase(subscription);
+}
+
+size_t Vfs::FileWatcher::Poll()
+{
+	if (m_Fd < 0)
+	{
+		return 0;
+	}
+
+	ReadEvents();
+	if (m_Changed.empty())
+	{
+		return 0;
+	}
+
+	//still being written, unless that's been going on for too long
+	if (m_LastChange->GetNanoseconds() < m_DebounceSeconds && m_FirstChange->GetNanoseconds() < m_MaxDelaySeconds)
+	{
+		return 0;
+	}
+
+	const size_t delivered = m_Changed.size();
+	Deliver();
+	return delivered;
+}
+
+bool Vfs::FileWatcher::IsWatching() const
+{
+	return m_Fd >= 0;
+}
+
+Vfs::FileWatcher::Stats Vfs::FileWatcher::GetStats() const
+{
+	return m_Stats;
+}
+
+void Vfs::FileWatcher::Watch(const std::string& directory, bool report)
+{
+#ifdef __linux__
+	const std::string host = HostDirectory(*m_Fs, directory);
+	const int watch = inotify_add_watch(m_Fd, host.c_str(), g_WatchMask);
+	if (watch < 0)
+	{
+		LOGW("FileWatcher: unable to watch %s: %s", host.c_str(), strerror(errno));
+		return;
+	}
+
+	//the same descriptor again for a directory that's watched already
+	if (m_Watches.find(watch) == m_Watches.end())
+	{
+		m_Stats.directories++;
+	}
+	m_Watches[watch] = directory;
+
+	//listed after the watch is there, so nothing created in between is missed
+	for (const std::string& name : m_Fs->List(directory, false))
+	{
+		if (name.back() == '/')
+		{
+			Watch(directory + name, report);
+		}
+		else if (report)
+		{
+			Changed(directory + name);
+		}
+	}
+#endif
+}
+
+void Vfs::FileWatcher::Changed(const std::string& path)
+{
+	if (m_Changed.empty())
+	{
+		m_FirstChange = Timing::Start();
+	}
+	m_LastChange = Timing::Start();
+	if (m_Changed.insert(path).second)
+	{
+		m_Stats.changes++;
+	}
+}
+
+void Vfs::FileWatcher::Forget(const std::string& directory)
+{
+#ifdef __linux__
+	for (auto watch = m_Watches.begin(); watch != m_Watches.end();)
+	{
+		if (watch->second.compare(0, directory.size(), directory) == 0)
+		{
+			inotify_rm_watch(m_Fd, watch->first);
+			watch = m_Watches.erase(watch);
+		}
+		else
+		{
+			++watch;
+		}
+	}
+#endif
+}
+
+void Vfs::FileWatcher::ReadEvents()
+{
+#ifdef __linux__
+	alignas(inotify_event) char buffer[4096];
+	for (;;)
+	{
+		const ssize_t length = read(m_Fd, buffer, sizeof(buffer));
+		if (length <= 0)
+		{
+			if (length < 0 && errno != EAGAIN && errno != EINTR)
+			{
+				LOGW("FileWatcher: read failed: %s", strerror(errno));
+			}
+			return;
+		}
+
+		for (ssize_t offset = 0; offset < length;)
+		{
+			const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+			offset += sizeof(inotify_event) + event->len;
+			m_Stats.events++;
+
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				//events were dropped, anything may have changed
+				LOGW("FileWatcher: event queue overflow, reporting every file");
+				m_Stats.overflows++;
+				Watch("", true);
+				continue;
+			}
+
+			auto watch = m_Watches.find(event->wd);
+			if (watch == m_Watches.end())
+			{
+				continue;
+			}
+			if (event->mask & IN_IGNORED)
+			{
+				//the directory is gone
+				m_Watches.erase(watch);
+				continue;
+			}
+			if (event->len == 0 || event->name[0] == '\0')
+			{
+				continue;
+			}
+
+			const std::string path = watch->second + event->name;
+			if (event->mask & IN_ISDIR)
+			{
+				if (event->mask & (IN_CREATE | IN_MOVED_TO))
+				{
+					Watch(path + "/", true);
+				}
+				else if (event->mask & IN_MOVED_FROM)
+				{
+					//its watches would report under the old name
+					Forget(path + "/");
+				}
+			}
+			else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE))
+			{
+				Changed(path);
+			}
+		}
+	}
+#endif
+}
+
+void Vfs::FileWatcher::Deliver()
+{
+	std::vector<std::string> paths;
+	paths.reserve(m_Changed.size());
+	for (const std::string& path : m_Changed)
+	{
+		paths.push_back(m_Prefix + path);
+	}
+	m_Changed.clear();
+	m_Stats.batches++;
+
+	//a callback may subscribe or unsubscribe
+	std::vector<SubscriptionId> ids;
+	for (const auto& subscription : m_Subscriptions)
+	{
+		ids.push_back(subscription.first);
+	}
+
+	std::vector<std::string> matching;
+	for (SubscriptionId id : ids)
+	{
+		auto subscription = m_Subscriptions.find(id);
+		if (subscription == m_Subscriptions.end())
+		{
+			continue;
+		}
+
+		const std::string& prefix = subscription->second.prefix;
+		matching.clear();
+		for (const std::string& path : paths)
+		{
+			if (path.compare(0, prefix.size(), prefix) == 0)
+			{
+				matching.push_back(path);
+			}
+		}
+		if (!matching.empty())
+		{
+			//a copy, the subscription may go away while it runs
+			ChangeCallback callback = subscription->second.callback;
+			callback(matching);
+		}
+	}
+}
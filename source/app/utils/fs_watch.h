@@ -0,0 +1,107 @@
+/* File watching
+ *
+ * Reports changes to the files of a POSIX filesystem, for hot reloading:
+ * edit a shader or an image on disk (or push it into the app's writable
+ * layer) and what was built from it is rebuilt while the app runs. Uses
+ * inotify, on every directory below the filesystem's own, directories
+ * created later included; where there is no inotify nothing is reported.
+ *
+ *   Vfs::FileWatcher watcher(writableFs);
+ *   watcher.Subscribe("shaders/", [](const std::vector<std::string>& paths) { ... });
+ *   //once a frame
+ *   watcher.Poll();
+ *
+ * Nothing happens on a thread of its own: Poll() drains what the kernel has
+ * queued and runs the callbacks on the calling thread. Changes are held back
+ * until none came for the debounce time, then delivered in one batch with
+ * every path once, so an editor saving a dozen files (or one file in several
+ * steps) means one rebuild. Files that keep changing are delivered at least
+ * every maxDelay.
+ *
+ * A path is reported when a file was written and closed, moved in or out,
+ * or removed; subscribers Exists() or Open() it to tell which.
+ */
+#pragma once
+
+#include "vfs.h"
+#include "fs_posix.h"
+#include "timing.h"
+#include <functional>
+#include <map>
+#include <set>
+
+namespace Vfs
+{
+	typedef uint32_t SubscriptionId;
+	const SubscriptionId InvalidSubscription = 0;
+
+	// sorted, each once
+	typedef std::function<void(const std::vector<std::string>& paths)> ChangeCallback;
+
+	class FileWatcher
+	{
+	public:
+		struct Stats
+		{
+			// from the kernel, and changed paths they came down to
+			uint32_t events;
+			uint32_t changes;
+			// batches handed to the subscribers
+			uint32_t batches;
+			uint32_t directories;
+			// times the kernel's queue ran over, everything is reported then
+			uint32_t overflows;
+		};
+
+		// paths are reported with prefix in front, the filesystem's mount point
+		FileWatcher(std::shared_ptr<PosixFileSystem> fs, const std::string& prefix = "",
+			unsigned debounceMilliseconds = 100, unsigned maxDelayMilliseconds = 1000);
+		~FileWatcher();
+
+		// callback gets the changed paths that start with prefix, "" for all
+		SubscriptionId Subscribe(const std::string& prefix, ChangeCallback callback);
+		void Unsubscribe(SubscriptionId subscription);
+
+		// once a frame; the number of paths delivered
+		size_t Poll();
+
+		// false without inotify, or if the directory couldn't be watched
+		bool IsWatching() const;
+		Stats GetStats() const;
+
+	private:
+		struct Subscription
+		{
+			std::string prefix;
+			ChangeCallback callback;
+		};
+
+		// directory and everything below it, which may have been written
+		// already, so its files count as changed when 'report' is set
+		void Watch(const std::string& directory, bool report);
+		// the watches of directory and below
+		void Forget(const std::string& directory);
+		void Changed(const std::string& path);
+		void ReadEvents();
+		void Deliver();
+
+		std::shared_ptr<PosixFileSystem> m_Fs;
+		std::string m_Prefix;
+		double m_DebounceSeconds;
+		double m_MaxDelaySeconds;
+
+		int m_Fd;
+		// watch descriptor to the directory it watches, "" or ending in '/'
+		std::map<int, std::string> m_Watches;
+
+		std::set<std::string> m_Changed;
+		// since the first change not delivered yet, and since the last one
+		Timewatcher m_FirstChange;
+		Timewatcher m_LastChange;
+
+		std::map<SubscriptionId, Subscription> m_Subscriptions;
+		SubscriptionId m_NextSubscription;
+
+		Stats m_Stats;
+	};
+}
@@ -1,12 +1,22 @@
 #pragma once
-#include <android/log.h>
 #include <string>
 
 #define LOGTAG "VulkanSink"
 
+#ifdef __ANDROID__
+#include <android/log.h>
+
 #define LOGI(...) ((void)__android_log_print(ANDROID_LOG_INFO, LOGTAG, __VA_ARGS__))
 #define LOGW(...) ((void)__android_log_print(ANDROID_LOG_WARN, LOGTAG, __VA_ARGS__))
 #define LOGE(...) ((void)__android_log_print(ANDROID_LOG_ERROR, LOGTAG, __VA_ARGS__))
+#else
+//host tools
+#include <cstdio>
+
+#define LOGI(...) ((void)fprintf(stdout, __VA_ARGS__), (void)fputc('\n', stdout))
+#define LOGW(...) ((void)fprintf(stderr, __VA_ARGS__), (void)fputc('\n', stderr))
+#define LOGE(...) ((void)fprintf(stderr, __VA_ARGS__), (void)fputc('\n', stderr))
+#endif
 
 
 std::string ToHex(std::string in);
@@ -0,0 +1,222 @@
+#include "utils/lz4.h"
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace {
+	const size_t MinMatch = 4;
+	// the format ends every block with literals ..
+	const size_t LastLiterals = 5;
+	// .. and starts no match this close to the end
+	const size_t MatchStartLimit = 12;
+	const size_t MaxOffset = 65535;
+	const unsigned HashBits = 12;
+
+	uint32_t Read32(const unsigned char* data)
+	{
+		uint32_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	uint32_t Hash(uint32_t sequence)
+	{
+		return (sequence * 2654435761u) >> (32 - HashBits);
+	}
+
+	// 15 in the token, then 255s and the rest
+	bool WriteLength(size_t length, unsigned char*& out, const unsigned char* end)
+	{
+		for (length -= 15; length >= 255; length -= 255)
+		{
+			if (out == end)
+			{
+				return false;
+			}
+			*out++ = 255;
+		}
+		if (out == end)
+		{
+			return false;
+		}
+		*out++ = (unsigned char)length;
+		return true;
+	}
+
+	bool ReadLength(size_t& length, const unsigned char*& in, const unsigned char* end)
+	{
+		unsigned char byte;
+		do
+		{
+			if (in == end)
+			{
+				return false;
+			}
+			byte = *in++;
+			length += byte;
+		} while (byte == 255);
+		return true;
+	}
+
+	bool WriteSequence(const unsigned char* literals, size_t literalLength, size_t offset, size_t matchLength,
+		unsigned char*& out, const unsigned char* end)
+	{
+		if (out == end)
+		{
+			return false;
+		}
+
+		unsigned char* token = out++;
+		*token = (unsigned char)((literalLength < 15 ? literalLength : 15) << 4);
+		if (literalLength >= 15 && !WriteLength(literalLength, out, end))
+		{
+			return false;
+		}
+		if (size_t(end - out) < literalLength)
+		{
+			return false;
+		}
+		if (literalLength > 0)
+		{
+			memcpy(out, literals, literalLength);
+			out += literalLength;
+		}
+
+		//no match in the last sequence
+		if (matchLength == 0)
+		{
+			return true;
+		}
+
+		if (end - out < 2)
+		{
+			return false;
+		}
+		*out++ = (unsigned char)(offset & 0xFF);
+		*out++ = (unsigned char)(offset >> 8);
+
+		const size_t length = matchLength - MinMatch;
+		*token |= (unsigned char)(length < 15 ? length : 15);
+		return length < 15 || WriteLength(length, out, end);
+	}
+}
+
+size_t Lz4::CompressBound(size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+size_t Lz4::Compress(const unsigned char* source, size_t size, unsigned char* destination, size_t capacity)
+{
+	unsigned char* out = destination;
+	const unsigned char* end = destination + capacity;
+
+	size_t anchor = 0;
+	if (size > MatchStartLimit)
+	{
+		std::vector<uint32_t> table(size_t(1) << HashBits, 0);
+		const size_t matchEnd = size - LastLiterals;
+
+		size_t position = 0;
+		while (position + MatchStartLimit <= size)
+		{
+			const uint32_t sequence = Read32(source + position);
+			const uint32_t hash = Hash(sequence);
+			const size_t candidate = table[hash];
+			table[hash] = (uint32_t)position;
+
+			if (candidate < position && position - candidate <= MaxOffset && Read32(source + candidate) == sequence)
+			{
+				size_t length = MinMatch;
+				while (position + length < matchEnd && source[candidate + length] == source[position + length])
+				{
+					length++;
+				}
+
+				if (!WriteSequence(source + anchor, position - anchor, position - candidate, length, out, end))
+				{
+					return 0;
+				}
+				position += length;
+				anchor = position;
+			}
+			else
+			{
+				position++;
+			}
+		}
+	}
+
+	if (!WriteSequence(source + anchor, size - anchor, 0, 0, out, end))
+	{
+		return 0;
+	}
+	return size_t(out - destination);
+}
+
+bool Lz4::Decompress(const unsigned char* source, size_t sourceSize, unsigned char* destination, size_t size)
+{
+	const unsigned char* in = source;
+	const unsigned char* inEnd = source + sourceSize;
+	unsigned char* out = destination;
+	unsigned char* outEnd = destination + size;
+
+	while (in < inEnd)
+	{
+		const unsigned char token = *in++;
+
+		size_t literalLength = token >> 4;
+		if (literalLength == 15 && !ReadLength(literalLength, in, inEnd))
+		{
+			return false;
+		}
+		if (size_t(inEnd - in) < literalLength || size_t(outEnd - out) < literalLength)
+		{
+			return false;
+		}
+		if (literalLength > 0)
+		{
+			memcpy(out, in, literalLength);
+			in += literalLength;
+			out += literalLength;
+		}
+
+		//the last sequence has literals only
+		if (in == inEnd)
+		{
+			break;
+		}
+
+		if (inEnd - in < 2)
+		{
+			return false;
+		}
+		const size_t offset = size_t(in[0]) | (size_t(in[1]) << 8);
+		in += 2;
+		if (offset == 0 || offset > size_t(out - destination))
+		{
+			return false;
+		}
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !ReadLength(matchLength, in, inEnd))
+		{
+			return false;
+		}
+		matchLength += MinMatch;
+		if (size_t(outEnd - out) < matchLength)
+		{
+			return false;
+		}
+
+		//may overlap what it writes, byte by byte then
+		const unsigned char* match = out - offset;
+		for (size_t i = 0; i < matchLength; i++)
+		{
+			out[i] = match[i];
+		}
+		out += matchLength;
+	}
+
+	return out == outEnd;
+}
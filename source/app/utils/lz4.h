@@ -0,0 +1,21 @@
+/* LZ4 blocks
+ *
+ * The LZ4 block format, without the frame around it: fast to decode, so
+ * packed assets can be inflated at load time. The compressor is the plain
+ * greedy one, good enough for a packer running once on the host.
+ */
+#pragma once
+
+#include <cstddef>
+
+namespace Lz4
+{
+	// the most Compress can write for 'size' bytes
+	size_t CompressBound(size_t size);
+
+	// the compressed size, 0 if it doesn't fit into 'capacity'
+	size_t Compress(const unsigned char* source, size_t size, unsigned char* destination, size_t capacity);
+
+	// false on malformed input, or if it doesn't come out as exactly 'size' bytes
+	bool Decompress(const unsigned char* source, size_t sourceSize, unsigned char* destination, size_t size);
+}
@@ -0,0 +1,333 @@
+#include "utils/pathindex.h"
+#include "utils/timing.h"
+#include "utils/log.h"
+#include <algorithm>
+#include <deque>
+#include <memory>
+
+namespace {
+	// the next non-empty component from pos on, false at the end
+	bool NextComponent(const Vfs::PathView& path, size_t& pos, Vfs::PathView& component)
+	{
+		while (pos < path.size && path.data[pos] == '/')
+		{
+			pos++;
+		}
+		if (pos == path.size)
+		{
+			return false;
+		}
+
+		const size_t start = pos;
+		while (pos < path.size && path.data[pos] != '/')
+		{
+			pos++;
+		}
+		component = Vfs::PathView(path.data + start, pos - start);
+		return true;
+	}
+
+	struct MapDirectory
+	{
+		std::map<std::string, std::shared_ptr<MapDirectory> > mounts;
+		uint32_t value;
+	};
+
+	//what VirtualDirectory::FsForPath did before the index
+	uint32_t MapFindDeepest(MapDirectory& directory, std::string path)
+	{
+		std::string::size_type pos = path.find('/');
+		if (pos == std::string::npos)
+		{
+			return Vfs::PathIndex::NoValue;
+		}
+
+		std::string prefix = path.substr(0, pos);
+		std::string postfix = path.substr(pos + 1, path.size() - pos - 1);
+		if (directory.mounts.find(prefix) != directory.mounts.end())
+		{
+			MapDirectory& child = *directory.mounts[prefix];
+			const uint32_t deeper = MapFindDeepest(child, postfix);
+			return deeper != Vfs::PathIndex::NoValue ? deeper : child.value;
+		}
+		return Vfs::PathIndex::NoValue;
+	}
+}
+
+Vfs::PathView Vfs::PathView::Parent() const
+{
+	size_t end = size;
+	while (end > 0 && data[end - 1] != '/')
+	{
+		end--;
+	}
+	return PathView(data, end > 0 ? end - 1 : 0);
+}
+
+uint32_t Vfs::HashPathComponent(PathView name)
+{
+	//FNV-1a
+	uint32_t hash = 2166136261u;
+	for (size_t i = 0; i < name.size; i++)
+	{
+		hash ^= (unsigned char)name.data[i];
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+Vfs::PathIndex::Builder::Builder()
+{
+	m_Root.value = NoValue;
+}
+
+void Vfs::PathIndex::Builder::Add(PathView path, uint32_t value)
+{
+	Node* node = &m_Root;
+	size_t pos = 0;
+	PathView component;
+	while (NextComponent(path, pos, component))
+	{
+		std::map<std::string, Node>::iterator child = node->children.find(std::string(component.data, component.size));
+		if (child == node->children.end())
+		{
+			Node added;
+			added.value = NoValue;
+			child = node->children.insert(std::make_pair(std::string(component.data, component.size), added)).first;
+		}
+		node = &child->second;
+	}
+	node->value = value;
+}
+
+Vfs::PathIndex Vfs::PathIndex::Builder::Build() const
+{
+	PathIndex index;
+	index.m_Nodes[0].value = m_Root.value;
+
+	//breadth first, so the children of a node end up next to each other
+	std::deque<std::pair<const Node*, uint32_t> > pending;
+	pending.push_back(std::make_pair(&m_Root, 0u));
+	while (!pending.empty())
+	{
+		const Node* source = pending.front().first;
+		const uint32_t target = pending.front().second;
+		pending.pop_front();
+
+		std::vector<std::pair<uint32_t, std::map<std::string, Node>::const_iterator> > children;
+		for (std::map<std::string, Node>::const_iterator child = source->children.begin(); child != source->children.end(); ++child)
+		{
+			children.push_back(std::make_pair(HashPathComponent(child->first), child));
+		}
+		//by hash, then by name, as the map had them
+		std::stable_sort(children.begin(), children.end(),
+			[](const std::pair<uint32_t, std::map<std::string, Node>::const_iterator>& a, const std::pair<uint32_t, std::map<std::string, Node>::const_iterator>& b)
+		{
+			return a.first < b.first;
+		});
+
+		index.m_Nodes[target].firstChild = (uint32_t)index.m_Nodes.size();
+		index.m_Nodes[target].childCount = (uint32_t)children.size();
+		for (size_t i = 0; i < children.size(); i++)
+		{
+			const std::string& name = children[i].second->first;
+			PathIndex::Node node = {children[i].first, (uint32_t)index.m_Names.size(), (uint32_t)name.size(), 0, 0, children[i].second->second.value};
+			index.m_Names += name;
+			pending.push_back(std::make_pair(&children[i].second->second, (uint32_t)index.m_Nodes.size()));
+			index.m_Nodes.push_back(node);
+		}
+	}
+
+	return index;
+}
+
+Vfs::PathIndex::PathIndex()
+{
+	Node root = {0, 0, 0, 0, 0, NoValue};
+	m_Nodes.push_back(root);
+}
+
+bool Vfs::PathIndex::Contains(PathView path) const
+{
+	return Walk(path) != NoValue;
+}
+
+uint32_t Vfs::PathIndex::Find(PathView path) const
+{
+	const uint32_t node = Walk(path);
+	return node != NoValue ? m_Nodes[node].value : NoValue;
+}
+
+uint32_t Vfs::PathIndex::FindDeepest(PathView path, size_t* matched) const
+{
+	uint32_t node = 0;
+	uint32_t value = m_Nodes[0].value;
+	if (matched)
+	{
+		*matched = 0;
+	}
+	size_t pos = 0;
+	PathView component;
+	//a component followed by a '/' is a directory
+	while (NextComponent(path, pos, component) && pos < path.size)
+	{
+		node = Child(node, component);
+		if (node == NoValue)
+		{
+			break;
+		}
+		if (m_Nodes[node].value != NoValue)
+		{
+			value = m_Nodes[node].value;
+			if (matched)
+			{
+				*matched = pos + 1;
+			}
+		}
+	}
+	return value;
+}
+
+bool Vfs::PathIndex::List(PathView directory, bool recursive, std::vector<std::string>& names) const
+{
+	const uint32_t start = Walk(directory);
+	if (start == NoValue)
+	{
+		return false;
+	}
+
+	const size_t first = names.size();
+	std::vector<std::pair<uint32_t, std::string> > pending(1, std::make_pair(start, std::string()));
+	while (!pending.empty())
+	{
+		const uint32_t parent = pending.back().first;
+		const std::string prefix = pending.back().second;
+		pending.pop_back();
+
+		const Node& node = m_Nodes[parent];
+		for (uint32_t child = node.firstChild; child < node.firstChild + node.childCount; child++)
+		{
+			std::string name = prefix + m_Names.substr(m_Nodes[child].nameOffset, m_Nodes[child].nameLength);
+			if (m_Nodes[child].childCount > 0)
+			{
+				name += '/';
+				if (recursive)
+				{
+					pending.push_back(std::make_pair(child, name));
+				}
+			}
+			names.push_back(name);
+		}
+	}
+
+	//hash order means nothing to the caller
+	std::sort(names.begin() + first, names.end());
+	return true;
+}
+
+size_t Vfs::PathIndex::NodeCount() const
+{
+	return m_Nodes.size();
+}
+
+uint32_t Vfs::PathIndex::Child(uint32_t parent, PathView name) const
+{
+	const Node& node = m_Nodes[parent];
+	const uint32_t hash = HashPathComponent(name);
+
+	uint32_t first = node.firstChild;
+	uint32_t count = node.childCount;
+	while (count > 0)
+	{
+		const uint32_t half = count / 2;
+		if (m_Nodes[first + half].hash < hash)
+		{
+			first += half + 1;
+			count -= half + 1;
+		}
+		else
+		{
+			count = half;
+		}
+	}
+
+	const uint32_t end = node.firstChild + node.childCount;
+	for (uint32_t child = first; child < end && m_Nodes[child].hash == hash; child++)
+	{
+		const Node& candidate = m_Nodes[child];
+		if (PathView(m_Names.data() + candidate.nameOffset, candidate.nameLength) == name)
+		{
+			return child;
+		}
+	}
+	return NoValue;
+}
+
+uint32_t Vfs::PathIndex::Walk(PathView path) const
+{
+	uint32_t node = 0;
+	size_t pos = 0;
+	PathView component;
+	while (node != NoValue && NextComponent(path, pos, component))
+	{
+		node = Child(node, component);
+	}
+	return node;
+}
+
+Vfs::LookupBenchmarkResult Vfs::RunLookupBenchmark(const std::vector<std::string>& paths, unsigned lookups)
+{
+	LookupBenchmarkResult result = {lookups, 0.0, 0.0, 0.0};
+	if (paths.empty())
+	{
+		return result;
+	}
+
+	//a mount at every directory, valued by where it was first seen
+	PathIndex::Builder builder;
+	MapDirectory root;
+	root.value = PathIndex::NoValue;
+	uint32_t mounts = 0;
+	for (const std::string& path : paths)
+	{
+		MapDirectory* directory = &root;
+		std::string::size_type start = 0;
+		for (std::string::size_type end = path.find('/'); end != std::string::npos; start = end + 1, end = path.find('/', start))
+		{
+			const std::string name = path.substr(start, end - start);
+			std::shared_ptr<MapDirectory>& child = directory->mounts[name];
+			if (!child)
+			{
+				child.reset(new MapDirectory());
+				child->value = mounts;
+				builder.Add(PathView(path.data(), end), mounts);
+				mounts++;
+			}
+			directory = child.get();
+		}
+	}
+	const PathIndex index = builder.Build();
+
+	uint64_t indexSum = 0;
+	Timewatcher timer = Timing::Start();
+	for (unsigned i = 0; i < lookups; i++)
+	{
+		indexSum += index.FindDeepest(paths[i % paths.size()]);
+	}
+	result.indexMilliseconds = timer->GetNanoseconds() * 1000.0;
+
+	uint64_t mapSum = 0;
+	timer = Timing::Start();
+	for (unsigned i = 0; i < lookups; i++)
+	{
+		mapSum += MapFindDeepest(root, paths[i % paths.size()]);
+	}
+	result.mapMilliseconds = timer->GetNanoseconds() * 1000.0;
+
+	if (indexSum != mapSum)
+	{
+		LOGE("Lookup benchmark: the index and the maps disagree");
+	}
+	result.speedup = result.indexMilliseconds > 0.0 ? result.mapMilliseconds / result.indexMilliseconds : 0.0;
+	return result;
+}
@@ -0,0 +1,111 @@
+/* Path index
+ *
+ * An immutable trie over '/' separated paths, built once and then only
+ * read, from any thread. The children of a node sit next to each other,
+ * sorted by the hash of their name, so a lookup is a binary search per
+ * component over PathViews into the caller's string; nothing is allocated.
+ * Every node may carry a value, NoValue otherwise.
+ *
+ * Empty components are skipped: "a//b/" is "a/b".
+ */
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace Vfs
+{
+	// a piece of someone else's string
+	struct PathView
+	{
+		const char* data;
+		size_t size;
+
+		PathView() : data(nullptr), size(0) {}
+		PathView(const char* text) : data(text), size(strlen(text)) {}
+		PathView(const char* text, size_t length) : data(text), size(length) {}
+		PathView(const std::string& text) : data(text.data()), size(text.size()) {}
+
+		bool operator==(const PathView& other) const { return size == other.size && memcmp(data, other.data, size) == 0; }
+		// everything before the last '/', empty without one
+		PathView Parent() const;
+	};
+
+	class PathIndex
+	{
+	public:
+		static const uint32_t NoValue = 0xFFFFFFFF;
+
+		class Builder
+		{
+		public:
+			Builder();
+			// the nodes on the way are created without a value
+			void Add(PathView path, uint32_t value);
+			PathIndex Build() const;
+
+		private:
+			struct Node
+			{
+				uint32_t value;
+				std::map<std::string, Node> children;
+			};
+
+			Node m_Root;
+		};
+
+		PathIndex();
+
+		// whether the path was added, or is on the way to one that was
+		bool Contains(PathView path) const;
+		// the value of exactly this path
+		uint32_t Find(PathView path) const;
+		// the value of the deepest directory of path that has one; the last
+		// component counts only if path ends with '/'. 'matched' is where the
+		// rest of path starts, after that directory and its '/'
+		uint32_t FindDeepest(PathView path, size_t* matched = nullptr) const;
+		// what is in directory, relative to it and sorted; names with more
+		// below them end with '/', and are gone into if recursive. False if
+		// directory isn't in the index
+		bool List(PathView directory, bool recursive, std::vector<std::string>& names) const;
+
+		size_t NodeCount() const;
+
+	private:
+		struct Node
+		{
+			uint32_t hash;
+			uint32_t nameOffset;
+			uint32_t nameLength;
+			uint32_t firstChild;
+			uint32_t childCount;
+			uint32_t value;
+		};
+
+		// NoValue as the index when there is none
+		uint32_t Child(uint32_t parent, PathView name) const;
+		// the node, or NoValue
+		uint32_t Walk(PathView path) const;
+
+		std::vector<Node> m_Nodes;
+		std::string m_Names;
+	};
+
+	uint32_t HashPathComponent(PathView name);
+
+	struct LookupBenchmarkResult
+	{
+		unsigned lookups;
+		// the index against a std::map per level, split with substr, as Vfs used to
+		double indexMilliseconds;
+		double mapMilliseconds;
+		double speedup;
+	};
+
+	// resolves paths, lookups times in total, against mounts at every directory of them
+	LookupBenchmarkResult RunLookupBenchmark(const std::vector<std::string>& paths, unsigned lookups = 100000);
+}
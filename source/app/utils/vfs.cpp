@@ -1,4 +1,6 @@
 #include "vfs.h"
+#include <algorithm>
+#include <cstring>
 
 namespace {
 	static Vfs::VirtualDirectory* g_Root = nullptr;
@@ -11,11 +13,52 @@ Vfs::VirtualFile::VirtualFile(const VirtualFileSystem& vfs, const std::string& p
 {
 }
 
-std::string Vfs::VirtualFile::Path()
+int64_t Vfs::VirtualFile::ReadAt(int64_t offset, void* data, int64_t size)
+{
+	if (offset < 0 || size < 0)
+	{
+		return -1;
+	}
+
+	const Span file = Data();
+	if (file.Empty())
+	{
+		return Size() == 0 ? 0 : -1;
+	}
+	if (uint64_t(offset) >= file.size)
+	{
+		return 0;
+	}
+
+	const int64_t left = int64_t(file.size) - offset;
+	if (size > left)
+	{
+		size = left;
+	}
+	memcpy(data, file.data + offset, (size_t)size);
+	return size;
+}
+
+int64_t Vfs::VirtualFile::WriteBytes(const void*, int64_t)
+{
+	return -1;
+}
+
+Vfs::Span Vfs::VirtualFile::Data()
+{
+	return {nullptr, 0};
+}
+
+std::string Vfs::VirtualFile::Path() const
 {
 	return m_Path;
 }
 
+bool Vfs::VirtualFile::HasFlag(FileSystemFlag flag) const
+{
+	return (m_Flag & static_cast<char>(flag)) != 0;
+}
+
 Vfs::VirtualDirectory::VirtualDirectory(const std::string& path, VirtualDirectory* parentDir)
 	: m_RootPath(path)
 	, m_ParentDir(parentDir)
@@ -30,53 +73,116 @@ std::string Vfs::VirtualDirectory::RootPath()
 void Vfs::VirtualDirectory::Mount(std::string path, std::shared_ptr<VirtualDirectory> dir)
 {
 	m_MountPoints[path] = dir;
+	dir->m_ParentDir = this;
+
+	//every directory above sees the new mount as well
+	for (VirtualDirectory* parent = this; parent != nullptr; parent = parent->m_ParentDir)
+	{
+		parent->BuildMountIndex();
+	}
 }
 
-std::vector<std::string> Vfs::VirtualDirectory::List()
+Vfs::VirtualDirectory::MountList Vfs::VirtualDirectory::Mounts() const
 {
-	std::vector<std::string> fileList;
-	for (auto file : m_MountPoints)
+	MountList mounts;
+	std::vector<std::pair<std::string, const VirtualDirectory*> > pending(1, std::make_pair(std::string(), this));
+	while (!pending.empty())
 	{
-		fileList.push_back(file.first);
-	}
+		const std::string prefix = pending.back().first;
+		const VirtualDirectory* directory = pending.back().second;
+		pending.pop_back();
 
-	return fileList;
+		for (const auto& mount : directory->m_MountPoints)
+		{
+			const std::string path = prefix + mount.first;
+			mounts.push_back(std::make_pair(path, dynamic_cast<VirtualFileSystem*>(mount.second.get())));
+			pending.push_back(std::make_pair(path + "/", mount.second.get()));
+		}
+	}
+	return mounts;
 }
 
-bool Vfs::VirtualDirectory::Exists(const std::string& directory)
+void Vfs::VirtualDirectory::BuildMountIndex()
 {
-	return m_MountPoints.find(directory) != m_MountPoints.end();
+	BuildMountIndex(MountList());
 }
 
-Vfs::VirtualFileSystem* Vfs::VirtualDirectory::FsForPath(std::string path)
+void Vfs::VirtualDirectory::BuildMountIndex(const MountList& extra)
 {
-	std::string::size_type pos = path.find('/');
-	if (pos == std::string::npos)
-	{
-		return nullptr;
-	}
+	MountList mounts = extra;
+	const MountList own = Mounts();
+	mounts.insert(mounts.end(), own.begin(), own.end());
 
-	std::string prefix = path.substr(0, pos);
-	std::string postfix = path.substr(pos + 1, path.size() - pos - 1);
+	PathIndex::Builder builder;
+	m_MountedFs.clear();
 
-	if (VirtualDirectory::Exists(prefix))
+	//plain directories first, so they don't clear a filesystem at the same path
+	for (const auto& mount : mounts)
 	{
-		return m_MountPoints[prefix]->FsForPath(postfix);
+		if (!mount.second)
+		{
+			builder.Add(mount.first, PathIndex::NoValue);
+		}
 	}
-	else
+	//later ones replace earlier ones at the same path
+	for (const auto& mount : mounts)
 	{
-		return nullptr;
+		if (mount.second)
+		{
+			builder.Add(mount.first, (uint32_t)m_MountedFs.size());
+			m_MountedFs.push_back(mount.second);
+		}
+	}
+
+	m_MountIndex = builder.Build();
+}
+
+std::vector<std::string> Vfs::VirtualDirectory::List(const std::string& directory, bool recursive)
+{
+	std::vector<std::string> fileList;
+	m_MountIndex.List(directory, recursive, fileList);
+	return fileList;
+}
+
+std::vector<std::string> Vfs::VirtualDirectory::ListMounts(const std::string& directory)
+{
+	std::vector<std::string> mounts = VirtualDirectory::List(directory, false);
+	//nothing mounted below them, they're directories all the same
+	for (std::string& mount : mounts)
+	{
+		if (mount.back() != '/')
+		{
+			mount += '/';
+		}
 	}
+	return mounts;
 }
 
-Vfs::VirtualFileSystem::VirtualFileSystem()
+bool Vfs::VirtualDirectory::Exists(const std::string& directory)
+{
+	return m_MountPoints.find(directory) != m_MountPoints.end();
+}
+
+Vfs::VirtualFileSystem* Vfs::VirtualDirectory::FsForPath(const std::string& path, size_t& mountLength)
+{
+	const uint32_t fs = m_MountIndex.FindDeepest(path, &mountLength);
+	return fs != PathIndex::NoValue ? m_MountedFs[fs] : nullptr;
+}
+
+Vfs::VirtualFileSystem::VirtualFileSystem(FileSystemType type)
 	: VirtualDirectory("", nullptr)
+	, m_Type(type)
+{
+}
+
+Vfs::FileSystemType Vfs::VirtualFileSystem::Type() const
 {
+	return m_Type;
 }
 
-Vfs::VirtualFileSystem* Vfs::VirtualFileSystem::FsForPath(std::string path)
+Vfs::VirtualFileSystem* Vfs::VirtualFileSystem::FsForPath(const std::string& path, size_t& mountLength)
 {
-	VirtualFileSystem* overriddenFs = VirtualDirectory::FsForPath(path);
+	VirtualFileSystem* overriddenFs = VirtualDirectory::FsForPath(path, mountLength);
 	if (overriddenFs != nullptr)
 	{
 		return overriddenFs;
@@ -106,10 +212,11 @@ bool Vfs::Exists(const std::string& path)
 {
 	if (g_Root)
 	{
-		VirtualFileSystem* targetFs = g_Root->FsForPath(path);
+		size_t mountLength = 0;
+		VirtualFileSystem* targetFs = g_Root->FsForPath(path, mountLength);
 		if (targetFs != nullptr)
 		{
-			return targetFs->Exists(path);
+			return targetFs->Exists(mountLength == 0 ? path : path.substr(mountLength));
 		}
 	}
 
@@ -118,16 +225,34 @@ bool Vfs::Exists(const std::string& path)
 
 std::vector<std::string> Vfs::List(const std::string& dir, bool recursive)
 {
-	if (dir.empty())
+	std::vector<std::string> fileList;
+	if (!g_Root)
 	{
-		return g_Root->List();
+		return fileList;
 	}
 
-	VirtualFileSystem* targetFs = g_Root->FsForPath(dir);
+	//a trailing '/' makes a mount point at dir itself count
+	const std::string directory = dir.empty() || dir.back() == '/' ? dir : dir + "/";
+	size_t mountLength = 0;
+	VirtualFileSystem* targetFs = g_Root->FsForPath(directory, mountLength);
 	if (targetFs)
 	{
-		return targetFs->List();
+		fileList = targetFs->List(directory.substr(mountLength), recursive);
 	}
 
-	return std::vector<std::string>();
+	for (const std::string& mount : g_Root->ListMounts(directory))
+	{
+		fileList.push_back(mount);
+		if (recursive)
+		{
+			for (const std::string& file : Vfs::List(directory + mount, true))
+			{
+				fileList.push_back(mount + file);
+			}
+		}
+	}
+
+	std::sort(fileList.begin(), fileList.end());
+	fileList.erase(std::unique(fileList.begin(), fileList.end()), fileList.end());
+	return fileList;
 }
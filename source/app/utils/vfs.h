@@ -1,7 +1,12 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
 #include <string>
 #include <vector>
 #include <map>
 #include <memory>
+#include "pathindex.h"
 
 namespace Vfs
 {
@@ -15,15 +20,27 @@ namespace Vfs
 	bool Exists(const std::string& file);
     template <typename T>
 	std::shared_ptr<T> Open(const std::string& open);
+	// across mount points, which show up as directories
 	std::vector<std::string> List(const std::string& dir, bool recursive);
 
 	enum class FileSystemType
 	{
 		Posix,
 		AndroidAsset,
+		Pack,
+		Overlay,
 		None
 	};
 
+	// bytes owned by someone else, valid as long as they say
+	struct Span
+	{
+		const unsigned char* data;
+		size_t size;
+
+		bool Empty() const { return data == nullptr || size == 0; }
+	};
+
 	enum class FileSystemFlag : char
 	{
 		Readable = 1,
@@ -44,20 +61,30 @@ namespace Vfs
 
 	public:
 		template <typename T>
-		int64_t Write(T&, int N = 1)
+		int64_t Write(T& t, int N = 1)
 		{
-			return 0;
+			return WriteBytes(&t, int64_t(sizeof(T)) * N);
 		}
 
+		// the whole buffer at the current position
 		template <typename T>
-		int64_t FromBuffer(const std::vector<T>& )
+		int64_t FromBuffer(const std::vector<T>& buffer)
 		{
-			return 0;
+			return WriteBytes(buffer.data(), int64_t(sizeof(T) * buffer.size()));
 		}
 
-		virtual int64_t Size() = 0;
+		// at the current position, which it moves; -1 on error and for read-only files
+		virtual int64_t WriteBytes(const void* data, int64_t size);
 
-		std::string Path();
+		virtual int64_t Size() = 0;
+		// at 'offset', without moving any position; the bytes read, -1 on error
+		virtual int64_t ReadAt(int64_t offset, void* data, int64_t size);
+		// the whole file read-only, valid while it stays open. Empty if the backend
+		// can't hand one out, read the file instead then
+		virtual Span Data();
+
+		std::string Path() const;
+		bool HasFlag(FileSystemFlag flag) const;
 	};
 
 	class VirtualDirectory
@@ -70,13 +97,33 @@ namespace Vfs
         std::string m_RootPath;
 		VirtualDirectory* m_ParentDir;
 		std::map<std::string, std::shared_ptr<VirtualDirectory> > m_MountPoints;
+		// every filesystem mounted below, at any depth; rebuilt on Mount()
+		PathIndex m_MountIndex;
+		std::vector<VirtualFileSystem*> m_MountedFs;
 	protected:
+		typedef std::vector<std::pair<std::string, VirtualFileSystem*> > MountList;
+
 		VirtualDirectory(const std::string&, VirtualDirectory* = nullptr);
 		std::string RootPath();
+		// from Mounts(); a subclass that resolves more mounts adds them
+		virtual void BuildMountIndex();
+		// the index of Mounts() and of 'extra', which they win over at the same path
+		void BuildMountIndex(const MountList& extra);
 	public:
-        virtual VirtualFileSystem* FsForPath(std::string path);
+		// every mount point below, at any depth, with the filesystem mounted
+		// there, nullptr for a plain directory
+		MountList Mounts() const;
+		// the filesystem mounted deepest on the way to path, nullptr if none is;
+		// path from mountLength on is the path within it
+		virtual VirtualFileSystem* FsForPath(const std::string& path, size_t& mountLength);
 		void Mount(std::string path, std::shared_ptr<VirtualDirectory>);
-		virtual std::vector<std::string> List();
+		// what is in directory ("" for the top), relative to it and sorted;
+		// directories end with '/' and are gone into if recursive. Here, the
+		// mount points
+		virtual std::vector<std::string> List(const std::string& directory, bool recursive);
+		// the mount points in directory and the directories on the way to
+		// deeper ones, as "name/"
+		virtual std::vector<std::string> ListMounts(const std::string& directory);
 		virtual bool Exists(const std::string&);
 	};
 
@@ -87,19 +134,21 @@ namespace Vfs
 		FileSystemType m_Type;
 
 	protected:
-		VirtualFileSystem();
-		virtual VirtualFileSystem* FsForPath(std::string path);
+		VirtualFileSystem(FileSystemType type = FileSystemType::None);
+		virtual VirtualFileSystem* FsForPath(const std::string& path, size_t& mountLength);
 	public:
+		FileSystemType Type() const;
 		virtual std::shared_ptr<VirtualFile> Open(const std::string&) = 0;
 	};
 
     template <typename T>
     std::shared_ptr<T> Open(const std::string& path)
     {
-        VirtualFileSystem* targetFs = Vfs::GetRoot()->FsForPath(path);
+        size_t mountLength = 0;
+        VirtualFileSystem* targetFs = Vfs::GetRoot()->FsForPath(path, mountLength);
         if (targetFs)
         {
-            return std::dynamic_pointer_cast<T>(targetFs->Open(path));
+            return std::dynamic_pointer_cast<T>(targetFs->Open(path.substr(mountLength)));
         }
 
         return std::shared_ptr<T>();
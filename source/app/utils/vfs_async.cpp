@@ -0,0 +1,450 @@
+#include "utils/vfs_async.h"
+#include "utils/fs_pack.h"
+#include "utils/log.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+	unsigned WorkerCount(unsigned threads)
+	{
+		//reads mostly wait, more workers than cores don't buy much on flash
+		return threads > 0 ? threads : 2;
+	}
+
+	bool SameSource(const std::string& path, const Vfs::PackFileSystem* pack, const std::string& otherPath, const Vfs::PackFileSystem* otherPack)
+	{
+		return pack == otherPack && (pack != nullptr || path == otherPath);
+	}
+}
+
+Vfs::ReadQueue::ReadQueue(unsigned threads, size_t maxBatch)
+	: m_MaxBatch(maxBatch)
+	, m_NextId(InvalidRequest + 1)
+	, m_Stop(false)
+	, m_Stats()
+	, m_Latencies()
+	, m_TotalMilliseconds()
+{
+	threads = WorkerCount(threads);
+	for (unsigned i = 0; i < threads; i++)
+	{
+		m_Threads.push_back(std::thread(&ReadQueue::Work, this));
+	}
+}
+
+Vfs::ReadQueue::~ReadQueue()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stop = true;
+	}
+	m_Wake.notify_all();
+
+	for (std::thread& thread : m_Threads)
+	{
+		thread.join();
+	}
+
+	//pending and done ones are all still in here
+	for (auto& job : m_Jobs)
+	{
+		delete job.second;
+	}
+}
+
+Vfs::RequestId Vfs::ReadQueue::Read(const std::string& path, int64_t offset, int64_t size, Priority priority, ReadCallback done)
+{
+	if (offset < 0 || size < 0 || priority >= Priority::Count)
+	{
+		LOGE("ReadQueue: bad read of %s", path.c_str());
+		return InvalidRequest;
+	}
+
+	Job* job = new Job();
+	job->result.path = path;
+	job->result.ok = false;
+	job->result.offset = offset;
+	job->done = done;
+	job->priority = priority;
+	job->pack = nullptr;
+	job->offset = offset;
+	job->size = size;
+	job->queued = Timing::Start();
+	job->cancelled = false;
+	job->finished = false;
+	job->claimed = false;
+
+	//stored pack entries are read straight out of the pack, by where they are in it
+	VirtualDirectory* root = GetRoot();
+	size_t mountLength = 0;
+	VirtualFileSystem* fs = root ? root->FsForPath(path, mountLength) : nullptr;
+	uint64_t entryOffset = 0;
+	uint64_t entrySize = 0;
+	if (fs && fs->Type() == FileSystemType::Pack
+		&& static_cast<PackFileSystem*>(fs)->Locate(path.substr(mountLength), entryOffset, entrySize))
+	{
+		const int64_t left = std::max(int64_t(entrySize) - offset, int64_t(0));
+		job->pack = static_cast<PackFileSystem*>(fs);
+		job->offset = int64_t(entryOffset) + std::min(offset, int64_t(entrySize));
+		job->size = size == 0 ? left : std::min(size, left);
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		job->result.id = m_NextId++;
+		if (m_NextId == InvalidRequest)
+		{
+			m_NextId++;
+		}
+		m_Stats.requested++;
+		m_Jobs[job->result.id] = job;
+		m_Pending[size_t(priority)].push_back(job);
+	}
+	m_Wake.notify_one();
+
+	return job->result.id;
+}
+
+Vfs::RequestId Vfs::ReadQueue::ReadFile(const std::string& path, Priority priority, ReadCallback done)
+{
+	return Read(path, 0, 0, priority, done);
+}
+
+bool Vfs::ReadQueue::Cancel(RequestId request)
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	auto job = m_Jobs.find(request);
+	if (job == m_Jobs.end() || job->second->cancelled)
+	{
+		return false;
+	}
+
+	//a worker finishes it without reading, or its read is thrown away
+	job->second->cancelled = true;
+	return true;
+}
+
+void Vfs::ReadQueue::Work()
+{
+	//what a batch is read into, reused from one to the next
+	std::vector<unsigned char> buffer;
+
+	for (;;)
+	{
+		std::vector<Job*> batch;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Wake.wait(lock, [this]
+			{
+				return m_Stop || std::any_of(m_Pending, m_Pending + size_t(Priority::Count),
+					[](const std::deque<Job*>& pending) { return !pending.empty(); });
+			});
+			if (m_Stop)
+			{
+				return;
+			}
+
+			for (std::deque<Job*>& pending : m_Pending)
+			{
+				if (!pending.empty())
+				{
+					Job* job = pending.front();
+					pending.pop_front();
+					batch = TakeBatch(job);
+					break;
+				}
+			}
+		}
+
+		if (!std::all_of(batch.begin(), batch.end(), [](const Job* job) { return job->cancelled.load(); }))
+		{
+			ReadBatch(batch, buffer);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			for (Job* job : batch)
+			{
+				const double milliseconds = job->queued->GetNanoseconds() * 1000.0;
+				const size_t priority = size_t(job->priority);
+				m_Latencies[priority]++;
+				m_TotalMilliseconds[priority] += milliseconds;
+				m_Stats.maxMilliseconds[priority] = std::max(m_Stats.maxMilliseconds[priority], milliseconds);
+
+				job->finished = true;
+				//a Wait() on it delivers it itself
+				if (!job->claimed)
+				{
+					m_Done.push_back(job);
+				}
+			}
+		}
+		m_Finished.notify_all();
+	}
+}
+
+std::vector<Vfs::ReadQueue::Job*> Vfs::ReadQueue::TakeBatch(Job* job)
+{
+	std::vector<Job*> batch(1, job);
+	//whole files of unknown size aren't merged with anything
+	if (m_MaxBatch == 0 || job->cancelled || job->size == 0)
+	{
+		return batch;
+	}
+
+	int64_t begin = job->offset;
+	int64_t end = job->offset + job->size;
+	//a range taken in can bring the next one within reach, until nothing grows
+	for (bool grown = true; grown; )
+	{
+		grown = false;
+		//only its own class, lower ones riding along would hold it up
+		std::deque<Job*>& pending = m_Pending[size_t(job->priority)];
+		for (std::deque<Job*>::iterator other = pending.begin(); other != pending.end(); )
+		{
+			Job* candidate = *other;
+			const int64_t otherEnd = candidate->offset + candidate->size;
+			if (candidate->cancelled || candidate->size == 0
+				|| !SameSource(job->result.path, job->pack, candidate->result.path, candidate->pack)
+				|| candidate->offset > end || otherEnd < begin
+				|| uint64_t(std::max(end, otherEnd) - std::min(begin, candidate->offset)) > m_MaxBatch)
+			{
+				++other;
+				continue;
+			}
+
+			begin = std::min(begin, candidate->offset);
+			end = std::max(end, otherEnd);
+			batch.push_back(candidate);
+			other = pending.erase(other);
+			grown = true;
+		}
+	}
+	return batch;
+}
+
+void Vfs::ReadQueue::ReadBatch(const std::vector<Job*>& batch, std::vector<unsigned char>& buffer)
+{
+	Job* first = batch.front();
+	int64_t begin = first->offset;
+	int64_t end = first->offset + first->size;
+	for (Job* job : batch)
+	{
+		begin = std::min(begin, job->offset);
+		end = std::max(end, job->offset + job->size);
+	}
+
+	//a lone request is read into its own result, no copy
+	std::vector<unsigned char>& data = batch.size() == 1 ? first->result.data : buffer;
+	int64_t read = 0;
+	if (first->pack)
+	{
+		data.resize(size_t(end - begin));
+		read = data.empty() ? 0 : first->pack->ReadRaw(uint64_t(begin), data.data(), uint64_t(end - begin));
+	}
+	else
+	{
+		std::shared_ptr<VirtualFile> file = Open<VirtualFile>(first->result.path);
+		if (!file)
+		{
+			read = -1;
+		}
+		else
+		{
+			if (first->size == 0)
+			{
+				end = std::max(file->Size(), begin);
+			}
+			data.resize(size_t(end - begin));
+			read = data.empty() ? 0 : file->ReadAt(begin, data.data(), end - begin);
+		}
+	}
+
+	if (read < 0)
+	{
+		LOGW("ReadQueue: unable to read %s", first->result.path.c_str());
+		data.clear();
+		return;
+	}
+	data.resize(size_t(read));
+
+	if (batch.size() > 1)
+	{
+		for (Job* job : batch)
+		{
+			const int64_t from = std::min(job->offset - begin, read);
+			const int64_t count = std::min(job->size, read - from);
+			job->result.data.assign(data.begin() + from, data.begin() + from + count);
+			job->result.ok = true;
+		}
+	}
+	first->result.ok = true;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Stats.reads++;
+	m_Stats.coalesced += uint32_t(batch.size() - 1);
+	m_Stats.bytesRead += uint64_t(read);
+}
+
+void Vfs::ReadQueue::Deliver(Job* job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Jobs.erase(job->result.id);
+		if (job->cancelled)
+		{
+			m_Stats.cancelled++;
+		}
+		else
+		{
+			(job->result.ok ? m_Stats.completed : m_Stats.failed)++;
+		}
+	}
+
+	if (!job->cancelled && job->done)
+	{
+		job->done(job->result);
+	}
+	delete job;
+}
+
+unsigned Vfs::ReadQueue::Poll(unsigned maxResults)
+{
+	unsigned delivered = 0;
+	while (delivered < maxResults)
+	{
+		Job* job;
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (m_Done.empty())
+			{
+				break;
+			}
+			job = m_Done.front();
+			m_Done.pop_front();
+			job->claimed = true;
+		}
+
+		if (!job->cancelled)
+		{
+			delivered++;
+		}
+		Deliver(job);
+	}
+	return delivered;
+}
+
+bool Vfs::ReadQueue::Wait(RequestId request)
+{
+	Job* job;
+	{
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		auto found = m_Jobs.find(request);
+		if (found == m_Jobs.end())
+		{
+			return false;
+		}
+		job = found->second;
+		//a Poll() or Wait() elsewhere delivers and deletes it
+		if (job->claimed)
+		{
+			return false;
+		}
+		job->claimed = true;
+
+		//finished before it was claimed, it's queued for Poll()
+		auto done = std::find(m_Done.begin(), m_Done.end(), job);
+		if (done != m_Done.end())
+		{
+			m_Done.erase(done);
+		}
+		m_Finished.wait(lock, [job] { return job->finished; });
+	}
+
+	const bool ok = !job->cancelled && job->result.ok;
+	Deliver(job);
+	return ok;
+}
+
+Vfs::ReadStats Vfs::ReadQueue::GetStats() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	ReadStats stats = m_Stats;
+	for (size_t i = 0; i < size_t(Priority::Count); i++)
+	{
+		stats.averageMilliseconds[i] = m_Latencies[i] > 0 ? m_TotalMilliseconds[i] / m_Latencies[i] : 0.0;
+	}
+	return stats;
+}
+
+unsigned Vfs::ReadQueue::ThreadCount() const
+{
+	return unsigned(m_Threads.size());
+}
+
+std::vector<Vfs::ReadBenchmarkResult> Vfs::RunReadBenchmark(const std::vector<std::string>& paths,
+	unsigned maxThreads, int64_t chunkSize)
+{
+	std::vector<ReadBenchmarkResult> results;
+	std::vector<int64_t> sizes;
+	for (const std::string& path : paths)
+	{
+		std::shared_ptr<VirtualFile> file = Open<VirtualFile>(path);
+		sizes.push_back(file ? file->Size() : 0);
+	}
+	if (paths.empty() || chunkSize <= 0)
+	{
+		return results;
+	}
+
+	for (unsigned threads = 1; threads <= std::max(maxThreads, 1u); threads *= 2)
+	{
+		for (size_t maxBatch : {size_t(0), size_t(1 << 20)})
+		{
+			ReadQueue queue(threads, maxBatch);
+			uint64_t bytes = 0;
+			ReadCallback count = [&bytes](ReadResult& result)
+			{
+				bytes += result.data.size();
+			};
+
+			Timewatcher timer = Timing::Start();
+			unsigned requests = 0;
+			for (size_t i = 0; i < paths.size(); i++)
+			{
+				if (i % 4 == 0)
+				{
+					queue.ReadFile(paths[i], Priority::Blocking, count);
+					requests++;
+				}
+				for (int64_t offset = 0; offset < sizes[i]; offset += chunkSize)
+				{
+					queue.Read(paths[i], offset, chunkSize, Priority::Streaming, count);
+					requests++;
+				}
+			}
+
+			unsigned received = 0;
+			while (received < requests)
+			{
+				received += queue.Poll();
+				if (received < requests)
+				{
+					std::this_thread::yield();
+				}
+			}
+			const double seconds = timer->GetNanoseconds();
+
+			ReadBenchmarkResult result;
+			result.threads = threads;
+			result.maxBatch = maxBatch;
+			result.requests = requests;
+			result.milliseconds = seconds * 1000.0;
+			result.megabytesPerSecond = seconds > 0.0 ? bytes / seconds / 1000000.0 : 0.0;
+			result.stats = queue.GetStats();
+			results.push_back(result);
+		}
+	}
+
+	return results;
+}
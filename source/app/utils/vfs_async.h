@@ -0,0 +1,157 @@
+/* Asynchronous Vfs reads
+ *
+ * Read() queues a byte range of a file (or the whole of it) with a priority
+ * class and a callback, and returns at once. A pool of I/O threads serves
+ * blocking loads first, then streaming, then background reads, each class
+ * in request order. Poll() runs the callbacks of finished reads on the
+ * calling thread; Wait() blocks on one request and runs just its callback.
+ *
+ * Queued ranges of the same file and class that touch or overlap are served
+ * by a single read, up to maxBatch bytes. Stored entries of a mounted pack
+ * are keyed by their place in the pack, so neighbouring entries coalesce
+ * too.
+ *
+ * Cancel() drops a request that hasn't been delivered yet; if a worker is
+ * already reading it the result is thrown away instead of delivered.
+ */
+#pragma once
+
+#include "vfs.h"
+#include "timing.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace Vfs
+{
+	class PackFileSystem;
+
+	typedef uint32_t RequestId;
+	const RequestId InvalidRequest = 0;
+
+	enum class Priority
+	{
+		// someone is waiting on it
+		Blocking,
+		// needed soon, texture and audio chunks
+		Streaming,
+		// prefetching, whenever there is nothing else
+		Background,
+		Count
+	};
+
+	struct ReadResult
+	{
+		RequestId id;
+		std::string path;
+		bool ok;
+		int64_t offset;
+		// shorter than asked for at the end of the file
+		std::vector<unsigned char> data;
+	};
+
+	typedef std::function<void(ReadResult&)> ReadCallback;
+
+	struct ReadStats
+	{
+		uint32_t requested;
+		uint32_t completed;
+		uint32_t failed;
+		uint32_t cancelled;
+		// requests served by a read made for another one
+		uint32_t coalesced;
+		// reads that went to a filesystem
+		uint32_t reads;
+		uint64_t bytesRead;
+		// from Read() to the worker being done with it, per priority class
+		double averageMilliseconds[size_t(Priority::Count)];
+		double maxMilliseconds[size_t(Priority::Count)];
+	};
+
+	class ReadQueue
+	{
+	public:
+		// 0 threads means two; maxBatch 0 turns coalescing off
+		ReadQueue(unsigned threads = 0, size_t maxBatch = 1 << 20);
+		~ReadQueue();
+
+		// size bytes from offset, size 0 reads to the end of the file
+		RequestId Read(const std::string& path, int64_t offset, int64_t size, Priority priority, ReadCallback done);
+		RequestId ReadFile(const std::string& path, Priority priority, ReadCallback done);
+		// false once it was delivered, or for an unknown request
+		bool Cancel(RequestId request);
+
+		// failed reads are delivered too, with ok false
+		unsigned Poll(unsigned maxResults = ~0u);
+		// blocks until the request is done and delivers it; false if it
+		// failed, was cancelled, is unknown or already being delivered by a
+		// Poll() or Wait() on another thread
+		bool Wait(RequestId request);
+
+		ReadStats GetStats() const;
+		unsigned ThreadCount() const;
+
+	private:
+		struct Job
+		{
+			ReadResult result;
+			ReadCallback done;
+			Priority priority;
+			// set for stored pack entries, offset and size are in the pack then
+			const PackFileSystem* pack;
+			int64_t offset;
+			int64_t size;
+			Timewatcher queued;
+			std::atomic<bool> cancelled;
+			bool finished;
+			// taken by the Poll() or Wait() that delivers it, which deletes it
+			bool claimed;
+		};
+
+		void Work();
+		// pending jobs that can share job's read, job first
+		std::vector<Job*> TakeBatch(Job* job);
+		void ReadBatch(const std::vector<Job*>& batch, std::vector<unsigned char>& buffer);
+		void Deliver(Job* job);
+
+		size_t m_MaxBatch;
+
+		mutable std::mutex m_Mutex;
+		std::condition_variable m_Wake;
+		std::condition_variable m_Finished;
+		std::deque<Job*> m_Pending[size_t(Priority::Count)];
+		// everything not delivered yet, for Cancel and Wait
+		std::map<RequestId, Job*> m_Jobs;
+		// finished and not claimed, oldest first
+		std::deque<Job*> m_Done;
+		RequestId m_NextId;
+		bool m_Stop;
+
+		ReadStats m_Stats;
+		uint32_t m_Latencies[size_t(Priority::Count)];
+		double m_TotalMilliseconds[size_t(Priority::Count)];
+
+		std::vector<std::thread> m_Threads;
+	};
+
+	struct ReadBenchmarkResult
+	{
+		unsigned threads;
+		size_t maxBatch;
+		unsigned requests;
+		double milliseconds;
+		double megabytesPerSecond;
+		ReadStats stats;
+	};
+
+	// a mixed load over paths, through the current root, with 1, 2, 4 ..
+	// maxThreads workers, coalescing off and on: every file streamed in
+	// chunkSize pieces, and every fourth one loaded whole with Blocking
+	// priority at the same time
+	std::vector<ReadBenchmarkResult> RunReadBenchmark(const std::vector<std::string>& paths,
+		unsigned maxThreads, int64_t chunkSize = 64 * 1024);
+}
@@ -0,0 +1,159 @@
+#include "utils/vfs_stream.h"
+#include "utils/log.h"
+#include <algorithm>
+
+Vfs::ChunkReader::ChunkReader(std::shared_ptr<VirtualFile> file, size_t chunkSize, unsigned readAhead)
+	: m_File(file)
+	, m_Size(file ? std::max(file->Size(), int64_t(0)) : 0)
+	, m_ChunkSize(std::max(chunkSize, size_t(1)))
+	, m_Filled(0)
+	, m_Taken(0)
+	, m_Released(0)
+	, m_End(!file)
+	, m_Failed(!file)
+	, m_Stop(false)
+{
+	//no bigger than the file, for small ones
+	const size_t bufferSize = size_t(std::min(int64_t(m_ChunkSize), m_Size));
+	m_Buffers.resize(readAhead + 1);
+	for (Buffer& buffer : m_Buffers)
+	{
+		buffer.data.resize(bufferSize);
+		buffer.size = 0;
+		buffer.offset = 0;
+	}
+
+	if (file && readAhead > 0 && m_Size > 0)
+	{
+		m_Thread = std::thread(&ChunkReader::Work, this);
+	}
+}
+
+Vfs::ChunkReader::~ChunkReader()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Stop = true;
+	}
+	m_Changed.notify_all();
+
+	if (m_Thread.joinable())
+	{
+		m_Thread.join();
+	}
+}
+
+int64_t Vfs::ChunkReader::Fill(uint64_t index)
+{
+	const int64_t offset = int64_t(index * m_ChunkSize);
+	if (offset >= m_Size)
+	{
+		return 0;
+	}
+
+	Buffer& buffer = m_Buffers[index % m_Buffers.size()];
+	const int64_t size = std::min(int64_t(m_ChunkSize), m_Size - offset);
+	const int64_t read = m_File->ReadAt(offset, buffer.data.data(), size);
+	if (read < 0)
+	{
+		LOGE("ChunkReader: read from %s failed at %lld", m_File->Path().c_str(), (long long)offset);
+		return -1;
+	}
+
+	buffer.size = size_t(read);
+	buffer.offset = offset;
+	return read;
+}
+
+void Vfs::ChunkReader::Work()
+{
+	for (;;)
+	{
+		uint64_t index;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			//the buffer the chunk goes into mustn't be the one handed out
+			m_Changed.wait(lock, [this] { return m_Stop || m_Filled - m_Released < m_Buffers.size(); });
+			if (m_Stop)
+			{
+				return;
+			}
+			index = m_Filled;
+		}
+
+		const int64_t read = Fill(index);
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			if (read > 0)
+			{
+				m_Filled++;
+			}
+			else
+			{
+				m_End = true;
+				m_Failed = read < 0;
+			}
+		}
+		m_Changed.notify_all();
+
+		if (read <= 0)
+		{
+			return;
+		}
+	}
+}
+
+bool Vfs::ChunkReader::Next(Chunk& chunk)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	//the previous chunk is done with
+	m_Released = m_Taken;
+
+	if (m_Thread.joinable())
+	{
+		m_Changed.notify_all();
+		m_Changed.wait(lock, [this] { return m_Filled > m_Taken || m_End; });
+	}
+	else if (!m_End)
+	{
+		const int64_t read = Fill(m_Taken);
+		if (read > 0)
+		{
+			m_Filled++;
+		}
+		else
+		{
+			m_End = true;
+			m_Failed = read < 0;
+		}
+	}
+
+	if (m_Filled == m_Taken)
+	{
+		return false;
+	}
+
+	const Buffer& buffer = m_Buffers[m_Taken % m_Buffers.size()];
+	chunk.offset = buffer.offset;
+	chunk.data = buffer.data.data();
+	chunk.size = buffer.size;
+	m_Taken++;
+	return true;
+}
+
+bool Vfs::ChunkReader::Failed() const
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Failed;
+}
+
+int64_t Vfs::ChunkReader::Size() const
+{
+	return m_Size;
+}
+
+size_t Vfs::ChunkReader::ChunkSize() const
+{
+	return m_ChunkSize;
+}
@@ -0,0 +1,81 @@
+/* Streaming reads
+ *
+ * ChunkReader walks a file front to back in fixed-size chunks, for files
+ * too big to hold whole (audio, video, big meshes). Memory stays at
+ * (readAhead + 1) chunks however big the file is: the buffers are allocated
+ * once and reused. With readAhead above 0 a thread of the reader's own
+ * fills the chunks ahead while the caller works on the current one.
+ *
+ *   Vfs::ChunkReader reader(Vfs::Open<Vfs::VirtualFile>("music/theme.ogg"));
+ *   Vfs::ChunkReader::Chunk chunk;
+ *   while (reader.Next(chunk))
+ *   {
+ *       decoder.Feed(chunk.data, chunk.size);
+ *   }
+ *
+ * It reads through VirtualFile::ReadAt, so it works for every backend; the
+ * reader has to be the only one using the file while it's alive.
+ */
+#pragma once
+
+#include "vfs.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace Vfs
+{
+	class ChunkReader
+	{
+	public:
+		struct Chunk
+		{
+			// in the file
+			int64_t offset;
+			const unsigned char* data;
+			size_t size;
+		};
+
+		ChunkReader(std::shared_ptr<VirtualFile> file, size_t chunkSize = 1 << 20, unsigned readAhead = 2);
+		~ChunkReader();
+
+		// the next chunk, valid until the following call; false at the end
+		// of the file, on a read error and for no file
+		bool Next(Chunk& chunk);
+		// whether Next() stopped on an error rather than the end of the file
+		bool Failed() const;
+
+		int64_t Size() const;
+		size_t ChunkSize() const;
+
+	private:
+		struct Buffer
+		{
+			std::vector<unsigned char> data;
+			size_t size;
+			int64_t offset;
+		};
+
+		// reads chunk 'index' into its buffer; the bytes read, 0 past the end, -1 on an error
+		int64_t Fill(uint64_t index);
+		void Work();
+
+		std::shared_ptr<VirtualFile> m_File;
+		int64_t m_Size;
+		size_t m_ChunkSize;
+		// a ring, chunk i goes into m_Buffers[i % m_Buffers.size()]
+		std::vector<Buffer> m_Buffers;
+
+		mutable std::mutex m_Mutex;
+		std::condition_variable m_Changed;
+		// chunks read, handed out, and handed back by the next Next()
+		uint64_t m_Filled;
+		uint64_t m_Taken;
+		uint64_t m_Released;
+		bool m_End;
+		bool m_Failed;
+		bool m_Stop;
+
+		std::thread m_Thread;
+	};
+}
@@ -27,6 +27,7 @@ public class VulkanActivity extends Activity implements SurfaceHolder.Callback
     public static native void nativeOnInput(int type, float x, float y);
     public static native void nativeSetSurface(Surface surface);
     public static native void nativeSetAssetManager(AssetManager assetManagerInstance);
+    public static native void nativeSetCacheDir(String path);
     public static native void nativeOnConfigurationChanged();
     public static native void nativeOnWindowFocusChanged(boolean hasFocus);
 //    public static native void nativeDoFrame(long frameTimeNanos);
@@ -65,6 +66,7 @@ public class VulkanActivity extends Activity implements SurfaceHolder.Callback
 
         assetManagerInstance = getResources().getAssets();
         nativeSetAssetManager(assetManagerInstance);
+        nativeSetCacheDir(getCacheDir().getAbsolutePath());
 
         nativeOnStart();
     }
@@ -195,3 +195,23 @@ void PacketProfileScopeOut::SetNanoseconds(double usec)
 {
 	m_Nanoseconds = usec;
 }
+
+
+PacketCounter::PacketCounter(double time, std::string name, double value)
+		: PacketProfileScopeIn(PacketCounter::ID, time, name)
+		, m_Value(value)
+{
+}
+
+unsigned int PacketCounter::GetSize()
+{
+	return PacketProfileScopeIn::GetSize() + sizeof(m_Value);
+}
+
+void PacketCounter::ToBuffer(unsigned char* buffer)
+{
+	PacketProfileScopeIn::ToBuffer(buffer);
+
+	unsigned int bufferIndexOffset = PacketProfileScopeIn::GetSize();
+	std::memcpy(buffer + bufferIndexOffset, (unsigned char*)&m_Value, sizeof(m_Value));
+}
@@ -60,4 +60,17 @@ public:
 	void SetNanoseconds(double);
 
 	PacketProfileScopeOut(double time, std::string scope, unsigned int useconds);
+};
+
+class PacketCounter : public PacketProfileScopeIn
+{
+	static const unsigned char ID = 0x20;
+
+	double m_Value;
+
+public:
+	virtual unsigned int GetSize();
+	virtual void ToBuffer(unsigned char*);
+
+	PacketCounter(double time, std::string name, double value);
 };
\ No newline at end of file
@@ -71,6 +71,11 @@ namespace Profiler {
 		return std::unique_ptr<ScopeProfiler>(new ScopeProfiler(name));
 	}
 
+	void Counter(std::string name, double value)
+	{
+		socketClient->SendPacketAsync(std::shared_ptr<PacketCounter>(new PacketCounter(startTime->GetNanoseconds(), name, value)));
+	}
+
 	void Destroy()
 	{
 		delete socketClient;
@@ -13,6 +13,7 @@
 #define PROFILE_DETAIL(a, b) std::unique_ptr<Profiler::ScopeProfiler> MAKE_UNIQUE(a) = Profiler::ProfileScope(b);
 #define PROFILE PROFILE_DETAIL(prof_var, __PRETTY_FUNCTION__)
 #define PROFILE_CUST(a) PROFILE_DETAIL(CONCATENATE_DETAIL(prof_var, a), a)
+#define PROFILE_COUNTER(name, value) Profiler::Counter(name, value)
 
 namespace Profiler
 {
@@ -29,10 +30,14 @@ namespace Profiler
 
 	std::unique_ptr<ScopeProfiler> ProfileScope(std::string name);
 
+	// a named value over time, e.g. resident texture bytes once per frame
+	void Counter(std::string name, double value);
+
 };
 #else
 #define PROFILE (void)0
 #define PROFILE_CUST(a) (void)0
+#define PROFILE_COUNTER(name, value) (void)0
 namespace Profiler
 {
     static void Initialize()
@@ -0,0 +1,24 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+// see Renderer::Vertex
+layout(location = 0) in vec2 position;
+layout(location = 1) in vec2 texCoord;
+layout(location = 2) in vec4 color;
+
+layout(push_constant) uniform PushConstants {
+    mat4 projection;
+} pushConstants;
+
+layout(location = 0) out vec2 fragTexCoord;
+layout(location = 1) out vec4 fragColor;
+
+void main() {
+    gl_Position = pushConstants.projection * vec4(position, 0.0, 1.0);
+    fragTexCoord = texCoord;
+    fragColor = color;
+}
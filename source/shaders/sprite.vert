@@ -0,0 +1,33 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+out gl_PerVertex {
+    vec4 gl_Position;
+};
+
+// per instance, see Sprites::Instance
+layout(location = 0) in vec4 rect;      // centre xy, size zw
+layout(location = 1) in vec4 uvRect;    // u0 v0 u1 v1
+layout(location = 2) in float rotation;
+layout(location = 3) in vec4 color;
+
+layout(push_constant) uniform PushConstants {
+    mat4 projection;
+} pushConstants;
+
+layout(location = 0) out vec2 fragTexCoord;
+layout(location = 1) out vec4 fragColor;
+
+void main() {
+    // triangle strip: (0,0) (1,0) (0,1) (1,1)
+    vec2 corner = vec2(gl_VertexIndex & 1, gl_VertexIndex >> 1);
+    vec2 local = (corner - 0.5) * rect.zw;
+
+    float s = sin(rotation);
+    float c = cos(rotation);
+    vec2 position = rect.xy + vec2(c * local.x - s * local.y, s * local.x + c * local.y);
+
+    gl_Position = pushConstants.projection * vec4(position, 0.0, 1.0);
+    fragTexCoord = mix(uvRect.xy, uvRect.zw, corner);
+    fragColor = color;
+}
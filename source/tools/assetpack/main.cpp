@@ -0,0 +1,129 @@
+/* assetpack <output> <directory> [--store <extension>]...
+ *
+ * Packs every file below directory, by its path relative to it. Entries
+ * are LZ4 compressed where that saves an eighth, except for the extensions
+ * given with --store (already compressed formats, say ktx2 or png).
+ */
+#include "utils/assetpack.h"
+#include "utils/log.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <sys/stat.h>
+
+namespace {
+    bool ReadFile(const std::string& path, std::vector<unsigned char>& data)
+    {
+        FILE* file = fopen(path.c_str(), "rb");
+        if (file == nullptr)
+        {
+            return false;
+        }
+
+        data.clear();
+        unsigned char chunk[65536];
+        size_t read;
+        while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0)
+        {
+            data.insert(data.end(), chunk, chunk + read);
+        }
+
+        const bool ok = ferror(file) == 0;
+        fclose(file);
+        return ok;
+    }
+
+    bool Stored(const std::string& path, const std::vector<std::string>& storeExtensions)
+    {
+        const std::string::size_type dot = path.rfind('.');
+        if (dot == std::string::npos || path.find('/', dot) != std::string::npos)
+        {
+            return false;
+        }
+        return std::find(storeExtensions.begin(), storeExtensions.end(), path.substr(dot + 1)) != storeExtensions.end();
+    }
+
+    // relative paths of the regular files below directory
+    void ListFiles(const std::string& directory, const std::string& relative, std::vector<std::string>& files)
+    {
+        const std::string path = relative.empty() ? directory : directory + "/" + relative;
+        DIR* dir = opendir(path.c_str());
+        if (dir == nullptr)
+        {
+            return;
+        }
+
+        while (dirent* entry = readdir(dir))
+        {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+            {
+                continue;
+            }
+
+            const std::string name = relative.empty() ? std::string(entry->d_name) : relative + "/" + entry->d_name;
+            struct stat info;
+            if (stat((directory + "/" + name).c_str(), &info) != 0)
+            {
+                continue;
+            }
+            if (S_ISDIR(info.st_mode))
+            {
+                ListFiles(directory, name, files);
+            }
+            else if (S_ISREG(info.st_mode))
+            {
+                files.push_back(name);
+            }
+        }
+        closedir(dir);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        LOGE("usage: assetpack <output> <directory> [--store <extension>]...");
+        return 1;
+    }
+
+    const std::string output = argv[1];
+    const std::string directory = argv[2];
+    std::vector<std::string> storeExtensions;
+    for (int i = 3; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "--store") != 0)
+        {
+            LOGE("unknown option %s", argv[i]);
+            return 1;
+        }
+        storeExtensions.push_back(argv[i + 1]);
+    }
+
+    std::vector<std::string> files;
+    ListFiles(directory, "", files);
+    //the same pack for the same input
+    std::sort(files.begin(), files.end());
+
+    AssetPack::Writer writer;
+    std::vector<unsigned char> data;
+    for (const std::string& file : files)
+    {
+        if (!ReadFile(directory + "/" + file, data))
+        {
+            LOGE("Unable to read %s", file.c_str());
+            return 1;
+        }
+        writer.Add(file, data, !Stored(file, storeExtensions));
+    }
+
+    if (!writer.Write(output))
+    {
+        return 1;
+    }
+
+    LOGI("%s: %u files, %llu bytes, %llu stored", output.c_str(), (unsigned)writer.EntryCount(),
+        (unsigned long long)writer.OriginalBytes(), (unsigned long long)writer.StoredBytes());
+    return 0;
+}
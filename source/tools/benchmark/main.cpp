@@ -0,0 +1,324 @@
+/* benchmark <name> <directory> [options]
+ *
+ * Runs the benchmarks built into the app on a host, over the files below
+ * directory, read through a Vfs POSIX root:
+ *
+ *   decode [--threads N] [--rounds N] [--cache <directory>]
+ *       ImageDecode::RunBenchmark over the PNGs, with libpng standing in
+ *       for AImageDecoder; with --cache a cold and a warm run through
+ *       CachedDecoder follow
+ *
+ *   lookup [--lookups N]
+ *       Vfs::RunLookupBenchmark over the paths of the files, the PathIndex
+ *       against the per-directory maps it replaced
+ *
+ *   read [--threads N] [--chunk KB] [--pack <pack>]
+ *       Vfs::RunReadBenchmark over the files, streamed in chunks with
+ *       whole-file loads mixed in, coalescing off and on; with --pack the
+ *       files of that pack (a file below directory) instead, mounted at
+ *       "pack"
+ *
+ *   atlas [--icons N] [--page N]
+ *       Atlas::RunBenchmark, a synthetic icon set packed, churned and
+ *       defragmented; directory is not read
+ *
+ *   sprites [--sprites N] [--frames N]
+ *       Sprites::RunCpuBenchmark, the moving sprites the Vulkan renderer
+ *       draws, sorted and batched into plain memory; directory is not read
+ */
+#include "graphics/atlas.h"
+#include "graphics/imagedecode.h"
+#include "graphics/spritebatch.h"
+#include "utils/contentcache.h"
+#include "utils/fs_pack.h"
+#include "utils/fs_posix.h"
+#include "utils/log.h"
+#include "utils/pathindex.h"
+#include "utils/vfs_async.h"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifdef BENCHMARK_PNG
+#include <png.h>
+#endif
+
+namespace {
+    struct Options
+    {
+        unsigned threads;
+        unsigned rounds;
+        std::string cache;
+        unsigned lookups;
+        int64_t chunk;
+        std::string pack;
+        unsigned icons;
+        unsigned pageSize;
+        unsigned sprites;
+        unsigned frames;
+    };
+
+    bool HasExtension(const std::string& path, const char* extension)
+    {
+        const std::string::size_type dot = path.rfind('.');
+        return dot != std::string::npos && path.compare(dot + 1, std::string::npos, extension) == 0;
+    }
+
+    // the files below the root, directories left out
+    std::vector<std::string> ListFiles(const char* extension)
+    {
+        std::vector<std::string> files;
+        for (const std::string& path : Vfs::List("", true))
+        {
+            if (path.back() != '/' && (extension == nullptr || HasExtension(path, extension)))
+            {
+                files.push_back(path);
+            }
+        }
+        return files;
+    }
+
+#ifdef BENCHMARK_PNG
+    bool DecodePng(const unsigned char* data, size_t size, ImageDecode::Image& image)
+    {
+        png_image png;
+        memset(&png, 0, sizeof(png));
+        png.version = PNG_IMAGE_VERSION;
+        if (!png_image_begin_read_from_memory(&png, data, size))
+        {
+            return false;
+        }
+
+        png.format = PNG_FORMAT_RGBA;
+        image.width = png.width;
+        image.height = png.height;
+        image.pixels.resize(PNG_IMAGE_SIZE(png));
+        if (!png_image_finish_read(&png, nullptr, image.pixels.data(), 0, nullptr))
+        {
+            png_image_free(&png);
+            return false;
+        }
+        return true;
+    }
+#endif
+
+    void PrintDecode(const char* title, const std::vector<ImageDecode::BenchmarkResult>& results)
+    {
+        LOGI("%s", title);
+        for (const ImageDecode::BenchmarkResult& result : results)
+        {
+            LOGI("  %2u threads: %u images in %8.2f ms, %8.1f images/s, %7.1f MP/s, %.2fx",
+                result.threads, result.images, result.milliseconds, result.imagesPerSecond,
+                result.megapixelsPerSecond, result.speedup);
+        }
+    }
+
+    int Decode(const Options& options)
+    {
+#ifdef BENCHMARK_PNG
+        //read through Vfs the way the pipeline does, then decoded from memory
+        std::vector<std::vector<unsigned char> > files;
+        for (const std::string& path : ListFiles("png"))
+        {
+            std::vector<unsigned char> data;
+            ImageDecode::Image image;
+            if (ImageDecode::ReadFromVfs(path, data) && DecodePng(data.data(), data.size(), image))
+            {
+                files.push_back(std::move(data));
+            }
+        }
+        if (files.empty())
+        {
+            LOGE("No PNGs to decode");
+            return 1;
+        }
+        LOGI("%u PNGs, %u rounds", unsigned(files.size()), options.rounds);
+
+        PrintDecode("libpng:", ImageDecode::RunBenchmark(files, DecodePng, options.threads, options.rounds));
+
+        if (!options.cache.empty())
+        {
+            Vfs::ContentCache cache(std::make_shared<Vfs::PosixFileSystem>(options.cache, true), "", uint64_t(1) << 30);
+            const ImageDecode::DecodeFunction cached = ImageDecode::CachedDecoder(cache, DecodePng);
+            PrintDecode("cached, cold:", ImageDecode::RunBenchmark(files, cached, 1, 1));
+            PrintDecode("cached, warm:", ImageDecode::RunBenchmark(files, cached, options.threads, options.rounds));
+            const Vfs::ContentCache::Stats stats = cache.GetStats();
+            LOGI("cache: %u hits, %u misses, %u stored, %.1f MB", stats.hits, stats.misses, stats.stored, cache.Bytes() / 1048576.0);
+        }
+        return 0;
+#else
+        (void)options;
+        LOGE("Built without libpng, nothing to decode with");
+        return 1;
+#endif
+    }
+
+    int Lookup(const Options& options)
+    {
+        const std::vector<std::string> paths = ListFiles(nullptr);
+        if (paths.empty())
+        {
+            LOGE("No files to look up");
+            return 1;
+        }
+
+        const Vfs::LookupBenchmarkResult result = Vfs::RunLookupBenchmark(paths, options.lookups);
+        LOGI("%u paths, %u lookups: index %.2f ms, maps %.2f ms, %.2fx",
+            unsigned(paths.size()), result.lookups, result.indexMilliseconds, result.mapMilliseconds, result.speedup);
+        return 0;
+    }
+
+    int Read(const Options& options)
+    {
+        std::vector<std::string> paths;
+        if (options.pack.empty())
+        {
+            paths = ListFiles(nullptr);
+        }
+        else
+        {
+            std::shared_ptr<Vfs::PackFileSystem> pack = Vfs::PackFileSystem::Load(Vfs::Open<Vfs::VirtualFile>(options.pack));
+            if (!pack)
+            {
+                LOGE("Unable to load %s", options.pack.c_str());
+                return 1;
+            }
+            Vfs::GetRoot()->Mount("pack", pack);
+            for (const std::string& path : pack->List("", true))
+            {
+                if (path.back() != '/')
+                {
+                    paths.push_back("pack/" + path);
+                }
+            }
+        }
+        if (paths.empty())
+        {
+            LOGE("No files to read");
+            return 1;
+        }
+        LOGI("%u files, %lld KB chunks", unsigned(paths.size()), (long long)(options.chunk / 1024));
+
+        for (const Vfs::ReadBenchmarkResult& result : Vfs::RunReadBenchmark(paths, options.threads, options.chunk))
+        {
+            LOGI("  %2u threads, batch %7u: %6u requests in %8.2f ms, %8.1f MB/s, %u reads, %u coalesced",
+                result.threads, unsigned(result.maxBatch), result.requests, result.milliseconds,
+                result.megabytesPerSecond, result.stats.reads, result.stats.coalesced);
+        }
+        return 0;
+    }
+
+    int PackAtlas(const Options& options)
+    {
+        const Atlas::BenchmarkResult atlas = Atlas::RunBenchmark(options.icons, options.pageSize);
+        LOGI("%u icons on %ux%u pages: %u pages (%.1f%%) in %.2f ms", atlas.icons, options.pageSize, options.pageSize,
+            atlas.pages, atlas.efficiency * 100.0f, atlas.insertMilliseconds);
+        LOGI("after churn %u pages (%.1f%%), defragmented %u pages (%.1f%%), %u moved in %.2f ms",
+            atlas.pagesAfterChurn, atlas.efficiencyAfterChurn * 100.0f, atlas.pagesAfterDefragment,
+            atlas.efficiencyAfterDefragment * 100.0f, atlas.moved, atlas.defragmentMilliseconds);
+        LOGI("texture switches drawing every icon: %u per image, %u per page", atlas.batchesPerImage, atlas.batchesPerPage);
+        return 0;
+    }
+
+    int Batch(const Options& options)
+    {
+        const Sprites::Stats stats = Sprites::RunCpuBenchmark(options.sprites, options.frames);
+        LOGI("%u sprites over %u frames: %u draws/frame, %.2f ms/frame to build",
+            stats.sprites, options.frames, stats.draws, stats.buildMilliseconds);
+        return 0;
+    }
+
+    int Usage()
+    {
+        LOGE("usage: benchmark decode <directory> [--threads N] [--rounds N] [--cache <directory>]");
+        LOGE("       benchmark lookup <directory> [--lookups N]");
+        LOGE("       benchmark read <directory> [--threads N] [--chunk KB] [--pack <pack>]");
+        LOGE("       benchmark atlas <directory> [--icons N] [--page N]");
+        LOGE("       benchmark sprites <directory> [--sprites N] [--frames N]");
+        return 2;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        return Usage();
+    }
+
+    Options options = {8, 4, std::string(), 100000, 64 * 1024, std::string(), 1000, 1024, 100000, 60};
+    for (int i = 3; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            options.threads = unsigned(atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--rounds") == 0 && i + 1 < argc)
+        {
+            options.rounds = unsigned(atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--cache") == 0 && i + 1 < argc)
+        {
+            options.cache = argv[++i];
+        }
+        else if (strcmp(argv[i], "--lookups") == 0 && i + 1 < argc)
+        {
+            options.lookups = unsigned(atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--chunk") == 0 && i + 1 < argc)
+        {
+            options.chunk = int64_t(atoi(argv[++i])) * 1024;
+        }
+        else if (strcmp(argv[i], "--pack") == 0 && i + 1 < argc)
+        {
+            options.pack = argv[++i];
+        }
+        else if (strcmp(argv[i], "--icons") == 0 && i + 1 < argc)
+        {
+            options.icons = unsigned(atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--page") == 0 && i + 1 < argc)
+        {
+            options.pageSize = unsigned(atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--sprites") == 0 && i + 1 < argc)
+        {
+            options.sprites = unsigned(atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+        {
+            options.frames = unsigned(atoi(argv[++i]));
+        }
+        else
+        {
+            return Usage();
+        }
+    }
+
+    Vfs::PosixFileSystem root(argv[2]);
+    Vfs::SetRoot(&root);
+
+    const std::string name = argv[1];
+    if (name == "decode")
+    {
+        return Decode(options);
+    }
+    if (name == "lookup")
+    {
+        return Lookup(options);
+    }
+    if (name == "read")
+    {
+        return Read(options);
+    }
+    if (name == "atlas")
+    {
+        return PackAtlas(options);
+    }
+    if (name == "sprites")
+    {
+        return Batch(options);
+    }
+    return Usage();
+}
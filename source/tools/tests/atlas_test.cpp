@@ -0,0 +1,115 @@
+/* Atlas::Packer: regions inside their pages and apart, padding included,
+ * after inserts, churn and Defragment, and a repack that no longer fits in
+ * maxPages leaving every region where it was.
+ */
+#include "check.h"
+#include "graphics/atlas.h"
+#include <vector>
+
+namespace {
+    struct Size
+    {
+        uint32_t width, height;
+    };
+
+    // every live region on a page, none overlapping another with its padding
+    bool Disjoint(const Atlas::Packer& packer, const std::vector<Atlas::Handle>& handles, uint32_t padding)
+    {
+        for (size_t i = 0; i < handles.size(); ++i)
+        {
+            if (!packer.IsValid(handles[i]))
+                continue;
+            const Atlas::Region& a = packer.Get(handles[i]);
+            if (a.page >= packer.PageCount() || a.x < padding || a.y < padding ||
+                a.x + a.width + padding > packer.PageSize() || a.y + a.height + padding > packer.PageSize())
+                return false;
+
+            for (size_t j = i + 1; j < handles.size(); ++j)
+            {
+                if (!packer.IsValid(handles[j]))
+                    continue;
+                const Atlas::Region& b = packer.Get(handles[j]);
+                if (a.page == b.page &&
+                    a.x < b.x + b.width + 2 * padding && b.x < a.x + a.width + 2 * padding &&
+                    a.y < b.y + b.height + 2 * padding && b.y < a.y + a.height + 2 * padding)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    void TestChurn()
+    {
+        Atlas::Packer packer(256, 1, 64);
+        std::vector<Atlas::Handle> handles;
+        uint32_t random = 0x2468ACE1;
+        for (int i = 0; i < 400; ++i)
+        {
+            random = random * 1103515245 + 12345;
+            const uint32_t width = 8 + (random >> 8) % 56;
+            const uint32_t height = 8 + (random >> 16) % 56;
+            handles.push_back(packer.Insert(width, height));
+            CHECK(handles.back() != Atlas::InvalidHandle);
+        }
+        CHECK(Disjoint(packer, handles, 1));
+
+        for (size_t i = 0; i < handles.size(); i += 2)
+            packer.Remove(handles[i]);
+        const uint32_t pagesBefore = packer.PageCount();
+
+        const std::vector<Atlas::Move> moves = packer.Defragment();
+        CHECK(!moves.empty());
+        CHECK(packer.PageCount() < pagesBefore);
+        CHECK(packer.GetStats().freedArea == 0);
+        CHECK(Disjoint(packer, handles, 1));
+        for (const Atlas::Move& move : moves)
+        {
+            const Atlas::Region& region = packer.Get(move.handle);
+            CHECK(region.page == move.to.page && region.x == move.to.x && region.y == move.to.y);
+        }
+    }
+
+    void TestRepackDoesNotFit()
+    {
+        // fits inserted in this order, but not tallest first
+        const Size sizes[] = {{7, 6}, {1, 2}, {1, 8}, {8, 2}, {3, 8}, {6, 6}, {3, 5}, {7, 6}};
+
+        Atlas::Packer packer(16, 0, 1);
+        std::vector<Atlas::Handle> handles;
+        for (const Size& size : sizes)
+        {
+            handles.push_back(packer.Insert(size.width, size.height));
+            CHECK(handles.back() != Atlas::InvalidHandle);
+        }
+        std::vector<Atlas::Region> before;
+        for (Atlas::Handle handle : handles)
+            before.push_back(packer.Get(handle));
+
+        // nothing moves and no page goes away under the regions
+        CHECK(packer.Defragment().empty());
+        CHECK(packer.PageCount() == 1);
+        for (size_t i = 0; i < handles.size(); ++i)
+        {
+            const Atlas::Region& region = packer.Get(handles[i]);
+            CHECK(region.page == before[i].page && region.x == before[i].x && region.y == before[i].y);
+        }
+        CHECK(Disjoint(packer, handles, 0));
+
+        // with room for another page the repack goes through
+        Atlas::Packer roomy(16, 0, 2);
+        handles.clear();
+        for (const Size& size : sizes)
+            handles.push_back(roomy.Insert(size.width, size.height));
+        CHECK(roomy.PageCount() == 1);
+        CHECK(!roomy.Defragment().empty());
+        CHECK(roomy.PageCount() == 2);
+        CHECK(Disjoint(roomy, handles, 0));
+    }
+}
+
+int main()
+{
+    TestChurn();
+    TestRepackDoesNotFit();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,24 @@
+/* Host test checks
+ *
+ * CHECK() reports a condition that doesn't hold, with where it is, and
+ * carries on, so one run shows every failure. A test's main() ends with
+ * return CHECK_RESULT();
+ */
+#pragma once
+#include <cstdio>
+
+namespace {
+    int g_Failures = 0;
+}
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            g_Failures++; \
+        } \
+    } while (0)
+
+#define CHECK_RESULT() (g_Failures == 0 ? 0 : (std::fprintf(stderr, "%d checks failed\n", g_Failures), 1))
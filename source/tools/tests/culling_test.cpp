@@ -0,0 +1,138 @@
+/* Culling: the SIMD Cull against the CullScalar reference on random spheres,
+ * at every count around the four-wide blocks, and on spheres that exactly
+ * touch a plane.
+ */
+#include "check.h"
+#include "graphics/culling.h"
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+    bool Same(const std::vector<Culling::DrawCommand>& a, const std::vector<Culling::DrawCommand>& b, uint32_t count)
+    {
+        return std::memcmp(a.data(), b.data(), count * sizeof(Culling::DrawCommand)) == 0;
+    }
+
+    // column-major perspective, 0..1 depth, looking down -z
+    void Perspective(float fovY, float aspect, float zNear, float zFar, float out[16])
+    {
+        const float f = 1.0f / std::tan(fovY * 0.5f);
+        std::memset(out, 0, sizeof(float) * 16);
+        out[0] = f / aspect;
+        out[5] = f;
+        out[10] = zFar / (zNear - zFar);
+        out[11] = -1.0f;
+        out[14] = zNear * zFar / (zNear - zFar);
+    }
+
+    // draws tell where they came from by firstInstance
+    std::vector<Culling::DrawCommand> Draws(uint32_t count)
+    {
+        std::vector<Culling::DrawCommand> draws(count);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            draws[i] = Culling::DrawCommand{36, 1, i * 36, 0, i};
+        }
+        return draws;
+    }
+
+    // both versions agree, draw for draw, and with IsVisible
+    void Compare(const Culling::Frustum& frustum, const std::vector<Culling::Bounds>& bounds, uint32_t count)
+    {
+        const std::vector<Culling::DrawCommand> draws = Draws(count);
+        std::vector<Culling::DrawCommand> scalar(count + 1);
+        std::vector<Culling::DrawCommand> simd(count + 1);
+        const uint32_t scalarCount = Culling::CullScalar(frustum, bounds.data(), draws.data(), count, scalar.data());
+        const uint32_t simdCount = Culling::Cull(frustum, bounds.data(), draws.data(), count, simd.data());
+        CHECK(scalarCount == simdCount);
+        CHECK(Same(scalar, simd, scalarCount));
+
+        uint32_t visible = 0;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            if (Culling::IsVisible(frustum, bounds[i]))
+            {
+                CHECK(visible < scalarCount && scalar[visible].firstInstance == i);
+                visible++;
+            }
+        }
+        CHECK(visible == scalarCount);
+    }
+
+    void TestRandom()
+    {
+        float viewProjection[16];
+        Perspective(1.0f, 16.0f / 9.0f, 0.1f, 100.0f, viewProjection);
+        const Culling::Frustum frustum = Culling::FromMatrix(viewProjection);
+
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> position(-60.0f, 60.0f);
+        std::uniform_real_distribution<float> radius(0.0f, 5.0f);
+        std::vector<Culling::Bounds> bounds(10001);
+        for (Culling::Bounds& sphere : bounds)
+        {
+            sphere = Culling::Bounds{position(random), position(random), position(random) - 50.0f, radius(random)};
+        }
+
+        // every tail length, and the remainder of a count that isn't a multiple of four
+        for (uint32_t count = 0; count <= 37; ++count)
+        {
+            Compare(frustum, bounds, count);
+        }
+        Compare(frustum, bounds, 10001);
+    }
+
+    void TestOnPlane()
+    {
+        // the identity is the box -1..1 in x and y, 0..1 in z, with unit normals
+        const float identity[16] = { 1, 0, 0, 0,   0, 1, 0, 0,   0, 0, 1, 0,   0, 0, 0, 1 };
+        const Culling::Frustum frustum = Culling::FromMatrix(identity);
+
+        // touching from outside counts as visible, a hair further doesn't
+        const Culling::Bounds touching[] = {
+            {-2.0f, 0.0f, 0.5f, 1.0f}, {2.0f, 0.0f, 0.5f, 1.0f},
+            {0.0f, -1.5f, 0.5f, 0.5f}, {0.0f, 1.5f, 0.5f, 0.5f},
+            {0.0f, 0.0f, -0.25f, 0.25f}, {0.0f, 0.0f, 1.25f, 0.25f},
+            // centre on the plane, zero radius
+            {1.0f, 0.0f, 0.5f, 0.0f},
+        };
+        const Culling::Bounds outside[] = {
+            {-2.001f, 0.0f, 0.5f, 1.0f}, {0.0f, 1.501f, 0.5f, 0.5f}, {0.0f, 0.0f, 1.26f, 0.25f},
+        };
+
+        std::vector<Culling::Bounds> bounds;
+        for (const Culling::Bounds& sphere : touching)
+        {
+            CHECK(Culling::IsVisible(frustum, sphere));
+            bounds.push_back(sphere);
+        }
+        for (const Culling::Bounds& sphere : outside)
+        {
+            CHECK(!Culling::IsVisible(frustum, sphere));
+            bounds.push_back(sphere);
+        }
+
+        const uint32_t count = (uint32_t)bounds.size();
+        const std::vector<Culling::DrawCommand> draws = Draws(count);
+        std::vector<Culling::DrawCommand> out(count);
+        CHECK(Culling::Cull(frustum, bounds.data(), draws.data(), count, out.data()) == 7);
+        for (uint32_t i = 0; i < 7; ++i)
+        {
+            CHECK(out[i].firstInstance == i);
+        }
+        for (uint32_t start = 0; start < count; ++start)
+        {
+            std::vector<Culling::Bounds> shifted(bounds.begin() + start, bounds.end());
+            Compare(frustum, shifted, (uint32_t)shifted.size());
+        }
+    }
+}
+
+int main()
+{
+    TestRandom();
+    TestOnPlane();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,232 @@
+/* GlState: the calls that reach GL, through the recording MockDispatch, for
+ * redundant state, the texture unit order, the unit left active for uploads,
+ * Invalidate and the Forget calls.
+ */
+#include "check.h"
+#include "graphics/glstate.h"
+#include <string>
+#include <vector>
+
+namespace {
+    // the calls made since the last Issued(), which forgets them
+    std::vector<std::string> Issued()
+    {
+        std::vector<std::string> calls;
+        calls.swap(GlState::MockCalls());
+        return calls;
+    }
+
+    bool Expect(const std::vector<std::string>& expected)
+    {
+        const std::vector<std::string> calls = Issued();
+        if (calls == expected)
+        {
+            return true;
+        }
+
+        std::fprintf(stderr, "issued:\n");
+        for (const std::string& call : calls)
+        {
+            std::fprintf(stderr, "  %s\n", call.c_str());
+        }
+        std::fprintf(stderr, "expected:\n");
+        for (const std::string& call : expected)
+        {
+            std::fprintf(stderr, "  %s\n", call.c_str());
+        }
+        return false;
+    }
+
+    void Reset()
+    {
+        GlState::Initialize(GlState::MockDispatch());
+        Issued();
+    }
+
+    void TestRedundant()
+    {
+        Reset();
+        GlState::UseProgram(3);
+        GlState::UseProgram(3);
+        GlState::BindBuffer(GL_ARRAY_BUFFER, 5);
+        GlState::BindBuffer(GL_ARRAY_BUFFER, 5);
+        GlState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 5);
+        GlState::SetEnabled(GL_BLEND, true);
+        GlState::SetEnabled(GL_BLEND, true);
+        GlState::SetEnabled(GL_BLEND, false);
+        GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        GlState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        GlState::Scissor(1, 2, 3, 4);
+        GlState::Scissor(1, 2, 3, 4);
+        GlState::Scissor(1, 2, 3, 5);
+        GlState::Viewport(0, 0, 640, 480);
+        GlState::Viewport(0, 0, 640, 480);
+        GlState::SetVertexAttribArray(2, true);
+        GlState::SetVertexAttribArray(2, true);
+        GlState::SetVertexAttribArray(2, false);
+        GlState::UseProgram(4);
+        CHECK(Expect({
+            "glUseProgram(3)",
+            "glBindBuffer(0x8892, 5)",
+            "glBindBuffer(0x8893, 5)",
+            "glEnable(0x0be2)",
+            "glDisable(0x0be2)",
+            "glBlendFunc(0x0302, 0x0303)",
+            "glScissor(1, 2, 3, 4)",
+            "glScissor(1, 2, 3, 5)",
+            "glViewport(0, 0, 640, 480)",
+            "glEnableVertexAttribArray(2)",
+            "glDisableVertexAttribArray(2)",
+            "glUseProgram(4)",
+        }));
+    }
+
+    void TestTextures()
+    {
+        Reset();
+        // the unit is selected before the bind, and only when it isn't active already
+        GlState::BindTexture(1, 7);
+        GlState::BindTexture(1, 7);
+        GlState::BindTexture(0, 7);
+        GlState::BindTexture(0, 9);
+        GlState::BindTexture(1, 7);
+        GlState::BindTexture(1, 8);
+        CHECK(Expect({
+            "glActiveTexture(0x84c1)",
+            "glBindTexture(0x0de1, 7)",
+            "glActiveTexture(0x84c0)",
+            "glBindTexture(0x0de1, 7)",
+            "glBindTexture(0x0de1, 9)",
+            "glActiveTexture(0x84c1)",
+            "glBindTexture(0x0de1, 8)",
+        }));
+
+        // past the shadowed units everything goes through, and the active unit is no longer known
+        GlState::BindTexture(GlState::MaxTextureUnits, 3);
+        GlState::BindTexture(GlState::MaxTextureUnits, 3);
+        GlState::BindTexture(1, 9);
+        CHECK(Expect({
+            "glActiveTexture(0x84c8)",
+            "glBindTexture(0x0de1, 3)",
+            "glActiveTexture(0x84c8)",
+            "glBindTexture(0x0de1, 3)",
+            "glActiveTexture(0x84c1)",
+            "glBindTexture(0x0de1, 9)",
+        }));
+    }
+
+    void TestUploadUnit()
+    {
+        Reset();
+        GlState::BindTexture(0, 5);
+        GlState::BindTexture(1, 6);
+        Issued();
+
+        // what Texture's uploads do: bind on unit 0, then glTexSubImage2D;
+        // 5 is bound there already, but unit 1 is the active one
+        GlState::BindTexture(0, 5);
+        CHECK(Expect({
+            "glActiveTexture(0x84c0)",
+        }));
+
+        // and once it is active, nothing at all
+        GlState::BindTexture(0, 5);
+        CHECK(Expect({}));
+    }
+
+    void TestInvalidate()
+    {
+        Reset();
+        GlState::UseProgram(3);
+        GlState::BindBuffer(GL_ARRAY_BUFFER, 5);
+        GlState::BindTexture(0, 7);
+        GlState::SetEnabled(GL_SCISSOR_TEST, true);
+        Issued();
+
+        // someone else touched GL; everything is issued again, once
+        GlState::Invalidate();
+        for (int i = 0; i < 2; ++i)
+        {
+            GlState::UseProgram(3);
+            GlState::BindBuffer(GL_ARRAY_BUFFER, 5);
+            GlState::BindTexture(0, 7);
+            GlState::SetEnabled(GL_SCISSOR_TEST, true);
+        }
+        CHECK(Expect({
+            "glUseProgram(3)",
+            "glBindBuffer(0x8892, 5)",
+            "glActiveTexture(0x84c0)",
+            "glBindTexture(0x0de1, 7)",
+            "glEnable(0x0c11)",
+        }));
+    }
+
+    void TestForget()
+    {
+        Reset();
+        GlState::UseProgram(3);
+        GlState::BindBuffer(GL_ARRAY_BUFFER, 5);
+        GlState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 5);
+        GlState::BindTexture(0, 7);
+        GlState::BindTexture(1, 7);
+        Issued();
+
+        // deleting unbinds them in GL, so binding 0 afterwards is redundant
+        // and binding a reused name isn't
+        GlState::ForgetProgram(3);
+        GlState::ForgetBuffer(5);
+        GlState::ForgetTexture(7);
+        GlState::BindBuffer(GL_ARRAY_BUFFER, 0);
+        GlState::BindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+        GlState::BindTexture(0, 0);
+        GlState::BindTexture(1, 0);
+        CHECK(Expect({
+            "glActiveTexture(0x84c0)",
+            "glActiveTexture(0x84c1)",
+        }));
+
+        GlState::UseProgram(3);
+        GlState::BindBuffer(GL_ARRAY_BUFFER, 5);
+        GlState::BindTexture(1, 7);
+        CHECK(Expect({
+            "glUseProgram(3)",
+            "glBindBuffer(0x8892, 5)",
+            "glBindTexture(0x0de1, 7)",
+        }));
+
+        // forgetting something that isn't bound changes nothing
+        GlState::ForgetProgram(42);
+        GlState::ForgetBuffer(42);
+        GlState::ForgetTexture(42);
+        GlState::UseProgram(3);
+        GlState::BindBuffer(GL_ARRAY_BUFFER, 5);
+        GlState::BindTexture(1, 7);
+        CHECK(Expect({}));
+    }
+
+    void TestCounters()
+    {
+        Reset();
+        GlState::SetCounting(true);
+        GlState::ResetCounters();
+        GlState::UseProgram(3);
+        GlState::UseProgram(3);
+        GlState::UseProgram(3);
+        GlState::BindBuffer(GL_ARRAY_BUFFER, 5);
+        CHECK(GlState::GetCounters().issued == 2);
+        CHECK(GlState::GetCounters().avoided == 2);
+        GlState::SetCounting(false);
+        Issued();
+    }
+}
+
+int main()
+{
+    TestRedundant();
+    TestTextures();
+    TestUploadUnit();
+    TestInvalidate();
+    TestForget();
+    TestCounters();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,349 @@
+/* Ktx: KTX1 and KTX2 files built in memory, parsed into their level tables;
+ * byte swapped, truncated and mis-sized files and unsupported formats
+ * rejected; block rounding of compressed level sizes and the mip chain of
+ * odd and non-square images.
+ */
+#include "check.h"
+#include "graphics/ktx.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+    typedef std::vector<unsigned char> Bytes;
+
+    const unsigned char Ktx1Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+    const unsigned char Ktx2Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+    const uint32_t GL_RGB = 0x1907;
+    const uint32_t GL_RGB8 = 0x8051;
+    const uint32_t GL_UNSIGNED_BYTE = 0x1401;
+    const uint32_t COMPRESSED_RGB_S3TC_DXT1 = 0x83F0;
+
+    const uint32_t VK_ASTC_6x6_UNORM = 165;
+    const uint32_t VK_ASTC_6x6_SRGB = 166;
+    const uint32_t VK_BC1_RGB_UNORM = 131;
+
+    void Put32(Bytes& bytes, uint32_t value)
+    {
+        const size_t at = bytes.size();
+        bytes.resize(at + sizeof(value));
+        memcpy(&bytes[at], &value, sizeof(value));
+    }
+
+    void Put64(Bytes& bytes, uint64_t value)
+    {
+        const size_t at = bytes.size();
+        bytes.resize(at + sizeof(value));
+        memcpy(&bytes[at], &value, sizeof(value));
+    }
+
+    void Set32(Bytes& bytes, size_t at, uint32_t value)
+    {
+        memcpy(&bytes[at], &value, sizeof(value));
+    }
+
+    struct Ktx1
+    {
+        uint32_t endianness;
+        uint32_t glType;
+        uint32_t glFormat;
+        uint32_t glInternalFormat;
+        uint32_t width;
+        uint32_t height;
+        uint32_t faces;
+        uint32_t levels;
+        uint32_t keyValueBytes;
+        // imageSize of each level, the data is filled with the level index
+        std::vector<uint32_t> levelSizes;
+    };
+
+    Ktx1 Etc2(uint32_t width, uint32_t height)
+    {
+        Ktx1 ktx = {0x04030201, 0, 0, Ktx::RGB8_ETC2, width, height, 1, 0, 0, {}};
+        return ktx;
+    }
+
+    Bytes Build(const Ktx1& ktx)
+    {
+        Bytes bytes(Ktx1Identifier, Ktx1Identifier + sizeof(Ktx1Identifier));
+        Put32(bytes, ktx.endianness);
+        Put32(bytes, ktx.glType);
+        Put32(bytes, ktx.glType ? 1 : 0);
+        Put32(bytes, ktx.glFormat);
+        Put32(bytes, ktx.glInternalFormat);
+        Put32(bytes, ktx.glFormat ? ktx.glFormat : GL_RGB);
+        Put32(bytes, ktx.width);
+        Put32(bytes, ktx.height);
+        Put32(bytes, 0);
+        Put32(bytes, 0);
+        Put32(bytes, ktx.faces);
+        Put32(bytes, ktx.levels);
+        Put32(bytes, ktx.keyValueBytes);
+        bytes.resize(bytes.size() + ktx.keyValueBytes, 0);
+        for (size_t i = 0; i < ktx.levelSizes.size(); ++i)
+        {
+            Put32(bytes, ktx.levelSizes[i]);
+            bytes.resize(bytes.size() + ((ktx.levelSizes[i] + 3) & ~3u), (unsigned char)i);
+        }
+        return bytes;
+    }
+
+    struct Ktx2
+    {
+        uint32_t vkFormat;
+        uint32_t width;
+        uint32_t height;
+        uint32_t levels;
+        uint32_t supercompression;
+        // byteLength of each level; stored smallest first, as KTX2 lays them out
+        std::vector<uint64_t> levelSizes;
+    };
+
+    const size_t Ktx2HeaderSize = 80;
+    const size_t Ktx2LevelSize = 24;
+
+    Bytes Build(const Ktx2& ktx)
+    {
+        Bytes bytes(Ktx2Identifier, Ktx2Identifier + sizeof(Ktx2Identifier));
+        Put32(bytes, ktx.vkFormat);
+        Put32(bytes, 1);
+        Put32(bytes, ktx.width);
+        Put32(bytes, ktx.height);
+        Put32(bytes, 0);
+        Put32(bytes, 0);
+        Put32(bytes, 1);
+        Put32(bytes, ktx.levels);
+        Put32(bytes, ktx.supercompression);
+        for (int i = 0; i < 4; ++i)
+        {
+            Put32(bytes, 0);
+        }
+        Put64(bytes, 0);
+        Put64(bytes, 0);
+
+        uint64_t offset = Ktx2HeaderSize + Ktx2LevelSize * ktx.levelSizes.size();
+        std::vector<uint64_t> offsets(ktx.levelSizes.size());
+        for (size_t i = ktx.levelSizes.size(); i-- > 0;)
+        {
+            offsets[i] = offset;
+            offset += ktx.levelSizes[i];
+        }
+        for (size_t i = 0; i < ktx.levelSizes.size(); ++i)
+        {
+            Put64(bytes, offsets[i]);
+            Put64(bytes, ktx.levelSizes[i]);
+            Put64(bytes, ktx.levelSizes[i]);
+        }
+        bytes.resize(offset, 0);
+        return bytes;
+    }
+
+    bool Parse(const Bytes& bytes, Ktx::Image& image)
+    {
+        return Ktx::Parse(bytes.data(), bytes.size(), image);
+    }
+
+    // the first size bytes only
+    bool Parse(const Bytes& bytes, size_t size = ~size_t(0))
+    {
+        Ktx::Image image;
+        return Ktx::Parse(bytes.data(), std::min(size, bytes.size()), image);
+    }
+
+    void TestKtx1()
+    {
+        // 16x8 ETC2: 4x2, 2x1 and 1x1 blocks of 8 bytes, after 8 bytes of key/value data
+        Ktx1 ktx = Etc2(16, 8);
+        ktx.levels = 3;
+        ktx.keyValueBytes = 8;
+        ktx.levelSizes = {64, 16, 8};
+        const Bytes bytes = Build(ktx);
+        CHECK(Ktx::IsKtx(bytes.data(), bytes.size()));
+
+        Ktx::Image image;
+        CHECK(Parse(bytes, image));
+        CHECK(image.container == Ktx::Container::Ktx1);
+        CHECK(image.glInternalFormat == Ktx::RGB8_ETC2 && image.compressed);
+        CHECK(image.width == 16 && image.height == 8 && !image.generateMipmaps);
+        CHECK(image.levels.size() == 3);
+        if (image.levels.size() == 3)
+        {
+            CHECK(image.levels[0].offset == 64 + 8 + 4 && image.levels[0].size == 64);
+            CHECK(image.levels[1].offset == 64 + 8 + 4 + 64 + 4 && image.levels[1].size == 16);
+            CHECK(image.levels[2].width == 4 && image.levels[2].height == 2 && image.levels[2].size == 8);
+            CHECK(bytes[image.levels[2].offset] == 2);
+        }
+
+        // no levels given: the base level is there, the loader builds the rest
+        ktx.levels = 0;
+        ktx.levelSizes = {64};
+        CHECK(Parse(Build(ktx), image));
+        CHECK(image.generateMipmaps && image.levels.size() == 1);
+
+        // uncompressed rows are padded to 4 bytes: 3 pixels of RGB8 take 12
+        Ktx1 rgb = {0x04030201, GL_UNSIGNED_BYTE, GL_RGB, GL_RGB8, 3, 2, 1, 1, 0, {24}};
+        CHECK(Parse(Build(rgb), image));
+        CHECK(!image.compressed && image.glFormat == GL_RGB && image.glType == GL_UNSIGNED_BYTE);
+        CHECK(image.levels.size() == 1 && image.levels[0].size == 24);
+        rgb.levelSizes = {17};
+        CHECK(!Parse(Build(rgb)));
+    }
+
+    void TestKtx1Rejected()
+    {
+        Ktx1 ktx = Etc2(16, 8);
+        ktx.levels = 2;
+        ktx.levelSizes = {64, 16};
+        CHECK(Parse(Build(ktx)));
+
+        // written on the other endianness
+        Ktx1 swapped = ktx;
+        swapped.endianness = 0x01020304;
+        CHECK(!Parse(Build(swapped)));
+
+        // cut anywhere: in the header, in a size field, in the data
+        const Bytes bytes = Build(ktx);
+        CHECK(!Parse(bytes, 40));
+        CHECK(!Parse(bytes, 64 + 4 + 64 + 2));
+        CHECK(!Parse(bytes, bytes.size() - 1));
+
+        // a compressed level has exactly the size of its blocks
+        Ktx1 oversized = ktx;
+        oversized.levelSizes = {72, 16};
+        CHECK(!Parse(Build(oversized)));
+        Ktx1 undersized = ktx;
+        undersized.levelSizes = {64, 8};
+        CHECK(!Parse(Build(undersized)));
+
+        // a size field larger than what follows
+        Bytes huge = Build(ktx);
+        Set32(huge, 64, 0xFFFFFFF0);
+        CHECK(!Parse(huge));
+
+        // formats without a known block layout, or with a glType that says otherwise
+        Ktx1 dxt = ktx;
+        dxt.glInternalFormat = COMPRESSED_RGB_S3TC_DXT1;
+        CHECK(!Parse(Build(dxt)));
+        Ktx1 typed = ktx;
+        typed.glType = GL_UNSIGNED_BYTE;
+        CHECK(!Parse(Build(typed)));
+
+        // cube maps, and more levels than down to 1x1
+        Ktx1 cube = ktx;
+        cube.faces = 6;
+        CHECK(!Parse(Build(cube)));
+        Ktx1 deep = ktx;
+        deep.levels = 6;
+        deep.levelSizes = {64, 16, 8, 8, 8, 8};
+        CHECK(!Parse(Build(deep)));
+
+        const unsigned char png[12] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n', 0, 0, 0, 0};
+        CHECK(!Ktx::IsKtx(png, sizeof(png)));
+        CHECK(!Parse(Bytes(png, png + sizeof(png))));
+    }
+
+    void TestKtx2()
+    {
+        // 20x13 ASTC 6x6: 4x3 blocks, then 10x6 in 2x1 blocks, of 16 bytes
+        Ktx2 ktx = {VK_ASTC_6x6_UNORM, 20, 13, 2, 0, {192, 32}};
+        const Bytes bytes = Build(ktx);
+        CHECK(Ktx::IsKtx(bytes.data(), bytes.size()));
+
+        Ktx::Image image;
+        CHECK(Parse(bytes, image));
+        CHECK(image.container == Ktx::Container::Ktx2);
+        CHECK(image.glInternalFormat == Ktx::RGBA_ASTC_4x4 + 4);
+        CHECK(image.compressed && image.glFormat == 0 && image.glType == 0);
+        CHECK(image.levels.size() == 2);
+        if (image.levels.size() == 2)
+        {
+            // the smallest level is stored first
+            CHECK(image.levels[1].offset == Ktx2HeaderSize + 2 * Ktx2LevelSize);
+            CHECK(image.levels[0].offset == image.levels[1].offset + 32);
+            CHECK(image.levels[0].size == 192 && image.levels[1].size == 32);
+            CHECK(image.levels[1].width == 10 && image.levels[1].height == 6);
+        }
+
+        ktx.vkFormat = VK_ASTC_6x6_SRGB;
+        CHECK(Parse(Build(ktx), image));
+        CHECK(image.glInternalFormat == Ktx::SRGB8_ALPHA8_ASTC_4x4 + 4);
+
+        ktx.levels = 0;
+        ktx.levelSizes = {192};
+        CHECK(Parse(Build(ktx), image));
+        CHECK(image.generateMipmaps && image.levels.size() == 1);
+    }
+
+    void TestKtx2Rejected()
+    {
+        const Ktx2 ktx = {VK_ASTC_6x6_UNORM, 20, 13, 2, 0, {192, 32}};
+        const Bytes bytes = Build(ktx);
+        CHECK(Parse(bytes));
+
+        Ktx2 supercompressed = ktx;
+        supercompressed.supercompression = 1;
+        CHECK(!Parse(Build(supercompressed)));
+
+        Ktx2 bc = ktx;
+        bc.vkFormat = VK_BC1_RGB_UNORM;
+        CHECK(!Parse(Build(bc)));
+
+        Ktx2 oversized = ktx;
+        oversized.levelSizes = {208, 32};
+        CHECK(!Parse(Build(oversized)));
+
+        // the level index, then the data, cut short
+        CHECK(!Parse(bytes, Ktx2HeaderSize + Ktx2LevelSize + 8));
+        CHECK(!Parse(bytes, bytes.size() - 1));
+
+        // a level pointing past the end
+        Bytes past = bytes;
+        const uint64_t offset = past.size();
+        memcpy(&past[Ktx2HeaderSize], &offset, sizeof(offset));
+        CHECK(!Parse(past));
+    }
+
+    void TestSizes()
+    {
+        CHECK(Ktx::FullMipCount(1, 1) == 1);
+        CHECK(Ktx::FullMipCount(16, 8) == 5);
+        CHECK(Ktx::FullMipCount(17, 5) == 5);
+        CHECK(Ktx::FullMipCount(1, 300) == 9);
+
+        // halved and rounded down, never below 1
+        CHECK(Ktx::MipDimension(13, 0) == 13);
+        CHECK(Ktx::MipDimension(13, 1) == 6);
+        CHECK(Ktx::MipDimension(13, 2) == 3);
+        CHECK(Ktx::MipDimension(13, 4) == 1);
+        CHECK(Ktx::MipDimension(300, 5) == 9);
+        CHECK(Ktx::MipDimension(7, 40) == 1);
+
+        // partial blocks count as whole ones
+        Ktx::BlockInfo block;
+        CHECK(Ktx::GetBlockInfo(Ktx::RGB8_ETC2, block));
+        CHECK(Ktx::LevelSize(block, 1, 1) == 8);
+        CHECK(Ktx::LevelSize(block, 5, 5) == 32);
+        CHECK(Ktx::GetBlockInfo(Ktx::RGBA8_ETC2_EAC, block));
+        CHECK(Ktx::LevelSize(block, 6, 2) == 32);
+        CHECK(Ktx::GetBlockInfo(Ktx::RGBA_ASTC_12x12, block));
+        CHECK(block.width == 12 && block.height == 12 && block.bytes == 16);
+        CHECK(Ktx::LevelSize(block, 13, 1) == 32);
+        CHECK(Ktx::GetBlockInfo(Ktx::RGBA_ASTC_4x4 + 5, block));
+        CHECK(block.width == 8 && block.height == 5);
+        CHECK(Ktx::LevelSize(block, 9, 9) == 64);
+        CHECK(Ktx::GetBlockInfo(GL_RGB8, block));
+        CHECK(Ktx::LevelSize(block, 3, 3) == 27);
+        CHECK(!Ktx::GetBlockInfo(COMPRESSED_RGB_S3TC_DXT1, block));
+    }
+}
+
+int main()
+{
+    TestKtx1();
+    TestKtx1Rejected();
+    TestKtx2();
+    TestKtx2Rejected();
+    TestSizes();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,130 @@
+/* OverlayFileSystem: the writable layer over read-only ones, filesystems
+ * mounted in the layers found through the overlay's own mount index, and
+ * the bound on remembered misses.
+ */
+#include "check.h"
+#include "utils/fs_overlay.h"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+namespace {
+    std::shared_ptr<Vfs::PosixFileSystem> Directory(const std::string& root, const std::string& name)
+    {
+        std::shared_ptr<Vfs::PosixFileSystem> fs = std::make_shared<Vfs::PosixFileSystem>(root + "/" + name, true);
+        fs->Create(".keep");
+        return fs;
+    }
+
+    void Put(Vfs::PosixFileSystem& fs, const std::string& path, const char* text)
+    {
+        std::shared_ptr<Vfs::PosixFile> file = fs.Create(path);
+        CHECK(file && file->Write(text, int(strlen(text))) == int64_t(strlen(text)));
+    }
+
+    std::string Contents(const std::string& path)
+    {
+        std::shared_ptr<Vfs::VirtualFile> file = Vfs::Open<Vfs::VirtualFile>(path);
+        if (!file)
+        {
+            return "<missing>";
+        }
+        std::string contents(size_t(file->Size()), '\0');
+        file->ReadAt(0, &contents[0], int64_t(contents.size()));
+        return contents;
+    }
+
+    void TestLayers(const std::string& root)
+    {
+        std::shared_ptr<Vfs::PosixFileSystem> writable = Directory(root, "writable");
+        std::shared_ptr<Vfs::PosixFileSystem> upper = Directory(root, "upper");
+        std::shared_ptr<Vfs::PosixFileSystem> lower = Directory(root, "lower");
+        Put(*upper, "a", "upper a");
+        Put(*lower, "a", "lower a");
+        Put(*lower, "b", "lower b");
+
+        // mounted in the layers before the overlay is made, "both" in each
+        std::shared_ptr<Vfs::PosixFileSystem> upperMount = Directory(root, "upper-mount");
+        std::shared_ptr<Vfs::PosixFileSystem> lowerMount = Directory(root, "lower-mount");
+        std::shared_ptr<Vfs::PosixFileSystem> lowerOnly = Directory(root, "lower-only");
+        Put(*upperMount, "file", "upper mount");
+        Put(*lowerMount, "file", "lower mount");
+        Put(*lowerOnly, "deep/file", "lower only");
+        upper->Mount("both", upperMount);
+        lower->Mount("both", lowerMount);
+        lower->Mount("lower/only", lowerOnly);
+
+        Vfs::OverlayFileSystem overlay(writable, {upper, lower});
+        Vfs::SetRoot(&overlay);
+
+        CHECK(Contents("a") == "upper a");
+        CHECK(Contents("b") == "lower b");
+        CHECK(Contents("c") == "<missing>");
+        CHECK(Contents("both/file") == "upper mount");
+        CHECK(Contents("lower/only/deep/file") == "lower only");
+        CHECK(Vfs::Exists("lower/only/deep/file"));
+
+        // the writable layer hides the others, until it's removed again
+        std::shared_ptr<Vfs::PosixFile> created = overlay.Create("b");
+        CHECK(created && created->Write("new b", 5) == 5);
+        CHECK(Contents("b") == "new b");
+        CHECK(overlay.Remove("b"));
+        CHECK(Contents("b") == "lower b");
+
+        // mounted behind the overlay's back: seen after Invalidate()
+        std::shared_ptr<Vfs::PosixFileSystem> late = Directory(root, "late");
+        Put(*late, "file", "late");
+        lower->Mount("late", late);
+        CHECK(Contents("late/file") == "<missing>");
+        overlay.Invalidate();
+        CHECK(Contents("late/file") == "late");
+        CHECK(Contents("both/file") == "upper mount");
+
+        // the overlay's own mounts win over the layers'
+        std::shared_ptr<Vfs::PosixFileSystem> own = Directory(root, "own");
+        Put(*own, "file", "own");
+        overlay.Mount("both", own);
+        CHECK(Contents("both/file") == "own");
+        CHECK(Contents("late/file") == "late");
+
+        Vfs::SetRoot(nullptr);
+    }
+
+    void TestMisses(const std::string& root)
+    {
+        std::shared_ptr<Vfs::PosixFileSystem> writable = Directory(root, "misses");
+        Vfs::OverlayFileSystem overlay(writable, {});
+
+        // remembered as missing, so written behind the overlay's back it isn't seen
+        CHECK(!overlay.Exists("probe"));
+        Put(*writable, "probe", "here");
+        CHECK(!overlay.Exists("probe"));
+
+        // until more misses than are kept push it out
+        for (size_t i = 0; i < Vfs::OverlayFileSystem::MaxMisses; i++)
+        {
+            CHECK(!overlay.Exists("missing/" + std::to_string(i)));
+        }
+        CHECK(overlay.Exists("probe"));
+    }
+}
+
+int main()
+{
+    char directory[] = "/tmp/overlay_test.XXXXXX";
+    if (!mkdtemp(directory))
+    {
+        return 1;
+    }
+
+    TestLayers(directory);
+    TestMisses(directory);
+
+    const int result = CHECK_RESULT();
+    const std::string remove = std::string("rm -rf ") + directory;
+    if (system(remove.c_str()) != 0)
+    {
+        return 1;
+    }
+    return result;
+}
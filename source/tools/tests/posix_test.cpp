@@ -0,0 +1,102 @@
+/* PosixFileSystem: the write modes of Create(), read-only Open(), and files
+ * that don't say how large they are, read until EOF.
+ */
+#include "check.h"
+#include "utils/fs_posix.h"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+
+namespace {
+    std::string Contents(Vfs::PosixFileSystem& fs, const std::string& path)
+    {
+        std::shared_ptr<Vfs::VirtualFile> file = fs.Open(path);
+        if (!file)
+        {
+            return "<missing>";
+        }
+        std::string contents((size_t)file->Size(), '\0');
+        CHECK(file->ReadAt(0, &contents[0], (int64_t)contents.size()) == (int64_t)contents.size());
+        return contents;
+    }
+
+    bool Write(Vfs::PosixFileSystem& fs, const std::string& path, Vfs::WriteMode mode, const char* text)
+    {
+        std::shared_ptr<Vfs::PosixFile> file = fs.Create(path, mode);
+        return file && file->Write(text, (int)strlen(text)) == (int64_t)strlen(text);
+    }
+
+    void TestWriteModes(const std::string& directory)
+    {
+        Vfs::PosixFileSystem fs(directory, true);
+        CHECK(Write(fs, "a/b/file", Vfs::WriteMode::Truncate, "hello"));
+        CHECK(Contents(fs, "a/b/file") == "hello");
+        CHECK(Write(fs, "a/b/file", Vfs::WriteMode::Update, "J"));
+        CHECK(Contents(fs, "a/b/file") == "Jello");
+        CHECK(Write(fs, "a/b/file", Vfs::WriteMode::Append, ", world"));
+        CHECK(Contents(fs, "a/b/file") == "Jello, world");
+        CHECK(Write(fs, "a/b/file", Vfs::WriteMode::Truncate, "bye"));
+        CHECK(Contents(fs, "a/b/file") == "bye");
+        // created by the ones that keep it, too
+        CHECK(Write(fs, "appended", Vfs::WriteMode::Append, "new"));
+        CHECK(Contents(fs, "appended") == "new");
+
+        std::shared_ptr<Vfs::PosixFile> updated = fs.Create("a/b/file", Vfs::WriteMode::Update);
+        CHECK(updated && updated->Size() == 3 && updated->Tell() == 0 && !updated->IsMapped());
+        std::shared_ptr<Vfs::PosixFile> appended = fs.Create("a/b/file", Vfs::WriteMode::Append);
+        CHECK(appended && appended->Tell() == 3);
+
+        // Open() is read-only even on a writable filesystem
+        std::shared_ptr<Vfs::PosixFile> opened = std::static_pointer_cast<Vfs::PosixFile>(fs.Open("a/b/file"));
+        CHECK(opened && !opened->IsWritable() && opened->IsMapped());
+        CHECK(opened && opened->Write("x", 1) == -1);
+        CHECK(opened && opened->Data().size == 3);
+
+        Vfs::PosixFileSystem readOnly(directory);
+        CHECK(!readOnly.Create("other", Vfs::WriteMode::Truncate));
+        CHECK(!readOnly.Create("a/b/file", Vfs::WriteMode::Append));
+        CHECK(Contents(readOnly, "a/b/file") == "bye");
+    }
+
+    void TestUnsized(const std::string& directory)
+    {
+        Vfs::PosixFileSystem fs(directory, true);
+        CHECK(Write(fs, "empty", Vfs::WriteMode::Truncate, ""));
+        std::shared_ptr<Vfs::VirtualFile> empty = fs.Open("empty");
+        CHECK(empty && empty->Size() == 0 && empty->Data().size == 0);
+
+        // says it's empty, isn't
+        Vfs::PosixFileSystem proc("/proc/self");
+        std::shared_ptr<Vfs::PosixFile> status = std::static_pointer_cast<Vfs::PosixFile>(proc.Open("status"));
+        CHECK(status != nullptr);
+        if (status)
+        {
+            char name[5] = {};
+            CHECK(status->Read(name, 5) == 5 && memcmp(name, "Name:", 5) == 0);
+            CHECK(status->Size() > 5);
+            CHECK(status->Data().size == (size_t)status->Size());
+            CHECK(status->ReadAt(status->Size(), name, 1) == 0);
+        }
+    }
+}
+
+int main()
+{
+    char directory[] = "/tmp/posix_test.XXXXXX";
+    if (!mkdtemp(directory))
+    {
+        return 1;
+    }
+
+    TestWriteModes(directory);
+    TestUnsized(directory);
+
+    const int result = CHECK_RESULT();
+    const std::string remove = std::string("rm -rf ") + directory;
+    if (system(remove.c_str()) != 0)
+    {
+        return 1;
+    }
+    return result;
+}
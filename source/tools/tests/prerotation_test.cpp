@@ -0,0 +1,175 @@
+/* PreRotation: the matrices and rectangles for the four quarter turns,
+ * against values worked out by hand.
+ */
+#include "check.h"
+#include "graphics/prerotation.h"
+#include <algorithm>
+#include <cmath>
+
+using PreRotation::Rotation;
+
+namespace {
+    const Rotation g_Rotations[] = { Rotation::Identity, Rotation::Rotate90, Rotation::Rotate180, Rotation::Rotate270 };
+
+    bool Equal(const float a[16], const float b[16])
+    {
+        for (int i = 0; i < 16; ++i)
+        {
+            if (std::fabs(a[i] - b[i]) > 1e-6f)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool Equal(const PreRotation::Rect& a, const PreRotation::Rect& b)
+    {
+        return a.x == b.x && a.y == b.y && a.width == b.width && a.height == b.height;
+    }
+
+    // where window pixel (x, y) ends up in the swapchain image
+    void NativePoint(Rotation rotation, const PreRotation::Extent& window, int32_t x, int32_t y, int32_t& nativeX, int32_t& nativeY)
+    {
+        const int32_t width = (int32_t)window.width;
+        const int32_t height = (int32_t)window.height;
+        switch (rotation)
+        {
+        case Rotation::Rotate90:
+            nativeX = height - 1 - y;
+            nativeY = x;
+            break;
+        case Rotation::Rotate180:
+            nativeX = width - 1 - x;
+            nativeY = height - 1 - y;
+            break;
+        case Rotation::Rotate270:
+            nativeX = y;
+            nativeY = width - 1 - x;
+            break;
+        default:
+            nativeX = x;
+            nativeY = y;
+            break;
+        }
+    }
+
+    void TestExtent()
+    {
+        const PreRotation::Extent window = {1920, 1080};
+        for (Rotation rotation : g_Rotations)
+        {
+            const PreRotation::Extent native = PreRotation::NativeExtent(window, rotation);
+            const bool swaps = rotation == Rotation::Rotate90 || rotation == Rotation::Rotate270;
+            CHECK(PreRotation::SwapsExtent(rotation) == swaps);
+            CHECK(native.width == (swaps ? 1080u : 1920u));
+            CHECK(native.height == (swaps ? 1920u : 1080u));
+        }
+    }
+
+    void TestMatrices()
+    {
+        // column-major, so each group of four is a column
+        const float expected[4][16] = {
+            { 1, 0, 0, 0,   0, 1, 0, 0,   0, 0, 1, 0,   0, 0, 0, 1 },
+            { 0, 1, 0, 0,  -1, 0, 0, 0,   0, 0, 1, 0,   0, 0, 0, 1 },
+            {-1, 0, 0, 0,   0,-1, 0, 0,   0, 0, 1, 0,   0, 0, 0, 1 },
+            { 0,-1, 0, 0,   1, 0, 0, 0,   0, 0, 1, 0,   0, 0, 0, 1 },
+        };
+
+        for (unsigned i = 0; i < 4; ++i)
+        {
+            float matrix[16];
+            PreRotation::Matrix(g_Rotations[i], matrix);
+            CHECK(Equal(matrix, expected[i]));
+        }
+    }
+
+    void TestApply()
+    {
+        // an orthographic projection for 200 x 100, y down, with a translation
+        const float projection[16] = {
+            2.0f / 200.0f, 0.0f, 0.0f, 0.0f,
+            0.0f, -2.0f / 100.0f, 0.0f, 0.0f,
+            0.0f, 0.0f, -1.0f, 0.0f,
+            -1.0f, 1.0f, 0.0f, 1.0f,
+        };
+
+        // each column (x, y, z, w) becomes (x, y) rotated: 90 (-y, x), 180 (-x, -y), 270 (y, -x)
+        float expected[4][16];
+        for (int column = 0; column < 4; ++column)
+        {
+            const float* in = projection + column * 4;
+            const float rotated[4][2] = { { in[0], in[1] }, { -in[1], in[0] }, { -in[0], -in[1] }, { in[1], -in[0] } };
+            for (int i = 0; i < 4; ++i)
+            {
+                expected[i][column * 4 + 0] = rotated[i][0];
+                expected[i][column * 4 + 1] = rotated[i][1];
+                expected[i][column * 4 + 2] = in[2];
+                expected[i][column * 4 + 3] = in[3];
+            }
+        }
+
+        for (unsigned i = 0; i < 4; ++i)
+        {
+            float out[16];
+            PreRotation::Apply(g_Rotations[i], projection, out);
+            CHECK(Equal(out, expected[i]));
+
+            // in place
+            float inPlace[16];
+            std::copy(projection, projection + 16, inPlace);
+            PreRotation::Apply(g_Rotations[i], inPlace, inPlace);
+            CHECK(Equal(inPlace, expected[i]));
+        }
+
+        // two quarter turns make a half turn
+        float once[16];
+        float twice[16];
+        PreRotation::Apply(Rotation::Rotate90, projection, once);
+        PreRotation::Apply(Rotation::Rotate90, once, twice);
+        CHECK(Equal(twice, expected[2]));
+    }
+
+    void TestRects()
+    {
+        const PreRotation::Extent window = {200, 100};
+        const PreRotation::Rect rect = {10, 20, 30, 40};
+
+        CHECK(Equal(PreRotation::NativeRect(rect, window, Rotation::Identity), PreRotation::Rect{10, 20, 30, 40}));
+        // {H - y - h, x, h, w}
+        CHECK(Equal(PreRotation::NativeRect(rect, window, Rotation::Rotate90), PreRotation::Rect{40, 10, 40, 30}));
+        // {W - x - w, H - y - h, w, h}
+        CHECK(Equal(PreRotation::NativeRect(rect, window, Rotation::Rotate180), PreRotation::Rect{160, 40, 30, 40}));
+        // {y, W - x - w, h, w}
+        CHECK(Equal(PreRotation::NativeRect(rect, window, Rotation::Rotate270), PreRotation::Rect{20, 160, 40, 30}));
+
+        for (Rotation rotation : g_Rotations)
+        {
+            // the whole window is the whole image
+            const PreRotation::Extent native = PreRotation::NativeExtent(window, rotation);
+            const PreRotation::Rect all = PreRotation::NativeRect(PreRotation::Rect{0, 0, window.width, window.height}, window, rotation);
+            CHECK(Equal(all, PreRotation::Rect{0, 0, native.width, native.height}));
+
+            // a single pixel lands where the rotation puts it, corners included
+            const int32_t points[][2] = { {0, 0}, {199, 0}, {0, 99}, {199, 99}, {10, 20}, {150, 70} };
+            for (const int32_t* point : points)
+            {
+                int32_t x;
+                int32_t y;
+                NativePoint(rotation, window, point[0], point[1], x, y);
+                const PreRotation::Rect pixel = PreRotation::NativeRect(PreRotation::Rect{point[0], point[1], 1, 1}, window, rotation);
+                CHECK(Equal(pixel, PreRotation::Rect{x, y, 1, 1}));
+            }
+        }
+    }
+}
+
+int main()
+{
+    TestExtent();
+    TestMatrices();
+    TestApply();
+    TestRects();
+    return CHECK_RESULT();
+}
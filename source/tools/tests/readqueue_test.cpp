@@ -0,0 +1,159 @@
+/* ReadQueue: reads through a POSIX root, coalescing, Cancel(), and Wait()
+ * against a Poll() running on another thread, where every request has to
+ * be delivered exactly once by whichever of them claimed it.
+ */
+#include "check.h"
+#include "utils/fs_posix.h"
+#include "utils/vfs_async.h"
+#include <atomic>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    const int64_t g_FileSize = 256 * 1024;
+
+    void TestReads()
+    {
+        Vfs::ReadQueue queue(2);
+        std::vector<unsigned char> whole;
+        int64_t chunkOffset = -1;
+        size_t chunkSize = 0;
+        bool failed = false;
+
+        const Vfs::RequestId file = queue.ReadFile("data", Vfs::Priority::Blocking, [&](Vfs::ReadResult& result) { whole = result.data; });
+        CHECK(queue.Wait(file));
+        CHECK(whole.size() == size_t(g_FileSize));
+        CHECK(whole.size() == size_t(g_FileSize) && whole[1000] == (unsigned char)(1000 * 7));
+
+        const Vfs::RequestId chunk = queue.Read("data", g_FileSize - 100, 4096, Vfs::Priority::Streaming,
+            [&](Vfs::ReadResult& result) { chunkOffset = result.offset; chunkSize = result.data.size(); });
+        CHECK(queue.Wait(chunk));
+        CHECK(chunkOffset == g_FileSize - 100 && chunkSize == 100);
+
+        const Vfs::RequestId missing = queue.ReadFile("missing", Vfs::Priority::Background, [&](Vfs::ReadResult& result) { failed = !result.ok; });
+        CHECK(!queue.Wait(missing));
+        CHECK(failed);
+
+        // delivered, or never there
+        CHECK(!queue.Wait(file));
+        CHECK(!queue.Wait(Vfs::InvalidRequest));
+        CHECK(!queue.Cancel(file));
+
+        const Vfs::ReadStats stats = queue.GetStats();
+        CHECK(stats.requested == 3 && stats.completed == 2 && stats.failed == 1);
+    }
+
+    void TestCoalescing()
+    {
+        // one worker, kept busy by the first read while the rest queue up behind it
+        Vfs::ReadQueue queue(1);
+        unsigned delivered = 0;
+        Vfs::ReadCallback count = [&delivered](Vfs::ReadResult& result) { delivered += result.ok ? 1 : 0; };
+        queue.ReadFile("data", Vfs::Priority::Blocking, count);
+        for (int64_t offset = 0; offset < g_FileSize; offset += 4096)
+        {
+            queue.Read("data", offset, 4096, Vfs::Priority::Streaming, count);
+        }
+        const Vfs::RequestId cancelled = queue.Read("data", 0, 1, Vfs::Priority::Background, count);
+        CHECK(queue.Cancel(cancelled));
+
+        const unsigned requests = 1 + unsigned(g_FileSize / 4096);
+        while (delivered < requests)
+        {
+            queue.Poll();
+            std::this_thread::yield();
+        }
+        while (queue.GetStats().cancelled == 0)
+        {
+            queue.Poll();
+            std::this_thread::yield();
+        }
+
+        const Vfs::ReadStats stats = queue.GetStats();
+        CHECK(delivered == requests);
+        CHECK(stats.cancelled == 1);
+        CHECK(stats.coalesced > 0);
+        CHECK(stats.reads + stats.coalesced <= requests + 1);
+    }
+
+    void TestWaitWhilePolling()
+    {
+        Vfs::ReadQueue queue(4);
+        const int requests = 20000;
+        std::vector<std::atomic<int> > deliveries(requests);
+        for (std::atomic<int>& count : deliveries)
+        {
+            count = 0;
+        }
+
+        std::vector<Vfs::RequestId> ids;
+        for (int i = 0; i < requests; i++)
+        {
+            ids.push_back(queue.Read("data", (i * 512) % g_FileSize, 512, Vfs::Priority::Streaming,
+                [&deliveries, i](Vfs::ReadResult&) { deliveries[i]++; }));
+        }
+
+        std::atomic<bool> stop(false);
+        std::thread poller([&queue, &stop]
+        {
+            while (!stop)
+            {
+                queue.Poll();
+            }
+        });
+
+        // each one either waited for here or delivered by the poller, never both
+        for (int i = 0; i < requests; i += 2)
+        {
+            queue.Wait(ids[i]);
+        }
+        while (queue.GetStats().completed < unsigned(requests))
+        {
+            std::this_thread::yield();
+        }
+        stop = true;
+        poller.join();
+
+        int once = 0;
+        for (std::atomic<int>& count : deliveries)
+        {
+            once += count == 1 ? 1 : 0;
+        }
+        CHECK(once == requests);
+        CHECK(queue.GetStats().completed == unsigned(requests));
+    }
+}
+
+int main()
+{
+    char directory[] = "/tmp/readqueue_test.XXXXXX";
+    if (!mkdtemp(directory))
+    {
+        return 1;
+    }
+
+    Vfs::PosixFileSystem root(directory, true);
+    std::vector<unsigned char> data(g_FileSize);
+    for (size_t i = 0; i < data.size(); i++)
+    {
+        data[i] = (unsigned char)(i * 7);
+    }
+    std::shared_ptr<Vfs::PosixFile> file = root.Create("data");
+    CHECK(file && file->Write(data.data(), int(data.size())) == g_FileSize);
+    file.reset();
+    Vfs::SetRoot(&root);
+
+    TestReads();
+    TestCoalescing();
+    TestWaitWhilePolling();
+
+    const int result = CHECK_RESULT();
+    const std::string remove = std::string("rm -rf ") + directory;
+    if (system(remove.c_str()) != 0)
+    {
+        return 1;
+    }
+    return result;
+}
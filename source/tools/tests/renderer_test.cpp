@@ -0,0 +1,184 @@
+/* Renderer: draw lists through the NullBackend, checking the FrameStats and
+ * the commands that get past the filtering, so a change to Execute that
+ * lets more state (or fewer draws) through shows up on a host.
+ */
+#include "check.h"
+#include "graphics/nullrenderer.h"
+#include <vector>
+
+using Renderer::DrawList;
+
+namespace {
+    bool Is(const DrawList::Command& command, DrawList::Op op, uint32_t a = 0, uint32_t b = 0, uint32_t c = 0, uint32_t d = 0)
+    {
+        return command.op == op && command.args[0] == a && command.args[1] == b && command.args[2] == c && command.args[3] == d;
+    }
+
+    struct Scene
+    {
+        Renderer::BufferId vertices;
+        Renderer::BufferId indices;
+        Renderer::TextureId textures[3];
+        Renderer::PipelineId pipelines[2];
+    };
+
+    Scene CreateScene(Renderer::NullBackend& backend)
+    {
+        const unsigned char pixels[4 * 4 * 4] = {};
+        Scene scene;
+        scene.vertices = backend.CreateBuffer(Renderer::BufferUsage::Vertex, 1 << 16, true);
+        scene.indices = backend.CreateBuffer(Renderer::BufferUsage::Index, 1 << 16, false);
+        for (Renderer::TextureId& texture : scene.textures)
+        {
+            texture = backend.CreateTexture(4, 4, pixels);
+        }
+        scene.pipelines[0] = backend.CreatePipeline({"sprite", Renderer::Blend::Alpha});
+        scene.pipelines[1] = backend.CreatePipeline({"sprite", Renderer::Blend::Additive});
+        return scene;
+    }
+
+    void TestRecorded()
+    {
+        Renderer::NullBackend backend;
+        CHECK(backend.Initialize(nullptr));
+        const Scene scene = CreateScene(backend);
+
+        DrawList list;
+        list.SetPipeline(scene.pipelines[0]);
+        list.SetVertexBuffer(scene.vertices);
+        list.SetIndexBuffer(scene.indices);
+        list.SetTexture(scene.textures[0]);
+        list.ClearScissor();
+        list.DrawIndexed(6);
+        // all redundant
+        list.SetPipeline(scene.pipelines[0]);
+        list.SetVertexBuffer(scene.vertices);
+        list.SetTexture(scene.textures[0]);
+        list.DrawIndexed(6, 6);
+        list.SetScissor(0, 0, 100, 50);
+        list.SetScissor(0, 0, 100, 50);
+        list.Draw(0);
+        list.Draw(3, 9);
+
+        CHECK(backend.BeginFrame());
+        backend.Submit(list);
+        const std::vector<DrawList::Command>& recorded = backend.Recorded();
+        CHECK(recorded.size() == 8);
+        if (recorded.size() == 8)
+        {
+            CHECK(Is(recorded[0], DrawList::Op::Pipeline, scene.pipelines[0]));
+            CHECK(Is(recorded[1], DrawList::Op::VertexBuffer, scene.vertices));
+            CHECK(Is(recorded[2], DrawList::Op::IndexBuffer, scene.indices));
+            CHECK(Is(recorded[3], DrawList::Op::Texture, scene.textures[0]));
+            CHECK(Is(recorded[4], DrawList::Op::DrawIndexed, 6));
+            CHECK(Is(recorded[5], DrawList::Op::DrawIndexed, 6, 6));
+            CHECK(Is(recorded[6], DrawList::Op::Scissor, 0, 0, 100, 50));
+            CHECK(Is(recorded[7], DrawList::Op::Draw, 3, 9));
+        }
+        backend.EndFrame();
+
+        const Renderer::FrameStats& stats = backend.GetStats();
+        CHECK(stats.commands == 14);
+        CHECK(stats.drawCalls == 3);
+        CHECK(stats.vertices == 15);
+        CHECK(stats.pipelineChanges == 1);
+        CHECK(stats.bufferChanges == 2);
+        CHECK(stats.textureChanges == 1);
+        CHECK(stats.scissorChanges == 1);
+        // the second pipeline, vertex buffer, texture and scissor, and ClearScissor at the start of a frame
+        CHECK(stats.redundant == 5);
+        CHECK(stats.invalid == 0);
+        // the resources were made before the frame, and count towards it
+        CHECK(stats.uploadBytes == 3 * 4 * 4 * 4);
+    }
+
+    void TestInvalid()
+    {
+        Renderer::NullBackend backend;
+        backend.Initialize(nullptr);
+        const Scene scene = CreateScene(backend);
+        backend.DestroyTexture(scene.textures[1]);
+
+        DrawList list;
+        // nothing bound yet
+        list.Draw(3);
+        list.SetPipeline(scene.pipelines[1]);
+        list.SetVertexBuffer(scene.vertices);
+        list.SetTexture(scene.textures[1]);
+        list.Draw(3);
+        list.SetTexture(scene.textures[2]);
+        list.Draw(3);
+        // no index buffer
+        list.DrawIndexed(3);
+        // an index buffer as the vertex buffer
+        list.SetVertexBuffer(scene.indices);
+        list.Draw(3);
+
+        backend.BeginFrame();
+        backend.Submit(list);
+        backend.EndFrame();
+        const Renderer::FrameStats& stats = backend.GetStats();
+        CHECK(stats.drawCalls == 1);
+        CHECK(stats.invalid == 4);
+        CHECK(backend.UpdateBuffer(scene.vertices, 0, nullptr, 1 << 16));
+        CHECK(!backend.UpdateBuffer(scene.vertices, 1, nullptr, 1 << 16));
+    }
+
+    // a gui-like frame over several lists and frames: the counts are what the
+    // state changes in it add up to, every frame the same
+    void TestFrames()
+    {
+        Renderer::NullBackend backend;
+        backend.Initialize(nullptr);
+        const Scene scene = CreateScene(backend);
+
+        std::vector<DrawList> lists(4);
+        for (size_t l = 0; l < lists.size(); ++l)
+        {
+            DrawList& list = lists[l];
+            list.SetPipeline(scene.pipelines[l % 2]);
+            list.SetVertexBuffer(scene.vertices, uint32_t(l) * 4096);
+            list.SetIndexBuffer(scene.indices, uint32_t(l) * 2048);
+            for (uint32_t i = 0; i < 250; ++i)
+            {
+                // a texture change every 10 draws, a scissor change every 50
+                list.SetTexture(scene.textures[(i / 10) % 3]);
+                list.SetScissor(0, int32_t(i / 50) * 10, 320, 10);
+                list.DrawIndexed(6, i * 6);
+            }
+        }
+
+        for (int frame = 0; frame < 3; ++frame)
+        {
+            backend.BeginFrame();
+            for (const DrawList& list : lists)
+            {
+                backend.Submit(list);
+            }
+            backend.EndFrame();
+
+            const Renderer::FrameStats& stats = backend.GetStats();
+            CHECK(stats.commands == 4 * (3 + 250 * 3));
+            CHECK(stats.drawCalls == 1000);
+            CHECK(stats.vertices == 6000);
+            CHECK(stats.pipelineChanges == 4);
+            CHECK(stats.bufferChanges == 8);
+            // state carries over from list to list: each ends on texture 0,
+            // which the next starts with, but on another scissor
+            CHECK(stats.textureChanges == 25 + 3 * 24);
+            CHECK(stats.scissorChanges == 4 * 5);
+            CHECK(stats.redundant == (1000 - 97) + (1000 - 20));
+            CHECK(stats.invalid == 0);
+            CHECK(backend.Recorded().size() == 4 + 8 + 97 + 20 + 1000);
+            CHECK(stats.uploadBytes == (frame == 0 ? 3 * 4 * 4 * 4 : 0));
+        }
+    }
+}
+
+int main()
+{
+    TestRecorded();
+    TestInvalid();
+    TestFrames();
+    return CHECK_RESULT();
+}
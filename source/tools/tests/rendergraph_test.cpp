@@ -0,0 +1,284 @@
+/* RenderGraph: compiled graphs executed against the RecordingBackend, for
+ * where barriers go, transient textures sharing memory, passes merged into
+ * subpasses on tilers, unused passes culled, and the load and store ops the
+ * render passes are begun with.
+ */
+#include "check.h"
+#include "graphics/rendergraph.h"
+
+using namespace RenderGraph;
+
+namespace {
+    typedef RecordingBackend::Event Event;
+
+    const TextureDesc Color = {256, 128, 0, false};
+    const TextureDesc Depth = {256, 128, 1, true};
+    const ClearValue Black = {{0.0f, 0.0f, 0.0f, 1.0f}, 1.0f, 0};
+
+    const Attachment* Find(const RecordingBackend::RecordedPass& pass, Resource resource)
+    {
+        for (const Attachment& attachment : pass.attachments)
+        {
+            if (attachment.resource == resource)
+            {
+                return &attachment;
+            }
+        }
+        return nullptr;
+    }
+
+    const Barrier* Find(const std::vector<Barrier>& barriers, Resource resource)
+    {
+        for (const Barrier& barrier : barriers)
+        {
+            if (barrier.resource == resource)
+            {
+                return &barrier;
+            }
+        }
+        return nullptr;
+    }
+
+    void TestBarriers()
+    {
+        // a texture rendered, then sampled into the swapchain image
+        Graph graph;
+        const Resource scene = graph.CreateTexture("scene", Color);
+        const Resource swapchain = graph.Import("swapchain", Color, Layout::Undefined, Layout::Present);
+        const unsigned draw = graph.AddPass("draw", nullptr);
+        graph.Write(draw, scene, Usage::ColorAttachment, Black);
+        const unsigned post = graph.AddPass("post", nullptr);
+        graph.Read(post, scene, Usage::Sampled);
+        graph.Write(post, swapchain, Usage::ColorAttachment);
+
+        RecordingBackend backend(false);
+        CHECK(graph.Compile(backend));
+        graph.Execute(backend);
+
+        const std::vector<Event> expected = {
+            Event::Barriers, Event::BeginPass, Event::EndPass,
+            Event::Barriers, Event::BeginPass, Event::EndPass,
+            Event::Barriers,
+        };
+        CHECK(backend.Events() == expected);
+
+        const std::vector<PhysicalPass>& passes = graph.PhysicalPasses();
+        CHECK(passes.size() == 2);
+        if (passes.size() != 2)
+        {
+            return;
+        }
+
+        // nothing to wait for the first time, only the layout
+        const Barrier* first = Find(passes[0].barriers, scene);
+        CHECK(first && first->oldLayout == Layout::Undefined && first->newLayout == Layout::ColorAttachment);
+        CHECK(first && first->srcAccess == AccessNone);
+
+        // sampling waits for the color writes of the pass before
+        const Barrier* sample = Find(passes[1].barriers, scene);
+        CHECK(sample && sample->oldLayout == Layout::ColorAttachment && sample->newLayout == Layout::ShaderReadOnly);
+        CHECK(sample && sample->srcStage == StageColorOutput && (sample->srcAccess & AccessColorWrite));
+        CHECK(sample && sample->dstStage == StageFragmentShader && sample->dstAccess == AccessShaderRead);
+        CHECK(!Find(passes[0].barriers, swapchain));
+
+        // and the swapchain image goes to present after everything
+        CHECK(graph.FinalBarriers().size() == 1);
+        const Barrier* present = Find(graph.FinalBarriers(), swapchain);
+        CHECK(present && present->oldLayout == Layout::ColorAttachment && present->newLayout == Layout::Present);
+        CHECK(present && (present->srcAccess & AccessColorWrite) && present->dstStage == StageBottom);
+    }
+
+    void TestAliasing()
+    {
+        // a chain of full-screen passes: a and c are never alive at the same time
+        Graph graph;
+        const Resource a = graph.CreateTexture("a", Color);
+        const Resource b = graph.CreateTexture("b", Color);
+        const Resource c = graph.CreateTexture("c", Color);
+        const Resource swapchain = graph.Import("swapchain", Color, Layout::Undefined, Layout::Present);
+        unsigned pass = graph.AddPass("a", nullptr);
+        graph.Write(pass, a, Usage::ColorAttachment, Black);
+        pass = graph.AddPass("b", nullptr);
+        graph.Read(pass, a, Usage::Sampled);
+        graph.Write(pass, b, Usage::ColorAttachment, Black);
+        pass = graph.AddPass("c", nullptr);
+        graph.Read(pass, b, Usage::Sampled);
+        graph.Write(pass, c, Usage::ColorAttachment, Black);
+        pass = graph.AddPass("present", nullptr);
+        graph.Read(pass, c, Usage::Sampled);
+        graph.Write(pass, swapchain, Usage::ColorAttachment);
+
+        RecordingBackend backend(false);
+        CHECK(graph.Compile(backend));
+
+        CHECK(graph.MemorySlots().size() == 2);
+        CHECK(graph.GetResource(a).memorySlot == graph.GetResource(c).memorySlot);
+        CHECK(graph.GetResource(a).memorySlot != graph.GetResource(b).memorySlot);
+        CHECK(graph.GetResource(swapchain).memorySlot == -1);
+
+        // c's first use waits for the last use of a, whose memory it takes over
+        const std::vector<PhysicalPass>& passes = graph.PhysicalPasses();
+        CHECK(passes.size() == 4);
+        if (passes.size() == 4)
+        {
+            const Barrier* takeover = Find(passes[2].barriers, c);
+            CHECK(takeover && takeover->aliased == a);
+            CHECK(takeover && takeover->oldLayout == Layout::Undefined);
+            CHECK(takeover && takeover->srcStage == StageFragmentShader);
+            CHECK(!Find(passes[1].barriers, b) || Find(passes[1].barriers, b)->aliased == InvalidResource);
+        }
+    }
+
+    // a g-buffer pass and a lighting pass reading it as input attachments
+    void BuildDeferred(Graph& graph, Resource& albedo, Resource& depth, Resource& swapchain, unsigned& debug)
+    {
+        albedo = graph.CreateTexture("albedo", Color);
+        depth = graph.CreateTexture("depth", Depth);
+        swapchain = graph.Import("swapchain", Color, Layout::Undefined, Layout::Present);
+        const Resource overlay = graph.CreateTexture("overlay", Color);
+
+        const unsigned gbuffer = graph.AddPass("gbuffer", nullptr);
+        graph.Write(gbuffer, albedo, Usage::ColorAttachment, Black);
+        graph.Write(gbuffer, depth, Usage::DepthAttachment, Black);
+
+        // writes something nobody reads
+        debug = graph.AddPass("debug", nullptr);
+        graph.Read(debug, albedo, Usage::Sampled);
+        graph.Write(debug, overlay, Usage::ColorAttachment, Black);
+
+        const unsigned lighting = graph.AddPass("lighting", nullptr);
+        graph.Read(lighting, albedo, Usage::InputAttachment);
+        graph.Read(lighting, depth, Usage::InputAttachment);
+        graph.Write(lighting, swapchain, Usage::ColorAttachment);
+    }
+
+    void TestMergeAndCull()
+    {
+        Graph graph;
+        Resource albedo, depth, swapchain;
+        unsigned debug;
+        BuildDeferred(graph, albedo, depth, swapchain, debug);
+
+        RecordingBackend backend(true);
+        CHECK(graph.Compile(backend));
+        graph.Execute(backend);
+
+        // the debug pass is culled, and doesn't keep the other two apart
+        CHECK(graph.IsCulled(debug));
+        CHECK(!graph.IsCulled(0));
+        CHECK(graph.PhysicalPasses().size() == 1);
+        const std::vector<Event> expected = {
+            Event::Barriers, Event::BeginPass, Event::NextSubpass, Event::EndPass, Event::Barriers,
+        };
+        CHECK(backend.Events() == expected);
+
+        if (graph.PhysicalPasses().size() == 1)
+        {
+            const PhysicalPass& pass = graph.PhysicalPasses()[0];
+            CHECK(pass.subpasses.size() == 2);
+            CHECK(pass.attachments.size() == 3);
+
+            // the lighting subpass waits for the g-buffer writes, inside the render pass
+            bool colorDependency = false;
+            for (const SubpassDependency& dependency : pass.dependencies)
+            {
+                CHECK(dependency.srcSubpass == 0 && dependency.dstSubpass == 1);
+                if ((dependency.srcAccess & AccessColorWrite) && (dependency.dstAccess & AccessInputAttachmentRead))
+                {
+                    colorDependency = true;
+                }
+            }
+            CHECK(colorDependency);
+        }
+
+        // the g-buffer never leaves tile memory
+        CHECK(graph.GetResource(albedo).transient);
+        CHECK(graph.GetResource(depth).transient);
+        CHECK(!graph.GetResource(swapchain).transient);
+    }
+
+    void TestLoadStore()
+    {
+        // merged on a tiler: the g-buffer is cleared and never stored,
+        // the swapchain image is fully written, so not loaded, and stored
+        {
+            Graph graph;
+            Resource albedo, depth, swapchain;
+            unsigned debug;
+            BuildDeferred(graph, albedo, depth, swapchain, debug);
+
+            RecordingBackend backend(true);
+            CHECK(graph.Compile(backend));
+            graph.Execute(backend);
+            CHECK(backend.RecordedPasses().size() == 1);
+            if (backend.RecordedPasses().size() == 1)
+            {
+                const RecordingBackend::RecordedPass& pass = backend.RecordedPasses()[0];
+                CHECK(pass.index == 0 && pass.subpasses == 2);
+                CHECK(pass.width == Color.width && pass.height == Color.height);
+
+                const Attachment* color = Find(pass, albedo);
+                CHECK(color && color->load == LoadOp::Clear && color->store == StoreOp::DontCare);
+                CHECK(color && color->clear.color[3] == 1.0f);
+                const Attachment* depthAttachment = Find(pass, depth);
+                CHECK(depthAttachment && depthAttachment->load == LoadOp::Clear && depthAttachment->store == StoreOp::DontCare);
+                const Attachment* target = Find(pass, swapchain);
+                CHECK(target && target->load == LoadOp::DontCare && target->store == StoreOp::Store);
+                CHECK(target && target->finalLayout == Layout::ColorAttachment);
+            }
+        }
+
+        // not merged: the g-buffer has to be stored for the next render pass, which loads it
+        {
+            Graph graph;
+            Resource albedo, depth, swapchain;
+            unsigned debug;
+            BuildDeferred(graph, albedo, depth, swapchain, debug);
+
+            RecordingBackend backend(false);
+            CHECK(graph.Compile(backend));
+            graph.Execute(backend);
+            CHECK(backend.RecordedPasses().size() == 2);
+            if (backend.RecordedPasses().size() == 2)
+            {
+                const Attachment* stored = Find(backend.RecordedPasses()[0], albedo);
+                CHECK(stored && stored->load == LoadOp::Clear && stored->store == StoreOp::Store);
+                const Attachment* loaded = Find(backend.RecordedPasses()[1], albedo);
+                CHECK(loaded && loaded->load == LoadOp::Load && loaded->store == StoreOp::DontCare);
+            }
+            CHECK(!graph.GetResource(albedo).transient);
+        }
+
+        // drawn over without a clear: what was there is loaded
+        {
+            Graph graph;
+            const Resource swapchain = graph.Import("swapchain", Color, Layout::Undefined, Layout::Present);
+            const unsigned clear = graph.AddPass("clear", nullptr);
+            graph.Write(clear, swapchain, Usage::ColorAttachment, Black);
+            const unsigned ui = graph.AddPass("ui", nullptr);
+            graph.Write(ui, swapchain, Usage::ColorAttachment);
+
+            RecordingBackend backend(false);
+            CHECK(graph.Compile(backend));
+            graph.Execute(backend);
+            CHECK(!graph.IsCulled(clear));
+            CHECK(backend.RecordedPasses().size() == 2);
+            if (backend.RecordedPasses().size() == 2)
+            {
+                const Attachment* first = Find(backend.RecordedPasses()[0], swapchain);
+                CHECK(first && first->load == LoadOp::Clear && first->store == StoreOp::Store);
+                const Attachment* second = Find(backend.RecordedPasses()[1], swapchain);
+                CHECK(second && second->load == LoadOp::Load && second->store == StoreOp::Store);
+            }
+        }
+    }
+}
+
+int main()
+{
+    TestBarriers();
+    TestAliasing();
+    TestMergeAndCull();
+    TestLoadStore();
+    return CHECK_RESULT();
+}
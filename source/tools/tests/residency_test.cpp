@@ -0,0 +1,343 @@
+/* Residency: the policy against the FakeBackend, tail-first streaming,
+ * upgrades only for what is drawn, chains over the upload limit still
+ * streamed, eviction under the budget, stall accounting, and a random run
+ * that checks the books always balance.
+ */
+#include "check.h"
+#include "graphics/residency.h"
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+    // 32 + 16 + 4 + 1 bytes; with 8 tail bytes the tail is levels 2 and 3
+    const std::vector<uint64_t> g_Levels = {64, 16, 4, 1};
+    const Residency::Settings g_Settings = {90, 1000, 8};
+
+    bool Calls(Residency::FakeBackend& backend, const std::vector<std::string>& expected)
+    {
+        const bool same = backend.calls == expected;
+        if (!same)
+        {
+            for (const std::string& call : backend.calls)
+            {
+                std::fprintf(stderr, "  called: %s\n", call.c_str());
+            }
+        }
+        backend.calls.clear();
+        return same;
+    }
+
+    void TestTailFirst()
+    {
+        Residency::FakeBackend backend;
+        Residency::Manager manager(backend, g_Settings);
+        const Residency::TextureId texture = manager.Register(g_Levels);
+        CHECK(manager.ResidentLevel(texture) == 4);
+
+        // nothing resident: a stall for the tail, then one level more per frame it's drawn in
+        manager.BeginFrame();
+        CHECK(manager.Use(texture));
+        CHECK(manager.GetStats().stalls == 1);
+        CHECK(manager.ResidentLevel(texture) == 2);
+        manager.EndFrame();
+        CHECK(manager.ResidentLevel(texture) == 1);
+        CHECK(manager.GetStats().upgrades == 1);
+        CHECK(manager.GetStats().uploadedBytes == 5 + 21);
+        CHECK(Calls(backend, {"resident 0 from 2", "resident 0 from 1"}));
+
+        manager.BeginFrame();
+        CHECK(manager.Use(texture));
+        CHECK(manager.GetStats().stalls == 0);
+        manager.EndFrame();
+        CHECK(manager.ResidentLevel(texture) == 0);
+        CHECK(manager.GetStats().residentBytes == 85);
+        CHECK(Calls(backend, {"resident 0 from 0"}));
+
+        // fully resident, nothing left to do
+        manager.BeginFrame();
+        CHECK(manager.Use(texture));
+        manager.EndFrame();
+        CHECK(Calls(backend, {}));
+    }
+
+    void TestUpgradeOnUse()
+    {
+        Residency::Settings settings = g_Settings;
+        settings.budgetBytes = 1000;
+        Residency::FakeBackend backend;
+        Residency::Manager manager(backend, settings);
+        const Residency::TextureId a = manager.Register(g_Levels);
+        const Residency::TextureId b = manager.Register(g_Levels);
+
+        manager.BeginFrame();
+        manager.Use(a);
+        manager.Use(b);
+        manager.EndFrame();
+        backend.calls.clear();
+
+        // b isn't drawn, so it stays as it is
+        manager.BeginFrame();
+        manager.Use(a);
+        manager.EndFrame();
+        CHECK(manager.ResidentLevel(a) == 0);
+        CHECK(manager.ResidentLevel(b) == 1);
+        CHECK(Calls(backend, {"resident 0 from 0"}));
+
+        // a tighter budget evicts the least recently used one, b, right away;
+        // drawn again b stalls for its tail, and its upgrade evicts a, which isn't drawn
+        manager.SetBudget(90);
+        manager.BeginFrame();
+        manager.Use(b);
+        manager.EndFrame();
+        CHECK(Calls(backend, {"evict 1", "resident 1 from 2", "evict 0", "resident 1 from 1"}));
+        CHECK(manager.ResidentLevel(a) == 4);
+        CHECK(manager.ResidentLevel(b) == 1);
+    }
+
+    void TestUploadLimit()
+    {
+        Residency::Settings settings = g_Settings;
+        settings.budgetBytes = 1000;
+        // room for one level 1 upgrade a frame
+        settings.uploadBytesPerFrame = 30;
+        Residency::FakeBackend backend;
+        Residency::Manager manager(backend, settings);
+        const Residency::TextureId a = manager.Register(g_Levels);
+        const Residency::TextureId b = manager.Register(g_Levels);
+
+        manager.BeginFrame();
+        manager.Use(a);
+        manager.EndFrame();
+        backend.calls.clear();
+
+        // b stalls for its tail and is the blurriest, so it gets the upload, a waits
+        manager.BeginFrame();
+        manager.Use(a);
+        manager.Use(b);
+        manager.EndFrame();
+        CHECK(manager.ResidentLevel(a) == 1);
+        CHECK(manager.ResidentLevel(b) == 1);
+        CHECK(Calls(backend, {"resident 1 from 2", "resident 1 from 1"}));
+        CHECK(manager.GetStats().uploadedBytes == 26);
+    }
+
+    void TestChainOverLimit()
+    {
+        Residency::Settings settings = g_Settings;
+        settings.budgetBytes = 1000;
+        // less than any chain past the tail
+        settings.uploadBytesPerFrame = 10;
+        Residency::FakeBackend backend;
+        Residency::Manager manager(backend, settings);
+        const Residency::TextureId a = manager.Register(g_Levels);
+        const Residency::TextureId b = manager.Register(g_Levels);
+
+        // the stall already uploaded the tail this frame
+        manager.BeginFrame();
+        manager.Use(a);
+        manager.EndFrame();
+        CHECK(manager.ResidentLevel(a) == 2);
+        CHECK(Calls(backend, {"resident 0 from 2"}));
+
+        // alone in a frame it goes anyway, one level a frame
+        manager.BeginFrame();
+        manager.Use(a);
+        manager.EndFrame();
+        CHECK(manager.ResidentLevel(a) == 1);
+        CHECK(manager.GetStats().uploadedBytes == 21);
+        CHECK(Calls(backend, {"resident 0 from 1"}));
+
+        // but nothing more after it: b's tail is uploaded, its upgrade waits
+        manager.BeginFrame();
+        manager.Use(a);
+        manager.Use(b);
+        manager.EndFrame();
+        CHECK(manager.ResidentLevel(a) == 1);
+        CHECK(manager.ResidentLevel(b) == 2);
+        CHECK(Calls(backend, {"resident 1 from 2"}));
+
+        manager.BeginFrame();
+        manager.Use(a);
+        manager.Use(b);
+        manager.EndFrame();
+        CHECK(manager.ResidentLevel(a) == 1);
+        CHECK(manager.ResidentLevel(b) == 1);
+        CHECK(Calls(backend, {"resident 1 from 1"}));
+
+        manager.BeginFrame();
+        manager.Use(a);
+        manager.EndFrame();
+        CHECK(manager.ResidentLevel(a) == 0);
+        CHECK(manager.GetStats().uploadedBytes == 85);
+        CHECK(manager.GetStats().upgrades == 1);
+    }
+
+    void TestEviction()
+    {
+        Residency::Settings settings = g_Settings;
+        settings.budgetBytes = 50;
+        Residency::FakeBackend backend;
+        Residency::Manager manager(backend, settings);
+        std::vector<Residency::TextureId> textures;
+        for (int i = 0; i < 3; ++i)
+        {
+            textures.push_back(manager.Register(g_Levels));
+        }
+
+        // 21 bytes each after a frame; the third needs the least recently used one gone
+        for (Residency::TextureId texture : textures)
+        {
+            manager.BeginFrame();
+            manager.Use(texture);
+            manager.EndFrame();
+        }
+        CHECK(Calls(backend, {
+            "resident 0 from 2", "resident 0 from 1",
+            "resident 1 from 2", "resident 1 from 1",
+            "resident 2 from 2", "evict 0", "resident 2 from 1",
+        }));
+        CHECK(manager.ResidentLevel(textures[0]) == 4);
+        CHECK(manager.GetStats().residentBytes == 42);
+        CHECK(manager.GetStats().residentTextures == 2);
+        CHECK(manager.GetStats().evictions == 1);
+
+        // what is drawn in a frame is never evicted for another texture drawn in it:
+        // the tail still fits, the upgrades don't
+        manager.BeginFrame();
+        CHECK(manager.Use(textures[1]));
+        CHECK(manager.Use(textures[2]));
+        CHECK(manager.Use(textures[0]));
+        manager.EndFrame();
+        CHECK(Calls(backend, {"resident 0 from 2"}));
+        CHECK(manager.GetStats().evictions == 0);
+        CHECK(manager.GetStats().upgrades == 0);
+        CHECK(manager.GetStats().residentBytes == 47);
+
+        // a lower budget evicts right away
+        manager.SetBudget(10);
+        CHECK(manager.GetStats().residentBytes <= 10);
+        manager.SetBudget(0);
+        CHECK(manager.GetStats().residentBytes == 0);
+        CHECK(manager.GetStats().residentTextures == 0);
+    }
+
+    void TestFailures()
+    {
+        Residency::FakeBackend backend;
+        Residency::Manager manager(backend, g_Settings);
+        const Residency::TextureId texture = manager.Register(g_Levels);
+
+        manager.BeginFrame();
+        backend.failNext = true;
+        CHECK(!manager.Use(texture));
+        CHECK(manager.GetStats().stalls == 1);
+        CHECK(manager.ResidentLevel(texture) == 4);
+        CHECK(manager.GetStats().residentBytes == 0);
+        manager.EndFrame();
+
+        // a tail over the whole budget
+        Residency::Settings settings = g_Settings;
+        settings.budgetBytes = 2;
+        Residency::Manager small(backend, settings);
+        const Residency::TextureId big = small.Register(g_Levels);
+        small.BeginFrame();
+        CHECK(!small.Use(big));
+        small.EndFrame();
+
+        CHECK(manager.Register({}) == Residency::InvalidTexture);
+        CHECK(!manager.Use(12345));
+    }
+
+    uint64_t BytesFrom(const std::vector<uint64_t>& levels, uint32_t level)
+    {
+        uint64_t bytes = 0;
+        for (uint32_t i = level; i < levels.size(); ++i)
+        {
+            bytes += levels[i];
+        }
+        return bytes;
+    }
+
+    // random registering, drawing and budget changes; the manager's books
+    // have to match the textures' levels, and stay under the budget
+    void TestStress()
+    {
+        std::mt19937 random(42);
+        Residency::Settings settings = {4096, 2048, 256};
+        Residency::FakeBackend backend;
+        Residency::Manager manager(backend, settings);
+
+        std::vector<std::pair<Residency::TextureId, std::vector<uint64_t> > > textures;
+        for (int frame = 0; frame < 2000; ++frame)
+        {
+            if (textures.size() < 40 && random() % 4 == 0)
+            {
+                std::vector<uint64_t> levels;
+                for (uint64_t size = 4 << (random() % 9); size >= 1; size /= 4)
+                {
+                    levels.push_back(size);
+                }
+                textures.push_back(std::make_pair(manager.Register(levels), levels));
+            }
+            if (!textures.empty() && random() % 16 == 0)
+            {
+                const size_t index = random() % textures.size();
+                manager.Unregister(textures[index].first);
+                textures.erase(textures.begin() + index);
+            }
+            if (random() % 64 == 0)
+            {
+                settings.budgetBytes = 256 + random() % 8192;
+                manager.SetBudget(settings.budgetBytes);
+                CHECK(manager.GetStats().residentBytes <= settings.budgetBytes);
+            }
+
+            manager.BeginFrame();
+            uint32_t stalls = 0;
+            for (size_t i = 0; !textures.empty() && i < 8; ++i)
+            {
+                const auto& texture = textures[random() % textures.size()];
+                // a stall is drawing with nothing resident, and only that
+                if (manager.ResidentLevel(texture.first) == texture.second.size())
+                {
+                    stalls++;
+                }
+                if (manager.Use(texture.first))
+                {
+                    CHECK(manager.ResidentLevel(texture.first) < texture.second.size());
+                }
+            }
+            CHECK(manager.GetStats().stalls == stalls);
+            manager.EndFrame();
+
+            uint64_t bytes = 0;
+            uint32_t count = 0;
+            for (const auto& texture : textures)
+            {
+                const uint32_t level = manager.ResidentLevel(texture.first);
+                CHECK(level <= texture.second.size());
+                if (level < texture.second.size())
+                {
+                    bytes += BytesFrom(texture.second, level);
+                    count++;
+                }
+            }
+            CHECK(bytes == manager.GetStats().residentBytes);
+            CHECK(count == manager.GetStats().residentTextures);
+            CHECK(bytes <= settings.budgetBytes);
+        }
+    }
+}
+
+int main()
+{
+    TestTailFirst();
+    TestUpgradeOnUse();
+    TestUploadLimit();
+    TestChainOverLimit();
+    TestEviction();
+    TestFailures();
+    TestStress();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,163 @@
+/* FileWatcher: changes held back until the debounce time passed without
+ * another one, delivered in one batch with every path once, files that keep
+ * changing delivered after maxDelay anyway, and subscribers getting only the
+ * paths under their prefix.
+ */
+#include "check.h"
+#include "utils/fs_watch.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+namespace {
+    const unsigned DebounceMilliseconds = 50;
+    const unsigned MaxDelayMilliseconds = 200;
+
+    void Put(Vfs::PosixFileSystem& fs, const std::string& path, const char* text)
+    {
+        std::shared_ptr<Vfs::PosixFile> file = fs.Create(path);
+        CHECK(file && file->Write(text, int(strlen(text))) == int64_t(strlen(text)));
+    }
+
+    void Sleep(unsigned milliseconds)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+    }
+
+    // as the app does, once a frame; changes are timed from the poll that sees them
+    size_t PollFor(Vfs::FileWatcher& watcher, unsigned milliseconds)
+    {
+        size_t delivered = 0;
+        const Timewatcher polling = Timing::Start();
+        while (polling->GetNanoseconds() * 1000.0 < milliseconds)
+        {
+            delivered += watcher.Poll();
+            Sleep(5);
+        }
+        return delivered;
+    }
+
+    typedef std::vector<std::vector<std::string> > Batches;
+
+    void TestCoalesce(const std::string& root)
+    {
+        std::shared_ptr<Vfs::PosixFileSystem> fs = std::make_shared<Vfs::PosixFileSystem>(root + "/coalesce", true);
+        Vfs::FileWatcher watcher(fs, "mnt/", DebounceMilliseconds, MaxDelayMilliseconds);
+        CHECK(watcher.IsWatching());
+
+        Batches batches;
+        watcher.Subscribe("", [&batches](const std::vector<std::string>& paths) {
+            batches.push_back(paths);
+        });
+
+        // several saves, one of them twice, one in a directory made meanwhile
+        Put(*fs, "b", "1");
+        Put(*fs, "a", "1");
+        Put(*fs, "b", "2");
+        Put(*fs, "sub/c", "1");
+
+        // still within the debounce time
+        CHECK(watcher.Poll() == 0);
+        CHECK(batches.empty());
+
+        CHECK(PollFor(watcher, DebounceMilliseconds * 3) == 3);
+        CHECK(batches.size() == 1);
+        if (batches.size() == 1)
+        {
+            const std::vector<std::string> expected = {"mnt/a", "mnt/b", "mnt/sub/c"};
+            CHECK(batches[0] == expected);
+        }
+
+        // nothing since
+        CHECK(PollFor(watcher, DebounceMilliseconds * 3) == 0);
+        CHECK(batches.size() == 1);
+
+        const Vfs::FileWatcher::Stats stats = watcher.GetStats();
+        CHECK(stats.batches == 1);
+        CHECK(stats.changes == 3);
+        CHECK(stats.directories == 2);
+        CHECK(stats.overflows == 0);
+    }
+
+    void TestMaxDelay(const std::string& root)
+    {
+        std::shared_ptr<Vfs::PosixFileSystem> fs = std::make_shared<Vfs::PosixFileSystem>(root + "/maxdelay", true);
+        Vfs::FileWatcher watcher(fs, "", DebounceMilliseconds, MaxDelayMilliseconds);
+
+        size_t delivered = 0;
+        watcher.Subscribe("", [&delivered](const std::vector<std::string>& paths) {
+            delivered += paths.size();
+        });
+
+        // written more often than the debounce time, for longer than maxDelay
+        const Timewatcher writing = Timing::Start();
+        bool deliveredWhileWriting = false;
+        while (writing->GetNanoseconds() * 1000.0 < MaxDelayMilliseconds * 2)
+        {
+            Put(*fs, "busy", "again");
+            Sleep(DebounceMilliseconds / 5);
+            if (watcher.Poll() > 0)
+            {
+                deliveredWhileWriting = true;
+            }
+        }
+        CHECK(deliveredWhileWriting);
+        CHECK(delivered > 0);
+    }
+
+    void TestSubscriptions(const std::string& root)
+    {
+        std::shared_ptr<Vfs::PosixFileSystem> fs = std::make_shared<Vfs::PosixFileSystem>(root + "/subscriptions", true);
+        Vfs::FileWatcher watcher(fs, "", DebounceMilliseconds, MaxDelayMilliseconds);
+
+        Batches all;
+        Batches shaders;
+        watcher.Subscribe("", [&all](const std::vector<std::string>& paths) {
+            all.push_back(paths);
+        });
+        const Vfs::SubscriptionId shadersSubscription = watcher.Subscribe("shaders/", [&shaders](const std::vector<std::string>& paths) {
+            shaders.push_back(paths);
+        });
+
+        Put(*fs, "shaders/x.frag", "1");
+        Put(*fs, "textures/y.png", "1");
+        CHECK(PollFor(watcher, DebounceMilliseconds * 3) == 2);
+        CHECK(all.size() == 1 && all[0].size() == 2);
+        CHECK(shaders.size() == 1 && shaders[0] == std::vector<std::string>{"shaders/x.frag"});
+
+        // only the shaders changed, the other subscriber isn't called
+        Put(*fs, "shaders/x.frag", "2");
+        PollFor(watcher, DebounceMilliseconds * 3);
+        CHECK(shaders.size() == 2);
+        CHECK(all.size() == 2);
+
+        watcher.Unsubscribe(shadersSubscription);
+        Put(*fs, "shaders/x.frag", "3");
+        PollFor(watcher, DebounceMilliseconds * 3);
+        CHECK(shaders.size() == 2);
+        CHECK(all.size() == 3);
+    }
+}
+
+int main()
+{
+    char directory[] = "/tmp/watcher_test.XXXXXX";
+    if (!mkdtemp(directory))
+    {
+        return 1;
+    }
+
+    TestCoalesce(directory);
+    TestMaxDelay(directory);
+    TestSubscriptions(directory);
+
+    const int result = CHECK_RESULT();
+    const std::string remove = std::string("rm -rf ") + directory;
+    if (system(remove.c_str()) != 0)
+    {
+        return 1;
+    }
+    return result;
+}